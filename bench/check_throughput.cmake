@@ -0,0 +1,105 @@
+# Throughput gate for the guest workloads in bench/guests, run by CTest when SVM_BENCH_GATE is on:
+#
+#   cmake -DSVM=<Svm> -DGUESTS=<dir> -DBASELINE=<json> [-DTOLERANCE=30] [-DREPEAT=5] [-DMIPS=OFF] [-DUPDATE=ON]
+#         -P check_throughput.cmake
+#
+# Every guest has to halt after the baseline's instruction count with the baseline's AX, and run at no less than
+# TOLERANCE percent below its baseline MIPS. MIPS=OFF leaves out the timing, which is how every build checks the
+# results. UPDATE=ON rewrites the baseline from this run instead, for a new host or a change that is meant to move the
+# numbers.
+cmake_minimum_required(VERSION 3.20)
+
+foreach(myRequired SVM GUESTS BASELINE)
+    if(NOT DEFINED ${myRequired})
+        message(FATAL_ERROR "${myRequired} is not set")
+    endif()
+endforeach()
+if(NOT DEFINED TOLERANCE)
+    set(TOLERANCE 30)
+endif()
+if(NOT DEFINED REPEAT)
+    set(REPEAT 5)
+endif()
+if(NOT DEFINED MIPS)
+    set(MIPS ON)
+endif()
+
+file(GLOB myGuests "${GUESTS}/*.hex")
+list(SORT myGuests)
+execute_process(COMMAND "${SVM}" --json --repeat ${REPEAT} ${myGuests}
+                OUTPUT_VARIABLE myRun
+                RESULT_VARIABLE myStatus)
+message("${myRun}")
+if(NOT myStatus EQUAL 0)
+    message(FATAL_ERROR "a guest did not halt, Svm exited with ${myStatus}")
+endif()
+
+# MIPS are handled in hundredths since CMake only does integer math, string(JSON GET) hands numbers back with every
+# binary digit so they are rounded here
+function(hundredths aMips aResult)
+    string(REGEX MATCH "^([0-9]+)\\.?([0-9]*)" myMatch "${aMips}")
+    set(myFraction "${CMAKE_MATCH_2}000")
+    string(SUBSTRING "${myFraction}" 0 3 myFraction)
+    math(EXPR myValue "(${CMAKE_MATCH_1} * 1000 + 1${myFraction} - 1000 + 5) / 10")
+    set(${aResult} ${myValue} PARENT_SCOPE)
+endfunction()
+
+function(formatHundredths aValue aResult)
+    math(EXPR myWhole "${aValue} / 100")
+    math(EXPR myFraction "${aValue} % 100 + 100")
+    string(SUBSTRING "${myFraction}" 1 2 myFraction)
+    set(${aResult} "${myWhole}.${myFraction}" PARENT_SCOPE)
+endfunction()
+
+if(NOT UPDATE)
+    file(READ "${BASELINE}" myBaseline)
+endif()
+
+set(myFailures "")
+string(JSON myCount LENGTH "${myRun}" guests)
+math(EXPR myLast "${myCount} - 1")
+foreach(i RANGE ${myLast})
+    string(JSON myName GET "${myRun}" guests ${i} name)
+    string(JSON myInstructions GET "${myRun}" guests ${i} instructions)
+    string(JSON myAx GET "${myRun}" guests ${i} ax)
+    string(JSON myMips GET "${myRun}" guests ${i} mips)
+    hundredths(${myMips} myActual)
+    formatHundredths(${myActual} myMips)
+    if(UPDATE)
+        list(APPEND myEntries
+             "    \"${myName}\": {\"instructions\": ${myInstructions}, \"ax\": ${myAx}, \"mips\": ${myMips}}")
+        continue()
+    endif()
+
+    string(JSON myExpected ERROR_VARIABLE myMissing GET "${myBaseline}" guests ${myName})
+    if(myMissing)
+        list(APPEND myFailures "${myName}: no baseline, rerun with -DUPDATE=ON")
+        continue()
+    endif()
+    string(JSON myExpectedInstructions GET "${myExpected}" instructions)
+    string(JSON myExpectedAx GET "${myExpected}" ax)
+    string(JSON myExpectedMips GET "${myExpected}" mips)
+    if(NOT myInstructions EQUAL myExpectedInstructions OR NOT myAx EQUAL myExpectedAx)
+        list(APPEND myFailures "${myName}: ${myInstructions} instructions ending with AX=${myAx}, expected \
+${myExpectedInstructions} and ${myExpectedAx}")
+    endif()
+    if(NOT MIPS)
+        continue()
+    endif()
+    hundredths(${myExpectedMips} myFloor)
+    formatHundredths(${myFloor} myExpectedMips)
+    math(EXPR myFloor "${myFloor} * (100 - ${TOLERANCE}) / 100")
+    if(myActual LESS myFloor)
+        list(APPEND myFailures "${myName}: ${myMips} MIPS, baseline ${myExpectedMips} allows no less than \
+${TOLERANCE}% below")
+    endif()
+endforeach()
+
+if(UPDATE)
+    list(JOIN myEntries ",\n" myBaseline)
+    file(WRITE "${BASELINE}" "{\"guests\": {\n${myBaseline}\n}}\n")
+    message(STATUS "baseline written to ${BASELINE}")
+elseif(myFailures)
+    list(JOIN myFailures "\n" myReport)
+    message(FATAL_ERROR "${myReport}")
+endif()
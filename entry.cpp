@@ -1,7 +1,219 @@
+// Runs guest programs from files and reports how fast they ran.
+//
+//   Svm [--json] [--budget N] [--repeat N] [--trace FILE] [--profile FILE [--symbols FILE]] [--serial FILE] IMAGE...
+//
+// Every image runs in a fresh machine until it halts, --repeat keeps the fastest of N runs. --trace records the
+// emulator's timeline over all runs as Chrome trace JSON. --profile gives every image one more run, left out of the
+// timing, and writes the guest call graph of those runs, all images together, as collapsed stacks for a flame graph,
+// with functions named from the --symbols map, and prints the busiest functions. --serial attaches COM1 and writes
+// what the guests send it during their first timed run to FILE. The exit status is zero only when every program
+// halted within the budget.
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
 #include <iostream>
+#include <optional>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
 
-int main()
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "guest_profiler.hpp"
+#include "guest_program.hpp"
+#include "trace.hpp"
+
+namespace
+{
+struct Options
+{
+    bool theJson{};
+    std::size_t theBudget{svm::GuestProgram::DefaultBudget};
+    std::size_t theRepeat{1U};
+    std::filesystem::path theTrace;
+    std::filesystem::path theProfile;
+    std::filesystem::path theSymbols;
+    std::filesystem::path theSerial;
+    std::vector<std::filesystem::path> theImages;
+};
+
+bool parseCount(std::string_view aText, std::size_t &aCount)
+{
+    const auto [myEnd, myError] = std::from_chars(aText.data(), aText.data() + aText.size(), aCount);
+    return myError == std::errc{} && myEnd == aText.data() + aText.size() && aCount != 0;
+}
+
+bool parseOptions(int aArgc, char **aArgv, Options &aOptions)
+{
+    for (int i = 1; i < aArgc; ++i)
+    {
+        const std::string_view myArg{aArgv[i]};
+        if (myArg == "--json")
+        {
+            aOptions.theJson = true;
+        }
+        else if (myArg == "--budget" || myArg == "--repeat")
+        {
+            auto &myCount = myArg == "--budget" ? aOptions.theBudget : aOptions.theRepeat;
+            if (++i == aArgc || !parseCount(aArgv[i], myCount))
+            {
+                return false;
+            }
+        }
+        else if (myArg == "--trace" || myArg == "--profile" || myArg == "--symbols" || myArg == "--serial")
+        {
+            if (++i == aArgc)
+            {
+                return false;
+            }
+            auto &myPath = myArg == "--trace" ? aOptions.theTrace
+                           : myArg == "--profile" ? aOptions.theProfile
+                           : myArg == "--symbols" ? aOptions.theSymbols
+                                                  : aOptions.theSerial;
+            myPath = aArgv[i];
+        }
+        else if (myArg.starts_with("--"))
+        {
+            return false;
+        }
+        else
+        {
+            aOptions.theImages.emplace_back(myArg);
+        }
+    }
+    return !aOptions.theImages.empty() && (aOptions.theSymbols.empty() || !aOptions.theProfile.empty());
+}
+
+void printText(const std::filesystem::path &aImage, const svm::GuestProgram::Result &aResult)
 {
-    std::cout << "Hello World" << std::endl;
-    return 0;
+    std::cout << aImage.stem().string() << ": " << svm::TRAP_NAMES[std::to_underlying(aResult.theTrap)] << " after "
+              << aResult.theInstructions << " instructions in " << std::fixed << std::setprecision(3)
+              << aResult.theSeconds << " s, " << std::setprecision(1) << aResult.mips() << " MIPS, AX=" << std::hex
+              << std::uppercase << std::setw(4) << std::setfill('0') << aResult.theAX << std::dec << std::setfill(' ')
+              << '\n';
+}
+
+void printJson(const std::filesystem::path &aImage, const svm::GuestProgram::Result &aResult)
+{
+    std::cout << "    {\"name\": \"" << aImage.stem().string() << "\", \"trap\": \""
+              << svm::TRAP_NAMES[std::to_underlying(aResult.theTrap)] << "\", \"instructions\": "
+              << aResult.theInstructions << ", \"seconds\": " << std::fixed << std::setprecision(6)
+              << aResult.theSeconds << ", \"mips\": " << std::setprecision(2) << aResult.mips()
+              << ", \"ax\": " << aResult.theAX << '}';
+}
+} // namespace
+
+int main(int aArgc, char **aArgv)
+{
+    Options myOptions;
+    if (!parseOptions(aArgc, aArgv, myOptions))
+    {
+        std::cerr << "usage: " << aArgv[0] << " [--json] [--budget N] [--repeat N] [--trace FILE]"
+                  << " [--profile FILE [--symbols FILE]] [--serial FILE] IMAGE...\n";
+        return 2;
+    }
+
+    std::optional<svm::TraceSession> myTrace;
+    if (!myOptions.theTrace.empty())
+    {
+        myTrace.emplace();
+        svm::trace::nameThread("main");
+    }
+
+    std::optional<svm::GuestProfiler> myProfiler;
+    if (!myOptions.theProfile.empty())
+    {
+        myProfiler.emplace();
+        if (!myOptions.theSymbols.empty() && !myProfiler->loadSymbols(myOptions.theSymbols))
+        {
+            std::cerr << myOptions.theSymbols.string() << ": not a symbol map\n";
+            return 2;
+        }
+    }
+
+    int mySerial = -1;
+    if (!myOptions.theSerial.empty())
+    {
+        mySerial = ::open(myOptions.theSerial.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (mySerial < 0)
+        {
+            std::cerr << myOptions.theSerial.string() << ": cannot open the serial output\n";
+            return 2;
+        }
+    }
+
+    bool myAllHalted = true;
+    if (myOptions.theJson)
+    {
+        std::cout << "{\"guests\": [\n";
+    }
+    for (std::size_t i{}; i < myOptions.theImages.size(); ++i)
+    {
+        const auto &myPath = myOptions.theImages[i];
+        const auto myImage = svm::GuestProgram::load(myPath);
+        if (!myImage)
+        {
+            std::cerr << myPath.string() << ": not a guest image\n";
+            return 2;
+        }
+        if (myProfiler)
+        {
+            // The profiler slows every instruction down, its run only feeds the profile
+            std::ignore = svm::GuestProgram::run(*myImage, myOptions.theBudget, {}, &*myProfiler);
+        }
+        auto myBest = svm::GuestProgram::run(*myImage, myOptions.theBudget, {}, nullptr, mySerial);
+        for (std::size_t myRun = 1; myRun < myOptions.theRepeat; ++myRun)
+        {
+            const auto myResult = svm::GuestProgram::run(*myImage, myOptions.theBudget);
+            if (myResult.theSeconds < myBest.theSeconds)
+            {
+                myBest = myResult;
+            }
+        }
+        myAllHalted = myAllHalted && myBest.theTrap == svm::Trap::HALT;
+
+        if (myOptions.theJson)
+        {
+            printJson(myPath, myBest);
+            std::cout << (i + 1 < myOptions.theImages.size() ? ",\n" : "\n");
+        }
+        else
+        {
+            printText(myPath, myBest);
+        }
+    }
+    if (myOptions.theJson)
+    {
+        std::cout << "]}\n";
+    }
+    if (mySerial >= 0)
+    {
+        ::close(mySerial);
+    }
+    if (myProfiler)
+    {
+        if (!myOptions.theJson)
+        {
+            std::cout << myProfiler->formatTable(10);
+        }
+        if (!myProfiler->writeCollapsedFile(myOptions.theProfile))
+        {
+            std::cerr << myOptions.theProfile.string() << ": cannot write the profile\n";
+            return EXIT_FAILURE;
+        }
+    }
+    if (myTrace)
+    {
+        myTrace->stop();
+        if (!myTrace->writeFile(myOptions.theTrace))
+        {
+            std::cerr << myOptions.theTrace.string() << ": cannot write the trace\n";
+            return EXIT_FAILURE;
+        }
+    }
+    return myAllHalted ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,64 @@
+// libFuzzer target for guest programs. SVM_FUZZ_IMAGE names a flat binary loaded and started at 0000:0100, each input
+// is stored at 1000:0000 as a length word followed by the bytes. A guest crash aborts so libFuzzer keeps the input.
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+#include "fuzz_harness.hpp"
+#include "memory.hpp"
+#include "single_core.hpp"
+
+namespace
+{
+constexpr std::uint32_t LoadAddress = 0x100U;
+
+// libFuzzer reads this section as extra coverage counters next to its own
+__attribute__((section("__libfuzzer_extra_counters"))) std::array<std::uint8_t, 1U << 16> theCoverage;
+
+struct Target
+{
+    svm::RandomAccessMemory theMemory;
+    svm::SingleCore theCore{theMemory};
+    svm::FuzzHarness theHarness{theCore, theMemory, theCoverage};
+};
+
+std::unique_ptr<Target> theTarget;
+} // namespace
+
+extern "C" int LLVMFuzzerInitialize(int *, char ***)
+{
+    const char *myPath = std::getenv("SVM_FUZZ_IMAGE");
+    std::ifstream myFile{myPath != nullptr ? myPath : ""};
+    if (!myFile)
+    {
+        std::cerr << "SVM_FUZZ_IMAGE has to name the guest binary\n";
+        std::exit(EXIT_FAILURE);
+    }
+    const std::vector<std::uint8_t> myImage{std::istreambuf_iterator<char>{myFile}, {}};
+
+    theTarget = std::make_unique<Target>();
+    if (theTarget->theMemory.writeBlock({.theAddress = LoadAddress}, myImage) != svm::Trap::OK)
+    {
+        std::cerr << "guest binary does not fit in memory\n";
+        std::exit(EXIT_FAILURE);
+    }
+    theTarget->theCore.writeRegister(svm::arch::Regs::IP, LoadAddress);
+    theTarget->theCore.writeRegister(svm::arch::Regs::SP, 0xFFFE);
+    theTarget->theHarness.prepare();
+    return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t *aData, std::size_t aSize)
+{
+    const auto myTrap = theTarget->theHarness.execute({aData, aSize});
+    if (svm::FuzzHarness::isCrash(myTrap))
+    {
+        std::abort();
+    }
+    return 0;
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "decoder.hpp"
+#include "memory.hpp"
+#include "single_core.hpp"
+#include "trap.hpp"
+
+namespace svm
+{
+// One block of guest code translated to C++ ahead of time by SvmAot. The body runs the block's instructions as direct
+// SingleCore calls, except for the ones listed in theInterpreted which it hands to their decoded handlers. It stores
+// how many instructions retired, the faulting one included, and leaves CS:IP where the interpreter would.
+struct CompiledBlock
+{
+    using Body = Trap (*)(SingleCore &, const DecodedInst *, std::uint32_t &) noexcept;
+
+    std::uint16_t theSegment;
+    std::uint16_t theOffset;
+    // Guest bytes the block was translated from
+    std::span<const std::uint8_t> theBytes;
+    std::uint32_t theInstructions;
+    // Offsets of the instructions the body runs through the decoder's handlers, in block order
+    std::span<const std::uint16_t> theInterpreted;
+    Body theBody;
+};
+
+// Runs a core on compiled blocks, falling back to the interpreter for any CS:IP without one. Blocks are dropped for
+// good once the guest stores into their bytes or when their bytes do not match memory to begin with, and a block
+// runs only when no interrupt or replayed event falls due inside it. Breakpoints only hit in interpreted code.
+//
+// Only pages holding compiled bytes are observed, and a store there looks at the blocks of its page once it hits one
+// of their bytes, so data kept next to the code costs a bit test per store.
+struct AotRuntime : MemoryObserver
+{
+    struct Stats
+    {
+        std::uint64_t theCompiledBlocks;
+        std::uint64_t theInterpretedBlocks;
+        // Compiled blocks dropped because the guest stored into them
+        std::uint64_t theInvalidations;
+    };
+
+    ~AotRuntime() override;
+    AotRuntime(const AotRuntime &) = delete;
+    AotRuntime(AotRuntime &&) = delete;
+    AotRuntime &operator=(const AotRuntime &) = delete;
+
+    // The compiled program's image has to be in aMemory already
+    AotRuntime(SingleCore &aCore, RandomAccessMemory &aMemory, std::span<const CompiledBlock> aBlocks);
+
+    // Same contract as SingleCore::run
+    Trap run(std::size_t aBudget) noexcept;
+    void onWrite(arch::MemoryAddress aMemoryAddress, std::size_t aLength) noexcept override;
+
+    [[nodiscard]] const Stats &stats() const noexcept;
+
+  private:
+    static constexpr auto PageSize = RandomAccessMemory::PageSize;
+    static constexpr auto PageCount = RandomAccessMemory::PageCount;
+
+    // Successor seen after a block, followed without hashing while CS:IP matches
+    struct Link
+    {
+        // No block starts at FFFF:FFFF, no instruction fits there
+        std::uint32_t theKey{0xFFFFFFFFU};
+        std::size_t theIndex{};
+    };
+
+    struct Entry
+    {
+        const CompiledBlock *theBlock;
+        std::uint32_t theBegin;
+        std::uint32_t theEnd;
+        std::vector<DecodedInst> theInterpreted;
+        // Taken and fall-through edge of a conditional branch, the most recent target of anything else
+        std::array<Link, 2> theLinks;
+        bool theIsValid;
+    };
+
+    // Bytes of the page's valid blocks, and the blocks touching the page valid or not
+    struct CodePage
+    {
+        std::bitset<PageSize> theCodeBytes;
+        std::vector<std::size_t> theEntries;
+    };
+
+    // Entry for CS:IP after aFrom, nullptr when no valid block starts there
+    [[nodiscard]] Entry *find(Entry *aFrom) noexcept;
+    void addToPage(std::size_t aPage, std::size_t aEntry);
+    void rebuildCodeBytes(std::size_t aPage) noexcept;
+    [[nodiscard]] static std::pair<std::size_t, std::size_t> pagesOf(const Entry &aEntry) noexcept;
+
+    SingleCore &theCore;
+    RandomAccessMemory &theMemory;
+    std::vector<Entry> theEntries;
+    // CS:IP as one key, also the key of a link
+    std::unordered_map<std::uint32_t, std::size_t> theIndex;
+    std::array<std::unique_ptr<CodePage>, PageCount> thePages;
+    Stats theStats{};
+};
+} // namespace svm
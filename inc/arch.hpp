@@ -50,6 +50,12 @@ enum class RegLevel
     High
 };
 
+enum class OperandSize
+{
+    Byte,
+    Word
+};
+
 using Immediate = std::uint16_t;
 
 struct MemoryAddress
@@ -90,6 +96,75 @@ enum class Inst
            // of two packed BCD values.
     DEC,   // Decrement
     DIV,   // Unsigned divide.
+    F2XM1,   // 2 to the power of ST(0), minus 1. ST(0) must be in 0 to 0.5.
+    FABS,    // Absolute value of ST(0).
+    FADD,    // Add a real operand, or ST(i) and ST(0), into ST(0) or ST(i).
+    FADDP,   // Add ST(0) into ST(i) and pop.
+    FBLD,    // Push an 18 digit packed BCD integer.
+    FBSTP,   // Store ST(0) as an 18 digit packed BCD integer and pop.
+    FCHS,    // Change the sign of ST(0).
+    FCLEX,   // Clear the exception flags, ES and B of the status word.
+    FCOM,    // Compare ST(0) with a real operand or ST(i), sets C3, C2 and C0.
+    FCOMP,   // Compare like FCOM and pop.
+    FCOMPP,  // Compare ST(0) with ST(1) and pop both.
+    FDECSTP, // Decrement the stack top pointer, no register changes.
+    FDISI,   // Disable the 8087 interrupt request (sets IEM).
+    FDIV,    // Divide ST(0) by a real operand or ST(i), or ST(i) by ST(0).
+    FDIVP,   // Divide ST(i) by ST(0) and pop.
+    FDIVR,   // Reverse divide: the operand divided by ST(0), or ST(0) by ST(i).
+    FDIVRP,  // Divide ST(0) by ST(i) into ST(i) and pop.
+    FENI,    // Enable the 8087 interrupt request (clears IEM).
+    FFREE,   // Tag ST(i) empty.
+    FIADD,   // Add an integer operand to ST(0).
+    FICOM,   // Compare ST(0) with an integer operand.
+    FICOMP,  // Compare ST(0) with an integer operand and pop.
+    FIDIV,   // Divide ST(0) by an integer operand.
+    FIDIVR,  // Divide an integer operand by ST(0).
+    FILD,    // Push an integer operand.
+    FIMUL,   // Multiply ST(0) by an integer operand.
+    FINCSTP, // Increment the stack top pointer, no register changes.
+    FINIT,   // Reset the coprocessor: default control word, empty stack.
+    FIST,    // Store ST(0) as an integer rounded as the control word says.
+    FISTP,   // Store ST(0) as an integer and pop.
+    FISUB,   // Subtract an integer operand from ST(0).
+    FISUBR,  // Subtract ST(0) from an integer operand.
+    FLD,     // Push a real operand or ST(i).
+    FLD1,    // Push +1.0.
+    FLDCW,   // Load the control word.
+    FLDENV,  // Load the environment: control, status and tag words, pointers.
+    FLDL2E,  // Push log2(e).
+    FLDL2T,  // Push log2(10).
+    FLDLG2,  // Push log10(2).
+    FLDLN2,  // Push ln(2).
+    FLDPI,   // Push pi.
+    FLDZ,    // Push +0.0.
+    FMUL,    // Multiply ST(0) by a real operand or ST(i), or ST(i) by ST(0).
+    FMULP,   // Multiply ST(i) by ST(0) and pop.
+    FNOP,    // No Operation on the coprocessor.
+    FPATAN,  // Arctangent of ST(1) / ST(0) into ST(1), pop.
+    FPREM,   // Partial remainder of ST(0) divided by ST(1).
+    FPTAN,   // Partial tangent of ST(0), pushed as a ratio Y / X.
+    FRNDINT, // Round ST(0) to an integer as the control word says.
+    FRSTOR,  // Load the environment and all eight registers.
+    FSAVE,   // Store the environment and all eight registers, then FINIT.
+    FSCALE,  // Multiply ST(0) by 2 to the power of ST(1) truncated.
+    FSQRT,   // Square root of ST(0).
+    FST,     // Store ST(0) to a real operand or ST(i).
+    FSTCW,   // Store the control word.
+    FSTENV,  // Store the environment.
+    FSTP,    // Store ST(0) to a real operand or ST(i) and pop.
+    FSTSW,   // Store the status word.
+    FSUB,    // Subtract a real operand or ST(i) from ST(0), or ST(0) from ST(i).
+    FSUBP,   // Subtract ST(0) from ST(i) and pop.
+    FSUBR,   // Reverse subtract: ST(0) from the operand, or ST(i) from ST(0).
+    FSUBRP,  // Subtract ST(i) from ST(0) into ST(i) and pop.
+    FTST,    // Compare ST(0) with 0.0.
+    FXAM,    // Classify ST(0) into C3, C2, C1 and C0.
+    FXCH,    // Exchange ST(0) and ST(i).
+    FXTRACT, // Split ST(0) into exponent and significand, significand on top.
+    FYL2X,   // ST(1) times log2(ST(0)) into ST(1), pop.
+    FYL2XP1, // ST(1) times log2(ST(0) + 1) into ST(1), pop.
+    HCALL, // Hypercall, 0F 3F nn runs host routine nn. An emulator extension on 0F, POP CS on the 8086
     HLT,   // Halt the system
     IDIV,  // Signed divide
     IMUL,  // Signed Multiply
@@ -227,6 +302,7 @@ enum class Inst
     SUB,    // Subtract.
     TEST,   // Logical AND between all bits of two operands for flags only. These
             // flags are effected: ZF, SF, PF. Result is not stored anywhere.
+    WAIT,   // Wait until the coprocessor is idle.
     XCHG,   // Exchange values of two operands.
     XLATB,  // Translate byte from table. Copy value of memory byte at DS:[BX +
             // unsigned AL] to AL register.
@@ -0,0 +1,109 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "arch.hpp"
+#include "decoder.hpp"
+#include "memory.hpp"
+#include "perf_counters.hpp"
+#include "trap.hpp"
+
+namespace svm
+{
+struct SingleCore;
+
+// Runs one program on many machines in lockstep. Registers are stored structure-of-arrays, one array of lanes per
+// register, and each decoded instruction is applied to every lane sitting at the same address by kernels that work
+// on whole vectors of lanes. Lanes whose branches disagree are split: the group at the lowest address issues first
+// and the lanes left behind rejoin it once it reaches their address.
+//
+// Every lane owns a memory copied from the image. Instructions are decoded once from lane 0, so the code has to be
+// the same in every lane and must not be modified by the guest. MOV with a memory operand and the near stack forms
+// (PUSH, POP, CALL and RET) access each lane's memory in turn, other memory operands and instructions without a kernel
+// run lane by lane on a SingleCore bound to the lane's memory.
+struct BatchCore
+{
+    // Lanes handled per kernel iteration, sixteen words fill one AVX2 register
+    static constexpr std::size_t VectorLanes = 16U;
+    static constexpr std::size_t RegisterCount = std::to_underlying(arch::Regs::FLAG) + 1U;
+
+    struct Stats
+    {
+        // Instructions issued to a group of lanes
+        std::uint64_t theIssues;
+        // Lane instructions retired by the vector kernels and by the scalar fallback
+        std::uint64_t theVectorLaneSteps;
+        std::uint64_t theScalarLaneSteps;
+        // Issues after which the group's lanes were at different addresses
+        std::uint64_t theDivergences;
+    };
+
+    // Constructors
+    ~BatchCore();
+    BatchCore(const BatchCore &) = delete;
+    BatchCore(BatchCore &&) = delete;
+    BatchCore &operator=(const BatchCore &) = delete;
+
+    BatchCore(const RandomAccessMemory &aImage, std::size_t aLaneCount);
+
+    [[nodiscard]] std::size_t laneCount() const noexcept;
+    [[nodiscard]] RandomAccessMemory &memory(std::size_t aLane) noexcept;
+    [[nodiscard]] arch::Immediate readRegister(std::size_t aLane, arch::Regs aRegister) const noexcept;
+    void writeRegister(std::size_t aLane, arch::Regs aRegister, arch::Immediate aValue) noexcept;
+    // Same value in every lane
+    void writeRegister(arch::Regs aRegister, arch::Immediate aValue) noexcept;
+
+    // Issues up to aBudget instructions and returns how many lanes are still running. A lane stops at its first
+    // trap, HLT included, with IP where SingleCore would leave it.
+    std::size_t run(std::size_t aBudget) noexcept;
+    // Trap::OK while the lane is running
+    [[nodiscard]] Trap trap(std::size_t aLane) const noexcept;
+    [[nodiscard]] const Stats &stats() const noexcept;
+
+  private:
+    using Lanes = std::vector<std::uint16_t>;
+
+    void regroup() noexcept;
+    void issue(const DecodedInst &aInst) noexcept;
+    void issueBranch(const DecodedInst &aInst) noexcept;
+    void issueMove(const DecodedInst &aInst) noexcept;
+    void issueStack(const DecodedInst &aInst) noexcept;
+    void issueScalar(const DecodedInst &aInst) noexcept;
+    void advance(const DecodedInst &aInst) noexcept;
+    void follow() noexcept;
+    void stop(std::size_t aLane, Trap aTrap) noexcept;
+    [[nodiscard]] const DecodedInst &decoded(std::uint32_t aAddress);
+    [[nodiscard]] std::uint32_t linearAddress(std::size_t aLane) const noexcept;
+    [[nodiscard]] arch::MemoryAddress effectiveAddress(std::size_t aLane, const DecodedInst &aInst) const noexcept;
+    [[nodiscard]] SingleCore &scalarCore(std::size_t aLane);
+    [[nodiscard]] Lanes &lanes(arch::Regs aRegister) noexcept;
+
+    std::size_t theLaneCount;
+    // Lane arrays are padded to whole vectors, padding lanes never join a group
+    std::size_t thePaddedCount;
+    std::array<Lanes, RegisterCount> theRegisters;
+    // 0xFFFF for lanes in the group being issued, 0 for the others
+    Lanes theGroup;
+    Lanes theScratch;
+    std::vector<Trap> theTraps;
+    std::vector<std::unique_ptr<RandomAccessMemory>> theMemories;
+    std::vector<std::unique_ptr<SingleCore>> theScalarCores;
+    std::unordered_map<std::uint32_t, DecodedInst> theDecoded;
+    // Stack accesses of issueStack are counted here, nothing reads them
+    CoreCounters theStackCounters{};
+
+    std::size_t theRunning{};
+    std::size_t theGroupSize{};
+    // Lowest lane of the group, its CS:IP stands for the whole group
+    std::size_t theLeader{};
+    std::uint32_t theGroupAddress{};
+    // Lowest address among running lanes outside the group
+    std::uint32_t theWaitingAddress{};
+    bool theNeedsRegroup{true};
+    Stats theStats{};
+};
+} // namespace svm
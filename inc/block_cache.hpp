@@ -0,0 +1,139 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "arch.hpp"
+#include "decoder.hpp"
+#include "memory.hpp"
+#include "perf_counters.hpp"
+
+namespace svm
+{
+struct Block;
+
+// Successor entered without a lookup once the edge has been taken
+struct BlockLink
+{
+    static constexpr std::uint32_t NoTarget = std::numeric_limits<std::uint32_t>::max();
+
+    std::uint32_t theTarget{NoTarget};
+    Block *theBlock{};
+};
+
+// Straight line run of decoded instructions ending at the first control transfer.
+struct Block
+{
+    // How the successor of the block is found
+    enum class Exit : std::uint8_t
+    {
+        // Fallthrough, relative or direct far target, or none the cache can predict
+        Direct,
+        // Indirect CALL or JMP, theLinks[1] caches the last target
+        Indirect,
+        // RET or RETF, predicted from the return stack
+        Return,
+    };
+
+    std::uint32_t theBegin{};
+    std::uint32_t theEnd{};
+    // Holds a breakpoint, the run loop walks it instruction by instruction
+    bool theIsMarked{};
+    // Evicted, kept alive until the next lookup
+    bool theIsRetired{};
+    Exit theExit{Exit::Direct};
+    // Ends in a CALL, theLinks[0] is the return address
+    bool theIsCall{};
+    std::vector<DecodedInst> theInsts;
+    // Fallthrough and relative branch target, for blocks whose successors are known when decoded
+    std::array<BlockLink, 2> theLinks{};
+    // Blocks linked to this one, unlinked when it is evicted
+    std::vector<Block *> theLinkedFrom;
+};
+
+// Decoded blocks keyed by linear address. Stores into decoded bytes evict the blocks covering them, evicted blocks
+// stay alive until the next lookup so the block being executed is never freed under the run loop.
+//
+// Blocks ending in a fallthrough or a relative branch are chained: the first time the run loop goes from a block to
+// one of its static successors the two are linked, later trips follow the link without hashing. Evicting a block
+// unlinks it from both ends.
+//
+// Indirect CALL and JMP sites keep their last target in a link slot of their own, replaced when the target changes.
+// A block ending in a CALL is pushed on a shadow return stack as the run loop leaves it and a RET pops it again,
+// predicting the block linked at the caller's return address. Every prediction is checked against the CS:IP the
+// instruction actually produced, a wrong one only costs a lookup.
+//
+// Once shared, stores made by other host threads only mark the pages they hit and the owning core evicts those pages
+// on its next lookup, so one core never touches another core's blocks.
+struct BlockCache : MemoryObserver
+{
+    static constexpr std::size_t MaxBlockLength = 32U;
+    static constexpr std::size_t ReturnStackDepth = 32U;
+    static constexpr auto PageSize = RandomAccessMemory::PageSize;
+    static constexpr auto PageCount = RandomAccessMemory::PageCount;
+
+    ~BlockCache() override;
+    BlockCache(const BlockCache &) = delete;
+    BlockCache(BlockCache &&) = delete;
+    BlockCache &operator=(const BlockCache &) = delete;
+
+    BlockCache(RandomAccessMemory &aMemory, CoreCounters &aCounters);
+
+    [[nodiscard]] const Block &lookup(arch::MemoryAddress aAddress);
+    // Next block after aFrom, taken from aFrom's links when the edge was seen before and linked otherwise. aFrom may
+    // be null or retired.
+    [[nodiscard]] Block &follow(Block *aFrom, arch::MemoryAddress aAddress);
+    void flush() noexcept;
+    void invalidate(arch::MemoryAddress aAddress, std::size_t aLength) noexcept;
+    // Blocks touching a marked page are decoded with theIsMarked set
+    void markPage(std::size_t aPage, bool aIsMarked) noexcept;
+    [[nodiscard]] std::size_t size() const noexcept;
+
+    // For memory written by several cores at once
+    void share() noexcept;
+    // Makes this the cache whose own stores are handled in place on the calling thread
+    void enter() noexcept;
+
+    void onWrite(arch::MemoryAddress aAddress, std::size_t aLength) noexcept override;
+
+  private:
+    struct CodePage
+    {
+        std::bitset<PageSize> theCodeBytes;
+        std::vector<Block *> theBlocks;
+    };
+
+    Block &find(std::uint32_t aAddress);
+    Block &decode(std::uint32_t aAddress);
+    static void link(Block &aFrom, Block &aTo) noexcept;
+    static void cacheTarget(Block &aFrom, Block &aTo) noexcept;
+    [[nodiscard]] static Block *linked(const Block &aFrom, std::uint32_t aAddress) noexcept;
+    void pushReturn(Block &aCaller) noexcept;
+    [[nodiscard]] Block *popReturn() noexcept;
+    void addToPage(std::size_t aPage, Block &aBlock);
+    void retire(Block &aBlock) noexcept;
+    void rebuildCodeBytes(CodePage &aPage, std::size_t aPageIndex) noexcept;
+    void applyRemoteWrites() noexcept;
+
+    static thread_local BlockCache *theEntered;
+
+    RandomAccessMemory &theMemory;
+    CoreCounters &theCounters;
+    std::unordered_map<std::uint32_t, std::unique_ptr<Block>> theBlocks;
+    std::array<std::unique_ptr<CodePage>, PageCount> thePages;
+    std::bitset<PageCount> theMarkedPages;
+    std::vector<std::unique_ptr<Block>> theRetired;
+    // Blocks ending in a CALL not returned from yet, oldest overwritten first
+    std::array<Block *, ReturnStackDepth> theReturnStack{};
+    std::size_t theReturnDepth{};
+
+    bool theIsShared{};
+    std::atomic<bool> theHasRemoteWrites{};
+    std::array<std::atomic<std::uint64_t>, PageCount / 64> theRemoteWrites{};
+};
+} // namespace svm
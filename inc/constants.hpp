@@ -14,6 +14,9 @@ constexpr const std::size_t SIGN_BIT_MASK = 0x8000U;
 constexpr const std::size_t MEMORY_BUS_ALIGNMENT = 0x10U;
 constexpr const std::size_t CHAR_SIZE = 8U;
 constexpr const std::size_t BYTE_MASK = 0xFF;
+constexpr const std::size_t WORD_SIZE = 2U;
+constexpr const std::size_t PAGE_SIZE = 0x1000U;
+constexpr const std::size_t SEGMENT_SIZE = 0x10000U;
 } // namespace constants
 
 } // namespace svm
@@ -0,0 +1,79 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include "arch.hpp"
+#include "memory.hpp"
+
+namespace svm
+{
+struct SingleCore;
+
+// Breakpoints mark the code pages they live on so only blocks decoded from those pages are walked instruction by
+// instruction, watchpoints ride on the per page observer flags of RandomAccessMemory. With nothing armed neither the
+// run loop nor the memory fast path does any extra work.
+struct Debugger : MemoryObserver
+{
+    struct Location
+    {
+        std::uint16_t theSegment;
+        std::uint16_t theOffset;
+
+        bool operator==(const Location &) const = default;
+    };
+
+    struct WatchHit
+    {
+        arch::MemoryAddress theAddress;
+        std::size_t theLength;
+        MemoryObserver::Access theAccess;
+    };
+
+    // Callbacks return true to stop the run loop
+    using BreakpointCallback = std::function<bool(const Location &)>;
+    using WatchpointCallback = std::function<bool(const WatchHit &)>;
+
+    ~Debugger() override;
+    Debugger(const Debugger &) = delete;
+    Debugger(Debugger &&) = delete;
+    Debugger &operator=(const Debugger &) = delete;
+
+    Debugger(SingleCore &aCore, RandomAccessMemory &aMemory);
+
+    void addBreakpoint(Location aLocation);
+    void removeBreakpoint(Location aLocation);
+    void addWatchpoint(arch::MemoryAddress aAddress, std::size_t aLength, std::uint8_t aAccess);
+    void removeWatchpoint(arch::MemoryAddress aAddress, std::size_t aLength);
+    void onBreakpoint(BreakpointCallback aCallback);
+    void onWatchpoint(WatchpointCallback aCallback);
+
+    // Asked by the core before each instruction of a marked block
+    [[nodiscard]] bool shouldBreak(Location aLocation) noexcept;
+
+    void onWrite(arch::MemoryAddress aAddress, std::size_t aLength) noexcept override;
+    void onRead(arch::MemoryAddress aAddress, std::size_t aLength) noexcept override;
+
+  private:
+    struct Watchpoint
+    {
+        std::uint32_t theBegin;
+        std::uint32_t theEnd;
+        std::uint8_t theAccess;
+    };
+
+    static std::size_t pageOf(Location aLocation) noexcept;
+    void reportAccess(arch::MemoryAddress aAddress, std::size_t aLength, MemoryObserver::Access aAccess) noexcept;
+    void rearmWatchpoints();
+
+    SingleCore &theCore;
+    RandomAccessMemory &theMemory;
+    std::vector<Location> theBreakpoints;
+    std::vector<Watchpoint> theWatchpoints;
+    BreakpointCallback theBreakpointCallback;
+    WatchpointCallback theWatchpointCallback;
+    // Location we last stopped at, skipped once so resuming does not stop again immediately
+    std::optional<Location> theResumeLocation;
+};
+} // namespace svm
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+
+#include "arch.hpp"
+#include "memory.hpp"
+#include "trap.hpp"
+
+namespace svm
+{
+struct SingleCore;
+
+// One guest instruction with its operands already resolved, executed by calling theHandler.
+struct DecodedInst
+{
+    using Handler = Trap (*)(SingleCore &, const DecodedInst &) noexcept;
+
+    enum OperandFlag : std::uint8_t
+    {
+        HasBase = 1U << 0,
+        HasIndex = 1U << 1,
+    };
+
+    // Operand shape the handler was picked for, lets executors other than SingleCore read the fields below
+    enum class Form : std::uint8_t
+    {
+        Other,
+        RegReg,
+        RegImm,
+        RegMem,
+        MemReg,
+        MemImm,
+        Reg,
+        Mem,
+        Relative,
+    };
+
+    Handler theHandler{};
+    arch::Inst theInst{arch::Inst::NOP};
+    Form theForm{Form::Other};
+    std::uint8_t theLength{};
+    std::uint8_t theOperandFlags{};
+    bool theEndsBlock{};
+    // LOCK prefix seen, memory forms were given locked handlers
+    bool theIsLocked{};
+    arch::Regs theFirst{arch::Regs::AX};
+    arch::Regs theSecond{arch::Regs::AX};
+
+    // Memory operand theSegment:(theBase + theIndex + theDisplacement), or theDisplacement:theImmediate for a direct
+    // far CALL or JMP
+    arch::Regs theSegment{arch::Regs::DS};
+    arch::Regs theBase{arch::Regs::BX};
+    arch::Regs theIndex{arch::Regs::SI};
+    std::uint16_t theDisplacement{};
+
+    // Immediate operand, or the signed displacement of a relative branch
+    std::uint16_t theImmediate{};
+};
+
+struct Decoder
+{
+    // Bytes that do not form a supported instruction decode to a handler raising Trap::ILLEGAL
+    [[nodiscard]] static DecodedInst decode(const RandomAccessMemory &aMemory, arch::MemoryAddress aAddress) noexcept;
+    // Memory operand from the decoded fields. Handlers do not call it, they are instantiated per addressing mode with
+    // the base, index and displacement fixed at compile time.
+    [[nodiscard]] static arch::MemoryAddress effectiveAddress(SingleCore &aCore, const DecodedInst &aInst) noexcept;
+};
+} // namespace svm
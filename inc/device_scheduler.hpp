@@ -0,0 +1,231 @@
+#pragma once
+#include <array>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "trap.hpp"
+
+namespace svm
+{
+struct DeviceScheduler;
+struct SingleCore;
+
+// Bump allocator with per size free lists for coroutine frames. Frames are allocated when a device coroutine is
+// created and freed when it finishes, resuming never allocates.
+struct FrameArena
+{
+    static constexpr std::size_t DefaultCapacity = 64U * 1024U;
+
+    explicit FrameArena(std::size_t aCapacity = DefaultCapacity);
+
+    // nullptr once the arena is exhausted
+    [[nodiscard]] void *allocate(std::size_t aSize) noexcept;
+    static void deallocate(void *aFrame) noexcept;
+    [[nodiscard]] std::size_t used() const noexcept;
+
+  private:
+    struct Header
+    {
+        FrameArena *theArena;
+        std::size_t theSize;
+    };
+    struct FreeList
+    {
+        std::size_t theSize;
+        void *theHead;
+    };
+    // What new[] already guarantees, so the storage needs no aligned allocation
+    static constexpr std::size_t Alignment = alignof(std::max_align_t);
+    static constexpr std::size_t HeaderSize = (sizeof(Header) + Alignment - 1) / Alignment * Alignment;
+
+    std::unique_ptr<std::byte[]> theStorage;
+    std::size_t theCapacity;
+    std::size_t theUsed{};
+    std::vector<FreeList> theFreeLists;
+};
+
+// Return type of a device coroutine, created through DeviceScheduler::spawn.
+struct DeviceTask
+{
+    struct promise_type
+    {
+        // Frames come from the arena of the scheduler currently spawning, outside spawn allocation fails
+        static void *operator new(std::size_t aSize) noexcept;
+        static void operator delete(void *aFrame) noexcept;
+
+        DeviceTask get_return_object() noexcept
+        {
+            return DeviceTask{Handle::from_promise(*this)};
+        }
+        static DeviceTask get_return_object_on_allocation_failure() noexcept
+        {
+            return DeviceTask{};
+        }
+        std::suspend_always initial_suspend() noexcept
+        {
+            return {};
+        }
+        std::suspend_always final_suspend() noexcept
+        {
+            return {};
+        }
+        void return_void() noexcept
+        {
+        }
+        void unhandled_exception() noexcept
+        {
+            std::terminate();
+        }
+    };
+    using Handle = std::coroutine_handle<promise_type>;
+
+    ~DeviceTask();
+    DeviceTask(const DeviceTask &) = delete;
+    DeviceTask &operator=(const DeviceTask &) = delete;
+    DeviceTask(DeviceTask &&aOther) noexcept;
+    DeviceTask &operator=(DeviceTask &&aOther) noexcept;
+
+    DeviceTask() = default;
+    explicit DeviceTask(Handle aHandle) noexcept;
+
+    [[nodiscard]] bool isValid() const noexcept;
+    [[nodiscard]] Handle handle() const noexcept;
+
+  private:
+    Handle theHandle{};
+};
+
+struct PortAccess
+{
+    std::uint16_t thePort;
+    std::uint16_t theValue;
+    bool theIsWrite;
+};
+
+// Hands port accesses from a PortDevice to the device coroutine waiting on them. Accesses arriving while the
+// coroutine is busy are queued, beyond Capacity the newest are dropped.
+struct PortChannel
+{
+    static constexpr std::size_t Capacity = 16U;
+
+    explicit PortChannel(DeviceScheduler &aScheduler) noexcept;
+
+    // Called from PortDevice::in and out, the waiting coroutine runs at the next slice boundary
+    void post(PortAccess aAccess) noexcept;
+    // Takes a queued access without suspending
+    [[nodiscard]] std::optional<PortAccess> tryReceive() noexcept;
+    [[nodiscard]] std::size_t dropped() const noexcept;
+
+    struct Awaiter
+    {
+        PortChannel &theChannel;
+
+        [[nodiscard]] bool await_ready() const noexcept;
+        void await_suspend(std::coroutine_handle<> aHandle) noexcept;
+        PortAccess await_resume() noexcept;
+    };
+    Awaiter operator co_await() noexcept;
+
+  private:
+    DeviceScheduler &theScheduler;
+    std::array<PortAccess, Capacity> theAccesses{};
+    std::size_t theHead{};
+    std::size_t theSize{};
+    std::size_t theDropped{};
+    std::coroutine_handle<> theWaiter;
+};
+
+// Resumes device coroutines in guest cycle order. The guest clock advances with instructions retired by the core
+// and skips ahead while the core sits in HLT waiting for a device.
+struct DeviceScheduler
+{
+    static constexpr std::uint64_t Idle = std::numeric_limits<std::uint64_t>::max();
+
+    ~DeviceScheduler();
+    DeviceScheduler(const DeviceScheduler &) = delete;
+    DeviceScheduler(DeviceScheduler &&) = delete;
+    DeviceScheduler &operator=(const DeviceScheduler &) = delete;
+
+    explicit DeviceScheduler(std::size_t aArenaSize = FrameArena::DefaultCapacity);
+
+    // Calls aBody(*this, aArgs...) with its frame allocated from the arena and starts it at the current cycle
+    template <typename Body, typename... Args> bool spawn(Body &&aBody, Args &&...aArgs)
+    {
+        auto *myPrevious = std::exchange(theSpawning, &theArena);
+        auto myTask = std::invoke(std::forward<Body>(aBody), *this, std::forward<Args>(aArgs)...);
+        theSpawning = myPrevious;
+        return adopt(std::move(myTask));
+    }
+    [[nodiscard]] std::uint64_t now() const noexcept;
+    // Cycle of the earliest pending wakeup, Idle when there is none
+    [[nodiscard]] std::uint64_t nextDue() const noexcept;
+    // Resumes every coroutine due up to aCycle in cycle order, then moves the clock to aCycle
+    void advanceTo(std::uint64_t aCycle) noexcept;
+    // Runs aCore in slices ending at the next device wakeup until aBudget instructions retired or a trap
+    Trap run(SingleCore &aCore, std::size_t aBudget) noexcept;
+
+    [[nodiscard]] std::size_t taskCount() const noexcept;
+    [[nodiscard]] std::size_t arenaUsed() const noexcept;
+
+    void wake(std::coroutine_handle<> aHandle) noexcept;
+
+    struct Delay
+    {
+        DeviceScheduler &theScheduler;
+        std::uint64_t theCycles;
+
+        [[nodiscard]] bool await_ready() const noexcept
+        {
+            return false;
+        }
+        void await_suspend(std::coroutine_handle<> aHandle) noexcept
+        {
+            theScheduler.schedule(theScheduler.theNow + theCycles, aHandle);
+        }
+        void await_resume() const noexcept
+        {
+        }
+    };
+    [[nodiscard]] Delay delay(std::uint64_t aCycles) noexcept;
+
+  private:
+    struct Wakeup
+    {
+        std::uint64_t theDue;
+        std::uint64_t theSequence;
+        std::coroutine_handle<> theHandle;
+
+        // Min heap on due cycle, first come first served within a cycle
+        bool operator<(const Wakeup &aOther) const noexcept
+        {
+            return theDue != aOther.theDue ? theDue > aOther.theDue : theSequence > aOther.theSequence;
+        }
+    };
+
+    friend DeviceTask::promise_type;
+
+    bool adopt(DeviceTask aTask);
+    void schedule(std::uint64_t aDue, std::coroutine_handle<> aHandle) noexcept;
+    void reapFinished() noexcept;
+
+    static thread_local FrameArena *theSpawning;
+    // Core inside run, asked to yield when a device is woken mid slice
+    SingleCore *theRunning{};
+
+    // Declared first so frames are released before the arena goes away
+    FrameArena theArena;
+    std::vector<DeviceTask> theTasks;
+    std::vector<Wakeup> theQueue;
+    std::uint64_t theNow{};
+    std::uint64_t theSequence{};
+    std::uint64_t theLastInstructionCount{};
+};
+} // namespace svm
@@ -0,0 +1,105 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "memory.hpp"
+#include "save_state.hpp"
+#include "single_core.hpp"
+#include "trap.hpp"
+
+namespace svm
+{
+// Expanded memory board answering the LIM EMS 4.0 services on INT 67h that DOS programs use to reach past 640K: 16K
+// logical pages from a pool of host memory, allocated to handles and mapped into the four windows of a 64K page frame.
+//
+// Mapping points the guest pages under a window at the pool through RandomAccessMemory::mapPage, so a switch is four
+// page table writes whatever the pages hold and no data is ever copied. An unmapped window shows conventional memory.
+// Functions in AH: 40h status, 41h page frame segment, 42h page counts, 43h allocate, 44h map or unmap, 45h deallocate,
+// 46h version, 4Bh handle count, 4Ch handle pages and 50h map or unmap several (AL 0, by physical page number). Any
+// other function answers 84h. Handle 0 belongs to the operating system and starts with no pages.
+//
+// A SaveState image only holds what the frame shows, so checkpoints of a guest using the board carry its section too.
+struct ExpandedMemory : InterruptService
+{
+    static constexpr std::uint8_t Vector = 0x67U;
+    static constexpr std::size_t PageSize = 0x4000U;
+    static constexpr std::size_t FramePages = 4U;
+    static constexpr std::uint16_t DefaultFrameSegment = 0xD000U;
+    // Two megabytes
+    static constexpr std::size_t DefaultPageCount = 128U;
+    static constexpr std::size_t MaxHandles = 255U;
+    // Logical page number unmapping a window
+    static constexpr std::uint16_t Unmapped = 0xFFFFU;
+    static constexpr std::uint8_t Version = 0x40U;
+    // "EMS4"
+    static constexpr std::uint32_t SectionTag = 0x34534D45U;
+
+    // Returned in AH
+    enum Status : std::uint8_t
+    {
+        OK = 0x00U,
+        SoftwareMalfunction = 0x80U,
+        InvalidHandle = 0x83U,
+        UndefinedFunction = 0x84U,
+        NoMoreHandles = 0x85U,
+        NotEnoughPages = 0x87U,
+        NotEnoughFreePages = 0x88U,
+        ZeroPages = 0x89U,
+        LogicalPageOutOfRange = 0x8AU,
+        PhysicalPageOutOfRange = 0x8BU,
+        InvalidSubfunction = 0x8FU,
+    };
+
+    ~ExpandedMemory() override;
+    ExpandedMemory(const ExpandedMemory &) = delete;
+    ExpandedMemory(ExpandedMemory &&) = delete;
+    ExpandedMemory &operator=(const ExpandedMemory &) = delete;
+
+    // aFrameSegment is rounded down to a 16K boundary
+    explicit ExpandedMemory(RandomAccessMemory &aMemory, std::size_t aPageCount = DefaultPageCount,
+                            std::uint16_t aFrameSegment = DefaultFrameSegment);
+
+    [[nodiscard]] Trap onInterrupt(SingleCore &aCore) noexcept override;
+
+    // The services behind INT 67h, for hosts setting up a guest
+    Status allocate(std::uint16_t aPages, std::uint16_t &aHandle);
+    Status deallocate(std::uint16_t aHandle) noexcept;
+    // aLogical of aHandle into window aPhysical, Unmapped gives the window back to conventional memory
+    Status map(std::uint8_t aPhysical, std::uint16_t aLogical, std::uint16_t aHandle) noexcept;
+
+    // The whole board as a SaveState section: pool, handles, windows and the conventional memory under the frame
+    [[nodiscard]] SaveState::Section saveSection() const;
+    // Replaces the board with aSection, pool size and frame included. False and nothing changed when aSection is not
+    // one saveSection made. Not while a core runs.
+    [[nodiscard]] bool restoreSection(const SaveState::Section &aSection);
+
+    [[nodiscard]] std::uint16_t frameSegment() const noexcept;
+    [[nodiscard]] std::size_t pageCount() const noexcept;
+    [[nodiscard]] std::size_t freePageCount() const noexcept;
+
+  private:
+    struct Handle
+    {
+        bool theIsOpen;
+        // Pool page of each logical page
+        std::vector<std::uint16_t> thePages;
+    };
+
+    Status mapMultiple(SingleCore &aCore) noexcept;
+    // Points window aPhysical at pool page aPoolPage, Unmapped gives it back to conventional memory
+    void mapWindow(std::uint8_t aPhysical, std::uint16_t aPoolPage) noexcept;
+    [[nodiscard]] bool isOpen(std::uint16_t aHandle) const noexcept;
+
+    RandomAccessMemory &theMemory;
+    std::uint16_t theFrameSegment;
+    std::size_t thePageCount;
+    std::unique_ptr<std::uint8_t[]> thePool;
+    // Pool pages owned by no handle, taken from the back
+    std::vector<std::uint16_t> theFreePages;
+    std::vector<Handle> theHandles;
+    // Pool page each window shows
+    std::array<std::uint16_t, FramePages> theWindows{Unmapped, Unmapped, Unmapped, Unmapped};
+};
+} // namespace svm
@@ -0,0 +1,170 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <span>
+#include <utility>
+
+#include "arch.hpp"
+#include "memory.hpp"
+#include "perf_counters.hpp"
+#include "trap.hpp"
+
+namespace svm
+{
+// The 8087 numeric coprocessor as an 8086 guest sees it: eight 80-bit registers used as a stack, the control, status
+// and tag words, and the ESC instructions D8 to DF. Registers are host long doubles, which on x86-64 are the 8087's
+// own extended format, so arithmetic runs natively with the 64-bit significand and values load and store bit exact.
+//
+// Arithmetic always rounds to nearest and ignores precision control, the rounding control applies to integer and BCD
+// stores and to FRNDINT. The precision and denormal exceptions are never raised. An unmasked exception sets ES and B
+// but interrupts nobody, the 8087's INT line is not wired, and invalid operations and zero divides then leave their
+// destination alone. The instruction and operand pointers of the environment are stored as zero.
+struct Fpu
+{
+    // Operand formats of the memory forms
+    enum class Format : std::uint8_t
+    {
+        Real32,
+        Real64,
+        Real80,
+        Int16,
+        Int32,
+        Int64,
+        Bcd80,
+    };
+
+    // Two operand arithmetic in ModRM reg field order of D8, the result replaces the destination
+    enum class Arith : std::uint8_t
+    {
+        Add,
+        Mul,
+        Com,
+        ComPop,
+        Sub,
+        SubR,
+        Div,
+        DivR,
+    };
+
+    enum class Constant : std::uint8_t
+    {
+        One,
+        Log2Ten,
+        Log2E,
+        Pi,
+        Log10Two,
+        LnTwo,
+        Zero,
+    };
+
+    // Exception flags of the status word, masks of the control word
+    static constexpr std::uint16_t InvalidOperation = 1U << 0;
+    static constexpr std::uint16_t ZeroDivide = 1U << 2;
+    static constexpr std::uint16_t Overflow = 1U << 3;
+    static constexpr std::uint16_t Underflow = 1U << 4;
+    static constexpr std::uint16_t Exceptions = 0x3FU;
+    // Status word
+    static constexpr std::uint16_t ErrorSummary = 1U << 7;
+    static constexpr std::uint16_t C0 = 1U << 8;
+    static constexpr std::uint16_t C1 = 1U << 9;
+    static constexpr std::uint16_t C2 = 1U << 10;
+    static constexpr std::uint16_t C3 = 1U << 14;
+    static constexpr std::uint16_t Busy = 1U << 15;
+    // Control word after FINIT: every exception masked, 64-bit precision, round to nearest
+    static constexpr std::uint16_t DefaultControl = 0x037FU;
+    // Real mode FSTENV and FSAVE images: seven environment words, then ST(0) to ST(7) at ten bytes each
+    static constexpr std::size_t EnvironmentSize = 14U;
+    static constexpr std::size_t StateSize = EnvironmentSize + 8U * 10U;
+
+    ~Fpu() = default;
+    Fpu(const Fpu &) = delete;
+    Fpu(Fpu &&) = delete;
+    Fpu &operator=(const Fpu &) = delete;
+
+    // Control and status word accesses are counted in aCounters, those of the owning core
+    Fpu(RandomAccessMemory &aMemory, CoreCounters &aCounters);
+
+    // Memory forms. FLD, FILD and FBLD push the operand, FST, FIST and FBSTP store ST(0).
+    Trap FLD(arch::MemoryAddress, Format) noexcept;
+    Trap FST(arch::MemoryAddress, Format, bool aPop) noexcept;
+    Trap arithmetic(Arith, arch::MemoryAddress, Format) noexcept;
+    Trap FLDCW(arch::MemoryAddress) noexcept;
+    Trap FSTCW(arch::MemoryAddress) noexcept;
+    Trap FSTSW(arch::MemoryAddress) noexcept;
+    Trap FLDENV(arch::MemoryAddress) noexcept;
+    Trap FSTENV(arch::MemoryAddress) noexcept;
+    Trap FRSTOR(arch::MemoryAddress) noexcept;
+    Trap FSAVE(arch::MemoryAddress) noexcept;
+
+    // Register forms take i of ST(i). Arithmetic stores into ST(0), or into ST(i) when aToIndex.
+    Trap arithmetic(Arith, std::uint8_t aIndex, bool aToIndex, bool aPop) noexcept;
+    Trap FLD(std::uint8_t) noexcept;
+    Trap FST(std::uint8_t, bool aPop) noexcept;
+    Trap FXCH(std::uint8_t) noexcept;
+    Trap FFREE(std::uint8_t) noexcept;
+    Trap FLD(Constant) noexcept;
+
+    Trap F2XM1(void) noexcept;
+    Trap FABS(void) noexcept;
+    Trap FCHS(void) noexcept;
+    Trap FCLEX(void) noexcept;
+    Trap FCOMPP(void) noexcept;
+    Trap FDECSTP(void) noexcept;
+    Trap FDISI(void) noexcept;
+    Trap FENI(void) noexcept;
+    Trap FINCSTP(void) noexcept;
+    Trap FINIT(void) noexcept;
+    Trap FNOP(void) noexcept;
+    Trap FPATAN(void) noexcept;
+    Trap FPREM(void) noexcept;
+    Trap FPTAN(void) noexcept;
+    Trap FRNDINT(void) noexcept;
+    Trap FSCALE(void) noexcept;
+    Trap FSQRT(void) noexcept;
+    Trap FTST(void) noexcept;
+    Trap FXAM(void) noexcept;
+    Trap FXTRACT(void) noexcept;
+    Trap FYL2X(void) noexcept;
+    Trap FYL2XP1(void) noexcept;
+
+    // Whole state in the FSAVE layout, for checkpoints
+    void saveState(std::span<std::uint8_t, StateSize> aState) const noexcept;
+    void restoreState(std::span<const std::uint8_t, StateSize> aState) noexcept;
+
+    [[nodiscard]] std::uint16_t control() const noexcept;
+    [[nodiscard]] std::uint16_t status() const noexcept;
+    [[nodiscard]] std::uint16_t tags() const noexcept;
+    // ST(i), a NaN when empty
+    [[nodiscard]] long double read(std::uint8_t aIndex) const noexcept;
+
+  private:
+    [[nodiscard]] std::uint8_t top() const noexcept;
+    void setTop(std::uint8_t) noexcept;
+    [[nodiscard]] std::uint8_t physical(std::uint8_t aIndex) const noexcept;
+    [[nodiscard]] bool isEmpty(std::uint8_t aIndex) const noexcept;
+    long double &st(std::uint8_t aIndex) noexcept;
+    void setValid(std::uint8_t aIndex) noexcept;
+    bool raise(std::uint16_t aExceptions) noexcept;
+    bool operand(std::uint8_t aIndex, long double &aValue) noexcept;
+    bool operands(std::uint8_t aFirst, std::uint8_t aSecond, long double &aFirstValue,
+                  long double &aSecondValue) noexcept;
+    void push(long double) noexcept;
+    void pop() noexcept;
+    void replace(std::uint8_t aIndex, long double aValue, std::uint16_t aExceptions) noexcept;
+    void compare(long double, long double) noexcept;
+    void combine(Arith, std::uint8_t aDestination, long double aDestinationValue, long double aSource) noexcept;
+    [[nodiscard]] long double roundToInteger(long double) const noexcept;
+    std::pair<Trap, long double> readOperand(arch::MemoryAddress, Format) noexcept;
+    void saveEnvironment(std::span<std::uint8_t, EnvironmentSize>) const noexcept;
+    void restoreEnvironment(std::span<const std::uint8_t, EnvironmentSize>) noexcept;
+
+    RandomAccessMemory &theMemory;
+    CoreCounters &theCounters;
+    // Physical registers, ST(i) is theRegisters[(TOP + i) % 8]
+    std::array<long double, 8> theRegisters{};
+    // One bit per physical register, set when its tag is empty
+    std::uint8_t theEmpty{0xFFU};
+    std::uint16_t theControl{DefaultControl};
+    std::uint16_t theStatus{};
+};
+} // namespace svm
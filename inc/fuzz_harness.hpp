@@ -0,0 +1,66 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <utility>
+
+#include "arch.hpp"
+#include "fpu.hpp"
+#include "memory.hpp"
+#include "single_core.hpp"
+#include "trap.hpp"
+
+namespace svm
+{
+// Runs a guest program once per fuzzer input, every run starting from the state captured by prepare.
+//
+// Resetting costs a register and coprocessor state copy plus one page copy per page the previous run stored to,
+// memory is never rebuilt. Interrupts still queued from the previous run are dropped. Inputs go to guest memory as a
+// length word followed by the bytes, or to an input device when one is attached. Edge coverage lands in the caller's
+// map, which libFuzzer can read as extra counters.
+struct FuzzHarness
+{
+    static constexpr std::size_t DefaultBudget = 100000U;
+    static constexpr std::uint32_t DefaultInputAddress = 0x10000U;
+    static constexpr std::size_t DefaultMaxInputSize = 4096U;
+
+    // Receives each input in place of guest memory, the device has to drop what the previous input left behind
+    using InputDevice = std::function<void(std::span<const std::uint8_t>)>;
+
+    ~FuzzHarness() = default;
+    FuzzHarness(const FuzzHarness &) = delete;
+    FuzzHarness(FuzzHarness &&) = delete;
+    FuzzHarness &operator=(const FuzzHarness &) = delete;
+
+    // Inputs longer than aMaxInputSize are cut
+    FuzzHarness(SingleCore &aCore, RandomAccessMemory &aMemory, std::span<std::uint8_t> aCoverage,
+                std::uint32_t aInputAddress = DefaultInputAddress, std::size_t aMaxInputSize = DefaultMaxInputSize,
+                std::size_t aBudget = DefaultBudget);
+
+    // Captures the current registers, coprocessor and memory as the start of every execution
+    void prepare();
+    void attachInputDevice(InputDevice aDevice);
+    // Restores the prepared state, feeds aInput and runs the guest for the configured budget
+    Trap execute(std::span<const std::uint8_t> aInput) noexcept;
+
+    // Traps the fuzzer reports as findings
+    [[nodiscard]] static bool isCrash(Trap aTrap) noexcept;
+    [[nodiscard]] std::uint64_t executions() const noexcept;
+    // Pages copied back by the last execute
+    [[nodiscard]] std::size_t restoredPages() const noexcept;
+
+  private:
+    SingleCore &theCore;
+    RandomAccessMemory &theMemory;
+    std::span<std::uint8_t> theCoverage;
+    arch::MemoryAddress theInputAddress;
+    std::size_t theMaxInputSize;
+    std::size_t theBudget;
+    InputDevice theInputDevice;
+    std::array<arch::Immediate, std::to_underlying(arch::Regs::FLAG) + 1U> theRegisters{};
+    std::array<std::uint8_t, Fpu::StateSize> theFpuState{};
+    std::uint64_t theExecutions{};
+    std::size_t theRestoredPages{};
+};
+} // namespace svm
@@ -0,0 +1,163 @@
+#pragma once
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "arch.hpp"
+#include "memory.hpp"
+#include "port_bus.hpp"
+#include "single_core.hpp"
+#include "trap.hpp"
+
+namespace svm
+{
+// CGA and EGA graphics modes, converted to an RGBA frame for headless capture.
+//
+// The CGA modes 04h/05h (320x200, four colours) and 06h (640x200, two colours) live in guest memory at B800:0000 with
+// even scanlines in the first 8K and odd ones in the second. The EGA modes 0Dh (320x200), 0Eh (640x200) and 10h
+// (640x350), all sixteen colours, keep four bit planes in the adapter. The 64K window at A000:0000 is mapped to a host
+// copy of the plane picked by the read map select register, so guest loads see that plane at memory speed, and every
+// guest store is copied into the planes enabled by the sequencer map mask. Only write mode 0 with every bit enabled is
+// modelled: set/reset, the bit mask, rotation, the logical operations and the latches are not.
+//
+// Stores mark the scanlines they touch and convert() only turns those into RGBA, unpacking pixels and expanding the
+// palette sixteen pixels at a time with byte shuffles. INT 10h answers set mode (00h), CGA palette (0Bh), get mode
+// (0Fh) and set one EGA palette register (10h, AL 0), other functions return unchanged. Ports 3C0h-3CFh (attribute
+// controller, sequencer and graphics controller) and 3D8h-3DAh (CGA mode control, colour select and status) are
+// answered once attached to a PortBus; the status register toggles retrace on every read so polling loops end.
+struct GraphicsAdapter : MemoryObserver, PortDevice, InterruptService
+{
+    static constexpr std::uint8_t Vector = 0x10U;
+    static constexpr std::size_t MaxWidth = 640U;
+    static constexpr std::size_t MaxHeight = 350U;
+    static constexpr std::size_t BytesPerPixel = 4U;
+    static constexpr arch::MemoryAddress CgaAddress{.theAddress = 0xB8000};
+    static constexpr std::size_t CgaSize = 0x4000U;
+    static constexpr std::size_t CgaBankSize = 0x2000U;
+    static constexpr arch::MemoryAddress EgaAddress{.theAddress = 0xA0000};
+    static constexpr std::size_t PlaneSize = 0x10000U;
+    static constexpr std::size_t PlaneCount = 4U;
+    static constexpr std::uint16_t EgaPorts = 0x3C0U;
+    static constexpr std::size_t EgaPortCount = 16U;
+    static constexpr std::uint16_t CgaPorts = 0x3D8U;
+    static constexpr std::size_t CgaPortCount = 3U;
+
+    // BIOS mode numbers, 05h is kept as 04h since the colour burst means nothing here
+    enum class Mode : std::uint8_t
+    {
+        Text = 0x03U,
+        Cga320 = 0x04U,
+        Cga640 = 0x06U,
+        Ega320 = 0x0DU,
+        Ega640 = 0x0EU,
+        Ega640x350 = 0x10U,
+    };
+
+    ~GraphicsAdapter() override;
+    GraphicsAdapter(const GraphicsAdapter &) = delete;
+    GraphicsAdapter(GraphicsAdapter &&) = delete;
+    GraphicsAdapter &operator=(const GraphicsAdapter &) = delete;
+
+    // Starts in text mode, leaving B800:0000 to TextModeVideo
+    explicit GraphicsAdapter(RandomAccessMemory &aMemory);
+
+    void onWrite(arch::MemoryAddress aMemoryAddress, std::size_t aLength) noexcept override;
+    [[nodiscard]] std::uint16_t in(std::uint16_t aPort, arch::OperandSize aSize) noexcept override;
+    void out(std::uint16_t aPort, std::uint16_t aValue, arch::OperandSize aSize) noexcept override;
+    [[nodiscard]] Trap onInterrupt(SingleCore &aCore) noexcept override;
+
+    // What INT 10h AH=00h does, including clearing the screen unless bit 7 of aMode is set. False for modes the
+    // adapter does not have, which leave it as it was.
+    bool setMode(std::uint8_t aMode) noexcept;
+    [[nodiscard]] Mode mode() const noexcept;
+    // Zero in text mode
+    [[nodiscard]] std::size_t width() const noexcept;
+    [[nodiscard]] std::size_t height() const noexcept;
+
+    // Brings the frame up to date with what the guest wrote and returns the number of scanlines converted
+    std::size_t convert() noexcept;
+    // width() x height() pixels of R, G, B and A bytes as of the last convert()
+    [[nodiscard]] std::span<const std::uint8_t> frame() const noexcept;
+    [[nodiscard]] std::size_t dirtyLineCount() const noexcept;
+    void markAllDirty() noexcept;
+
+    // One of the four EGA planes, for hosts inspecting the screen
+    [[nodiscard]] std::span<const std::uint8_t, PlaneSize> plane(std::size_t aIndex) const noexcept;
+
+  private:
+    using Plane = std::array<std::uint8_t, PlaneSize>;
+
+    [[nodiscard]] bool isEga() const noexcept;
+    [[nodiscard]] std::size_t bytesPerLine() const noexcept;
+    void writeEga(std::size_t aBegin, std::size_t aEnd) noexcept;
+    void writeCga(std::size_t aBegin, std::size_t aEnd) noexcept;
+    void markLines(std::size_t aFirst, std::size_t aLast) noexcept;
+    void mapWindow(bool aMapped) noexcept;
+    void selectReadPlane(std::uint8_t aPlane) noexcept;
+    void writeAttribute(std::uint8_t aValue) noexcept;
+    void writeByte(std::uint16_t aPort, std::uint8_t aValue) noexcept;
+    [[nodiscard]] std::uint8_t readByte(std::uint16_t aPort) noexcept;
+    void updatePalette() noexcept;
+    void convertLine(std::size_t aLine) noexcept;
+
+    RandomAccessMemory &theMemory;
+    Mode theMode{Mode::Text};
+    std::unique_ptr<std::array<Plane, PlaneCount>> thePlanes;
+    // Stands in for guest memory under A000:0000 in the EGA modes, always equal to the read plane between stores
+    std::unique_ptr<Plane> theWindow;
+    // Set while the adapter switches the window itself, so the page notifications are not taken for guest stores
+    bool theIsSwitching{};
+
+    std::uint8_t theMapMask{0x0FU};
+    std::uint8_t theReadPlane{};
+    std::uint8_t theSequencerIndex{};
+    std::uint8_t theGraphicsIndex{};
+    std::uint8_t theAttributeIndex{};
+    bool theAttributeIsData{};
+    std::array<std::uint8_t, 16> theAttributes{};
+    std::uint8_t theCgaMode{};
+    std::uint8_t theColorSelect{};
+    std::uint8_t theStatusReads{};
+
+    std::array<std::uint32_t, 16> thePalette{};
+    std::bitset<MaxHeight> theDirtyLines;
+    std::vector<std::uint8_t> theFrame;
+};
+
+// Writes the frames of a GraphicsAdapter to disk, either appended to one raw RGBA stream (ffmpeg -f rawvideo
+// -pix_fmt rgba -s WxH) or as a numbered PNG per frame in a directory. A raw stream keeps the size of the mode it
+// started in and skips frames of any other size.
+struct FrameCapture
+{
+    enum class Format
+    {
+        RawVideo,
+        PngSequence,
+    };
+
+    FrameCapture(GraphicsAdapter &aAdapter, std::filesystem::path aPath, Format aFormat);
+
+    // Converts what changed and writes one frame, false in text mode, on a size change of a raw stream or when the
+    // host write failed
+    bool capture();
+    [[nodiscard]] std::size_t frames() const noexcept;
+
+    // Uncompressed deflate, so the image costs one pass over the pixels and no compression library
+    [[nodiscard]] static bool writePng(const std::filesystem::path &aPath, std::size_t aWidth, std::size_t aHeight,
+                                       std::span<const std::uint8_t> aPixels);
+
+  private:
+    GraphicsAdapter &theAdapter;
+    std::filesystem::path thePath;
+    Format theFormat;
+    std::ofstream theStream;
+    std::size_t theWidth{};
+    std::size_t theHeight{};
+    std::size_t theFrames{};
+};
+} // namespace svm
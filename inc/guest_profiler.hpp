@@ -0,0 +1,100 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace svm
+{
+// Guest call graph kept from the control transfers a core reports: CALL and interrupt entry push a frame, RET, RETF
+// and IRET pop it. A frame remembers the stack address of the return address it left, a return pops every frame at or
+// below the address it pops from, so frames abandoned by a longjmp go with it and a PUSH then RET used as a jump pops
+// nothing.
+//
+// Instructions are attributed per calling context, one node for each distinct chain of callers. Only the last
+// instruction of a block can transfer control, so a block's instructions all go to the context it started in.
+// Functions are named from an optional symbol map, unnamed ones by their entry point.
+struct GuestProfiler
+{
+    // Calls made deeper are not tracked, their instructions go to the deepest tracked frame
+    static constexpr std::size_t MaxDepth = 1024U;
+
+    struct Function
+    {
+        std::string theName;
+        // Linear address of the entry point
+        std::uint32_t theAddress;
+        std::uint64_t theCalls;
+        // Instructions of the function and everything it called, recursion counted once
+        std::uint64_t theInclusive;
+        std::uint64_t theExclusive;
+    };
+
+    ~GuestProfiler() = default;
+    GuestProfiler(const GuestProfiler &) = delete;
+    GuestProfiler(GuestProfiler &&) = delete;
+    GuestProfiler &operator=(const GuestProfiler &) = delete;
+
+    GuestProfiler();
+
+    // One "SEGMENT:OFFSET NAME" or "LINEAR NAME" per line with the addresses in hex, '#' starts a comment. False and
+    // nothing added on any other line.
+    [[nodiscard]] bool parseSymbols(std::string_view aText);
+    [[nodiscard]] bool loadSymbols(const std::filesystem::path &aPath);
+    void addSymbol(std::uint32_t aAddress, std::string aName);
+
+    // Reported by the core, aFrame being the linear address of the return address on the guest stack
+    void onCall(std::uint16_t aSegment, std::uint16_t aOffset, std::uint32_t aFrame) noexcept;
+    void onReturn(std::uint32_t aFrame) noexcept;
+    // Instructions retired since the last call, after any transfer the last of them made
+    void retire(std::uint64_t aInstructions) noexcept;
+
+    [[nodiscard]] std::size_t depth() const noexcept;
+    [[nodiscard]] std::uint64_t total() const noexcept;
+    // Calls not tracked for going past MaxDepth
+    [[nodiscard]] std::uint64_t truncated() const noexcept;
+
+    // Functions with any instructions, highest inclusive count first
+    [[nodiscard]] std::vector<Function> functions() const;
+    [[nodiscard]] std::string formatTable(std::size_t aLimit) const;
+    // One "outer;inner count" line per calling context with instructions of its own, as flamegraph.pl and
+    // speedscope read them. The root is the code running when profiling started.
+    void writeCollapsed(std::ostream &aStream) const;
+    [[nodiscard]] bool writeCollapsedFile(const std::filesystem::path &aPath) const;
+
+  private:
+    static constexpr std::uint32_t Root = 0U;
+
+    struct Context
+    {
+        std::uint32_t theParent;
+        std::uint32_t theAddress;
+        std::uint16_t theSegment;
+        std::uint16_t theOffset;
+        std::uint64_t theCalls;
+        std::uint64_t theExclusive;
+    };
+
+    struct Frame
+    {
+        std::uint32_t theContext;
+        std::uint32_t theStack;
+    };
+
+    [[nodiscard]] std::uint32_t current() const noexcept;
+    [[nodiscard]] std::string nameOf(const Context &aContext) const;
+
+    std::vector<Context> theContexts;
+    // Child context by parent context in the high half and entry point in the low half
+    std::unordered_map<std::uint64_t, std::uint32_t> theChildren;
+    std::vector<Frame> theFrames;
+    std::unordered_map<std::uint32_t, std::string> theSymbols;
+    // Context the block being retired started in
+    std::uint32_t theBlockContext{Root};
+    std::uint64_t theTotal{};
+    std::uint64_t theTruncated{};
+};
+} // namespace svm
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "arch.hpp"
+#include "trap.hpp"
+
+namespace svm
+{
+struct CompiledBlock;
+struct GuestProfiler;
+
+// Guest programs kept as files. Flat binaries load as they are, hex listings (".hex") hold the bytes as pairs of hex
+// digits where ';' starts a comment running to the end of the line, so hand assembled programs stay reviewable.
+//
+// A program starts at 0000:0100 with SP at FFFE, the text screen attached, an expanded memory board on INT 67h and,
+// when given a host descriptor, a serial port on COM1, and runs until it stops.
+struct GuestProgram
+{
+    static constexpr std::uint32_t LoadAddress = 0x100U;
+    static constexpr arch::Immediate StackPointer = 0xFFFE;
+    // Instructions a run gets unless told otherwise, ample for every guest in bench/guests
+    static constexpr std::size_t DefaultBudget = 1000000000U;
+
+    struct Result
+    {
+        Trap theTrap;
+        std::uint64_t theInstructions;
+        double theSeconds;
+        // Programs leave their answer in AX so a run can be checked, not only timed
+        arch::Immediate theAX;
+
+        // Millions of guest instructions per second of wall time
+        [[nodiscard]] double mips() const noexcept;
+    };
+
+    // Empty on anything but hex digit pairs, blanks and comments
+    [[nodiscard]] static std::optional<std::vector<std::uint8_t>> parseListing(std::string_view aText);
+    [[nodiscard]] static std::optional<std::vector<std::uint8_t>> load(const std::filesystem::path &aPath);
+    // Runs aImage in a fresh memory until it traps or at least aBudget instructions retired, Trap::OK meaning the
+    // budget ran out. Blocks compiled ahead of time from aImage run through AotRuntime, the interpreter covers the rest.
+    // aProfiler, when given, is attached to the core for the run. What the guest sends to COM1 is written to aSerial,
+    // the port is left out when it is -1.
+    [[nodiscard]] static Result run(std::span<const std::uint8_t> aImage, std::size_t aBudget,
+                                    std::span<const CompiledBlock> aBlocks = {}, GuestProfiler *aProfiler = nullptr,
+                                    int aSerial = -1);
+};
+} // namespace svm
@@ -0,0 +1,96 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <utility>
+
+#include "arch.hpp"
+#include "memory.hpp"
+#include "trap.hpp"
+
+namespace svm
+{
+struct SingleCore;
+
+// Guest bytes lent to a host routine in place: the host storage behind them, one part per run of pages adjacent on
+// the host. Conventional memory is a single part, a range running into a page mapped elsewhere, such as an expanded
+// memory window, splits where the backing changes. Buffers lent for reading hold const bytes, only stores through
+// buffers taken for writing are reported.
+template <typename ByteT> struct GuestBuffer
+{
+    // A buffer stays within one segment, 64K touching at most this many pages
+    static constexpr std::size_t MaxParts = 0x10000U / RandomAccessMemory::PageSize + 1U;
+
+    std::array<std::span<ByteT>, MaxParts> theParts{};
+    std::size_t theCount{};
+    std::size_t theSize{};
+
+    [[nodiscard]] std::span<const std::span<ByteT>> parts() const noexcept;
+    // The whole buffer as one span when it is a single part
+    [[nodiscard]] std::optional<std::span<ByteT>> contiguous() const noexcept;
+};
+
+// Host routines guest code calls directly, for work far faster done natively than emulated: block copies, checksums,
+// sorts, decompression. The opcode 0F 3F nn calls routine nn. On the 8086 0F is POP CS, which the emulator does not
+// implement and reserves for hypercalls instead. The routine takes its arguments from the registers, answers in them
+// and works on guest memory through GuestBuffers, so nothing is copied byte by byte. An unregistered number traps as
+// an illegal instruction, as does the opcode on a core without hypercalls attached.
+//
+// Stores a routine makes through buffers taken for writing are reported to the memory once it returns, one block
+// store per buffer, so decoded blocks, dirty pages and observers see them as they would see a REP MOVSB.
+struct Hypercalls
+{
+    static constexpr std::uint8_t Prefix = 0x0FU;
+    static constexpr std::uint8_t Opcode = 0x3FU;
+    // Buffers a single call may take for writing
+    static constexpr std::size_t MaxWrittenBuffers = 4U;
+
+    // One call in progress, the core's registers are as the guest set them with IP past the opcode
+    struct Call
+    {
+        Call(SingleCore &aCore, RandomAccessMemory &aMemory) noexcept;
+
+        SingleCore &theCore;
+        RandomAccessMemory &theMemory;
+
+        // aLength bytes at aSegment:aOffset, empty when the range leaves the segment or memory or, for writing, when
+        // MaxWrittenBuffers are already taken
+        [[nodiscard]] std::optional<GuestBuffer<const std::uint8_t>> read(std::uint16_t aSegment, std::uint16_t aOffset,
+                                                                          std::size_t aLength) noexcept;
+        [[nodiscard]] std::optional<GuestBuffer<std::uint8_t>> write(std::uint16_t aSegment, std::uint16_t aOffset,
+                                                                     std::size_t aLength) noexcept;
+
+      private:
+        friend struct Hypercalls;
+
+        template <typename ByteT>
+        [[nodiscard]] std::optional<GuestBuffer<ByteT>> lend(std::uint16_t, std::uint16_t, std::size_t) noexcept;
+
+        std::array<std::pair<arch::MemoryAddress, std::size_t>, MaxWrittenBuffers> theWritten{};
+        std::size_t theWrittenCount{};
+    };
+
+    // Routines must not throw, a trap other than OK stops the core
+    using Routine = std::function<Trap(Call &)>;
+
+    ~Hypercalls() = default;
+    Hypercalls(const Hypercalls &) = delete;
+    Hypercalls(Hypercalls &&) = delete;
+    Hypercalls &operator=(const Hypercalls &) = delete;
+
+    explicit Hypercalls(RandomAccessMemory &aMemory);
+
+    // Replaces any routine registered as aNumber, an empty routine unregisters it. Not while a core runs.
+    void define(std::uint8_t aNumber, Routine aRoutine);
+    [[nodiscard]] bool isDefined(std::uint8_t aNumber) const noexcept;
+
+    // Run by the core for 0F 3F aNumber, from whichever thread runs it
+    [[nodiscard]] Trap dispatch(SingleCore &aCore, std::uint8_t aNumber) noexcept;
+
+  private:
+    RandomAccessMemory &theMemory;
+    std::array<Routine, 256> theRoutines;
+};
+} // namespace svm
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+
+#include "device_scheduler.hpp"
+#include "port_bus.hpp"
+
+namespace svm
+{
+struct SingleCore;
+
+// Channel 0 of an 8253 style interval timer: ports 40h (counter, low byte then high byte) and 43h (mode, ignored).
+// Once a non zero reload value is written the timer raises its interrupt every reload guest cycles.
+struct IntervalTimer : PortDevice
+{
+    static constexpr std::uint16_t BasePort = 0x40;
+    static constexpr std::size_t PortCount = 4U;
+    static constexpr std::uint8_t DefaultVector = 0x08;
+
+    ~IntervalTimer() override = default;
+    IntervalTimer(const IntervalTimer &) = delete;
+    IntervalTimer(IntervalTimer &&) = delete;
+    IntervalTimer &operator=(const IntervalTimer &) = delete;
+
+    IntervalTimer(SingleCore &aCore, DeviceScheduler &aScheduler, std::uint8_t aVector = DefaultVector);
+
+    [[nodiscard]] std::uint16_t in(std::uint16_t aPort, arch::OperandSize aSize) noexcept override;
+    void out(std::uint16_t aPort, std::uint16_t aValue, arch::OperandSize aSize) noexcept override;
+
+    [[nodiscard]] std::uint16_t reload() const noexcept;
+    [[nodiscard]] std::uint64_t ticks() const noexcept;
+
+  private:
+    static DeviceTask tick(DeviceScheduler &aScheduler, IntervalTimer &aTimer);
+
+    SingleCore &theCore;
+    DeviceScheduler &theScheduler;
+    PortChannel theChannel;
+    std::uint8_t theVector;
+    std::uint16_t theReload{};
+    std::uint16_t theLatch{};
+    bool theHighByteNext{};
+    bool theReadHighByteNext{};
+    std::uint64_t thePeriodStart{};
+    std::uint64_t theTicks{};
+};
+} // namespace svm
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+
+#include "port_bus.hpp"
+#include "spsc_queue.hpp"
+
+namespace svm
+{
+struct SingleCore;
+
+// Output side of an 8042 style keyboard controller: port 60h reads the next scancode, bit 0 of port 64h reports a
+// scancode waiting. A host thread feeds scancodes through a lock free queue while the guest runs on another thread,
+// every byte handed over raises the keyboard interrupt.
+struct KeyboardController : PortDevice
+{
+    static constexpr std::uint16_t DataPort = 0x60;
+    static constexpr std::uint16_t StatusPort = 0x64;
+    static constexpr std::uint8_t DefaultVector = 0x09;
+    static constexpr std::size_t QueueCapacity = 256U;
+
+    enum Status : std::uint8_t
+    {
+        OutputFull = 1U << 0,
+    };
+
+    ~KeyboardController() override = default;
+    KeyboardController(const KeyboardController &) = delete;
+    KeyboardController(KeyboardController &&) = delete;
+    KeyboardController &operator=(const KeyboardController &) = delete;
+
+    KeyboardController(SingleCore &aCore, std::uint8_t aVector = DefaultVector);
+
+    // Host side, one producer thread at a time. False when the guest has fallen QueueCapacity bytes behind.
+    [[nodiscard]] bool press(std::uint8_t aScancode) noexcept;
+
+    // Guest side, called from the thread running the core
+    [[nodiscard]] std::uint16_t in(std::uint16_t aPort, arch::OperandSize aSize) noexcept override;
+    void out(std::uint16_t aPort, std::uint16_t aValue, arch::OperandSize aSize) noexcept override;
+
+  private:
+    SingleCore &theCore;
+    std::uint8_t theVector;
+    // Last byte read from port 60h, read again while the queue is empty
+    std::uint8_t theScancode{};
+    SpscQueue<std::uint8_t, QueueCapacity> theQueue;
+};
+} // namespace svm
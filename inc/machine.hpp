@@ -0,0 +1,62 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "memory.hpp"
+#include "port_bus.hpp"
+#include "single_core.hpp"
+#include "trap.hpp"
+
+namespace svm
+{
+// Several cores sharing one guest memory, each run on its own host thread.
+//
+// LOCK prefixed read-modify-write instructions and XCHG with memory are host atomics, plain guest accesses are
+// ordered by the memory model of the shared memory, TotalStoreOrder unless set otherwise. A store into code cached by
+// another core evicts that code before the other core's next block. Each core counts its own memory accesses.
+struct Machine
+{
+    ~Machine() = default;
+    Machine(const Machine &) = delete;
+    Machine(Machine &&) = delete;
+    Machine &operator=(const Machine &) = delete;
+
+    Machine(RandomAccessMemory &aMemory, std::size_t aCoreCount);
+
+    [[nodiscard]] std::size_t coreCount() const noexcept;
+    [[nodiscard]] SingleCore &core(std::size_t aIndex) noexcept;
+    // Attaches one bus to every core, its devices then see accesses from every core's thread
+    void attachPortBus(PortBus *aPortBus) noexcept;
+    void setMemoryModel(RandomAccessMemory::MemoryModel aModel) noexcept;
+
+    // Runs every core for aBudget instructions on its own thread and returns once all of them stopped
+    [[nodiscard]] std::vector<Trap> run(std::size_t aBudget);
+    // Safe from any thread, including a core's own device handlers
+    void sendInterrupt(std::size_t aTarget, std::uint8_t aVector) noexcept;
+
+  private:
+    RandomAccessMemory &theMemory;
+    std::vector<std::unique_ptr<SingleCore>> theCores;
+};
+
+// Inter-processor interrupts for guests: a word written to the port sends vector AL to the core numbered AH, reads
+// return the number of cores.
+struct InterprocessorPort : PortDevice
+{
+    static constexpr std::uint16_t DefaultPort = 0xE0;
+
+    ~InterprocessorPort() override = default;
+    InterprocessorPort(const InterprocessorPort &) = delete;
+    InterprocessorPort(InterprocessorPort &&) = delete;
+    InterprocessorPort &operator=(const InterprocessorPort &) = delete;
+
+    explicit InterprocessorPort(Machine &aMachine);
+
+    [[nodiscard]] std::uint16_t in(std::uint16_t aPort, arch::OperandSize aSize) noexcept override;
+    void out(std::uint16_t aPort, std::uint16_t aValue, arch::OperandSize aSize) noexcept override;
+
+  private:
+    Machine &theMachine;
+};
+} // namespace svm
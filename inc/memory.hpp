@@ -1,28 +1,184 @@
 #pragma once
 #include <array>
+#include <atomic>
 #include <cstdint>
+#include <mutex>
+#include <span>
 #include <utility>
+#include <vector>
 
 #include "arch.hpp"
 #include "constants.hpp"
+#include "perf_counters.hpp"
 #include "trap.hpp"
 
 namespace svm
 {
+struct MemoryHeatmap;
+
+// Receives the guest accesses that land inside the range it was attached to.
+struct MemoryObserver
+{
+    enum Access : std::uint8_t
+    {
+        Read = 1U << 0,
+        Write = 1U << 1,
+    };
+
+    virtual ~MemoryObserver() = default;
+    virtual void onWrite(arch::MemoryAddress aMemoryAddress, std::size_t aLength) noexcept = 0;
+    virtual void onRead(arch::MemoryAddress, std::size_t) noexcept
+    {
+    }
+};
+
 struct RandomAccessMemory
 {
     static constexpr auto Capacity = constants::MAX_MEMORY_CAPACITY;
     static constexpr auto MemoryAlign = constants::MEMORY_BUS_ALIGNMENT;
+    static constexpr auto WordSize = constants::WORD_SIZE;
+    static constexpr auto PageSize = constants::PAGE_SIZE;
+    static constexpr auto PageCount = Capacity / PageSize;
 
-    RandomAccessMemory() = default;
+    // Per page bits consulted on every access, only a set bit leaves the fast path
+    enum PageFlag : std::uint8_t
+    {
+        ObservedRead = MemoryObserver::Read,
+        ObservedWrite = MemoryObserver::Write,
+        Ordered = 1U << 2,
+        // Unchanged since the snapshot, the first store marks the page dirty and clears this
+        Clean = 1U << 3,
+        // Accesses are counted in the attached heatmap
+        Counted = 1U << 4,
+    };
+
+    // How guest loads and stores issued on different host threads are ordered against each other. Relaxed makes plain
+    // host accesses, for a single core or cores that never touch the same memory unlocked. TotalStoreOrder makes every
+    // access a host atomic, loads acquire and stores release like an x86, so an aligned word is never seen half
+    // written; SequentiallyConsistent makes them sequentially consistent. Locked accesses always are.
+    enum class MemoryModel : std::uint8_t
+    {
+        Relaxed,
+        TotalStoreOrder,
+        SequentiallyConsistent,
+    };
+
+    RandomAccessMemory();
     [[nodiscard]] Trap write(arch::MemoryAddress aMemoryAddress, arch::Immediate aImmediate) noexcept;
     [[nodiscard]] Trap writeByte(arch::MemoryAddress aMemoryAddress, arch::Immediate aImmediate) noexcept;
     [[nodiscard]] std::pair<Trap, arch::Immediate> read(arch::MemoryAddress aMemoryAddress) const noexcept;
     [[nodiscard]] std::pair<Trap, arch::Immediate> readByte(arch::MemoryAddress aMemoryAddress) const noexcept;
+    // Instruction fetch, never reported to observers
+    [[nodiscard]] std::pair<Trap, std::uint8_t> fetchByte(arch::MemoryAddress aMemoryAddress) const noexcept;
+
+    // Bulk transfers, reported to observers as a single access
+    [[nodiscard]] Trap writeBlock(arch::MemoryAddress aMemoryAddress, std::span<const std::uint8_t> aData) noexcept;
+    [[nodiscard]] Trap readBlock(arch::MemoryAddress aMemoryAddress, std::span<std::uint8_t> aData) const noexcept;
+    [[nodiscard]] Trap fill(arch::MemoryAddress aMemoryAddress, std::size_t aLength, std::uint8_t aValue) noexcept;
+    // Locked word accesses, atomic against each other on every host thread. A word straddling an eight byte boundary
+    // is serialised against other straddling locked words only.
+    [[nodiscard]] std::pair<Trap, bool> compareExchange(arch::MemoryAddress aMemoryAddress, arch::Immediate aExpected,
+                                                        arch::Immediate aDesired) noexcept;
+    [[nodiscard]] std::pair<Trap, arch::Immediate> exchange(arch::MemoryAddress aMemoryAddress,
+                                                            arch::Immediate aImmediate) noexcept;
+
+    // Copy to return to with restoreSnapshot. Each page leaves the fast path once, for its first store after the
+    // snapshot or a restore, which marks it dirty.
+    void takeSnapshot();
+    // Copies back the pages stored to since the snapshot or the last restore and tells observers about each of them.
+    // Returns how many pages were copied. No core may run meanwhile.
+    std::size_t restoreSnapshot() noexcept;
+    [[nodiscard]] bool hasSnapshot() const noexcept;
+
+    // Counts reads and writes per page in aHeatmap, nullptr detaches. Every access takes the slow path meanwhile, so
+    // attach and detach while no core runs.
+    void attachHeatmap(MemoryHeatmap *aHeatmap) noexcept;
+    [[nodiscard]] MemoryHeatmap *heatmap() const noexcept;
+
+    void setMemoryModel(MemoryModel aModel) noexcept;
+    [[nodiscard]] MemoryModel memoryModel() const noexcept;
+
+    // Host storage behind aLength guest bytes from aAddress, for host code working on guest memory in place: one span
+    // per run of pages adjacent on the host, so memory without mapped pages is a single span. Returns how many spans
+    // the range needs and fills as many of them as aParts holds. Nothing is reported, stores made through the spans
+    // are announced with reportStore. Read only spans come from the const form.
+    [[nodiscard]] std::pair<Trap, std::size_t> hostSpans(arch::MemoryAddress aMemoryAddress, std::size_t aLength,
+                                                         std::span<std::span<const std::uint8_t>> aParts)
+        const noexcept;
+    [[nodiscard]] std::pair<Trap, std::size_t> hostSpans(arch::MemoryAddress aMemoryAddress, std::size_t aLength,
+                                                         std::span<std::span<std::uint8_t>> aParts) noexcept;
+    // Reports an access host code made through hostSpans the way readBlock and writeBlock report their own
+    void reportLoad(arch::MemoryAddress aMemoryAddress, std::size_t aLength) const noexcept;
+    void reportStore(arch::MemoryAddress aMemoryAddress, std::size_t aLength) noexcept;
+
+    // Snapshot view of one page, never reported to observers
+    [[nodiscard]] std::span<const std::uint8_t, PageSize> page(std::size_t aIndex) const noexcept;
+    // Own storage of page aIndex, what it shows again once unmapped, never reported to observers
+    [[nodiscard]] std::span<const std::uint8_t, PageSize> ownPage(std::size_t aIndex) const noexcept;
+
+    // Backs guest page aIndex with aBacking instead of its own storage, nothing is copied so the switch takes the
+    // same time whatever the page holds. aBacking has to be eight byte aligned and outlive the mapping. The page
+    // counts as stored to, observers hear about a write of all of it. An access racing the switch on another thread
+    // sees either backing.
+    void mapPage(std::size_t aIndex, std::span<std::uint8_t, PageSize> aBacking) noexcept;
+    // Backs guest page aIndex with its own storage again, which kept what it held before the page was mapped
+    void unmapPage(std::size_t aIndex) noexcept;
+
+    void attachObserver(MemoryObserver &aObserver, arch::MemoryAddress aMemoryAddress, std::size_t aLength,
+                        std::uint8_t aAccess = MemoryObserver::Write);
+    void detachObserver(MemoryObserver &aObserver) noexcept;
+
+    // Loads and stores are counted by the core making them, see CoreCounters
+    [[nodiscard]] MemoryCounters counters() const noexcept;
+    void resetCounters() noexcept;
 
   private:
-    bool isMemoryInBound(arch::MemoryAddress) const noexcept;
-    std::array<std::uint8_t, constants::MAX_MEMORY_CAPACITY> theMemory;
+    struct ObservedRange
+    {
+        MemoryObserver *theObserver;
+        std::uint32_t theBegin;
+        std::uint32_t theEnd;
+        std::uint8_t theAccess;
+    };
+
+    template <typename UpdateT> std::pair<Trap, arch::Immediate> updateLocked(arch::MemoryAddress, UpdateT) noexcept;
+    template <typename PartT> void forEachPage(std::uint32_t, std::size_t, PartT) const noexcept;
+    template <typename ByteT>
+    std::pair<Trap, std::size_t> collectSpans(arch::MemoryAddress, std::size_t,
+                                              std::span<std::span<ByteT>>) const noexcept;
+    std::uint8_t *hostByte(std::uint32_t) const noexcept;
+    void switchPage(std::size_t, std::uint8_t *) noexcept;
+    bool isMemoryInBound(arch::MemoryAddress, std::size_t) const noexcept;
+    std::uint8_t pageFlags(std::uint32_t, std::size_t) const noexcept;
+    arch::Immediate loadOrdered(std::uint32_t, std::size_t) const noexcept;
+    void storeOrdered(std::uint32_t, std::size_t, arch::Immediate) noexcept;
+    void afterStore(arch::MemoryAddress, std::size_t, std::uint8_t) noexcept;
+    void afterLoad(arch::MemoryAddress, std::size_t, std::uint8_t) const noexcept;
+    void notifyWrite(arch::MemoryAddress, std::size_t) noexcept;
+    void notifyRead(arch::MemoryAddress, std::size_t) const noexcept;
+    bool hasPageFlag(std::size_t, std::size_t, std::uint8_t) const noexcept;
+    void markDirty(std::size_t, std::size_t) noexcept;
+    void countAccess(bool, std::size_t, std::size_t) const noexcept;
+    [[nodiscard]] bool isDirty(std::size_t) const noexcept;
+    bool isFirstMatch(std::size_t, arch::MemoryAddress, std::size_t, std::uint8_t) const noexcept;
+    void refreshPageFlags() noexcept;
 
+    // Aligned so locked accesses can operate on whole eight byte cells. Every guest page lives here unless mapped.
+    alignas(64) std::array<std::uint8_t, constants::MAX_MEMORY_CAPACITY> theMemory{};
+    // Host storage of each guest page, loaded by every access and rewritten by mapPage, hence relaxed atomics
+    std::array<std::atomic<std::uint8_t *>, PageCount> thePageTable;
+    // Read by every core on every access and rewritten when observers change, hence relaxed atomics
+    std::array<std::atomic<std::uint8_t>, PageCount> thePageFlags{};
+    std::vector<ObservedRange> theObservers;
+    std::vector<std::uint8_t> theSnapshot;
+    MemoryHeatmap *theHeatmap{};
+    // One bit per page stored to since the snapshot, set from whichever thread made the store
+    std::array<std::atomic<std::uint64_t>, PageCount / 64> theDirtyPages{};
+    // Cores attach code pages and store into observed pages from their own threads
+    mutable std::recursive_mutex theObserverLock;
+    std::mutex theSplitLock;
+    MemoryModel theMemoryModel{MemoryModel::Relaxed};
+    // Bumped by block transfers from any thread, on a line of its own
+    alignas(64) mutable std::atomic<std::uint64_t> theBulkBytes{};
 };
 } // namespace svm
@@ -0,0 +1,62 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "constants.hpp"
+
+namespace svm
+{
+// Per page access counts, an alternative to tracing every access. Attached to a RandomAccessMemory it counts reads
+// and writes on the memory's slow path, cores count the instructions of each block they enter and block caches the
+// blocks a store evicted. With a sampling period above one only every period-th event on a host thread is counted,
+// weighted by the period.
+struct MemoryHeatmap
+{
+    static constexpr std::size_t PageSize = constants::PAGE_SIZE;
+    static constexpr std::size_t PageCount = constants::MAX_MEMORY_CAPACITY / PageSize;
+
+    enum class Access : std::uint8_t
+    {
+        Read,
+        Write,
+        Execute,
+        // Decoded blocks evicted by stores, counted on the page holding the block
+        Invalidate,
+    };
+    static constexpr std::size_t AccessKinds = 4U;
+
+    struct PageHeat
+    {
+        std::size_t thePage;
+        std::array<std::uint64_t, AccessKinds> theCounts;
+
+        [[nodiscard]] std::uint64_t total() const noexcept;
+    };
+
+    ~MemoryHeatmap() = default;
+    MemoryHeatmap(const MemoryHeatmap &) = delete;
+    MemoryHeatmap(MemoryHeatmap &&) = delete;
+    MemoryHeatmap &operator=(const MemoryHeatmap &) = delete;
+
+    explicit MemoryHeatmap(std::uint32_t aPeriod = 1U);
+
+    void record(Access aAccess, std::size_t aPage, std::uint64_t aCount = 1U) noexcept;
+    [[nodiscard]] std::uint64_t count(Access aAccess, std::size_t aPage) const noexcept;
+    [[nodiscard]] std::uint32_t period() const noexcept;
+    void reset() noexcept;
+
+    // Pages with any access, busiest first
+    [[nodiscard]] std::vector<PageHeat> hottest(std::size_t aLimit) const;
+    // One row per 64 KiB, one character per page from ' ' for none to '@' for the busiest on a log scale
+    [[nodiscard]] std::string formatMap(Access aAccess) const;
+    // hottest as a table with the page's linear address
+    [[nodiscard]] std::string formatTable(std::size_t aLimit) const;
+
+  private:
+    std::uint32_t thePeriod;
+    std::array<std::array<std::atomic<std::uint64_t>, PageCount>, AccessKinds> theCounts{};
+};
+} // namespace svm
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <vector>
+
+#include "expanded_memory.hpp"
+#include "memory.hpp"
+#include "record_replay.hpp"
+#include "single_core.hpp"
+#include "trap.hpp"
+
+namespace svm
+{
+// A point of a recorded run to restart replay from: machine state plus where the run stood in its log
+struct ReplayCheckpoint
+{
+    std::uint64_t theInstruction;
+    ReplayLog::Position thePosition;
+    // SaveState image of core and memory, with the expanded memory board's section when the run had one
+    std::vector<std::uint8_t> theState;
+};
+
+// Replays a recorded run as independent segments, one per pair of consecutive checkpoints, spread over host threads.
+// Every segment starts from its first checkpoint in a machine of its own and has to end in exactly the state of the
+// next one, so instrumentation too slow for the whole run can be attached to all segments at once.
+//
+// Segments only see what the log holds: IN values and interrupts come from it, OUT reaches no device. The one host
+// service a segment gets is an expanded memory board, restored from the checkpoint when it carries one.
+struct ParallelReplay
+{
+    struct Segment
+    {
+        std::size_t theIndex;
+        // Instruction counts of the recorded run the segment starts and ends at
+        std::uint64_t theFirst;
+        std::uint64_t theLast;
+        Trap theTrap;
+        // Ended on the last instruction in the next checkpoint's state without diverging from the log
+        bool theIsVerified;
+    };
+
+    // Called on the segment's thread before it runs, to attach debuggers, coverage maps or heatmaps. Calls for
+    // different segments can overlap.
+    using Instrument = std::function<void(const Segment &, SingleCore &, RandomAccessMemory &)>;
+
+    // Takes a checkpoint of a core being recorded by aRecorder, between runs. A guest using expanded memory needs
+    // aExpandedMemory, the board attached to the core, or its segments cannot verify.
+    [[nodiscard]] static ReplayCheckpoint checkpoint(SingleCore &aCore, const RandomAccessMemory &aMemory,
+                                                     const Recorder &aRecorder,
+                                                     const ExpandedMemory *aExpandedMemory = nullptr);
+    // Replays every segment of aLog, the whole flushed log, on aThreads threads or one per host core when zero.
+    // Segments come back in checkpoint order.
+    [[nodiscard]] static std::vector<Segment> replay(std::span<const std::uint8_t> aLog,
+                                                     std::span<const ReplayCheckpoint> aCheckpoints,
+                                                     const Instrument &aInstrument = {}, std::size_t aThreads = 0);
+};
+} // namespace svm
@@ -0,0 +1,122 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "trap.hpp"
+
+#ifndef SVM_COUNTERS
+#define SVM_COUNTERS 0
+#endif
+
+namespace svm
+{
+namespace counters
+{
+// Set by the SVM_COUNTERS build option, with counters off every update below compiles to nothing
+constexpr const bool ENABLED = SVM_COUNTERS != 0;
+
+inline void add(std::uint64_t &aCounter, std::uint64_t aValue = 1U) noexcept
+{
+    if constexpr (ENABLED)
+    {
+        aCounter += aValue;
+    }
+}
+
+// For counters shared by every core, never on a per access path
+inline void add(std::atomic<std::uint64_t> &aCounter, std::uint64_t aValue = 1U) noexcept
+{
+    if constexpr (ENABLED)
+    {
+        aCounter.fetch_add(aValue, std::memory_order_relaxed);
+    }
+}
+
+// Time stamp counter where there is one, nanoseconds elsewhere
+inline std::uint64_t hostCycles() noexcept
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return static_cast<std::uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+} // namespace counters
+
+// Read from the memory shared by all cores
+struct MemoryCounters
+{
+    // Bytes moved by block transfers and snapshot restores
+    std::uint64_t theBulkBytes{};
+};
+
+// Owned by one core and bumped from its thread only, whole cache lines so no other core's counters share them
+struct alignas(64) CoreCounters
+{
+    std::uint64_t theInstructions{};
+    std::uint64_t theBlocks{};
+    // Guest loads and stores the core made, indexed by arch::OperandSize
+    std::array<std::uint64_t, 2> theMemoryReads{};
+    std::array<std::uint64_t, 2> theMemoryWrites{};
+    std::uint64_t theBlockCacheHits{};
+    std::uint64_t theBlockCacheMisses{};
+    // Blocks entered through a chain link, without a lookup
+    std::uint64_t theBlockLinks{};
+    // RET and RETF whose target block came from the shadow return stack, and those needing a lookup
+    std::uint64_t theReturnHits{};
+    std::uint64_t theReturnMisses{};
+    std::uint64_t thePortReads{};
+    std::uint64_t thePortWrites{};
+    std::uint64_t theInterrupts{};
+    // Host cycles spent inside run
+    std::uint64_t theHostCycles{};
+    // Why run returned, indexed by Trap
+    std::array<std::uint64_t, TRAP_KINDS> theTraps{};
+};
+
+// Hardware counters of the calling thread, opened as one perf_event group so they are read atomically. Without
+// perf_event_open permission the session is unavailable and reports nothing.
+struct HostPerf
+{
+    struct Sample
+    {
+        std::uint64_t theCycles;
+        std::uint64_t theInstructions;
+        std::uint64_t theBranchMisses;
+        std::uint64_t theCacheMisses;
+    };
+
+    ~HostPerf();
+    HostPerf(const HostPerf &) = delete;
+    HostPerf(HostPerf &&) = delete;
+    HostPerf &operator=(const HostPerf &) = delete;
+
+    HostPerf();
+
+    [[nodiscard]] bool isAvailable() const noexcept;
+    void start() noexcept;
+    [[nodiscard]] std::optional<Sample> stop() noexcept;
+
+  private:
+    static constexpr std::size_t EventCount = 4U;
+
+    std::array<int, EventCount> theFds{-1, -1, -1, -1};
+};
+
+struct PerfReport
+{
+    [[nodiscard]] static double hostCyclesPerInstruction(const CoreCounters &aCore) noexcept;
+    // Host events per million guest instructions
+    [[nodiscard]] static double perMillion(std::uint64_t aEvents, std::uint64_t aGuestInstructions) noexcept;
+    [[nodiscard]] static std::string format(const CoreCounters &aCore, const MemoryCounters &aMemory,
+                                            const std::optional<HostPerf::Sample> &aHost = std::nullopt);
+};
+} // namespace svm
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "arch.hpp"
+
+namespace svm
+{
+// A device decoding a range of the 64K I/O port space
+struct PortDevice
+{
+    virtual ~PortDevice() = default;
+
+    [[nodiscard]] virtual std::uint16_t in(std::uint16_t aPort, arch::OperandSize aSize) noexcept = 0;
+    virtual void out(std::uint16_t aPort, std::uint16_t aValue, arch::OperandSize aSize) noexcept = 0;
+};
+
+// Routes IN and OUT to the device owning the port through a flat table, unclaimed ports read as all ones
+struct PortBus
+{
+    static constexpr std::size_t PortCount = 0x10000;
+    static constexpr std::uint16_t FloatingBus = 0xFFFF;
+
+    PortBus();
+
+    // Later attachments take over ports already claimed
+    void attach(PortDevice &aDevice, std::uint16_t aFirst, std::size_t aCount);
+    void detach(PortDevice &aDevice);
+
+    [[nodiscard]] std::uint16_t in(std::uint16_t aPort, arch::OperandSize aSize) noexcept;
+    void out(std::uint16_t aPort, std::uint16_t aValue, arch::OperandSize aSize) noexcept;
+
+  private:
+    // Index into theDevices per port, zero when unclaimed
+    std::vector<std::uint8_t> theSlots;
+    std::vector<PortDevice *> theDevices;
+};
+} // namespace svm
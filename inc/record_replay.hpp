@@ -0,0 +1,117 @@
+#pragma once
+#include <cstdint>
+#include <istream>
+#include <limits>
+#include <optional>
+#include <ostream>
+#include <vector>
+
+namespace svm
+{
+// Every nondeterministic input reaches the guest either as an IN from a device (keyboard scancodes, host clock reads,
+// serial data) or as an external interrupt. Replaying the IN values in order and delivering interrupts at the same
+// retired instruction count reproduces a run exactly.
+//
+// Log: "SVMR", version byte, then events. Each event is a tag byte followed by LEB128 varints
+//   PortIn:    port, value
+//   Interrupt: instructions retired since the previous interrupt or the start of recording, vector
+struct ReplayLog
+{
+    static constexpr std::uint8_t Version = 1U;
+
+    enum class Event : std::uint8_t
+    {
+        PortIn = 1,
+        Interrupt = 2,
+    };
+
+    // Where a run stands in its log: the byte offset of the next event, the header included, and the instructions
+    // retired since the last logged interrupt or the start of recording
+    struct Position
+    {
+        std::uint64_t theOffset;
+        std::uint64_t theSinceInterrupt;
+    };
+};
+
+// Appends events to a buffer and hands the buffer to the stream only when it fills up or on flush
+struct Recorder
+{
+    static constexpr std::size_t DefaultBufferSize = 64U * 1024U;
+
+    ~Recorder();
+    Recorder(const Recorder &) = delete;
+    Recorder(Recorder &&) = delete;
+    Recorder &operator=(const Recorder &) = delete;
+
+    explicit Recorder(std::ostream &aStream, std::size_t aBufferSize = DefaultBufferSize);
+
+    // Called by the core
+    void start(std::uint64_t aInstruction) noexcept;
+    void portIn(std::uint16_t aPort, std::uint16_t aValue) noexcept;
+    void interrupt(std::uint64_t aInstruction, std::uint8_t aVector) noexcept;
+
+    void flush() noexcept;
+    [[nodiscard]] std::size_t bytesWritten() const noexcept;
+    // Position of a core that retired aInstruction, for a stream that was empty when recording started
+    [[nodiscard]] ReplayLog::Position position(std::uint64_t aInstruction) const noexcept;
+
+  private:
+    void putVarint(std::uint64_t aValue) noexcept;
+    void reserve() noexcept;
+
+    std::ostream &theStream;
+    std::vector<std::uint8_t> theBuffer;
+    std::size_t theBufferSize;
+    std::size_t theBytesWritten{};
+    std::uint64_t theLastInterrupt{};
+};
+
+// Reads a log back in chunks, one event of lookahead
+struct Replayer
+{
+    static constexpr std::uint64_t NoInterrupt = std::numeric_limits<std::uint64_t>::max();
+
+    ~Replayer() = default;
+    Replayer(const Replayer &) = delete;
+    Replayer(Replayer &&) = delete;
+    Replayer &operator=(const Replayer &) = delete;
+
+    explicit Replayer(std::istream &aStream);
+    // Continues a log from aPosition on a seekable stream, the core has to be in the state the position was taken in
+    Replayer(std::istream &aStream, ReplayLog::Position aPosition);
+
+    // Called by the core
+    void start(std::uint64_t aInstruction) noexcept;
+    [[nodiscard]] std::uint16_t portIn(std::uint16_t aPort) noexcept;
+    // Instruction count the next logged interrupt is due at
+    [[nodiscard]] std::uint64_t nextInterruptAt() noexcept;
+    // Vector of the interrupt due at aInstruction, consumed
+    [[nodiscard]] std::optional<std::uint8_t> interruptAt(std::uint64_t aInstruction) noexcept;
+
+    // The guest asked for something the log does not contain at this point
+    [[nodiscard]] bool diverged() const noexcept;
+    [[nodiscard]] bool finished() noexcept;
+
+  private:
+    struct Pending
+    {
+        ReplayLog::Event theEvent;
+        std::uint64_t theFirst;
+        std::uint64_t theSecond;
+    };
+
+    [[nodiscard]] const std::optional<Pending> &peek() noexcept;
+    [[nodiscard]] std::optional<std::uint8_t> nextByte() noexcept;
+    [[nodiscard]] std::optional<std::uint64_t> nextVarint() noexcept;
+
+    std::istream &theStream;
+    std::vector<std::uint8_t> theBuffer;
+    std::size_t thePosition{};
+    std::optional<Pending> thePending;
+    bool theHasPending{};
+    bool theDiverged{};
+    std::uint64_t theLastInterrupt{};
+    std::uint64_t theSinceInterrupt{};
+};
+} // namespace svm
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+#include "memory.hpp"
+#include "single_core.hpp"
+
+namespace svm
+{
+// Versioned machine checkpoint: core registers, coprocessor, guest memory and opaque device sections.
+//
+// Layout: header, one directory entry per guest page, device sections, then page data starting on a page boundary.
+// Zero pages take no data, repeated pages point at their first copy, pages made of long byte runs are run-length
+// encoded and every other page is stored verbatim at a page aligned offset so loading maps the file and copies.
+struct SaveState
+{
+    static constexpr std::uint16_t Version = 2U;
+
+    enum class Status
+    {
+        OK,
+        IO_ERROR,
+        BAD_FORMAT,
+        VERSION_MISMATCH,
+    };
+
+    enum class PageKind : std::uint8_t
+    {
+        Zero,
+        Raw,
+        Duplicate,
+        RunLength,
+    };
+
+    // Device state travels as tagged bytes, the owning device defines the payload
+    struct Section
+    {
+        std::uint32_t theTag;
+        std::vector<std::uint8_t> theData;
+    };
+
+    [[nodiscard]] static std::vector<std::uint8_t> encode(SingleCore &aCore, const RandomAccessMemory &aMemory,
+                                                          std::span<const Section> aSections = {});
+    [[nodiscard]] static Status decode(std::span<const std::uint8_t> aImage, SingleCore &aCore,
+                                       RandomAccessMemory &aMemory, std::vector<Section> *aSections = nullptr);
+
+    [[nodiscard]] static Status save(const std::filesystem::path &aPath, SingleCore &aCore,
+                                     const RandomAccessMemory &aMemory, std::span<const Section> aSections = {});
+    [[nodiscard]] static Status load(const std::filesystem::path &aPath, SingleCore &aCore, RandomAccessMemory &aMemory,
+                                     std::vector<Section> *aSections = nullptr);
+
+    // Page kinds chosen for aImage, in guest page order
+    [[nodiscard]] static std::vector<PageKind> pageKinds(std::span<const std::uint8_t> aImage);
+};
+} // namespace svm
@@ -1,12 +1,41 @@
 #pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <limits>
 #include <memory>
+#include <optional>
+#include <span>
+#include <utility>
 
 #include "arch.hpp"
+#include "block_cache.hpp"
+#include "fpu.hpp"
 #include "memory.hpp"
+#include "perf_counters.hpp"
+#include "stack_accessor.hpp"
 #include "trap.hpp"
 
 namespace svm
 {
+struct Debugger;
+struct GuestProfiler;
+struct Hypercalls;
+struct PortBus;
+struct Recorder;
+struct Replayer;
+struct SingleCore;
+
+// Host implementation of a software interrupt, the way a BIOS or driver service is emulated at high level. INT runs
+// it in place of the guest's handler, it sees the registers as the caller set them and its changes are what the caller
+// gets back.
+struct InterruptService
+{
+    virtual ~InterruptService() = default;
+
+    [[nodiscard]] virtual Trap onInterrupt(SingleCore &aCore) noexcept = 0;
+};
+
 struct SingleCore
 {
 
@@ -24,6 +53,52 @@ struct SingleCore
         Sub,
     };
 
+    // Execution
+    // Runs whole blocks from CS:IP until a trap, a stop request or at least aBudget instructions retired
+    Trap run(std::size_t aBudget) noexcept;
+    // Runs until exactly aInstruction instructions retired since construction, a trap or a stop request. The last
+    // block is cut short the way a replayed interrupt cuts it, so checkpoints land on the same instruction every time.
+    Trap runTo(std::uint64_t aInstruction) noexcept;
+    Trap step() noexcept;
+    // Runs a LOCK prefixed instruction, retried until its memory destination is updated without interference
+    Trap executeLocked(const DecodedInst &aInst, DecodedInst::Handler aBody) noexcept;
+    // Ends run at the next block boundary, run then reports Trap::BREAK
+    void requestStop() noexcept;
+    // Ends run at the next block boundary without reporting a stop, used when a device needs to act
+    void requestYield() noexcept;
+    void attachDebugger(Debugger *aDebugger) noexcept;
+    BlockCache &blockCache() noexcept;
+    // Instructions retired by run and step since construction
+    [[nodiscard]] std::uint64_t instructionCount() const noexcept;
+    // For executors running guest code outside run and step, such as ahead-of-time compiled blocks: counts what they
+    // retired, and tells how many instructions may retire before run has to take an interrupt or a replayed event
+    void retire(std::uint64_t aInstructions) noexcept;
+    [[nodiscard]] std::uint64_t eventDistance() noexcept;
+    // All zero unless built with SVM_COUNTERS
+    [[nodiscard]] const CoreCounters &counters() const noexcept;
+    void resetCounters() noexcept;
+
+    // Devices and external interrupts
+    void attachPortBus(PortBus *aPortBus) noexcept;
+    // INT aVector calls aService instead of the handler in the vector table, nullptr gives the vector back to the guest
+    void attachService(std::uint8_t aVector, InterruptService *aService) noexcept;
+    // Host routines the reserved hypercall opcode reaches, nullptr makes the opcode illegal again
+    void attachHypercalls(Hypercalls *aHypercalls) noexcept;
+    // Queues an external interrupt, taken at the next block boundary once IF is set. Safe to call from host threads
+    // while run executes on another thread, the run loop only looks at the pending mask between blocks.
+    void raiseInterrupt(std::uint8_t aVector) noexcept;
+    // Drops every queued interrupt, for callers restarting the guest from a saved state
+    void clearPendingInterrupts() noexcept;
+    // While recording every IN value and interrupt delivery is logged, while replaying IN values and interrupts
+    // come from the log and raiseInterrupt is ignored
+    void attachRecorder(Recorder *aRecorder) noexcept;
+    void attachReplayer(Replayer *aReplayer) noexcept;
+    // Edge coverage: entering a block bumps the counter of the (previous block, block) pair in aMap, whose size must
+    // be a power of two. Attaching starts a new trace, an empty span turns coverage off.
+    void attachCoverage(std::span<std::uint8_t> aMap) noexcept;
+    // Reports every CALL, RET, RETF, interrupt entry and IRET, and the instructions retired between them, to aProfiler
+    void attachProfiler(GuestProfiler *aProfiler) noexcept;
+
     // Instruction set
     Trap AAA(void) noexcept;
     Trap AAD(void) noexcept;
@@ -43,8 +118,10 @@ struct SingleCore
     Trap AND(arch::MemoryAddress, arch::Regs) noexcept;
     void AND_setFlags(arch::Immediate) noexcept;
 
+    // Near calls take their target as an offset within CS, far calls as segment and offset
     Trap CALL(arch::MemoryAddress) noexcept;
     Trap CALL(arch::Regs) noexcept;
+    Trap CALL(arch::Immediate, arch::Immediate) noexcept;
 
     Trap CBW(void) noexcept;
 
@@ -73,6 +150,8 @@ struct SingleCore
     Trap DIV(arch::Regs) noexcept;
     Trap DIV(arch::MemoryAddress) noexcept;
 
+    Trap HCALL(arch::Immediate) noexcept;
+
     Trap HLT(void) noexcept;
 
     Trap IDIV(arch::Regs) noexcept;
@@ -81,8 +160,8 @@ struct SingleCore
     Trap IMUL(arch::Regs) noexcept;
     Trap IMUL(arch::MemoryAddress) noexcept;
 
-    Trap IN(arch::Immediate, arch::RegLevel) noexcept;
-    Trap IN(arch::RegLevel) noexcept;
+    // Port I/O moves AL or AX depending on the operand size
+    Trap IN(arch::Immediate, arch::OperandSize) noexcept;
 
     Trap INC(arch::Regs) noexcept;
     Trap INC(arch::MemoryAddress) noexcept;
@@ -91,36 +170,41 @@ struct SingleCore
     Trap INTO(void) noexcept;
     Trap IRET(void) noexcept;
 
-    Trap JA(arch::MemoryAddress) noexcept;   // TODO
-    Trap JAE(arch::MemoryAddress) noexcept;  // TODO
-    Trap JB(arch::MemoryAddress) noexcept;   // TODO
-    Trap JBE(arch::MemoryAddress) noexcept;  // TODO
-    Trap JC(arch::MemoryAddress) noexcept;   // TODO
-    Trap JCXZ(arch::MemoryAddress) noexcept; // TODO
-    Trap JE(arch::MemoryAddress) noexcept;   // TODO
-    Trap JG(arch::MemoryAddress) noexcept;   // TODO
-    Trap JGE(arch::MemoryAddress) noexcept;  // TODO
-    Trap JL(arch::MemoryAddress) noexcept;   // TODO
-    Trap JMP(arch::MemoryAddress) noexcept;  // TODO
-    Trap JNA(arch::MemoryAddress) noexcept;  // TODO
-    Trap JNAE(arch::MemoryAddress) noexcept; // TODO
-    Trap JNB(arch::MemoryAddress) noexcept;  // TODO
-    Trap JNBE(arch::MemoryAddress) noexcept; // TODO
-    Trap JNC(arch::MemoryAddress) noexcept;  // TODO
-    Trap JNE(arch::MemoryAddress) noexcept;  // TODO
-    Trap JNG(arch::MemoryAddress) noexcept;  // TODO
-    Trap JNGE(arch::MemoryAddress) noexcept; // TODO
-    Trap JNL(arch::MemoryAddress) noexcept;  // TODO
-    Trap JNLE(arch::MemoryAddress) noexcept; // TODO
-    Trap JNO(arch::MemoryAddress) noexcept;  // TODO
-    Trap JNP(arch::MemoryAddress) noexcept;  // TODO
-    Trap JNS(arch::MemoryAddress) noexcept;  // TODO
-    Trap JNZ(arch::MemoryAddress) noexcept;  // TODO
-    Trap JO(arch::MemoryAddress) noexcept;   // TODO
-    Trap JP(arch::MemoryAddress) noexcept;   // TODO
-    Trap JPE(arch::MemoryAddress) noexcept;  // TODO
-    Trap JPO(arch::MemoryAddress) noexcept;  // TODO
-    Trap JZ(arch::MemoryAddress) noexcept;   // TODO
+    // Near branches take their target as an offset within CS
+    Trap JA(arch::MemoryAddress) noexcept;
+    Trap JAE(arch::MemoryAddress) noexcept;
+    Trap JB(arch::MemoryAddress) noexcept;
+    Trap JBE(arch::MemoryAddress) noexcept;
+    Trap JC(arch::MemoryAddress) noexcept;
+    Trap JCXZ(arch::MemoryAddress) noexcept;
+    Trap JE(arch::MemoryAddress) noexcept;
+    Trap JG(arch::MemoryAddress) noexcept;
+    Trap JGE(arch::MemoryAddress) noexcept;
+    Trap JL(arch::MemoryAddress) noexcept;
+    Trap JLE(arch::MemoryAddress) noexcept;
+    Trap JMP(arch::MemoryAddress) noexcept;
+    Trap JMP(arch::Regs) noexcept;
+    Trap JMP(arch::Immediate, arch::Immediate) noexcept;
+    Trap JNA(arch::MemoryAddress) noexcept;
+    Trap JNAE(arch::MemoryAddress) noexcept;
+    Trap JNB(arch::MemoryAddress) noexcept;
+    Trap JNBE(arch::MemoryAddress) noexcept;
+    Trap JNC(arch::MemoryAddress) noexcept;
+    Trap JNE(arch::MemoryAddress) noexcept;
+    Trap JNG(arch::MemoryAddress) noexcept;
+    Trap JNGE(arch::MemoryAddress) noexcept;
+    Trap JNL(arch::MemoryAddress) noexcept;
+    Trap JNLE(arch::MemoryAddress) noexcept;
+    Trap JNO(arch::MemoryAddress) noexcept;
+    Trap JNP(arch::MemoryAddress) noexcept;
+    Trap JNS(arch::MemoryAddress) noexcept;
+    Trap JNZ(arch::MemoryAddress) noexcept;
+    Trap JO(arch::MemoryAddress) noexcept;
+    Trap JP(arch::MemoryAddress) noexcept;
+    Trap JPE(arch::MemoryAddress) noexcept;
+    Trap JPO(arch::MemoryAddress) noexcept;
+    Trap JS(arch::MemoryAddress) noexcept;
+    Trap JZ(arch::MemoryAddress) noexcept;
 
     Trap LAHF(void) noexcept;
     Trap LDS(arch::Regs, arch::MemoryAddress) noexcept;
@@ -129,11 +213,11 @@ struct SingleCore
 
     Trap LODSB(void) noexcept;
     Trap LODSW(void) noexcept;
-    Trap LOOP(arch::MemoryAddress) noexcept;   // TODO
-    Trap LOOPE(arch::MemoryAddress) noexcept;  // TODO
-    Trap LOOPNE(arch::MemoryAddress) noexcept; // TODO
-    Trap LOOPNZ(arch::MemoryAddress) noexcept; // TODO
-    Trap LOOPZ(arch::MemoryAddress) noexcept;  // TODO
+    Trap LOOP(arch::MemoryAddress) noexcept;
+    Trap LOOPE(arch::MemoryAddress) noexcept;
+    Trap LOOPNE(arch::MemoryAddress) noexcept;
+    Trap LOOPNZ(arch::MemoryAddress) noexcept;
+    Trap LOOPZ(arch::MemoryAddress) noexcept;
 
     Trap MOV(arch::Regs, arch::Regs) noexcept;
     Trap MOV(arch::Regs, arch::MemoryAddress) noexcept;
@@ -155,8 +239,7 @@ struct SingleCore
     Trap OR(arch::MemoryAddress, arch::Immediate) noexcept;
     Trap OR(arch::MemoryAddress, arch::Regs) noexcept;
 
-    Trap OUT(arch::Immediate, arch::Regs, arch::RegLevel) noexcept;
-    Trap OUT(arch::RegLevel) noexcept;
+    Trap OUT(arch::Immediate, arch::OperandSize) noexcept;
 
     Trap POP(arch::Regs) noexcept;
     Trap POP(arch::MemoryAddress) noexcept;
@@ -167,6 +250,7 @@ struct SingleCore
     Trap PUSH(arch::Regs) noexcept;
     Trap PUSH(arch::MemoryAddress) noexcept;
     Trap PUSH(arch::Immediate) noexcept;
+    Trap PUSHA(void) noexcept;
     Trap PUSHF(void) noexcept;
 
     Trap RCL(arch::Regs) noexcept;
@@ -244,6 +328,9 @@ struct SingleCore
     Trap SUB(arch::MemoryAddress, arch::Immediate) noexcept;
     Trap SUB(arch::MemoryAddress, arch::Regs) noexcept;
 
+    // The coprocessor finishes every ESC instruction before the next one starts, nothing to wait for
+    Trap WAIT(void) noexcept;
+
     Trap TEST(arch::Regs, arch::Regs) noexcept;
     Trap TEST(arch::Regs, arch::MemoryAddress) noexcept;
     Trap TEST(arch::Regs, arch::Immediate) noexcept;
@@ -261,15 +348,60 @@ struct SingleCore
     Trap XOR(arch::MemoryAddress, arch::Immediate) noexcept;
     Trap XOR(arch::MemoryAddress, arch::Regs) noexcept;
 
+    // Indirect CALL and JMP through a memory operand holding the offset, followed by the segment when far
+    Trap callThrough(arch::MemoryAddress, bool) noexcept;
+    Trap jumpThrough(arch::MemoryAddress, bool) noexcept;
+
+    // 8087 state, the decoder sends the ESC instructions straight to it
+    Fpu &fpu() noexcept;
+
     void parseInstruction() noexcept;
     arch::Register &getReg(arch::Regs) noexcept;
     [[nodiscard]] arch::Immediate readRegister(arch::Regs) noexcept;
+    // Compile time form for handlers specialized on their operands, no register switch
+    template <arch::Regs Register> [[nodiscard]] arch::Immediate readRegister() const noexcept
+    {
+        static constexpr std::array<arch::Register SingleCore::*, std::to_underlying(arch::Regs::FLAG) + 1U> Members{
+            &SingleCore::theAX, &SingleCore::theBX, &SingleCore::theCX, &SingleCore::theDX, &SingleCore::theCS,
+            &SingleCore::theDS, &SingleCore::theSS, &SingleCore::theES, &SingleCore::theSP, &SingleCore::theBP,
+            &SingleCore::theSI, &SingleCore::theDI, &SingleCore::theIP, &SingleCore::theFlag};
+        return (this->*Members[std::to_underlying(Register)]).theRegisterValue;
+    }
     void writeRegister(arch::Regs, arch::Immediate) noexcept;
     void setFlag(arch::Flags, arch::Immediate) noexcept;
     arch::Immediate readFlag(arch::Flags) noexcept;
-    arch::MemoryAddress getEffectiveAddr(arch::Regs, arch::Regs) const noexcept;
+    // Linear address of segment:offset
+    arch::MemoryAddress getEffectiveAddr(arch::Regs, arch::Regs) noexcept;
 
   private:
+    Trap runBlocks(std::size_t) noexcept;
+    Trap runBlock(const Block &) noexcept;
+    Trap runMarkedBlock(const Block &) noexcept;
+    Trap execute(const DecodedInst &) noexcept;
+    void consumeBudget(std::size_t) noexcept;
+    [[nodiscard]] std::size_t blockLimit(const Block &) const noexcept;
+    Trap serviceEvents() noexcept;
+    [[nodiscard]] std::uint64_t nextEvent() noexcept;
+    void recordEdge(std::uint32_t) noexcept;
+    [[nodiscard]] bool hasPendingInterrupt() const noexcept;
+    [[nodiscard]] std::optional<std::uint8_t> takePendingInterrupt() noexcept;
+    std::uint16_t portIn(std::uint16_t, arch::OperandSize) noexcept;
+    Trap interrupt(std::uint8_t) noexcept;
+    // Guest data accesses of this core, counted in its own counters
+    std::pair<Trap, arch::Immediate> load(arch::MemoryAddress) noexcept;
+    std::pair<Trap, arch::Immediate> loadByte(arch::MemoryAddress) noexcept;
+    Trap store(arch::MemoryAddress, arch::Immediate) noexcept;
+    std::pair<Trap, arch::Immediate> readDestination(arch::MemoryAddress) noexcept;
+    Trap writeDestination(arch::MemoryAddress, arch::Immediate) noexcept;
+    StackAccessor stack() noexcept;
+    Trap returnFrom(bool, arch::Immediate) noexcept;
+    Trap profileCall(Trap) noexcept;
+    Trap profileReturn(arch::MemoryAddress, Trap) noexcept;
+    std::pair<Trap, std::array<arch::Immediate, 2>> readPointer(arch::MemoryAddress, bool) noexcept;
+    Trap jumpIf(bool, arch::MemoryAddress) noexcept;
+    Trap incDec(arch::Regs, SingleCore::BinaryOp) noexcept;
+    Trap incDec(arch::MemoryAddress, SingleCore::BinaryOp) noexcept;
+
     template<BinaryOp Op, typename IntegralT>
     arch::Immediate computeArithmeticFlags(IntegralT, IntegralT, IntegralT) noexcept;
     arch::Immediate setFlagOnAdd(std::uint32_t, std::uint32_t, std::uint32_t) noexcept;
@@ -297,5 +429,36 @@ struct SingleCore
     arch::Register theFlag{arch::Register{.theLabel = arch::Regs::FLAG, .theRegisterValue = 0}};
 
     RandomAccessMemory &theMemory;
+    CoreCounters theCounters;
+    Fpu theFpu{theMemory, theCounters};
+
+    BlockCache theBlockCache;
+    Debugger *theDebugger{};
+    std::size_t theRunBudget{};
+    bool theStopRequested{};
+
+    // Read-modify-write destination of the LOCK prefixed instruction being executed
+    struct LockedAccess
+    {
+        bool theIsActive;
+        bool theIsConflict;
+        arch::Immediate theValue;
+    };
+    LockedAccess theLockedAccess{};
+
+    PortBus *thePortBus{};
+    std::array<InterruptService *, 256> theServices{};
+    Hypercalls *theHypercalls{};
+    Recorder *theRecorder{};
+    Replayer *theReplayer{};
+    std::span<std::uint8_t> theCoverage;
+    GuestProfiler *theProfiler{};
+    std::uint32_t thePreviousBlock{};
+    std::uint64_t theInstructionCount{};
+    // Instruction count at which the run loop has to stop mid block, set while replaying an interrupt or in runTo
+    std::uint64_t theEventHorizon{std::numeric_limits<std::uint64_t>::max()};
+    std::uint64_t theStopAt{std::numeric_limits<std::uint64_t>::max()};
+    // One bit per vector, set by raiseInterrupt from any thread and cleared by the run loop
+    alignas(64) std::array<std::atomic<std::uint64_t>, 4> thePendingInterrupts{};
 };
 } // namespace svm
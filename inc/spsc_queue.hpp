@@ -0,0 +1,71 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <optional>
+
+namespace svm
+{
+// Bounded wait free queue between exactly one producer thread and one consumer thread. Head and tail live on their
+// own cache lines and each side caches the other's index, so the shared lines are only touched when the cached view
+// says the queue is full or empty.
+template <typename T, std::size_t Capacity> struct SpscQueue
+{
+    static_assert(Capacity != 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+    // Producer side
+    [[nodiscard]] bool tryPush(const T &aValue) noexcept
+    {
+        const auto myTail = theTail.load(std::memory_order_relaxed);
+        if (myTail - theCachedHead == Capacity)
+        {
+            theCachedHead = theHead.load(std::memory_order_acquire);
+            if (myTail - theCachedHead == Capacity)
+            {
+                return false;
+            }
+        }
+        theSlots[myTail & (Capacity - 1)] = aValue;
+        theTail.store(myTail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side
+    [[nodiscard]] std::optional<T> tryPop() noexcept
+    {
+        const auto myHead = theHead.load(std::memory_order_relaxed);
+        if (myHead == theCachedTail)
+        {
+            theCachedTail = theTail.load(std::memory_order_acquire);
+            if (myHead == theCachedTail)
+            {
+                return std::nullopt;
+            }
+        }
+        T myValue = theSlots[myHead & (Capacity - 1)];
+        theHead.store(myHead + 1, std::memory_order_release);
+        return myValue;
+    }
+
+    // Consumer side
+    [[nodiscard]] bool isEmpty() noexcept
+    {
+        const auto myHead = theHead.load(std::memory_order_relaxed);
+        if (myHead != theCachedTail)
+        {
+            return false;
+        }
+        theCachedTail = theTail.load(std::memory_order_acquire);
+        return myHead == theCachedTail;
+    }
+
+  private:
+    static constexpr std::size_t CacheLine = 64U;
+
+    alignas(CacheLine) std::atomic<std::size_t> theHead{};
+    std::size_t theCachedTail{};
+    alignas(CacheLine) std::atomic<std::size_t> theTail{};
+    std::size_t theCachedHead{};
+    alignas(CacheLine) std::array<T, Capacity> theSlots{};
+};
+} // namespace svm
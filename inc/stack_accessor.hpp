@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <utility>
+
+#include "arch.hpp"
+#include "memory.hpp"
+#include "perf_counters.hpp"
+#include "trap.hpp"
+
+namespace svm
+{
+// SS:SP traffic of one instruction. The SS base is worked out once for all the words the instruction moves, offsets
+// wrap at 64 KiB like on the 8086 and SP only moves once the whole transfer went through.
+//
+// Multi-word pushes and pops that do not wrap are a single block transfer.
+struct StackAccessor
+{
+    ~StackAccessor() = default;
+    StackAccessor(const StackAccessor &) = delete;
+    StackAccessor(StackAccessor &&) = delete;
+    StackAccessor &operator=(const StackAccessor &) = delete;
+
+    // Word accesses are counted in aCounters, those of the core whose stack it is
+    StackAccessor(RandomAccessMemory &aMemory, CoreCounters &aCounters, arch::Immediate aSegment,
+                  arch::Immediate &aPointer) noexcept;
+
+    Trap push(arch::Immediate aValue) noexcept;
+    std::pair<Trap, arch::Immediate> pop() noexcept;
+    // aValues[0] is pushed first and ends up at the highest address, popAll undoes pushAll
+    Trap pushAll(std::span<const arch::Immediate> aValues) noexcept;
+    Trap popAll(std::span<arch::Immediate> aValues) noexcept;
+    // Drops aBytes of arguments, as RET n does
+    void release(arch::Immediate aBytes) noexcept;
+
+  private:
+    static constexpr std::size_t MaxWords = 8U;
+
+    Trap writeWord(arch::Immediate aOffset, arch::Immediate aValue) noexcept;
+    std::pair<Trap, arch::Immediate> readWord(arch::Immediate aOffset) const noexcept;
+    [[nodiscard]] arch::MemoryAddress at(arch::Immediate aOffset) const noexcept;
+
+    RandomAccessMemory &theMemory;
+    CoreCounters &theCounters;
+    std::uint32_t theBase;
+    arch::Immediate &thePointer;
+};
+} // namespace svm
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "decoder.hpp"
+#include "memory.hpp"
+
+namespace svm
+{
+// Offline half of the ahead-of-time path: recovers the control flow graph of a loaded program and writes it out as
+// C++ that AotRuntime runs.
+//
+// Discovery follows direct jumps, calls, conditional branches and fall-through from the entry point. Targets only
+// known at run time (RET, indirect and far transfers) end a block without successors, their code is left to the
+// interpreter unless some direct path reaches it too. Blocks stay inside the image and may overlap.
+struct StaticRecompiler
+{
+    // Longest block, keeps the generated functions a size compilers optimise well
+    static constexpr std::size_t MaxBlockInstructions = 64U;
+
+    struct Instruction
+    {
+        std::uint16_t theOffset;
+        DecodedInst theDecoded;
+    };
+
+    struct Block
+    {
+        std::uint16_t theOffset;
+        std::vector<Instruction> theInstructions;
+        // Offsets the block statically continues at
+        std::vector<std::uint16_t> theSuccessors;
+    };
+
+    struct Program
+    {
+        std::uint16_t theSegment;
+        std::uint16_t theEntry;
+        // Image bytes at theSegment:theBegin
+        std::uint16_t theBegin;
+        std::vector<std::uint8_t> theImage;
+        // Ordered by offset
+        std::vector<Block> theBlocks;
+    };
+
+    // Loads aImage into aMemory at aSegment:aBegin and discovers what is reachable from aSegment:aEntry
+    [[nodiscard]] static Program discover(RandomAccessMemory &aMemory, std::span<const std::uint8_t> aImage,
+                                          std::uint16_t aSegment, std::uint16_t aBegin, std::uint16_t aEntry);
+    // Whether the translation calls SingleCore directly rather than the decoded handler
+    [[nodiscard]] static bool isNative(const DecodedInst &aInst) noexcept;
+    // A translation unit defining the blocks and a main that runs the program like Svm does and reports as aName
+    static void emit(std::ostream &aStream, const Program &aProgram, std::string_view aName);
+};
+} // namespace svm
@@ -0,0 +1,88 @@
+#pragma once
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+#include <span>
+
+#include "arch.hpp"
+#include "memory.hpp"
+
+namespace svm
+{
+// 80x25 colour text mode living at B800:0000. Every cell is a character byte followed by an attribute byte, the
+// device only remembers which cells the guest touched so consumers never rescan the whole buffer.
+struct TextModeVideo : MemoryObserver
+{
+    static constexpr std::size_t Columns = 80U;
+    static constexpr std::size_t Rows = 25U;
+    static constexpr std::size_t CellCount = Columns * Rows;
+    static constexpr std::size_t CellSize = 2U;
+    static constexpr std::size_t BufferSize = CellCount * CellSize;
+    static constexpr arch::MemoryAddress BaseAddress{.theAddress = 0xB8000};
+
+    struct Cell
+    {
+        std::uint8_t theCharacter;
+        std::uint8_t theAttribute;
+    };
+
+    ~TextModeVideo() override;
+    TextModeVideo(const TextModeVideo &) = delete;
+    TextModeVideo(TextModeVideo &&) = delete;
+    TextModeVideo &operator=(const TextModeVideo &) = delete;
+
+    TextModeVideo(RandomAccessMemory &aMemory);
+
+    void onWrite(arch::MemoryAddress aMemoryAddress, std::size_t aLength) noexcept override;
+
+    [[nodiscard]] Cell cell(std::size_t aIndex) const noexcept;
+    [[nodiscard]] std::size_t dirtyCount() const noexcept;
+    // Cells written since the last clearDirty, in the order they were first touched
+    [[nodiscard]] std::span<const std::uint16_t> dirtyCells() const noexcept;
+    void clearDirty() noexcept;
+    void markAllDirty() noexcept;
+
+  private:
+    void markDirty(std::size_t aIndex) noexcept;
+
+    RandomAccessMemory &theMemory;
+    std::bitset<CellCount> theDirtyBits;
+    std::array<std::uint16_t, CellCount> theDirtyList{};
+    std::size_t theDirtyCount{};
+};
+
+// Emits the cells a TextModeVideo reports as changed, so the cost of a frame scales with what the guest wrote.
+struct HeadlessRenderer
+{
+    enum class Mode
+    {
+        Terminal, // ANSI cursor addressing and colours
+        Log,      // One "row,col char attr" line per changed cell
+    };
+
+    HeadlessRenderer(TextModeVideo &aVideo, std::ostream &aStream, Mode aMode) noexcept;
+
+    // Renders the pending changes and returns the number of cells emitted
+    std::size_t flush();
+    // Writes the full screen as 25 lines of text every aPeriod frames, only when something changed in between
+    void enableScreenshots(std::filesystem::path aPath, std::size_t aPeriod);
+    [[nodiscard]] bool writeScreenshot(const std::filesystem::path &aPath) const;
+
+  private:
+    void emitTerminal(std::uint16_t aIndex, TextModeVideo::Cell aCell);
+    void emitLog(std::uint16_t aIndex, TextModeVideo::Cell aCell);
+
+    TextModeVideo &theVideo;
+    std::ostream &theStream;
+    Mode theMode;
+    std::size_t theFrame{};
+    std::size_t theCursor{TextModeVideo::CellCount};
+    int theLastAttribute{-1};
+
+    std::filesystem::path theScreenshotPath;
+    std::size_t theScreenshotPeriod{};
+    bool theScreenshotPending{};
+};
+} // namespace svm
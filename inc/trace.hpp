@@ -0,0 +1,184 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#ifndef SVM_TRACE
+#define SVM_TRACE 0
+#endif
+
+namespace svm
+{
+struct TraceSession;
+
+namespace trace
+{
+// Set by the SVM_TRACE build option, with tracing off every probe below compiles to nothing. With it on, a probe
+// outside a session costs one relaxed load.
+constexpr const bool ENABLED = SVM_TRACE != 0;
+
+enum class Category : std::uint8_t
+{
+    Run,
+    BlockCache,
+    Interrupt,
+    Device,
+    Port,
+    Service,
+    HostIo,
+};
+
+struct Event
+{
+    // Probes pass string literals, only the pointer is kept
+    const char *theName;
+    // Nanoseconds since the session started
+    std::uint64_t theBegin;
+    // Zero for instants
+    std::uint64_t theDuration;
+    std::uint64_t theValue;
+    Category theCategory;
+    bool theIsSlice;
+};
+
+inline std::atomic<TraceSession *> theActiveSession{};
+
+inline std::uint64_t now() noexcept
+{
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+[[nodiscard]] inline bool isActive() noexcept
+{
+    if constexpr (ENABLED)
+    {
+        return theActiveSession.load(std::memory_order_relaxed) != nullptr;
+    }
+    else
+    {
+        return false;
+    }
+}
+
+void recordInstant(Category, const char *aName, std::uint64_t aValue) noexcept;
+void recordBurst(Category, const char *aName) noexcept;
+void recordSlice(Category, const char *aName, std::uint64_t aBegin, std::uint64_t aValue) noexcept;
+
+// A point on the timeline
+inline void instant(Category aCategory, const char *aName, std::uint64_t aValue = 0) noexcept
+{
+    if (isActive()) [[unlikely]]
+    {
+        recordInstant(aCategory, aName, aValue);
+    }
+}
+
+// Events of the same name following each other closely on one thread merge into one slice, its value counting them
+inline void burst(Category aCategory, const char *aName) noexcept
+{
+    if (isActive()) [[unlikely]]
+    {
+        recordBurst(aCategory, aName);
+    }
+}
+
+// Labels the calling thread's track in the active session
+void nameThread(std::string aName);
+
+// Records the time from construction to destruction as one slice
+struct Slice
+{
+    ~Slice()
+    {
+        if (theBegin != NotRecording) [[unlikely]]
+        {
+            recordSlice(theCategory, theName, theBegin, theValue);
+        }
+    }
+    Slice(const Slice &) = delete;
+    Slice(Slice &&) = delete;
+    Slice &operator=(const Slice &) = delete;
+
+    Slice(Category aCategory, const char *aName, std::uint64_t aValue = 0) noexcept
+        : theName{aName}, theBegin{isActive() ? now() : NotRecording}, theValue{aValue}, theCategory{aCategory}
+    {
+    }
+
+    void setValue(std::uint64_t aValue) noexcept
+    {
+        theValue = aValue;
+    }
+
+  private:
+    static constexpr std::uint64_t NotRecording = 0;
+
+    const char *theName;
+    std::uint64_t theBegin;
+    std::uint64_t theValue;
+    Category theCategory;
+};
+} // namespace trace
+
+// Timeline of emulator events in the Chrome trace event format, which chrome://tracing and ui.perfetto.dev open.
+//
+// Constructing a session makes it the active one until it stops or is destroyed. Each thread records into a buffer of
+// its own, found through a thread local and registered with the session on the thread's first event, so recording
+// takes no lock. A full buffer drops further events and counts them. Event timestamps come from the steady clock;
+// run slices carry the guest instructions they retired, so guest progress lines up with host stalls.
+struct TraceSession
+{
+    // Events per thread
+    static constexpr std::size_t DefaultCapacity = 1U << 18;
+
+    ~TraceSession();
+    TraceSession(const TraceSession &) = delete;
+    TraceSession(TraceSession &&) = delete;
+    TraceSession &operator=(const TraceSession &) = delete;
+
+    explicit TraceSession(std::size_t aCapacity = DefaultCapacity);
+
+    // Later events are not recorded, those in flight on other threads may still land
+    void stop() noexcept;
+
+    [[nodiscard]] std::size_t eventCount() const;
+    [[nodiscard]] std::size_t dropped() const;
+    [[nodiscard]] std::vector<trace::Event> events(std::size_t aThread) const;
+    [[nodiscard]] std::size_t threadCount() const;
+
+    // Only once the recording threads stopped or joined
+    void write(std::ostream &aStream) const;
+    [[nodiscard]] bool writeFile(const std::filesystem::path &aPath) const;
+
+  private:
+    struct Buffer
+    {
+        std::string theName;
+        std::vector<trace::Event> theEvents;
+        std::size_t theDropped{};
+    };
+
+    friend void trace::recordInstant(trace::Category, const char *, std::uint64_t) noexcept;
+    friend void trace::recordBurst(trace::Category, const char *) noexcept;
+    friend void trace::recordSlice(trace::Category, const char *, std::uint64_t, std::uint64_t) noexcept;
+    friend void trace::nameThread(std::string);
+
+    // The calling thread's buffer, nullptr when it cannot be had
+    Buffer *buffer() noexcept;
+    void append(Buffer &aBuffer, const trace::Event &aEvent) noexcept;
+
+    std::size_t theCapacity;
+    std::uint64_t theStart;
+    // Tells this session's thread local buffer pointers from those a previous session at the same address left
+    std::uint64_t theGeneration;
+    mutable std::mutex theLock;
+    std::vector<std::unique_ptr<Buffer>> theBuffers;
+};
+} // namespace svm
@@ -1,4 +1,7 @@
 #pragma once
+#include <array>
+#include <cstddef>
+
 namespace svm
 {
 enum class Trap
@@ -8,6 +11,13 @@ enum class Trap
     SEG_FAULT,
     MEM_FAULT,
     HALT,
+    BREAK,
 };
 
+// Number of Trap kinds, BREAK being the last
+constexpr const std::size_t TRAP_KINDS = static_cast<std::size_t>(Trap::BREAK) + 1;
+
+// Lower case names for reports, indexed by Trap
+constexpr std::array<const char *, TRAP_KINDS> TRAP_NAMES{"ok", "illegal", "seg_fault", "mem_fault", "halt", "break"};
+
 } // namespace svm
@@ -0,0 +1,119 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "device_scheduler.hpp"
+#include "port_bus.hpp"
+#include "spsc_queue.hpp"
+
+namespace svm
+{
+struct SingleCore;
+
+// 8250/16550 compatible serial port, by default COM1 at 3F8h-3FFh on vector 0Ch.
+//
+// Transmitted bytes are appended to a buffer written to the host descriptor once aBatchSize bytes are queued, on
+// flush and on destruction, so a chatty guest costs one write syscall per batch rather than per OUT. A newline also
+// writes the buffer unless the last write was less than aFlushDelay guest instructions ago, so log lines show up as
+// the guest prints them and only a flood of them is batched. With a scheduler attached, bytes never wait longer than
+// aFlushDelay cycles, a guest idling in HLT included. The line is infinitely fast: the transmitter always reports
+// empty and the line status register is answered from device state without touching the host. Received bytes come
+// from a host thread through a lock free queue, bytes arriving while the queue is full are dropped and reported as an
+// overrun.
+struct Uart : PortDevice
+{
+    static constexpr std::uint16_t BasePort = 0x3F8;
+    static constexpr std::size_t PortCount = 8U;
+    static constexpr std::uint8_t DefaultVector = 0x0C;
+    static constexpr std::size_t DefaultBatchSize = 4096U;
+    static constexpr std::uint64_t DefaultFlushDelay = 100000U;
+    static constexpr std::size_t ReceiveCapacity = 1024U;
+
+    // Offsets from the base port
+    enum Register : std::uint16_t
+    {
+        Data,
+        InterruptEnable,
+        InterruptId,
+        LineControl,
+        ModemControl,
+        LineStatus,
+        ModemStatus,
+        Scratch,
+    };
+
+    enum LineStatusBit : std::uint8_t
+    {
+        DataReady = 1U << 0,
+        OverrunError = 1U << 1,
+        TransmitHoldingEmpty = 1U << 5,
+        TransmitterEmpty = 1U << 6,
+    };
+
+    enum InterruptEnableBit : std::uint8_t
+    {
+        ReceiveInterrupt = 1U << 0,
+        TransmitInterrupt = 1U << 1,
+    };
+
+    ~Uart() override;
+    Uart(const Uart &) = delete;
+    Uart(Uart &&) = delete;
+    Uart &operator=(const Uart &) = delete;
+
+    // aFd is borrowed and may be a file, pipe or pty, -1 discards transmitted bytes
+    Uart(SingleCore &aCore, int aFd, std::uint16_t aBasePort = BasePort, std::uint8_t aVector = DefaultVector,
+         std::size_t aBatchSize = DefaultBatchSize, std::uint64_t aFlushDelay = DefaultFlushDelay);
+
+    // Starts the task writing out what the guest left queued aFlushDelay cycles after it was queued, false when the
+    // scheduler's arena is full. Once per UART.
+    bool attachScheduler(DeviceScheduler &aScheduler);
+
+    [[nodiscard]] std::uint16_t in(std::uint16_t aPort, arch::OperandSize aSize) noexcept override;
+    void out(std::uint16_t aPort, std::uint16_t aValue, arch::OperandSize aSize) noexcept override;
+
+    // Writes out buffered transmit bytes, false when the host descriptor failed
+    bool flush() noexcept;
+
+    // Host side, one producer thread at a time
+    void receive(std::uint8_t aByte) noexcept;
+    // Reads whatever aFd has available and queues it, returns the bytes read or -1 on error
+    long receiveFrom(int aFd) noexcept;
+
+    [[nodiscard]] std::uint64_t transmitted() const noexcept;
+    [[nodiscard]] std::uint64_t flushes() const noexcept;
+
+  private:
+    static DeviceTask drain(DeviceScheduler &aScheduler, Uart &aUart);
+    [[nodiscard]] std::uint8_t interruptId() noexcept;
+    [[nodiscard]] bool isDivisorLatched() const noexcept;
+
+    SingleCore &theCore;
+    int theFd;
+    std::uint16_t theBasePort;
+    std::uint8_t theVector;
+    std::size_t theBatchSize;
+    std::uint64_t theFlushDelay;
+    // Instruction count before which a newline does not write the buffer
+    std::uint64_t theNextLineFlush{};
+    std::vector<std::uint8_t> theTransmit;
+    std::uint64_t theTransmitted{};
+    std::uint64_t theFlushes{};
+
+    std::uint16_t theDivisor{12};
+    std::uint8_t theLineControl{};
+    std::uint8_t theModemControl{};
+    std::uint8_t theFifoControl{};
+    std::uint8_t theScratch{};
+    std::uint8_t theReceived{};
+    bool theTransmitPending{};
+    // Written by the guest and read by the host thread deciding whether a received byte interrupts
+    std::atomic<std::uint8_t> theInterruptEnable{};
+    std::atomic<bool> theOverrun{};
+    SpscQueue<std::uint8_t, ReceiveCapacity> theReceive;
+    // Wakes the drain task when the transmit buffer stops being empty
+    std::optional<PortChannel> theChannel;
+};
+} // namespace svm
@@ -0,0 +1,210 @@
+#include <algorithm>
+
+#include "aot_runtime.hpp"
+
+namespace svm
+{
+namespace
+{
+std::uint32_t key(std::uint16_t aSegment, std::uint16_t aOffset) noexcept
+{
+    return std::uint32_t{aSegment} << 16 | aOffset;
+}
+
+std::uint32_t linear(std::uint16_t aSegment, std::uint16_t aOffset) noexcept
+{
+    return (std::uint32_t{aSegment} << 4) + aOffset;
+}
+} // namespace
+
+AotRuntime::AotRuntime(SingleCore &aCore, RandomAccessMemory &aMemory, std::span<const CompiledBlock> aBlocks)
+    : theCore{aCore}, theMemory{aMemory}
+{
+    theEntries.reserve(aBlocks.size());
+    for (const auto &myBlock : aBlocks)
+    {
+        const auto myBegin = linear(myBlock.theSegment, myBlock.theOffset);
+        Entry myEntry{.theBlock = &myBlock,
+                      .theBegin = myBegin,
+                      .theEnd = static_cast<std::uint32_t>(myBegin + myBlock.theBytes.size()),
+                      .theInterpreted = {},
+                      .theLinks = {},
+                      .theIsValid = true};
+
+        // Whatever is in memory now is what the guest will run, compiled from something else the block is useless
+        std::vector<std::uint8_t> myBytes(myBlock.theBytes.size());
+        myEntry.theIsValid = theMemory.readBlock({.theAddress = myBegin}, myBytes) == Trap::OK &&
+                             std::ranges::equal(myBytes, myBlock.theBytes);
+        for (const auto myOffset : myBlock.theInterpreted)
+        {
+            myEntry.theInterpreted.push_back(
+                Decoder::decode(theMemory, {.theAddress = linear(myBlock.theSegment, myOffset)}));
+        }
+
+        theIndex.emplace(key(myBlock.theSegment, myBlock.theOffset), theEntries.size());
+        theEntries.push_back(std::move(myEntry));
+    }
+    for (std::size_t i{}; i < theEntries.size(); ++i)
+    {
+        if (!theEntries[i].theIsValid || theEntries[i].theBegin == theEntries[i].theEnd)
+        {
+            continue;
+        }
+        const auto [myFirstPage, myLastPage] = pagesOf(theEntries[i]);
+        for (auto myPage = myFirstPage; myPage <= myLastPage; ++myPage)
+        {
+            addToPage(myPage, i);
+        }
+    }
+}
+
+AotRuntime::~AotRuntime()
+{
+    theMemory.detachObserver(*this);
+}
+
+Trap AotRuntime::run(std::size_t aBudget) noexcept
+{
+    const auto myEnd = theCore.instructionCount() + aBudget;
+    Entry *myEntry{};
+    while (theCore.instructionCount() < myEnd)
+    {
+        myEntry = find(myEntry);
+        if (myEntry == nullptr || myEntry->theBlock->theInstructions > theCore.eventDistance())
+        {
+            ++theStats.theInterpretedBlocks;
+            if (const auto myTrap = theCore.run(1); myTrap != Trap::OK)
+            {
+                return myTrap;
+            }
+            continue;
+        }
+
+        ++theStats.theCompiledBlocks;
+        std::uint32_t myRetired{};
+        const auto myTrap = myEntry->theBlock->theBody(theCore, myEntry->theInterpreted.data(), myRetired);
+        theCore.retire(myRetired);
+        if (myTrap != Trap::OK)
+        {
+            return myTrap;
+        }
+    }
+    return Trap::OK;
+}
+
+void AotRuntime::onWrite(arch::MemoryAddress aMemoryAddress, std::size_t aLength) noexcept
+{
+    if (aLength == 0)
+    {
+        return;
+    }
+    const std::size_t myBegin = aMemoryAddress.theAddress;
+    const std::size_t myEnd = myBegin + aLength;
+    const auto myLastPage = std::min((myEnd - 1) / PageSize, PageCount - 1);
+    for (auto myPageIndex = myBegin / PageSize; myPageIndex <= myLastPage; ++myPageIndex)
+    {
+        auto *myPage = thePages[myPageIndex].get();
+        if (myPage == nullptr)
+        {
+            continue;
+        }
+        const std::size_t myPageBegin = myPageIndex * PageSize;
+        bool myIsCode = false;
+        for (auto myByte = std::max(myBegin, myPageBegin); myByte < std::min(myEnd, myPageBegin + PageSize); ++myByte)
+        {
+            myIsCode |= myPage->theCodeBytes.test(myByte - myPageBegin);
+        }
+        if (!myIsCode)
+        {
+            continue;
+        }
+
+        for (const auto myIndex : myPage->theEntries)
+        {
+            auto &myEntry = theEntries[myIndex];
+            if (myEntry.theIsValid && myEntry.theBegin < myEnd && myBegin < myEntry.theEnd)
+            {
+                myEntry.theIsValid = false;
+                ++theStats.theInvalidations;
+                // Its bytes stop counting as code, later stores there are plain data again
+                const auto [myFirst, myLast] = pagesOf(myEntry);
+                for (auto myOther = myFirst; myOther <= myLast; ++myOther)
+                {
+                    rebuildCodeBytes(myOther);
+                }
+            }
+        }
+    }
+}
+
+const AotRuntime::Stats &AotRuntime::stats() const noexcept
+{
+    return theStats;
+}
+
+void AotRuntime::addToPage(std::size_t aPage, std::size_t aEntry)
+{
+    auto &myPage = thePages[aPage];
+    if (!myPage)
+    {
+        myPage = std::make_unique<CodePage>();
+        theMemory.attachObserver(*this, {.theAddress = static_cast<std::uint32_t>(aPage * PageSize)}, PageSize);
+    }
+    myPage->theEntries.push_back(aEntry);
+    rebuildCodeBytes(aPage);
+}
+
+void AotRuntime::rebuildCodeBytes(std::size_t aPage) noexcept
+{
+    auto &myPage = *thePages[aPage];
+    myPage.theCodeBytes.reset();
+    const std::size_t myPageBegin = aPage * PageSize;
+    for (const auto myIndex : myPage.theEntries)
+    {
+        const auto &myEntry = theEntries[myIndex];
+        if (!myEntry.theIsValid)
+        {
+            continue;
+        }
+        const auto myEnd = std::min<std::size_t>(myEntry.theEnd, myPageBegin + PageSize);
+        for (auto myByte = std::max<std::size_t>(myEntry.theBegin, myPageBegin); myByte < myEnd; ++myByte)
+        {
+            myPage.theCodeBytes.set(myByte - myPageBegin);
+        }
+    }
+}
+
+std::pair<std::size_t, std::size_t> AotRuntime::pagesOf(const Entry &aEntry) noexcept
+{
+    return {std::min<std::size_t>(aEntry.theBegin / PageSize, PageCount - 1),
+            std::min<std::size_t>((aEntry.theEnd - 1) / PageSize, PageCount - 1)};
+}
+
+AotRuntime::Entry *AotRuntime::find(Entry *aFrom) noexcept
+{
+    const auto myKey = key(theCore.readRegister(arch::Regs::CS), theCore.readRegister(arch::Regs::IP));
+    if (aFrom != nullptr)
+    {
+        for (const auto &myLink : aFrom->theLinks)
+        {
+            if (myLink.theKey == myKey)
+            {
+                auto &myEntry = theEntries[myLink.theIndex];
+                return myEntry.theIsValid ? &myEntry : nullptr;
+            }
+        }
+    }
+
+    const auto myFound = theIndex.find(myKey);
+    if (myFound == theIndex.end() || !theEntries[myFound->second].theIsValid)
+    {
+        return nullptr;
+    }
+    if (aFrom != nullptr)
+    {
+        aFrom->theLinks[1] = aFrom->theLinks[0];
+        aFrom->theLinks[0] = {.theKey = myKey, .theIndex = myFound->second};
+    }
+    return &theEntries[myFound->second];
+}
+} // namespace svm
@@ -0,0 +1,829 @@
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <tuple>
+
+#include "batch_core.hpp"
+#include "single_core.hpp"
+#include "stack_accessor.hpp"
+
+namespace svm
+{
+namespace
+{
+#if defined(__x86_64__)
+// The default clone uses SSE2 and splits each vector in two, the AVX2 clone is picked at load time when the host has it
+#define SVM_VECTOR_KERNEL [[gnu::target_clones("avx2", "default")]]
+#else
+#define SVM_VECTOR_KERNEL
+#endif
+
+// One word per lane. Vectors only live inside the kernels, passing them by value would tie the ABI to the clone.
+using Vec = std::uint16_t __attribute__((vector_size(BatchCore::VectorLanes * sizeof(std::uint16_t))));
+
+constexpr auto NoAddress = std::numeric_limits<std::uint32_t>::max();
+
+enum class LaneOp : std::uint8_t
+{
+    Adc,
+    And,
+    Cmp,
+    Inc,
+    Dec,
+};
+
+constexpr std::uint16_t flagBit(arch::Flags aFlag) noexcept
+{
+    return static_cast<std::uint16_t>(1U << std::to_underlying(aFlag));
+}
+
+constexpr std::uint16_t ArithmeticFlags = flagBit(arch::Flags::CF) | flagBit(arch::Flags::PF) |
+                                          flagBit(arch::Flags::AF) | flagBit(arch::Flags::ZF) |
+                                          flagBit(arch::Flags::SF) | flagBit(arch::Flags::OF);
+
+std::optional<LaneOp> laneOp(arch::Inst aInst) noexcept
+{
+    switch (aInst)
+    {
+    case arch::Inst::ADC:
+        return LaneOp::Adc;
+    case arch::Inst::AND:
+        return LaneOp::And;
+    case arch::Inst::CMP:
+        return LaneOp::Cmp;
+    case arch::Inst::INC:
+        return LaneOp::Inc;
+    case arch::Inst::DEC:
+        return LaneOp::Dec;
+    default:
+        return std::nullopt;
+    }
+}
+
+bool isVectorBranch(arch::Inst aInst) noexcept
+{
+    using enum arch::Inst;
+    switch (aInst)
+    {
+    case JO:
+    case JNO:
+    case JB:
+    case JAE:
+    case JE:
+    case JNE:
+    case JBE:
+    case JA:
+    case JS:
+    case JNS:
+    case JP:
+    case JNP:
+    case JL:
+    case JGE:
+    case JLE:
+    case JG:
+    case JCXZ:
+    case JMP:
+    case LOOP:
+    case LOOPE:
+    case LOOPNE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void load(Vec &aVec, const std::uint16_t *aLanes) noexcept
+{
+    std::memcpy(&aVec, aLanes, sizeof(Vec));
+}
+
+void store(std::uint16_t *aLanes, const Vec &aVec) noexcept
+{
+    std::memcpy(aLanes, &aVec, sizeof(Vec));
+}
+
+// aDest = aSource in the group's lanes
+SVM_VECTOR_KERNEL void mergeLanes(std::uint16_t *aDest, const std::uint16_t *aSource, const std::uint16_t *aGroup,
+                                  std::size_t aCount) noexcept
+{
+    for (std::size_t i{}; i < aCount; i += BatchCore::VectorLanes)
+    {
+        Vec myDest;
+        Vec mySource;
+        Vec myGroup;
+        load(myDest, aDest + i);
+        load(mySource, aSource + i);
+        load(myGroup, aGroup + i);
+        store(aDest + i, (mySource & myGroup) | (myDest & ~myGroup));
+    }
+}
+
+// aDest = aValue in the group's lanes
+SVM_VECTOR_KERNEL void mergeImmediate(std::uint16_t *aDest, std::uint16_t aValue, const std::uint16_t *aGroup,
+                                      std::size_t aCount) noexcept
+{
+    for (std::size_t i{}; i < aCount; i += BatchCore::VectorLanes)
+    {
+        Vec myDest;
+        Vec myGroup;
+        load(myDest, aDest + i);
+        load(myGroup, aGroup + i);
+        store(aDest + i, (myGroup & aValue) | (myDest & ~myGroup));
+    }
+}
+
+// aDest += aValue in the group's lanes
+SVM_VECTOR_KERNEL void addImmediate(std::uint16_t *aDest, std::uint16_t aValue, const std::uint16_t *aGroup,
+                                    std::size_t aCount) noexcept
+{
+    for (std::size_t i{}; i < aCount; i += BatchCore::VectorLanes)
+    {
+        Vec myDest;
+        Vec myGroup;
+        load(myDest, aDest + i);
+        load(myGroup, aGroup + i);
+        store(aDest + i, myDest + (myGroup & aValue));
+    }
+}
+
+// Word ADC, AND, CMP, INC and DEC with the flags SingleCore computes, aSource is unused by INC and DEC
+SVM_VECTOR_KERNEL void arithmeticLanes(LaneOp aOp, std::uint16_t *aDest, const std::uint16_t *aSource,
+                                       std::uint16_t *aFlags, const std::uint16_t *aGroup, std::size_t aCount) noexcept
+{
+    constexpr std::uint16_t CarryFlag = flagBit(arch::Flags::CF);
+    constexpr std::uint16_t AuxFlag = flagBit(arch::Flags::AF);
+    constexpr std::uint16_t ZeroFlag = flagBit(arch::Flags::ZF);
+    constexpr std::uint16_t LogicFlags = ArithmeticFlags & static_cast<std::uint16_t>(~AuxFlag);
+    const bool myIsIncDec = aOp == LaneOp::Inc || aOp == LaneOp::Dec;
+    // INC and DEC keep CF, AND leaves AF alone
+    const std::uint16_t myAffected = aOp == LaneOp::And ? LogicFlags
+                                     : myIsIncDec ? static_cast<std::uint16_t>(ArithmeticFlags & ~CarryFlag)
+                                                  : ArithmeticFlags;
+
+    for (std::size_t i{}; i < aCount; i += BatchCore::VectorLanes)
+    {
+        Vec myDest;
+        Vec mySource = Vec{} + 1;
+        Vec myFlags;
+        Vec myGroup;
+        load(myDest, aDest + i);
+        load(myFlags, aFlags + i);
+        load(myGroup, aGroup + i);
+        if (!myIsIncDec)
+        {
+            load(mySource, aSource + i);
+        }
+
+        Vec myResult{};
+        Vec myComputed{};
+        switch (aOp)
+        {
+        case LaneOp::Adc:
+        case LaneOp::Inc: {
+            const Vec myCarry = aOp == LaneOp::Adc ? (myFlags & CarryFlag) : Vec{};
+            myResult = myDest + mySource + myCarry;
+            const Vec myCarryOut = static_cast<Vec>(myResult < myDest) |
+                                   (static_cast<Vec>(myResult == myDest) & static_cast<Vec>(myCarry != 0));
+            const Vec myAux = static_cast<Vec>(((myDest & 0xF) + (mySource & 0xF) + myCarry) > 0xF);
+            myComputed = (myCarryOut & CarryFlag) | (myAux & AuxFlag) |
+                         ((((myDest ^ myResult) & (mySource ^ myResult)) >> 15) << 11);
+            break;
+        }
+        case LaneOp::Cmp:
+        case LaneOp::Dec: {
+            myResult = myDest - mySource;
+            myComputed = (static_cast<Vec>(myDest < mySource) & CarryFlag) |
+                         ((myDest ^ mySource ^ myResult) & AuxFlag) |
+                         ((((myDest ^ mySource) & (myDest ^ myResult)) >> 15) << 11);
+            break;
+        }
+        case LaneOp::And:
+            myResult = myDest & mySource;
+            break;
+        }
+
+        // PF is set for an even number of ones in the low byte
+        Vec myParity = myResult & 0xFF;
+        myParity ^= myParity >> 4;
+        myParity ^= myParity >> 2;
+        myParity ^= myParity >> 1;
+        myComputed |= ((~myParity & 1) << 2) | (static_cast<Vec>(myResult == 0) & ZeroFlag) | ((myResult >> 15) << 7);
+
+        const Vec myNewFlags = (myFlags & static_cast<std::uint16_t>(~myAffected)) | (myComputed & myAffected);
+        store(aFlags + i, (myNewFlags & myGroup) | (myFlags & ~myGroup));
+        if (aOp != LaneOp::Cmp)
+        {
+            store(aDest + i, (myResult & myGroup) | (myDest & ~myGroup));
+        }
+    }
+}
+
+struct BranchOutcome
+{
+    bool theAnyTaken;
+    bool theAnyFallthrough;
+};
+
+// Moves the group's IP past the branch or to its target, LOOP forms count CX down first
+SVM_VECTOR_KERNEL BranchOutcome branchLanes(arch::Inst aInst, std::uint16_t *aIp, std::uint16_t *aCx,
+                                            const std::uint16_t *aFlags, const std::uint16_t *aGroup,
+                                            std::uint16_t aLength, std::uint16_t aDisplacement,
+                                            std::size_t aCount) noexcept
+{
+    using enum arch::Inst;
+    Vec myTakenSeen{};
+    Vec myFallthroughSeen{};
+    for (std::size_t i{}; i < aCount; i += BatchCore::VectorLanes)
+    {
+        Vec myIp;
+        Vec myCx;
+        Vec myFlags;
+        Vec myGroup;
+        load(myIp, aIp + i);
+        load(myCx, aCx + i);
+        load(myFlags, aFlags + i);
+        load(myGroup, aGroup + i);
+
+        const Vec myCf = myFlags & 1;
+        const Vec myPf = (myFlags >> 2) & 1;
+        const Vec myZf = (myFlags >> 6) & 1;
+        const Vec mySf = (myFlags >> 7) & 1;
+        const Vec myOf = (myFlags >> 11) & 1;
+        if (aInst == LOOP || aInst == LOOPE || aInst == LOOPNE)
+        {
+            myCx -= myGroup & 1;
+            store(aCx + i, myCx);
+        }
+        const Vec myCxLeft = static_cast<Vec>(myCx != 0) & 1;
+
+        Vec myCondition;
+        switch (aInst)
+        {
+        case JO:
+            myCondition = myOf;
+            break;
+        case JNO:
+            myCondition = myOf ^ 1;
+            break;
+        case JB:
+            myCondition = myCf;
+            break;
+        case JAE:
+            myCondition = myCf ^ 1;
+            break;
+        case JE:
+            myCondition = myZf;
+            break;
+        case JNE:
+            myCondition = myZf ^ 1;
+            break;
+        case JBE:
+            myCondition = myCf | myZf;
+            break;
+        case JA:
+            myCondition = (myCf | myZf) ^ 1;
+            break;
+        case JS:
+            myCondition = mySf;
+            break;
+        case JNS:
+            myCondition = mySf ^ 1;
+            break;
+        case JP:
+            myCondition = myPf;
+            break;
+        case JNP:
+            myCondition = myPf ^ 1;
+            break;
+        case JL:
+            myCondition = mySf ^ myOf;
+            break;
+        case JGE:
+            myCondition = (mySf ^ myOf) ^ 1;
+            break;
+        case JLE:
+            myCondition = myZf | (mySf ^ myOf);
+            break;
+        case JG:
+            myCondition = (myZf | (mySf ^ myOf)) ^ 1;
+            break;
+        case JCXZ:
+            myCondition = myCxLeft ^ 1;
+            break;
+        case LOOP:
+            myCondition = myCxLeft;
+            break;
+        case LOOPE:
+            myCondition = myCxLeft & myZf;
+            break;
+        case LOOPNE:
+            myCondition = myCxLeft & (myZf ^ 1);
+            break;
+        default:
+            myCondition = Vec{} + 1;
+            break;
+        }
+
+        const Vec myTaken = (Vec{} - myCondition) & myGroup;
+        store(aIp + i, myIp + (myGroup & aLength) + (myTaken & aDisplacement));
+        myTakenSeen |= myTaken;
+        myFallthroughSeen |= myGroup & ~myTaken;
+    }
+
+    BranchOutcome myOutcome{};
+    for (std::size_t i{}; i < BatchCore::VectorLanes; ++i)
+    {
+        myOutcome.theAnyTaken |= myTakenSeen[i] != 0;
+        myOutcome.theAnyFallthrough |= myFallthroughSeen[i] != 0;
+    }
+    return myOutcome;
+}
+} // namespace
+
+BatchCore::~BatchCore() = default;
+
+BatchCore::BatchCore(const RandomAccessMemory &aImage, std::size_t aLaneCount)
+    : theLaneCount{aLaneCount},
+      thePaddedCount{(aLaneCount + VectorLanes - 1) / VectorLanes * VectorLanes},
+      theTraps(aLaneCount, Trap::OK),
+      theScalarCores(aLaneCount),
+      theRunning{aLaneCount}
+{
+    for (auto &myRegister : theRegisters)
+    {
+        myRegister.assign(thePaddedCount, 0);
+    }
+    theGroup.assign(thePaddedCount, 0);
+    theScratch.assign(thePaddedCount, 0);
+
+    std::vector<std::size_t> myUsedPages;
+    for (std::size_t myPage{}; myPage < RandomAccessMemory::PageCount; ++myPage)
+    {
+        if (std::ranges::any_of(aImage.page(myPage), [](std::uint8_t aByte) { return aByte != 0; }))
+        {
+            myUsedPages.push_back(myPage);
+        }
+    }
+    theMemories.reserve(aLaneCount);
+    for (std::size_t myLane{}; myLane < aLaneCount; ++myLane)
+    {
+        auto myMemory = std::make_unique<RandomAccessMemory>();
+        for (const auto myPage : myUsedPages)
+        {
+            // A fresh memory has no read-only pages, the copy cannot fail
+            const arch::MemoryAddress myAddress{.theAddress = static_cast<std::uint32_t>(myPage * RandomAccessMemory::PageSize)};
+            std::ignore = myMemory->writeBlock(myAddress, aImage.page(myPage));
+        }
+        theMemories.push_back(std::move(myMemory));
+    }
+}
+
+std::size_t BatchCore::laneCount() const noexcept
+{
+    return theLaneCount;
+}
+
+RandomAccessMemory &BatchCore::memory(std::size_t aLane) noexcept
+{
+    return *theMemories[aLane];
+}
+
+arch::Immediate BatchCore::readRegister(std::size_t aLane, arch::Regs aRegister) const noexcept
+{
+    return theRegisters[std::to_underlying(aRegister)][aLane];
+}
+
+void BatchCore::writeRegister(std::size_t aLane, arch::Regs aRegister, arch::Immediate aValue) noexcept
+{
+    lanes(aRegister)[aLane] = aValue;
+    theNeedsRegroup = true;
+}
+
+void BatchCore::writeRegister(arch::Regs aRegister, arch::Immediate aValue) noexcept
+{
+    std::fill_n(lanes(aRegister).begin(), theLaneCount, aValue);
+    theNeedsRegroup = true;
+}
+
+std::size_t BatchCore::run(std::size_t aBudget) noexcept
+{
+    for (std::size_t myIssued{}; myIssued < aBudget && theRunning != 0; ++myIssued)
+    {
+        // The group at the lowest address issues first, it picks up the waiting lanes once it gets to them
+        if (theNeedsRegroup || theGroupAddress >= theWaitingAddress)
+        {
+            regroup();
+        }
+        issue(decoded(theGroupAddress));
+    }
+    return theRunning;
+}
+
+Trap BatchCore::trap(std::size_t aLane) const noexcept
+{
+    return theTraps[aLane];
+}
+
+const BatchCore::Stats &BatchCore::stats() const noexcept
+{
+    return theStats;
+}
+
+void BatchCore::regroup() noexcept
+{
+    theGroupAddress = NoAddress;
+    for (std::size_t myLane{}; myLane < theLaneCount; ++myLane)
+    {
+        if (theTraps[myLane] == Trap::OK)
+        {
+            theGroupAddress = std::min(theGroupAddress, linearAddress(myLane));
+        }
+    }
+
+    theWaitingAddress = NoAddress;
+    theGroupSize = 0;
+    for (std::size_t myLane{}; myLane < theLaneCount; ++myLane)
+    {
+        const auto myAddress = theTraps[myLane] == Trap::OK ? linearAddress(myLane) : NoAddress;
+        const bool myIsMember = myAddress == theGroupAddress && myAddress != NoAddress;
+        theGroup[myLane] = myIsMember ? 0xFFFF : 0;
+        if (myIsMember)
+        {
+            theLeader = theGroupSize == 0 ? myLane : theLeader;
+            ++theGroupSize;
+        }
+        else
+        {
+            theWaitingAddress = std::min(theWaitingAddress, myAddress);
+        }
+    }
+    theNeedsRegroup = false;
+}
+
+void BatchCore::issue(const DecodedInst &aInst) noexcept
+{
+    using Form = DecodedInst::Form;
+    ++theStats.theIssues;
+    if (aInst.theIsLocked)
+    {
+        issueScalar(aInst);
+        return;
+    }
+
+    const auto myOp = laneOp(aInst.theInst);
+    const bool myIsMove = aInst.theInst == arch::Inst::MOV;
+    auto *myFirst = lanes(aInst.theFirst).data();
+    switch (aInst.theForm)
+    {
+    case Form::Relative:
+        issueBranch(aInst);
+        return;
+    case Form::RegReg:
+        if (myIsMove)
+        {
+            mergeLanes(myFirst, lanes(aInst.theSecond).data(), theGroup.data(), thePaddedCount);
+            advance(aInst);
+            return;
+        }
+        if (myOp && *myOp != LaneOp::Inc && *myOp != LaneOp::Dec)
+        {
+            arithmeticLanes(*myOp, myFirst, lanes(aInst.theSecond).data(), lanes(arch::Regs::FLAG).data(),
+                            theGroup.data(), thePaddedCount);
+            advance(aInst);
+            return;
+        }
+        if (aInst.theInst == arch::Inst::XCHG)
+        {
+            auto *mySecond = lanes(aInst.theSecond).data();
+            std::ranges::copy(lanes(aInst.theFirst), theScratch.begin());
+            mergeLanes(myFirst, mySecond, theGroup.data(), thePaddedCount);
+            mergeLanes(mySecond, theScratch.data(), theGroup.data(), thePaddedCount);
+            advance(aInst);
+            return;
+        }
+        break;
+    case Form::RegImm:
+        if (myIsMove)
+        {
+            mergeImmediate(myFirst, aInst.theImmediate, theGroup.data(), thePaddedCount);
+            advance(aInst);
+            return;
+        }
+        if (myOp && *myOp != LaneOp::Inc && *myOp != LaneOp::Dec)
+        {
+            std::ranges::fill(theScratch, aInst.theImmediate);
+            arithmeticLanes(*myOp, myFirst, theScratch.data(), lanes(arch::Regs::FLAG).data(), theGroup.data(),
+                            thePaddedCount);
+            advance(aInst);
+            return;
+        }
+        break;
+    case Form::Reg:
+        if (myOp == LaneOp::Inc || myOp == LaneOp::Dec)
+        {
+            arithmeticLanes(*myOp, myFirst, nullptr, lanes(arch::Regs::FLAG).data(), theGroup.data(),
+                            thePaddedCount);
+            advance(aInst);
+            return;
+        }
+        if (aInst.theInst == arch::Inst::PUSH || aInst.theInst == arch::Inst::POP)
+        {
+            issueStack(aInst);
+            return;
+        }
+        break;
+    case Form::RegMem:
+    case Form::MemReg:
+    case Form::MemImm:
+        if (myIsMove)
+        {
+            issueMove(aInst);
+            return;
+        }
+        break;
+    case Form::Other:
+        if (aInst.theInst == arch::Inst::NOP)
+        {
+            advance(aInst);
+            return;
+        }
+        if (aInst.theInst == arch::Inst::HLT)
+        {
+            advance(aInst);
+            for (std::size_t myLane{}; myLane < theLaneCount; ++myLane)
+            {
+                if (theGroup[myLane] != 0)
+                {
+                    stop(myLane, Trap::HALT);
+                }
+            }
+            return;
+        }
+        // PUSH immediate and near RET
+        if (aInst.theInst == arch::Inst::PUSH || aInst.theInst == arch::Inst::RET)
+        {
+            issueStack(aInst);
+            return;
+        }
+        break;
+    default:
+        break;
+    }
+    issueScalar(aInst);
+}
+
+void BatchCore::issueBranch(const DecodedInst &aInst) noexcept
+{
+    if (aInst.theInst == arch::Inst::CALL)
+    {
+        issueStack(aInst);
+        return;
+    }
+    if (!isVectorBranch(aInst.theInst))
+    {
+        issueScalar(aInst);
+        return;
+    }
+    const auto myOutcome = branchLanes(aInst.theInst, lanes(arch::Regs::IP).data(), lanes(arch::Regs::CX).data(),
+                                       lanes(arch::Regs::FLAG).data(), theGroup.data(), aInst.theLength,
+                                       aInst.theImmediate, thePaddedCount);
+    theStats.theVectorLaneSteps += theGroupSize;
+    if (myOutcome.theAnyTaken && myOutcome.theAnyFallthrough)
+    {
+        ++theStats.theDivergences;
+        theNeedsRegroup = true;
+        return;
+    }
+    theGroupAddress = linearAddress(theLeader);
+}
+
+// Every lane has its own address, the accesses are made one lane at a time
+void BatchCore::issueMove(const DecodedInst &aInst) noexcept
+{
+    using Form = DecodedInst::Form;
+    for (std::size_t myLane{}; myLane < theLaneCount; ++myLane)
+    {
+        if (theGroup[myLane] == 0)
+        {
+            continue;
+        }
+        const auto myAddress = effectiveAddress(myLane, aInst);
+        auto &myMemory = *theMemories[myLane];
+        auto myTrap = Trap::OK;
+        if (aInst.theForm == Form::RegMem)
+        {
+            const auto [myReadTrap, myValue] = myMemory.read(myAddress);
+            myTrap = myReadTrap;
+            if (myTrap == Trap::OK)
+            {
+                lanes(aInst.theFirst)[myLane] = myValue;
+            }
+        }
+        else
+        {
+            const auto myValue =
+                aInst.theForm == Form::MemReg ? lanes(aInst.theSecond)[myLane] : aInst.theImmediate;
+            myTrap = myMemory.write(myAddress, myValue);
+        }
+
+        if (myTrap != Trap::OK)
+        {
+            stop(myLane, myTrap);
+            continue;
+        }
+        lanes(arch::Regs::IP)[myLane] += aInst.theLength;
+    }
+    theStats.theScalarLaneSteps += theGroupSize;
+    theNeedsRegroup |= aInst.theForm == Form::RegMem && aInst.theFirst == arch::Regs::CS;
+    if (!theNeedsRegroup)
+    {
+        theGroupAddress = linearAddress(theLeader);
+    }
+}
+
+// Near PUSH, POP, CALL and RET work on the register arrays directly, only the stack word goes through each lane's
+// memory. A fault leaves the lane as SingleCore would, on the instruction with SP untouched.
+void BatchCore::issueStack(const DecodedInst &aInst) noexcept
+{
+    using enum arch::Inst;
+    auto &myIp = lanes(arch::Regs::IP);
+    auto &myStackPointer = lanes(arch::Regs::SP);
+    for (std::size_t myLane{}; myLane < theLaneCount; ++myLane)
+    {
+        if (theGroup[myLane] == 0)
+        {
+            continue;
+        }
+        const auto myNext = static_cast<arch::Immediate>(myIp[myLane] + aInst.theLength);
+        StackAccessor myStack{*theMemories[myLane], theStackCounters, readRegister(myLane, arch::Regs::SS),
+                              myStackPointer[myLane]};
+        auto myTrap = Trap::OK;
+        auto myTarget = myNext;
+        if (aInst.theInst == PUSH)
+        {
+            // The 8086 pushes SP as it is after the decrement
+            const auto myValue = aInst.theForm == DecodedInst::Form::Other ? aInst.theImmediate
+                                 : aInst.theFirst == arch::Regs::SP
+                                     ? static_cast<arch::Immediate>(myStackPointer[myLane] - 2)
+                                     : lanes(aInst.theFirst)[myLane];
+            myTrap = myStack.push(myValue);
+        }
+        else if (aInst.theInst == CALL)
+        {
+            myTrap = myStack.push(myNext);
+            myTarget = static_cast<arch::Immediate>(myNext + aInst.theImmediate);
+        }
+        else
+        {
+            const auto [myPopTrap, myValue] = myStack.pop();
+            myTrap = myPopTrap;
+            if (myTrap == Trap::OK && aInst.theInst == POP)
+            {
+                lanes(aInst.theFirst)[myLane] = myValue;
+            }
+            else if (myTrap == Trap::OK)
+            {
+                myStack.release(aInst.theImmediate);
+                myTarget = myValue;
+            }
+        }
+
+        if (myTrap != Trap::OK)
+        {
+            stop(myLane, myTrap);
+            continue;
+        }
+        myIp[myLane] = myTarget;
+    }
+    theStats.theScalarLaneSteps += theGroupSize;
+    // Return addresses come from each lane's own stack
+    if (aInst.theInst == RET)
+    {
+        follow();
+    }
+    else if (!theNeedsRegroup)
+    {
+        theGroupAddress = linearAddress(theLeader);
+    }
+}
+
+// Instructions without a kernel run on a SingleCore holding a copy of the lane's registers
+void BatchCore::issueScalar(const DecodedInst &aInst) noexcept
+{
+    for (std::size_t myLane{}; myLane < theLaneCount; ++myLane)
+    {
+        if (theGroup[myLane] == 0)
+        {
+            continue;
+        }
+        auto &myCore = scalarCore(myLane);
+        for (std::size_t i{}; i < RegisterCount; ++i)
+        {
+            myCore.writeRegister(static_cast<arch::Regs>(i), theRegisters[i][myLane]);
+        }
+        const auto myTrap = myCore.step();
+        for (std::size_t i{}; i < RegisterCount; ++i)
+        {
+            theRegisters[i][myLane] = myCore.readRegister(static_cast<arch::Regs>(i));
+        }
+        if (myTrap != Trap::OK)
+        {
+            stop(myLane, myTrap);
+        }
+    }
+    theStats.theScalarLaneSteps += theGroupSize;
+    // Far transfers, interrupts and indirect jumps may send the lanes anywhere, the rest leave them together
+    if (aInst.theEndsBlock)
+    {
+        follow();
+    }
+    else if (!theNeedsRegroup)
+    {
+        theGroupAddress = linearAddress(theLeader);
+    }
+}
+
+void BatchCore::advance(const DecodedInst &aInst) noexcept
+{
+    addImmediate(lanes(arch::Regs::IP).data(), aInst.theLength, theGroup.data(), thePaddedCount);
+    theStats.theVectorLaneSteps += theGroupSize;
+    theGroupAddress = linearAddress(theLeader);
+    // A new CS is not the same for every lane
+    theNeedsRegroup |= aInst.theForm != DecodedInst::Form::Other && aInst.theFirst == arch::Regs::CS;
+}
+
+// After a transfer whose target each lane worked out for itself, the group only splits when the lanes disagree
+void BatchCore::follow() noexcept
+{
+    if (theNeedsRegroup)
+    {
+        return;
+    }
+    const auto myTarget = linearAddress(theLeader);
+    for (std::size_t myLane{}; myLane < theLaneCount; ++myLane)
+    {
+        if (theGroup[myLane] != 0 && linearAddress(myLane) != myTarget)
+        {
+            ++theStats.theDivergences;
+            theNeedsRegroup = true;
+            return;
+        }
+    }
+    theGroupAddress = myTarget;
+}
+
+void BatchCore::stop(std::size_t aLane, Trap aTrap) noexcept
+{
+    theTraps[aLane] = aTrap;
+    --theRunning;
+    theNeedsRegroup = true;
+}
+
+const DecodedInst &BatchCore::decoded(std::uint32_t aAddress)
+{
+    const auto myIter = theDecoded.find(aAddress);
+    if (myIter != theDecoded.end()) [[likely]]
+    {
+        return myIter->second;
+    }
+    const auto myInst = Decoder::decode(*theMemories.front(), arch::MemoryAddress{.theAddress = aAddress});
+    return theDecoded.emplace(aAddress, myInst).first->second;
+}
+
+std::uint32_t BatchCore::linearAddress(std::size_t aLane) const noexcept
+{
+    const std::uint32_t mySegment = readRegister(aLane, arch::Regs::CS);
+    return (mySegment << 4) + readRegister(aLane, arch::Regs::IP);
+}
+
+arch::MemoryAddress BatchCore::effectiveAddress(std::size_t aLane, const DecodedInst &aInst) const noexcept
+{
+    arch::Immediate myOffset = aInst.theDisplacement;
+    if ((aInst.theOperandFlags & DecodedInst::HasBase) != 0)
+    {
+        myOffset += readRegister(aLane, aInst.theBase);
+    }
+    if ((aInst.theOperandFlags & DecodedInst::HasIndex) != 0)
+    {
+        myOffset += readRegister(aLane, aInst.theIndex);
+    }
+    const std::uint32_t mySegment = readRegister(aLane, aInst.theSegment);
+    return arch::MemoryAddress{.theAddress = (mySegment << 4) + myOffset};
+}
+
+SingleCore &BatchCore::scalarCore(std::size_t aLane)
+{
+    auto &myCore = theScalarCores[aLane];
+    if (!myCore)
+    {
+        myCore = std::make_unique<SingleCore>(*theMemories[aLane]);
+    }
+    return *myCore;
+}
+
+BatchCore::Lanes &BatchCore::lanes(arch::Regs aRegister) noexcept
+{
+    return theRegisters[std::to_underlying(aRegister)];
+}
+} // namespace svm
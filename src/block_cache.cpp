@@ -0,0 +1,418 @@
+#include <algorithm>
+#include <bit>
+#include <utility>
+#include <vector>
+
+#include "block_cache.hpp"
+#include "decoder.hpp"
+#include "memory_heatmap.hpp"
+#include "trace.hpp"
+
+namespace svm
+{
+thread_local BlockCache *BlockCache::theEntered{};
+
+BlockCache::BlockCache(RandomAccessMemory &aMemory, CoreCounters &aCounters) : theMemory{aMemory}, theCounters{aCounters}
+{
+}
+
+BlockCache::~BlockCache()
+{
+    theMemory.detachObserver(*this);
+}
+
+const Block &BlockCache::lookup(arch::MemoryAddress aAddress)
+{
+    return find(aAddress.theAddress);
+}
+
+Block &BlockCache::follow(Block *aFrom, arch::MemoryAddress aAddress)
+{
+    const auto myAddress = aAddress.theAddress;
+    // Block whose CALL a RET is returning to
+    Block *myCaller{};
+    if (aFrom != nullptr && !aFrom->theIsRetired) [[likely]]
+    {
+        if (aFrom->theIsCall)
+        {
+            pushReturn(*aFrom);
+        }
+        else if (aFrom->theExit == Block::Exit::Return)
+        {
+            myCaller = popReturn();
+        }
+        if (!theHasRemoteWrites.load(std::memory_order_relaxed)) [[likely]]
+        {
+            if (auto *myBlock = linked(*aFrom, myAddress); myBlock != nullptr)
+            {
+                counters::add(theCounters.theBlockLinks);
+                return *myBlock;
+            }
+            if (auto *myBlock = myCaller != nullptr ? linked(*myCaller, myAddress) : nullptr; myBlock != nullptr)
+            {
+                counters::add(theCounters.theReturnHits);
+                return *myBlock;
+            }
+        }
+    }
+    if (aFrom != nullptr && aFrom->theExit == Block::Exit::Return)
+    {
+        counters::add(theCounters.theReturnMisses);
+    }
+    // A block retired before this call is freed by find, one retired by it stays alive until the next
+    if (aFrom != nullptr && aFrom->theIsRetired)
+    {
+        aFrom = nullptr;
+    }
+    auto &myBlock = find(myAddress);
+    if (myCaller != nullptr && !myCaller->theIsRetired)
+    {
+        link(*myCaller, myBlock);
+    }
+    if (aFrom != nullptr && !aFrom->theIsRetired)
+    {
+        if (aFrom->theExit == Block::Exit::Indirect)
+        {
+            cacheTarget(*aFrom, myBlock);
+        }
+        else
+        {
+            link(*aFrom, myBlock);
+        }
+    }
+    return myBlock;
+}
+
+Block &BlockCache::find(std::uint32_t aAddress)
+{
+    // Nothing executes from a retired block once the run loop asks for the next one
+    theRetired.clear();
+    if (theHasRemoteWrites.load(std::memory_order_relaxed)) [[unlikely]]
+    {
+        applyRemoteWrites();
+    }
+
+    const auto myIter = theBlocks.find(aAddress);
+    if (myIter != theBlocks.end()) [[likely]]
+    {
+        counters::add(theCounters.theBlockCacheHits);
+        return *myIter->second;
+    }
+    counters::add(theCounters.theBlockCacheMisses);
+    return decode(aAddress);
+}
+
+Block *BlockCache::linked(const Block &aFrom, std::uint32_t aAddress) noexcept
+{
+    for (const auto &myLink : aFrom.theLinks)
+    {
+        if (myLink.theTarget == aAddress && myLink.theBlock != nullptr)
+        {
+            return myLink.theBlock;
+        }
+    }
+    return nullptr;
+}
+
+void BlockCache::link(Block &aFrom, Block &aTo) noexcept
+{
+    for (auto &myLink : aFrom.theLinks)
+    {
+        if (myLink.theTarget == aTo.theBegin && myLink.theBlock == nullptr)
+        {
+            myLink.theBlock = &aTo;
+            aTo.theLinkedFrom.push_back(&aFrom);
+            return;
+        }
+    }
+}
+
+// Monomorphic: the new target replaces the old one
+void BlockCache::cacheTarget(Block &aFrom, Block &aTo) noexcept
+{
+    auto &myLink = aFrom.theLinks[1];
+    if (myLink.theBlock != nullptr)
+    {
+        auto &myLinkedFrom = myLink.theBlock->theLinkedFrom;
+        myLinkedFrom.erase(std::ranges::find(myLinkedFrom, &aFrom));
+    }
+    myLink = BlockLink{.theTarget = aTo.theBegin, .theBlock = &aTo};
+    aTo.theLinkedFrom.push_back(&aFrom);
+}
+
+void BlockCache::pushReturn(Block &aCaller) noexcept
+{
+    theReturnStack[theReturnDepth++ % ReturnStackDepth] = &aCaller;
+}
+
+Block *BlockCache::popReturn() noexcept
+{
+    if (theReturnDepth == 0)
+    {
+        return nullptr;
+    }
+    return std::exchange(theReturnStack[--theReturnDepth % ReturnStackDepth], nullptr);
+}
+
+Block &BlockCache::decode(std::uint32_t aAddress)
+{
+    auto myBlock = std::make_unique<Block>();
+    myBlock->theBegin = aAddress;
+
+    const auto myFirstPage = aAddress / PageSize;
+    auto myAddress = aAddress;
+    while (true)
+    {
+        const auto myInst = Decoder::decode(theMemory, arch::MemoryAddress{.theAddress = myAddress});
+        myBlock->theInsts.push_back(myInst);
+        myAddress += myInst.theLength;
+        if (myInst.theEndsBlock || myBlock->theInsts.size() >= MaxBlockLength || myAddress / PageSize != myFirstPage)
+        {
+            break;
+        }
+    }
+    myBlock->theEnd = myAddress;
+
+    // Relative targets are worked out on linear addresses, a target wrapping around the segment just never matches
+    const auto &myLast = myBlock->theInsts.back();
+    using enum arch::Inst;
+    if (!myLast.theEndsBlock)
+    {
+        myBlock->theLinks[0].theTarget = myAddress;
+    }
+    else if (myLast.theInst == RET || myLast.theInst == RETF)
+    {
+        myBlock->theExit = Block::Exit::Return;
+    }
+    else if (myLast.theInst == CALL || myLast.theInst == JMP || myLast.theForm == DecodedInst::Form::Relative)
+    {
+        myBlock->theIsCall = myLast.theInst == CALL;
+        // Conditional branches fall through, calls come back there
+        if (myLast.theInst != JMP)
+        {
+            myBlock->theLinks[0].theTarget = myAddress;
+        }
+        if (myLast.theForm == DecodedInst::Form::Relative)
+        {
+            const auto myDisplacement = static_cast<std::int16_t>(myLast.theImmediate);
+            myBlock->theLinks[1].theTarget = myAddress + static_cast<std::uint32_t>(myDisplacement);
+        }
+        else if (myLast.theForm == DecodedInst::Form::Other)
+        {
+            myBlock->theLinks[1].theTarget = (std::uint32_t{myLast.theDisplacement} << 4) + myLast.theImmediate;
+        }
+        else
+        {
+            myBlock->theExit = Block::Exit::Indirect;
+        }
+    }
+
+    const auto myLastPage = std::min<std::size_t>((myBlock->theEnd - 1) / PageSize, PageCount - 1);
+    myBlock->theIsMarked = theMarkedPages.test(myFirstPage) || theMarkedPages.test(myLastPage);
+
+    auto &myResult = *myBlock;
+    theBlocks.insert_or_assign(aAddress, std::move(myBlock));
+    addToPage(myFirstPage, myResult);
+    if (myLastPage != myFirstPage)
+    {
+        addToPage(myLastPage, myResult);
+    }
+    return myResult;
+}
+
+void BlockCache::addToPage(std::size_t aPage, Block &aBlock)
+{
+    auto &myPage = thePages[aPage];
+    if (!myPage)
+    {
+        myPage = std::make_unique<CodePage>();
+        theMemory.attachObserver(*this, arch::MemoryAddress{.theAddress = static_cast<std::uint32_t>(aPage * PageSize)},
+                                 PageSize);
+    }
+    myPage->theBlocks.push_back(&aBlock);
+
+    const std::size_t myPageBegin = aPage * PageSize;
+    const auto myBegin = std::max<std::size_t>(aBlock.theBegin, myPageBegin);
+    const auto myEnd = std::min<std::size_t>(aBlock.theEnd, myPageBegin + PageSize);
+    for (auto myByte = myBegin; myByte < myEnd; ++myByte)
+    {
+        myPage->theCodeBytes.set(myByte - myPageBegin);
+    }
+}
+
+void BlockCache::onWrite(arch::MemoryAddress aAddress, std::size_t aLength) noexcept
+{
+    if (!theIsShared || theEntered == this)
+    {
+        invalidate(aAddress, aLength);
+        return;
+    }
+    const auto myLastPage = std::min<std::size_t>((aAddress.theAddress + aLength - 1) / PageSize, PageCount - 1);
+    for (std::size_t myPage = aAddress.theAddress / PageSize; myPage <= myLastPage; ++myPage)
+    {
+        theRemoteWrites[myPage / 64].fetch_or(std::uint64_t{1} << (myPage % 64), std::memory_order_relaxed);
+    }
+    theHasRemoteWrites.store(true, std::memory_order_release);
+}
+
+// Whole pages go, the writer did not look at which bytes hold code
+void BlockCache::applyRemoteWrites() noexcept
+{
+    // Reading the writer's release store makes every page bit set before it visible below
+    if (!theHasRemoteWrites.exchange(false, std::memory_order_acquire))
+    {
+        return;
+    }
+    for (std::size_t i{}; i < theRemoteWrites.size(); ++i)
+    {
+        for (auto myPages = theRemoteWrites[i].exchange(0, std::memory_order_relaxed); myPages != 0;
+             myPages &= myPages - 1)
+        {
+            const auto myPage = i * 64 + static_cast<std::size_t>(std::countr_zero(myPages));
+            invalidate(arch::MemoryAddress{.theAddress = static_cast<std::uint32_t>(myPage * PageSize)}, PageSize);
+        }
+    }
+}
+
+void BlockCache::invalidate(arch::MemoryAddress aAddress, std::size_t aLength) noexcept
+{
+    if (aLength == 0)
+    {
+        return;
+    }
+    const std::size_t myBegin = aAddress.theAddress;
+    const std::size_t myEnd = myBegin + aLength;
+    const auto myLastPage = std::min((myEnd - 1) / PageSize, PageCount - 1);
+    for (auto myPageIndex = myBegin / PageSize; myPageIndex <= myLastPage; ++myPageIndex)
+    {
+        auto *myPage = thePages[myPageIndex].get();
+        if (myPage == nullptr)
+        {
+            continue;
+        }
+
+        const std::size_t myPageBegin = myPageIndex * PageSize;
+        bool myIsCode = false;
+        for (auto myByte = std::max(myBegin, myPageBegin); myByte < std::min(myEnd, myPageBegin + PageSize); ++myByte)
+        {
+            myIsCode |= myPage->theCodeBytes.test(myByte - myPageBegin);
+        }
+        if (!myIsCode)
+        {
+            continue;
+        }
+        trace::instant(trace::Category::BlockCache, "invalidate", myPageBegin);
+
+        auto myVictims = myPage->theBlocks;
+        for (auto *myBlock : myVictims)
+        {
+            if (myBlock->theBegin < myEnd && myBegin < myBlock->theEnd)
+            {
+                retire(*myBlock);
+            }
+        }
+    }
+}
+
+void BlockCache::retire(Block &aBlock) noexcept
+{
+    aBlock.theIsRetired = true;
+    for (auto *myFrom : aBlock.theLinkedFrom)
+    {
+        for (auto &myLink : myFrom->theLinks)
+        {
+            myLink.theBlock = myLink.theBlock == &aBlock ? nullptr : myLink.theBlock;
+        }
+    }
+    aBlock.theLinkedFrom.clear();
+    for (auto &myLink : aBlock.theLinks)
+    {
+        if (myLink.theBlock != nullptr)
+        {
+            std::erase(myLink.theBlock->theLinkedFrom, &aBlock);
+            myLink.theBlock = nullptr;
+        }
+    }
+    std::ranges::replace(theReturnStack, &aBlock, nullptr);
+
+    const auto myFirstPage = aBlock.theBegin / PageSize;
+    if (auto *myHeatmap = theMemory.heatmap(); myHeatmap != nullptr) [[unlikely]]
+    {
+        myHeatmap->record(MemoryHeatmap::Access::Invalidate, myFirstPage);
+    }
+    const auto myLastPage = std::min<std::size_t>((aBlock.theEnd - 1) / PageSize, PageCount - 1);
+    for (auto myPageIndex = myFirstPage; myPageIndex <= myLastPage; ++myPageIndex)
+    {
+        auto &myPage = *thePages[myPageIndex];
+        std::erase(myPage.theBlocks, &aBlock);
+        rebuildCodeBytes(myPage, myPageIndex);
+    }
+
+    const auto myIter = theBlocks.find(aBlock.theBegin);
+    theRetired.push_back(std::move(myIter->second));
+    theBlocks.erase(myIter);
+}
+
+void BlockCache::rebuildCodeBytes(CodePage &aPage, std::size_t aPageIndex) noexcept
+{
+    aPage.theCodeBytes.reset();
+    const std::size_t myPageBegin = aPageIndex * PageSize;
+    for (const auto *myBlock : aPage.theBlocks)
+    {
+        const auto myBegin = std::max<std::size_t>(myBlock->theBegin, myPageBegin);
+        const auto myEnd = std::min<std::size_t>(myBlock->theEnd, myPageBegin + PageSize);
+        for (auto myByte = myBegin; myByte < myEnd; ++myByte)
+        {
+            aPage.theCodeBytes.set(myByte - myPageBegin);
+        }
+    }
+}
+
+void BlockCache::flush() noexcept
+{
+    trace::instant(trace::Category::BlockCache, "flush", theBlocks.size());
+    theMemory.detachObserver(*this);
+    for (auto &[myAddress, myBlock] : theBlocks)
+    {
+        myBlock->theIsRetired = true;
+        theRetired.push_back(std::move(myBlock));
+    }
+    theBlocks.clear();
+    theReturnStack.fill(nullptr);
+    theReturnDepth = 0;
+    for (auto &myPage : thePages)
+    {
+        myPage.reset();
+    }
+}
+
+void BlockCache::markPage(std::size_t aPage, bool aIsMarked) noexcept
+{
+    theMarkedPages.set(aPage, aIsMarked);
+    if (!thePages[aPage])
+    {
+        return;
+    }
+    for (auto *myBlock : thePages[aPage]->theBlocks)
+    {
+        const auto myFirstPage = myBlock->theBegin / PageSize;
+        const auto myLastPage = std::min<std::size_t>((myBlock->theEnd - 1) / PageSize, PageCount - 1);
+        myBlock->theIsMarked = theMarkedPages.test(myFirstPage) || theMarkedPages.test(myLastPage);
+    }
+}
+
+std::size_t BlockCache::size() const noexcept
+{
+    return theBlocks.size();
+}
+
+void BlockCache::share() noexcept
+{
+    theIsShared = true;
+}
+
+void BlockCache::enter() noexcept
+{
+    theEntered = this;
+}
+} // namespace svm
@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <utility>
+
+#include "debugger.hpp"
+#include "single_core.hpp"
+
+namespace svm
+{
+Debugger::Debugger(SingleCore &aCore, RandomAccessMemory &aMemory) : theCore{aCore}, theMemory{aMemory}
+{
+    theCore.attachDebugger(this);
+}
+
+Debugger::~Debugger()
+{
+    for (const auto &myBreakpoint : theBreakpoints)
+    {
+        theCore.blockCache().markPage(pageOf(myBreakpoint), false);
+    }
+    theMemory.detachObserver(*this);
+    theCore.attachDebugger(nullptr);
+}
+
+std::size_t Debugger::pageOf(Location aLocation) noexcept
+{
+    const std::uint32_t myAddress = (std::uint32_t{aLocation.theSegment} << 4) + aLocation.theOffset;
+    return std::min(myAddress / RandomAccessMemory::PageSize, RandomAccessMemory::PageCount - 1);
+}
+
+void Debugger::addBreakpoint(Location aLocation)
+{
+    if (std::ranges::find(theBreakpoints, aLocation) == theBreakpoints.end())
+    {
+        theBreakpoints.push_back(aLocation);
+        theCore.blockCache().markPage(pageOf(aLocation), true);
+    }
+}
+
+void Debugger::removeBreakpoint(Location aLocation)
+{
+    std::erase(theBreakpoints, aLocation);
+    const auto myPage = pageOf(aLocation);
+    const bool myIsStillMarked = std::ranges::any_of(
+        theBreakpoints, [&](const Location &aBreakpoint) { return pageOf(aBreakpoint) == myPage; });
+    theCore.blockCache().markPage(myPage, myIsStillMarked);
+}
+
+void Debugger::addWatchpoint(arch::MemoryAddress aAddress, std::size_t aLength, std::uint8_t aAccess)
+{
+    theWatchpoints.push_back(Watchpoint{.theBegin = aAddress.theAddress,
+                                        .theEnd = static_cast<std::uint32_t>(aAddress.theAddress + aLength),
+                                        .theAccess = aAccess});
+    theMemory.attachObserver(*this, aAddress, aLength, aAccess);
+}
+
+void Debugger::removeWatchpoint(arch::MemoryAddress aAddress, std::size_t aLength)
+{
+    std::erase_if(theWatchpoints, [&](const Watchpoint &aWatchpoint) {
+        return aWatchpoint.theBegin == aAddress.theAddress && aWatchpoint.theEnd == aAddress.theAddress + aLength;
+    });
+    rearmWatchpoints();
+}
+
+void Debugger::rearmWatchpoints()
+{
+    theMemory.detachObserver(*this);
+    for (const auto &myWatchpoint : theWatchpoints)
+    {
+        theMemory.attachObserver(*this, arch::MemoryAddress{.theAddress = myWatchpoint.theBegin},
+                                 myWatchpoint.theEnd - myWatchpoint.theBegin, myWatchpoint.theAccess);
+    }
+}
+
+void Debugger::onBreakpoint(BreakpointCallback aCallback)
+{
+    theBreakpointCallback = std::move(aCallback);
+}
+
+void Debugger::onWatchpoint(WatchpointCallback aCallback)
+{
+    theWatchpointCallback = std::move(aCallback);
+}
+
+bool Debugger::shouldBreak(Location aLocation) noexcept
+{
+    const auto myResumeLocation = std::exchange(theResumeLocation, std::nullopt);
+    if (myResumeLocation == aLocation)
+    {
+        return false;
+    }
+    if (std::ranges::find(theBreakpoints, aLocation) == theBreakpoints.end())
+    {
+        return false;
+    }
+
+    const bool myShouldStop = theBreakpointCallback ? theBreakpointCallback(aLocation) : true;
+    if (myShouldStop)
+    {
+        theResumeLocation = aLocation;
+    }
+    return myShouldStop;
+}
+
+void Debugger::onWrite(arch::MemoryAddress aAddress, std::size_t aLength) noexcept
+{
+    reportAccess(aAddress, aLength, MemoryObserver::Write);
+}
+
+void Debugger::onRead(arch::MemoryAddress aAddress, std::size_t aLength) noexcept
+{
+    reportAccess(aAddress, aLength, MemoryObserver::Read);
+}
+
+void Debugger::reportAccess(arch::MemoryAddress aAddress, std::size_t aLength, MemoryObserver::Access aAccess) noexcept
+{
+    const auto myBegin = aAddress.theAddress;
+    const auto myEnd = myBegin + aLength;
+    const bool myIsWatched = std::ranges::any_of(theWatchpoints, [&](const Watchpoint &aWatchpoint) {
+        return (aWatchpoint.theAccess & aAccess) != 0 && myBegin < aWatchpoint.theEnd && aWatchpoint.theBegin < myEnd;
+    });
+    if (!myIsWatched)
+    {
+        return;
+    }
+
+    const WatchHit myHit{.theAddress = aAddress, .theLength = aLength, .theAccess = aAccess};
+    if (theWatchpointCallback ? theWatchpointCallback(myHit) : true)
+    {
+        theCore.requestStop();
+    }
+}
+} // namespace svm
@@ -0,0 +1,1252 @@
+#include <array>
+#include <optional>
+#include <utility>
+
+#include "arch.hpp"
+#include "decoder.hpp"
+#include "fpu.hpp"
+#include "hypercall.hpp"
+#include "single_core.hpp"
+#include "trap.hpp"
+
+namespace svm
+{
+namespace
+{
+using RegRegOp = Trap (SingleCore::*)(arch::Regs, arch::Regs) noexcept;
+using RegMemOp = Trap (SingleCore::*)(arch::Regs, arch::MemoryAddress) noexcept;
+using RegImmOp = Trap (SingleCore::*)(arch::Regs, arch::Immediate) noexcept;
+using MemImmOp = Trap (SingleCore::*)(arch::MemoryAddress, arch::Immediate) noexcept;
+using MemRegOp = Trap (SingleCore::*)(arch::MemoryAddress, arch::Regs) noexcept;
+using RegOp = Trap (SingleCore::*)(arch::Regs) noexcept;
+using MemOp = Trap (SingleCore::*)(arch::MemoryAddress) noexcept;
+using NoneOp = Trap (SingleCore::*)(void) noexcept;
+using ImmOp = Trap (SingleCore::*)(arch::Immediate) noexcept;
+using FarOp = Trap (SingleCore::*)(arch::Immediate, arch::Immediate) noexcept;
+using FpuOp = Trap (Fpu::*)(void) noexcept;
+using FpuStackOp = Trap (Fpu::*)(std::uint8_t) noexcept;
+using FpuMemOp = Trap (Fpu::*)(arch::MemoryAddress) noexcept;
+
+// Register field encodings of the 8086
+constexpr std::array<arch::Regs, 8> WORD_REGS{arch::Regs::AX, arch::Regs::CX, arch::Regs::DX, arch::Regs::BX,
+                                              arch::Regs::SP, arch::Regs::BP, arch::Regs::SI, arch::Regs::DI};
+constexpr std::array<arch::Regs, 4> SEGMENT_REGS{arch::Regs::ES, arch::Regs::CS, arch::Regs::SS, arch::Regs::DS};
+// Base and index registers of the ModRM memory forms by r/m field, r/m 4 to 7 have no index
+constexpr std::array<arch::Regs, 8> MODRM_BASE{arch::Regs::BX, arch::Regs::BX, arch::Regs::BP, arch::Regs::BP,
+                                               arch::Regs::SI, arch::Regs::DI, arch::Regs::BP, arch::Regs::BX};
+constexpr std::array<arch::Regs, 8> MODRM_INDEX{arch::Regs::SI, arch::Regs::DI, arch::Regs::SI, arch::Regs::DI,
+                                                arch::Regs::SI, arch::Regs::SI, arch::Regs::SI, arch::Regs::SI};
+constexpr std::size_t ADDRESS_MODES = 3U * 8U;
+
+// One of the 24 memory forms of a ModRM byte, mod 0 to 2 by r/m. Base, index and displacement are fixed at compile
+// time, only the segment is read from the instruction since a prefix may override it.
+template <std::uint8_t Mod, std::uint8_t Rm> struct AddressMode
+{
+    static constexpr bool IsDirect = Mod == 0 && Rm == 6;
+
+    static arch::MemoryAddress compute(SingleCore &aCore, const DecodedInst &aInst) noexcept
+    {
+        arch::Immediate myOffset{};
+        if constexpr (Mod != 0 || IsDirect)
+        {
+            myOffset = aInst.theDisplacement;
+        }
+        if constexpr (!IsDirect)
+        {
+            myOffset += aCore.readRegister<MODRM_BASE[Rm]>();
+        }
+        if constexpr (!IsDirect && Rm < 4)
+        {
+            myOffset += aCore.readRegister<MODRM_INDEX[Rm]>();
+        }
+        const std::uint32_t mySegment = aCore.readRegister(aInst.theSegment);
+        return arch::MemoryAddress{.theAddress = (mySegment << 4) + myOffset};
+    }
+};
+
+template <RegRegOp Op> Trap regReg(SingleCore &aCore, const DecodedInst &aInst) noexcept
+{
+    return (aCore.*Op)(aInst.theFirst, aInst.theSecond);
+}
+
+template <RegImmOp Op> Trap regImm(SingleCore &aCore, const DecodedInst &aInst) noexcept
+{
+    return (aCore.*Op)(aInst.theFirst, aInst.theImmediate);
+}
+
+template <RegOp Op> Trap reg(SingleCore &aCore, const DecodedInst &aInst) noexcept
+{
+    return (aCore.*Op)(aInst.theFirst);
+}
+
+// Memory operand handlers, each a family instantiated once per address mode
+template <RegMemOp Op> struct RegMem
+{
+    template <typename Mode> static Trap handle(SingleCore &aCore, const DecodedInst &aInst) noexcept
+    {
+        return (aCore.*Op)(aInst.theFirst, Mode::compute(aCore, aInst));
+    }
+};
+
+template <MemImmOp Op> struct MemImm
+{
+    template <typename Mode> static Trap handle(SingleCore &aCore, const DecodedInst &aInst) noexcept
+    {
+        return (aCore.*Op)(Mode::compute(aCore, aInst), aInst.theImmediate);
+    }
+};
+
+template <MemRegOp Op> struct MemReg
+{
+    template <typename Mode> static Trap handle(SingleCore &aCore, const DecodedInst &aInst) noexcept
+    {
+        return (aCore.*Op)(Mode::compute(aCore, aInst), aInst.theSecond);
+    }
+};
+
+template <MemOp Op> struct Mem
+{
+    template <typename Mode> static Trap handle(SingleCore &aCore, const DecodedInst &aInst) noexcept
+    {
+        return (aCore.*Op)(Mode::compute(aCore, aInst));
+    }
+};
+
+// Indirect CALL and JMP through memory
+template <bool IsCall, bool IsFar> struct Through
+{
+    template <typename Mode> static Trap handle(SingleCore &aCore, const DecodedInst &aInst) noexcept
+    {
+        const auto myPointer = Mode::compute(aCore, aInst);
+        return IsCall ? aCore.callThrough(myPointer, IsFar) : aCore.jumpThrough(myPointer, IsFar);
+    }
+};
+
+// Coprocessor memory forms
+template <FpuMemOp Op> struct FpuMem
+{
+    template <typename Mode> static Trap handle(SingleCore &aCore, const DecodedInst &aInst) noexcept
+    {
+        return (aCore.fpu().*Op)(Mode::compute(aCore, aInst));
+    }
+};
+
+template <Fpu::Format Format> struct FpuLoad
+{
+    template <typename Mode> static Trap handle(SingleCore &aCore, const DecodedInst &aInst) noexcept
+    {
+        return aCore.fpu().FLD(Mode::compute(aCore, aInst), Format);
+    }
+};
+
+template <Fpu::Format Format, bool Pop> struct FpuStore
+{
+    template <typename Mode> static Trap handle(SingleCore &aCore, const DecodedInst &aInst) noexcept
+    {
+        return aCore.fpu().FST(Mode::compute(aCore, aInst), Format, Pop);
+    }
+};
+
+template <Fpu::Arith Op, Fpu::Format Format> struct FpuArithmetic
+{
+    template <typename Mode> static Trap handle(SingleCore &aCore, const DecodedInst &aInst) noexcept
+    {
+        return aCore.fpu().arithmetic(Op, Mode::compute(aCore, aInst), Format);
+    }
+};
+
+// LOCK prefixed memory forms run their plain handler under the core's retry loop
+template <typename Family> struct Locked
+{
+    template <typename Mode> static Trap handle(SingleCore &aCore, const DecodedInst &aInst) noexcept
+    {
+        return aCore.executeLocked(aInst, &Family::template handle<Mode>);
+    }
+};
+
+template <typename Family, std::size_t... Modes>
+constexpr std::array<DecodedInst::Handler, ADDRESS_MODES> addressModeTable(std::index_sequence<Modes...>) noexcept
+{
+    return {&Family::template handle<AddressMode<Modes / 8U, Modes % 8U>>...};
+}
+
+template <NoneOp Op> Trap none(SingleCore &aCore, const DecodedInst &) noexcept
+{
+    return (aCore.*Op)();
+}
+
+// Near branches take their target as an offset within CS, IP already points past the instruction
+template <MemOp Op> Trap relative(SingleCore &aCore, const DecodedInst &aInst) noexcept
+{
+    const arch::Immediate myTarget = aCore.readRegister(arch::Regs::IP) + aInst.theImmediate;
+    return (aCore.*Op)(arch::MemoryAddress{.theAddress = myTarget});
+}
+
+template <ImmOp Op> Trap imm(SingleCore &aCore, const DecodedInst &aInst) noexcept
+{
+    return (aCore.*Op)(aInst.theImmediate);
+}
+
+// Direct far transfers, the pointer's segment is kept in theDisplacement
+template <FarOp Op> Trap far(SingleCore &aCore, const DecodedInst &aInst) noexcept
+{
+    return (aCore.*Op)(aInst.theDisplacement, aInst.theImmediate);
+}
+
+// Port number is the immediate byte or DX
+template <arch::OperandSize Size, bool FromDx> Trap portIn(SingleCore &aCore, const DecodedInst &aInst) noexcept
+{
+    return aCore.IN(FromDx ? aCore.readRegister(arch::Regs::DX) : aInst.theImmediate, Size);
+}
+
+template <arch::OperandSize Size, bool FromDx> Trap portOut(SingleCore &aCore, const DecodedInst &aInst) noexcept
+{
+    return aCore.OUT(FromDx ? aCore.readRegister(arch::Regs::DX) : aInst.theImmediate, Size);
+}
+
+// Coprocessor register forms, i of ST(i) is kept in theImmediate
+template <FpuOp Op> Trap fpu(SingleCore &aCore, const DecodedInst &) noexcept
+{
+    return (aCore.fpu().*Op)();
+}
+
+template <FpuStackOp Op> Trap fpuStack(SingleCore &aCore, const DecodedInst &aInst) noexcept
+{
+    return (aCore.fpu().*Op)(static_cast<std::uint8_t>(aInst.theImmediate));
+}
+
+template <Fpu::Arith Op, bool ToIndex, bool Pop> Trap fpuArithmetic(SingleCore &aCore, const DecodedInst &aInst) noexcept
+{
+    return aCore.fpu().arithmetic(Op, static_cast<std::uint8_t>(aInst.theImmediate), ToIndex, Pop);
+}
+
+template <bool Pop> Trap fpuStore(SingleCore &aCore, const DecodedInst &aInst) noexcept
+{
+    return aCore.fpu().FST(static_cast<std::uint8_t>(aInst.theImmediate), Pop);
+}
+
+template <Fpu::Constant Value> Trap fpuConstant(SingleCore &aCore, const DecodedInst &) noexcept
+{
+    return aCore.fpu().FLD(Value);
+}
+
+Trap softwareInterrupt(SingleCore &aCore, const DecodedInst &aInst) noexcept
+{
+    return aCore.INT(aInst.theImmediate);
+}
+
+Trap illegal(SingleCore &, const DecodedInst &) noexcept
+{
+    return Trap::ILLEGAL;
+}
+
+Trap fetchFault(SingleCore &, const DecodedInst &) noexcept
+{
+    return Trap::SEG_FAULT;
+}
+
+struct Fetcher
+{
+    const RandomAccessMemory &theMemory;
+    std::uint32_t theAddress;
+    std::uint8_t theLength{};
+    Trap theTrap{Trap::OK};
+
+    std::uint8_t byte() noexcept
+    {
+        const auto [myTrap, myValue] = theMemory.fetchByte(arch::MemoryAddress{.theAddress = theAddress + theLength});
+        if (myTrap != Trap::OK)
+        {
+            theTrap = myTrap;
+        }
+        ++theLength;
+        return myValue;
+    }
+
+    std::uint16_t word() noexcept
+    {
+        const std::uint16_t myLow = byte();
+        const std::uint16_t myHigh = byte();
+        return myLow | (myHigh << constants::CHAR_SIZE);
+    }
+
+    std::uint16_t signExtendedByte() noexcept
+    {
+        return static_cast<std::uint16_t>(static_cast<std::int8_t>(byte()));
+    }
+};
+
+struct ModRM
+{
+    std::uint8_t theMod;
+    std::uint8_t theReg;
+    std::uint8_t theRm;
+
+    [[nodiscard]] bool isRegister() const noexcept
+    {
+        return theMod == 3;
+    }
+};
+
+// Reads the ModRM byte and, for memory forms, the addressing registers and displacement
+ModRM decodeModRM(Fetcher &aFetcher, DecodedInst &aInst) noexcept
+{
+    const auto myByte = aFetcher.byte();
+    const ModRM myModRM{.theMod = static_cast<std::uint8_t>(myByte >> 6),
+                        .theReg = static_cast<std::uint8_t>((myByte >> 3) & 0x7),
+                        .theRm = static_cast<std::uint8_t>(myByte & 0x7)};
+    if (myModRM.isRegister())
+    {
+        aInst.theFirst = WORD_REGS[myModRM.theRm];
+        return myModRM;
+    }
+
+    const bool myIsDirect = myModRM.theMod == 0 && myModRM.theRm == 6;
+
+    aInst.theOperandFlags = 0;
+    if (!myIsDirect)
+    {
+        aInst.theBase = MODRM_BASE[myModRM.theRm];
+        aInst.theOperandFlags |= DecodedInst::HasBase;
+        if (myModRM.theRm < 4)
+        {
+            aInst.theIndex = MODRM_INDEX[myModRM.theRm];
+            aInst.theOperandFlags |= DecodedInst::HasIndex;
+        }
+    }
+    aInst.theSegment = (!myIsDirect && aInst.theBase == arch::Regs::BP) ? arch::Regs::SS : arch::Regs::DS;
+
+    if (myIsDirect || myModRM.theMod == 2)
+    {
+        aInst.theDisplacement = aFetcher.word();
+    }
+    else if (myModRM.theMod == 1)
+    {
+        aInst.theDisplacement = aFetcher.signExtendedByte();
+    }
+    return myModRM;
+}
+
+// Handler of aFamily specialized for the memory form in aModRM
+template <typename Family> DecodedInst::Handler addressed(const ModRM &aModRM) noexcept
+{
+    static constexpr auto Handlers = addressModeTable<Family>(std::make_index_sequence<ADDRESS_MODES>{});
+    return Handlers[aModRM.theMod * 8U + aModRM.theRm];
+}
+
+template <typename Family> DecodedInst::Handler lockable(const DecodedInst &aInst, const ModRM &aModRM) noexcept
+{
+    return aInst.theIsLocked ? addressed<Locked<Family>>(aModRM) : addressed<Family>(aModRM);
+}
+
+// r/m operand first, register operand second
+template <RegRegOp RR, MemRegOp MR> void rmReg(DecodedInst &aInst, const ModRM &aModRM) noexcept
+{
+    aInst.theSecond = WORD_REGS[aModRM.theReg];
+    aInst.theForm = aModRM.isRegister() ? DecodedInst::Form::RegReg : DecodedInst::Form::MemReg;
+    aInst.theHandler = aModRM.isRegister() ? &regReg<RR> : lockable<MemReg<MR>>(aInst, aModRM);
+}
+
+// Register operand first, r/m operand second
+template <RegRegOp RR, RegMemOp RM> void regRm(DecodedInst &aInst, const ModRM &aModRM) noexcept
+{
+    if (aModRM.isRegister())
+    {
+        aInst.theSecond = aInst.theFirst;
+        aInst.theForm = DecodedInst::Form::RegReg;
+        aInst.theHandler = &regReg<RR>;
+    }
+    else
+    {
+        aInst.theForm = DecodedInst::Form::RegMem;
+        aInst.theHandler = addressed<RegMem<RM>>(aModRM);
+    }
+    aInst.theFirst = WORD_REGS[aModRM.theReg];
+}
+
+template <RegImmOp RI, MemImmOp MI> void rmImm(DecodedInst &aInst, const ModRM &aModRM) noexcept
+{
+    aInst.theForm = aModRM.isRegister() ? DecodedInst::Form::RegImm : DecodedInst::Form::MemImm;
+    aInst.theHandler = aModRM.isRegister() ? &regImm<RI> : lockable<MemImm<MI>>(aInst, aModRM);
+}
+
+template <RegOp R, MemOp M> void rm(DecodedInst &aInst, const ModRM &aModRM) noexcept
+{
+    aInst.theForm = aModRM.isRegister() ? DecodedInst::Form::Reg : DecodedInst::Form::Mem;
+    aInst.theHandler = aModRM.isRegister() ? &reg<R> : lockable<Mem<M>>(aInst, aModRM);
+}
+
+void branch(DecodedInst &aInst, arch::Inst aKind, DecodedInst::Handler aHandler) noexcept
+{
+    aInst.theInst = aKind;
+    aInst.theHandler = aHandler;
+    aInst.theEndsBlock = true;
+}
+
+void relativeBranch(DecodedInst &aInst, arch::Inst aKind, DecodedInst::Handler aHandler) noexcept
+{
+    branch(aInst, aKind, aHandler);
+    aInst.theForm = DecodedInst::Form::Relative;
+}
+
+void decodeGroup1(Fetcher &aFetcher, DecodedInst &aInst, bool aIsSignExtended) noexcept
+{
+    const auto myModRM = decodeModRM(aFetcher, aInst);
+    aInst.theImmediate = aIsSignExtended ? aFetcher.signExtendedByte() : aFetcher.word();
+    switch (myModRM.theReg)
+    {
+    case 2:
+        aInst.theInst = arch::Inst::ADC;
+        rmImm<&SingleCore::ADC, &SingleCore::ADC>(aInst, myModRM);
+        break;
+    case 4:
+        aInst.theInst = arch::Inst::AND;
+        rmImm<&SingleCore::AND, &SingleCore::AND>(aInst, myModRM);
+        break;
+    case 7:
+        aInst.theInst = arch::Inst::CMP;
+        rmImm<&SingleCore::CMP, &SingleCore::CMP>(aInst, myModRM);
+        break;
+    default:
+        branch(aInst, arch::Inst::NOP, &illegal);
+        break;
+    }
+}
+
+void decodeGroup5(Fetcher &aFetcher, DecodedInst &aInst) noexcept
+{
+    const auto myModRM = decodeModRM(aFetcher, aInst);
+    switch (myModRM.theReg)
+    {
+    case 0:
+        aInst.theInst = arch::Inst::INC;
+        rm<&SingleCore::INC, &SingleCore::INC>(aInst, myModRM);
+        break;
+    case 1:
+        aInst.theInst = arch::Inst::DEC;
+        rm<&SingleCore::DEC, &SingleCore::DEC>(aInst, myModRM);
+        break;
+    case 2:
+        branch(aInst, arch::Inst::CALL, myModRM.isRegister() ? &reg<&SingleCore::CALL> : addressed<Through<true, false>>(myModRM));
+        aInst.theForm = myModRM.isRegister() ? DecodedInst::Form::Reg : DecodedInst::Form::Mem;
+        break;
+    case 4:
+        branch(aInst, arch::Inst::JMP, myModRM.isRegister() ? &reg<&SingleCore::JMP> : addressed<Through<false, false>>(myModRM));
+        aInst.theForm = myModRM.isRegister() ? DecodedInst::Form::Reg : DecodedInst::Form::Mem;
+        break;
+    case 6:
+        aInst.theInst = arch::Inst::PUSH;
+        rm<&SingleCore::PUSH, &SingleCore::PUSH>(aInst, myModRM);
+        break;
+    // Far forms need a memory operand holding the pointer
+    case 3:
+    case 5:
+        if (myModRM.isRegister())
+        {
+            branch(aInst, arch::Inst::NOP, &illegal);
+            break;
+        }
+        branch(aInst, myModRM.theReg == 3 ? arch::Inst::CALL : arch::Inst::JMP,
+               myModRM.theReg == 3 ? addressed<Through<true, true>>(myModRM)
+                                     : addressed<Through<false, true>>(myModRM));
+        aInst.theForm = DecodedInst::Form::Mem;
+        break;
+    default:
+        branch(aInst, arch::Inst::NOP, &illegal);
+        break;
+    }
+}
+
+void decodeConditional(Fetcher &aFetcher, DecodedInst &aInst, std::uint8_t aCondition) noexcept
+{
+    struct Condition
+    {
+        arch::Inst theInst;
+        DecodedInst::Handler theHandler;
+    };
+    using enum arch::Inst;
+    static constexpr std::array<Condition, 16> CONDITIONS{{
+        {JO, &relative<&SingleCore::JO>},
+        {JNO, &relative<&SingleCore::JNO>},
+        {JB, &relative<&SingleCore::JB>},
+        {JAE, &relative<&SingleCore::JAE>},
+        {JE, &relative<&SingleCore::JE>},
+        {JNE, &relative<&SingleCore::JNE>},
+        {JBE, &relative<&SingleCore::JBE>},
+        {JA, &relative<&SingleCore::JA>},
+        {JS, &relative<&SingleCore::JS>},
+        {JNS, &relative<&SingleCore::JNS>},
+        {JP, &relative<&SingleCore::JP>},
+        {JNP, &relative<&SingleCore::JNP>},
+        {JL, &relative<&SingleCore::JL>},
+        {JGE, &relative<&SingleCore::JGE>},
+        {JLE, &relative<&SingleCore::JLE>},
+        {JG, &relative<&SingleCore::JG>},
+    }};
+    aInst.theImmediate = aFetcher.signExtendedByte();
+    relativeBranch(aInst, CONDITIONS[aCondition].theInst, CONDITIONS[aCondition].theHandler);
+}
+
+// Memory form handler of some family for a given ModRM, a null one marks a reserved encoding
+using AddressedHandler = DecodedInst::Handler (*)(const ModRM &) noexcept;
+
+struct EscForm
+{
+    arch::Inst theInst;
+    AddressedHandler theHandler;
+};
+
+template <Fpu::Format Format, std::size_t... Ops>
+constexpr std::array<AddressedHandler, 8> fpuArithmeticForms(std::index_sequence<Ops...>) noexcept
+{
+    return {&addressed<FpuArithmetic<static_cast<Fpu::Arith>(Ops), Format>>...};
+}
+
+// D8, DA, DC and DE with a memory operand: arithmetic on ST(0) in Fpu::Arith order, D9, DB, DD and DF: transfers
+void decodeEscMemory(DecodedInst &aInst, std::uint8_t aEsc, const ModRM &aModRM) noexcept
+{
+    using enum arch::Inst;
+    using enum Fpu::Format;
+    static constexpr std::array<arch::Inst, 8> REAL_ARITHMETIC{FADD, FMUL, FCOM, FCOMP, FSUB, FSUBR, FDIV, FDIVR};
+    static constexpr std::array<arch::Inst, 8> INTEGER_ARITHMETIC{FIADD, FIMUL, FICOM,  FICOMP,
+                                                                  FISUB, FISUBR, FIDIV, FIDIVR};
+    static constexpr std::array<std::array<AddressedHandler, 8>, 4> ARITHMETIC{
+        fpuArithmeticForms<Real32>(std::make_index_sequence<8>{}),
+        fpuArithmeticForms<Int32>(std::make_index_sequence<8>{}),
+        fpuArithmeticForms<Real64>(std::make_index_sequence<8>{}),
+        fpuArithmeticForms<Int16>(std::make_index_sequence<8>{})};
+    static constexpr std::array<std::array<EscForm, 8>, 4> TRANSFERS{{
+        {{{FLD, &addressed<FpuLoad<Real32>>},
+          {NOP, nullptr},
+          {FST, &addressed<FpuStore<Real32, false>>},
+          {FSTP, &addressed<FpuStore<Real32, true>>},
+          {FLDENV, &addressed<FpuMem<&Fpu::FLDENV>>},
+          {FLDCW, &addressed<FpuMem<&Fpu::FLDCW>>},
+          {FSTENV, &addressed<FpuMem<&Fpu::FSTENV>>},
+          {FSTCW, &addressed<FpuMem<&Fpu::FSTCW>>}}},
+        {{{FILD, &addressed<FpuLoad<Int32>>},
+          {NOP, nullptr},
+          {FIST, &addressed<FpuStore<Int32, false>>},
+          {FISTP, &addressed<FpuStore<Int32, true>>},
+          {NOP, nullptr},
+          {FLD, &addressed<FpuLoad<Real80>>},
+          {NOP, nullptr},
+          {FSTP, &addressed<FpuStore<Real80, true>>}}},
+        {{{FLD, &addressed<FpuLoad<Real64>>},
+          {NOP, nullptr},
+          {FST, &addressed<FpuStore<Real64, false>>},
+          {FSTP, &addressed<FpuStore<Real64, true>>},
+          {FRSTOR, &addressed<FpuMem<&Fpu::FRSTOR>>},
+          {NOP, nullptr},
+          {FSAVE, &addressed<FpuMem<&Fpu::FSAVE>>},
+          {FSTSW, &addressed<FpuMem<&Fpu::FSTSW>>}}},
+        {{{FILD, &addressed<FpuLoad<Int16>>},
+          {NOP, nullptr},
+          {FIST, &addressed<FpuStore<Int16, false>>},
+          {FISTP, &addressed<FpuStore<Int16, true>>},
+          {FBLD, &addressed<FpuLoad<Bcd80>>},
+          {FILD, &addressed<FpuLoad<Int64>>},
+          {FBSTP, &addressed<FpuStore<Bcd80, true>>},
+          {FISTP, &addressed<FpuStore<Int64, true>>}}},
+    }};
+
+    aInst.theForm = DecodedInst::Form::Mem;
+    if ((aEsc & 1U) == 0)
+    {
+        aInst.theInst = (aEsc & 2U) == 0 ? REAL_ARITHMETIC[aModRM.theReg] : INTEGER_ARITHMETIC[aModRM.theReg];
+        aInst.theHandler = ARITHMETIC[aEsc >> 1][aModRM.theReg](aModRM);
+        return;
+    }
+    const auto &myForm = TRANSFERS[aEsc >> 1][aModRM.theReg];
+    if (myForm.theHandler == nullptr)
+    {
+        branch(aInst, arch::Inst::NOP, &illegal);
+        return;
+    }
+    aInst.theInst = myForm.theInst;
+    aInst.theHandler = myForm.theHandler(aModRM);
+}
+
+struct EscRegisterForm
+{
+    arch::Inst theInst;
+    DecodedInst::Handler theHandler;
+};
+
+// Register forms taking ST(i), by ESC opcode and reg field. DC and DE store into ST(i), which swaps the direction of
+// their subtractions and divisions against D8: DC E0+i is FSUBR ST(i), ST(0) and computes ST(0) - ST(i).
+template <std::size_t Esc> constexpr std::array<EscRegisterForm, 8> escStackForms() noexcept
+{
+    using enum arch::Inst;
+    using enum Fpu::Arith;
+    if constexpr (Esc == 0)
+    {
+        return {{{FADD, &fpuArithmetic<Add, false, false>},
+                 {FMUL, &fpuArithmetic<Mul, false, false>},
+                 {FCOM, &fpuArithmetic<Com, false, false>},
+                 {FCOMP, &fpuArithmetic<ComPop, false, false>},
+                 {FSUB, &fpuArithmetic<Sub, false, false>},
+                 {FSUBR, &fpuArithmetic<SubR, false, false>},
+                 {FDIV, &fpuArithmetic<Div, false, false>},
+                 {FDIVR, &fpuArithmetic<DivR, false, false>}}};
+    }
+    else if constexpr (Esc == 1)
+    {
+        return {{{FLD, &fpuStack<&Fpu::FLD>},
+                 {FXCH, &fpuStack<&Fpu::FXCH>},
+                 {NOP, nullptr},
+                 {NOP, nullptr},
+                 {NOP, nullptr},
+                 {NOP, nullptr},
+                 {NOP, nullptr},
+                 {NOP, nullptr}}};
+    }
+    else if constexpr (Esc == 4)
+    {
+        return {{{FADD, &fpuArithmetic<Add, true, false>},
+                 {FMUL, &fpuArithmetic<Mul, true, false>},
+                 {FCOM, &fpuArithmetic<Com, false, false>},
+                 {FCOMP, &fpuArithmetic<ComPop, false, false>},
+                 {FSUBR, &fpuArithmetic<SubR, true, false>},
+                 {FSUB, &fpuArithmetic<Sub, true, false>},
+                 {FDIVR, &fpuArithmetic<DivR, true, false>},
+                 {FDIV, &fpuArithmetic<Div, true, false>}}};
+    }
+    else if constexpr (Esc == 5)
+    {
+        return {{{FFREE, &fpuStack<&Fpu::FFREE>},
+                 {NOP, nullptr},
+                 {FST, &fpuStore<false>},
+                 {FSTP, &fpuStore<true>},
+                 {NOP, nullptr},
+                 {NOP, nullptr},
+                 {NOP, nullptr},
+                 {NOP, nullptr}}};
+    }
+    else if constexpr (Esc == 6)
+    {
+        return {{{FADDP, &fpuArithmetic<Add, true, true>},
+                 {FMULP, &fpuArithmetic<Mul, true, true>},
+                 {FCOMP, &fpuArithmetic<ComPop, false, false>},
+                 {NOP, nullptr},
+                 {FSUBRP, &fpuArithmetic<SubR, true, true>},
+                 {FSUBP, &fpuArithmetic<Sub, true, true>},
+                 {FDIVRP, &fpuArithmetic<DivR, true, true>},
+                 {FDIVP, &fpuArithmetic<Div, true, true>}}};
+    }
+    else
+    {
+        return {{{NOP, nullptr},
+                 {NOP, nullptr},
+                 {NOP, nullptr},
+                 {NOP, nullptr},
+                 {NOP, nullptr},
+                 {NOP, nullptr},
+                 {NOP, nullptr},
+                 {NOP, nullptr}}};
+    }
+}
+
+// Register forms without an operand, by ModRM byte from E0: D9 E0 to FF, then the handful elsewhere
+EscRegisterForm escFixedForm(std::uint8_t aEsc, const ModRM &aModRM) noexcept
+{
+    using enum arch::Inst;
+    using enum Fpu::Constant;
+    static constexpr std::array<EscRegisterForm, 32> D9_FORMS{{
+        {FCHS, &fpu<&Fpu::FCHS>},
+        {FABS, &fpu<&Fpu::FABS>},
+        {NOP, nullptr},
+        {NOP, nullptr},
+        {FTST, &fpu<&Fpu::FTST>},
+        {FXAM, &fpu<&Fpu::FXAM>},
+        {NOP, nullptr},
+        {NOP, nullptr},
+        {FLD1, &fpuConstant<One>},
+        {FLDL2T, &fpuConstant<Log2Ten>},
+        {FLDL2E, &fpuConstant<Log2E>},
+        {FLDPI, &fpuConstant<Pi>},
+        {FLDLG2, &fpuConstant<Log10Two>},
+        {FLDLN2, &fpuConstant<LnTwo>},
+        {FLDZ, &fpuConstant<Zero>},
+        {NOP, nullptr},
+        {F2XM1, &fpu<&Fpu::F2XM1>},
+        {FYL2X, &fpu<&Fpu::FYL2X>},
+        {FPTAN, &fpu<&Fpu::FPTAN>},
+        {FPATAN, &fpu<&Fpu::FPATAN>},
+        {FXTRACT, &fpu<&Fpu::FXTRACT>},
+        {NOP, nullptr},
+        {FDECSTP, &fpu<&Fpu::FDECSTP>},
+        {FINCSTP, &fpu<&Fpu::FINCSTP>},
+        {FPREM, &fpu<&Fpu::FPREM>},
+        {FYL2XP1, &fpu<&Fpu::FYL2XP1>},
+        {FSQRT, &fpu<&Fpu::FSQRT>},
+        {NOP, nullptr},
+        {FRNDINT, &fpu<&Fpu::FRNDINT>},
+        {FSCALE, &fpu<&Fpu::FSCALE>},
+        {NOP, nullptr},
+        {NOP, nullptr},
+    }};
+    static constexpr std::array<EscRegisterForm, 4> DB_FORMS{{
+        {FENI, &fpu<&Fpu::FENI>},
+        {FDISI, &fpu<&Fpu::FDISI>},
+        {FCLEX, &fpu<&Fpu::FCLEX>},
+        {FINIT, &fpu<&Fpu::FINIT>},
+    }};
+
+    if (aEsc == 1 && aModRM.theReg >= 4)
+    {
+        return D9_FORMS[(aModRM.theReg - 4U) * 8U + aModRM.theRm];
+    }
+    if (aEsc == 1 && aModRM.theReg == 2 && aModRM.theRm == 0)
+    {
+        return {FNOP, &fpu<&Fpu::FNOP>};
+    }
+    if (aEsc == 3 && aModRM.theReg == 4 && aModRM.theRm < DB_FORMS.size())
+    {
+        return DB_FORMS[aModRM.theRm];
+    }
+    if (aEsc == 6 && aModRM.theReg == 3 && aModRM.theRm == 1)
+    {
+        return {FCOMPP, &fpu<&Fpu::FCOMPP>};
+    }
+    return {NOP, nullptr};
+}
+
+// ESC opcodes D8 to DF, the coprocessor instruction is picked by the low opcode bits and the ModRM byte
+void decodeEsc(Fetcher &aFetcher, DecodedInst &aInst, std::uint8_t aOpcode) noexcept
+{
+    static constexpr std::array<std::array<EscRegisterForm, 8>, 8> STACK_FORMS{
+        escStackForms<0>(), escStackForms<1>(), escStackForms<2>(), escStackForms<3>(),
+        escStackForms<4>(), escStackForms<5>(), escStackForms<6>(), escStackForms<7>()};
+
+    const auto myModRM = decodeModRM(aFetcher, aInst);
+    const auto myEsc = static_cast<std::uint8_t>(aOpcode & 0x7U);
+    if (!myModRM.isRegister())
+    {
+        decodeEscMemory(aInst, myEsc, myModRM);
+        return;
+    }
+
+    aInst.theImmediate = myModRM.theRm;
+    auto myForm = STACK_FORMS[myEsc][myModRM.theReg];
+    if (myForm.theHandler == nullptr)
+    {
+        myForm = escFixedForm(myEsc, myModRM);
+    }
+    if (myForm.theHandler == nullptr)
+    {
+        branch(aInst, arch::Inst::NOP, &illegal);
+        return;
+    }
+    aInst.theInst = myForm.theInst;
+    aInst.theHandler = myForm.theHandler;
+}
+
+void decodeOpcode(Fetcher &aFetcher, DecodedInst &aInst, std::uint8_t aOpcode) noexcept
+{
+    using enum arch::Inst;
+    switch (aOpcode)
+    {
+    case 0x06:
+    case 0x0E:
+    case 0x16:
+    case 0x1E:
+        aInst.theInst = PUSH;
+        aInst.theFirst = SEGMENT_REGS[(aOpcode >> 3) & 0x3];
+        aInst.theForm = DecodedInst::Form::Reg;
+        aInst.theHandler = &reg<&SingleCore::PUSH>;
+        break;
+    case 0x07:
+    case 0x17:
+    case 0x1F:
+        aInst.theInst = POP;
+        aInst.theFirst = SEGMENT_REGS[(aOpcode >> 3) & 0x3];
+        aInst.theForm = DecodedInst::Form::Reg;
+        aInst.theHandler = &reg<&SingleCore::POP>;
+        break;
+    // 0x0F is POP CS on the 8086. The emulator does not implement it and reserves the opcode for hypercalls instead
+    case 0x0F:
+        if (aFetcher.byte() != Hypercalls::Opcode)
+        {
+            branch(aInst, NOP, &illegal);
+            break;
+        }
+        aInst.theImmediate = aFetcher.byte();
+        branch(aInst, HCALL, &imm<&SingleCore::HCALL>);
+        break;
+    case 0x11:
+        aInst.theInst = ADC;
+        rmReg<&SingleCore::ADC, &SingleCore::ADC>(aInst, decodeModRM(aFetcher, aInst));
+        break;
+    case 0x13:
+        aInst.theInst = ADC;
+        regRm<&SingleCore::ADC, &SingleCore::ADC>(aInst, decodeModRM(aFetcher, aInst));
+        break;
+    case 0x15:
+        aInst.theInst = ADC;
+        aInst.theFirst = arch::Regs::AX;
+        aInst.theImmediate = aFetcher.word();
+        aInst.theForm = DecodedInst::Form::RegImm;
+        aInst.theHandler = &regImm<&SingleCore::ADC>;
+        break;
+    case 0x21:
+        aInst.theInst = AND;
+        rmReg<&SingleCore::AND, &SingleCore::AND>(aInst, decodeModRM(aFetcher, aInst));
+        break;
+    case 0x23:
+        aInst.theInst = AND;
+        regRm<&SingleCore::AND, &SingleCore::AND>(aInst, decodeModRM(aFetcher, aInst));
+        break;
+    case 0x25:
+        aInst.theInst = AND;
+        aInst.theFirst = arch::Regs::AX;
+        aInst.theImmediate = aFetcher.word();
+        aInst.theForm = DecodedInst::Form::RegImm;
+        aInst.theHandler = &regImm<&SingleCore::AND>;
+        break;
+    case 0x37:
+        aInst.theInst = AAA;
+        aInst.theHandler = &none<&SingleCore::AAA>;
+        break;
+    case 0x39:
+        aInst.theInst = CMP;
+        rmReg<&SingleCore::CMP, &SingleCore::CMP>(aInst, decodeModRM(aFetcher, aInst));
+        break;
+    case 0x3B:
+        aInst.theInst = CMP;
+        regRm<&SingleCore::CMP, &SingleCore::CMP>(aInst, decodeModRM(aFetcher, aInst));
+        break;
+    case 0x3D:
+        aInst.theInst = CMP;
+        aInst.theFirst = arch::Regs::AX;
+        aInst.theImmediate = aFetcher.word();
+        aInst.theForm = DecodedInst::Form::RegImm;
+        aInst.theHandler = &regImm<&SingleCore::CMP>;
+        break;
+    case 0x3F:
+        aInst.theInst = AAS;
+        aInst.theHandler = &none<&SingleCore::AAS>;
+        break;
+    case 0x40:
+    case 0x41:
+    case 0x42:
+    case 0x43:
+    case 0x44:
+    case 0x45:
+    case 0x46:
+    case 0x47:
+        aInst.theInst = INC;
+        aInst.theFirst = WORD_REGS[aOpcode & 0x7];
+        aInst.theForm = DecodedInst::Form::Reg;
+        aInst.theHandler = &reg<&SingleCore::INC>;
+        break;
+    case 0x48:
+    case 0x49:
+    case 0x4A:
+    case 0x4B:
+    case 0x4C:
+    case 0x4D:
+    case 0x4E:
+    case 0x4F:
+        aInst.theInst = DEC;
+        aInst.theFirst = WORD_REGS[aOpcode & 0x7];
+        aInst.theForm = DecodedInst::Form::Reg;
+        aInst.theHandler = &reg<&SingleCore::DEC>;
+        break;
+    case 0x50:
+    case 0x51:
+    case 0x52:
+    case 0x53:
+    case 0x54:
+    case 0x55:
+    case 0x56:
+    case 0x57:
+        aInst.theInst = PUSH;
+        aInst.theFirst = WORD_REGS[aOpcode & 0x7];
+        aInst.theForm = DecodedInst::Form::Reg;
+        aInst.theHandler = &reg<&SingleCore::PUSH>;
+        break;
+    case 0x58:
+    case 0x59:
+    case 0x5A:
+    case 0x5B:
+    case 0x5C:
+    case 0x5D:
+    case 0x5E:
+    case 0x5F:
+        aInst.theInst = POP;
+        aInst.theFirst = WORD_REGS[aOpcode & 0x7];
+        aInst.theForm = DecodedInst::Form::Reg;
+        aInst.theHandler = &reg<&SingleCore::POP>;
+        break;
+    // PUSHA, POPA and PUSH immediate came with the 80186
+    case 0x60:
+        aInst.theInst = PUSHA;
+        aInst.theHandler = &none<&SingleCore::PUSHA>;
+        break;
+    case 0x61:
+        aInst.theInst = POPA;
+        aInst.theHandler = &none<&SingleCore::POPA>;
+        break;
+    case 0x68:
+        aInst.theInst = PUSH;
+        aInst.theImmediate = aFetcher.word();
+        aInst.theHandler = &imm<&SingleCore::PUSH>;
+        break;
+    case 0x6A:
+        aInst.theInst = PUSH;
+        aInst.theImmediate = aFetcher.signExtendedByte();
+        aInst.theHandler = &imm<&SingleCore::PUSH>;
+        break;
+    case 0x81:
+        decodeGroup1(aFetcher, aInst, false);
+        break;
+    case 0x83:
+        decodeGroup1(aFetcher, aInst, true);
+        break;
+    case 0x87:
+        aInst.theInst = XCHG;
+        rmReg<&SingleCore::XCHG, &SingleCore::XCHG>(aInst, decodeModRM(aFetcher, aInst));
+        break;
+    case 0x89:
+        aInst.theInst = MOV;
+        rmReg<&SingleCore::MOV, &SingleCore::MOV>(aInst, decodeModRM(aFetcher, aInst));
+        break;
+    case 0x8B:
+        aInst.theInst = MOV;
+        regRm<&SingleCore::MOV, &SingleCore::MOV>(aInst, decodeModRM(aFetcher, aInst));
+        break;
+    case 0x8C: {
+        aInst.theInst = MOV;
+        const auto myModRM = decodeModRM(aFetcher, aInst);
+        aInst.theSecond = SEGMENT_REGS[myModRM.theReg & 0x3];
+        aInst.theForm = myModRM.isRegister() ? DecodedInst::Form::RegReg : DecodedInst::Form::MemReg;
+        aInst.theHandler =
+            myModRM.isRegister() ? &regReg<&SingleCore::MOV> : addressed<MemReg<&SingleCore::MOV>>(myModRM);
+        break;
+    }
+    case 0x8E: {
+        aInst.theInst = MOV;
+        const auto myModRM = decodeModRM(aFetcher, aInst);
+        if (myModRM.isRegister())
+        {
+            aInst.theSecond = aInst.theFirst;
+            aInst.theForm = DecodedInst::Form::RegReg;
+            aInst.theHandler = &regReg<&SingleCore::MOV>;
+        }
+        else
+        {
+            aInst.theForm = DecodedInst::Form::RegMem;
+            aInst.theHandler = addressed<RegMem<&SingleCore::MOV>>(myModRM);
+        }
+        aInst.theFirst = SEGMENT_REGS[myModRM.theReg & 0x3];
+        break;
+    }
+    case 0x8F: {
+        const auto myModRM = decodeModRM(aFetcher, aInst);
+        if (myModRM.theReg != 0)
+        {
+            branch(aInst, NOP, &illegal);
+            break;
+        }
+        aInst.theInst = POP;
+        rm<&SingleCore::POP, &SingleCore::POP>(aInst, myModRM);
+        break;
+    }
+    case 0x90:
+        aInst.theInst = NOP;
+        aInst.theHandler = &none<&SingleCore::NOP>;
+        break;
+    case 0x91:
+    case 0x92:
+    case 0x93:
+    case 0x94:
+    case 0x95:
+    case 0x96:
+    case 0x97:
+        aInst.theInst = XCHG;
+        aInst.theFirst = arch::Regs::AX;
+        aInst.theSecond = WORD_REGS[aOpcode & 0x7];
+        aInst.theForm = DecodedInst::Form::RegReg;
+        aInst.theHandler = &regReg<&SingleCore::XCHG>;
+        break;
+    case 0x98:
+        aInst.theInst = CBW;
+        aInst.theHandler = &none<&SingleCore::CBW>;
+        break;
+    case 0x99:
+        aInst.theInst = CWD;
+        aInst.theHandler = &none<&SingleCore::CWD>;
+        break;
+    case 0x9A:
+        aInst.theImmediate = aFetcher.word();
+        aInst.theDisplacement = aFetcher.word();
+        branch(aInst, CALL, &far<&SingleCore::CALL>);
+        break;
+    case 0x9B:
+        aInst.theInst = WAIT;
+        aInst.theHandler = &none<&SingleCore::WAIT>;
+        break;
+    case 0x9C:
+        aInst.theInst = PUSHF;
+        aInst.theHandler = &none<&SingleCore::PUSHF>;
+        break;
+    case 0x9D:
+        aInst.theInst = POPF;
+        aInst.theHandler = &none<&SingleCore::POPF>;
+        break;
+    case 0xA6:
+        aInst.theInst = CMPSB;
+        aInst.theHandler = &none<&SingleCore::CMPSB>;
+        break;
+    case 0xA7:
+        aInst.theInst = CMPSW;
+        aInst.theHandler = &none<&SingleCore::CMPSW>;
+        break;
+    case 0xB8:
+    case 0xB9:
+    case 0xBA:
+    case 0xBB:
+    case 0xBC:
+    case 0xBD:
+    case 0xBE:
+    case 0xBF:
+        aInst.theInst = MOV;
+        aInst.theFirst = WORD_REGS[aOpcode & 0x7];
+        aInst.theImmediate = aFetcher.word();
+        aInst.theForm = DecodedInst::Form::RegImm;
+        aInst.theHandler = &regImm<&SingleCore::MOV>;
+        break;
+    case 0xC2:
+        aInst.theImmediate = aFetcher.word();
+        branch(aInst, RET, &imm<&SingleCore::RET>);
+        break;
+    case 0xC3:
+        branch(aInst, RET, &none<&SingleCore::RET>);
+        break;
+    case 0xC7: {
+        const auto myModRM = decodeModRM(aFetcher, aInst);
+        aInst.theImmediate = aFetcher.word();
+        if (myModRM.theReg != 0)
+        {
+            branch(aInst, NOP, &illegal);
+            break;
+        }
+        aInst.theInst = MOV;
+        rmImm<&SingleCore::MOV, &SingleCore::MOV>(aInst, myModRM);
+        break;
+    }
+    case 0xCA:
+        aInst.theImmediate = aFetcher.word();
+        branch(aInst, RETF, &imm<&SingleCore::RETF>);
+        break;
+    case 0xCB:
+        branch(aInst, RETF, &none<&SingleCore::RETF>);
+        break;
+    case 0xCC:
+        aInst.theImmediate = 3;
+        branch(aInst, INT, &softwareInterrupt);
+        break;
+    case 0xCD:
+        aInst.theImmediate = aFetcher.byte();
+        branch(aInst, INT, &softwareInterrupt);
+        break;
+    case 0xCE:
+        branch(aInst, INTO, &none<&SingleCore::INTO>);
+        break;
+    case 0xCF:
+        branch(aInst, IRET, &none<&SingleCore::IRET>);
+        break;
+    case 0xD4:
+    case 0xD5: {
+        // Only the documented base 10 forms exist as AAM and AAD
+        if (aFetcher.byte() != 0x0A)
+        {
+            branch(aInst, NOP, &illegal);
+            break;
+        }
+        aInst.theInst = aOpcode == 0xD4 ? AAM : AAD;
+        aInst.theHandler = aOpcode == 0xD4 ? &none<&SingleCore::AAM> : &none<&SingleCore::AAD>;
+        break;
+    }
+    case 0xD8:
+    case 0xD9:
+    case 0xDA:
+    case 0xDB:
+    case 0xDC:
+    case 0xDD:
+    case 0xDE:
+    case 0xDF:
+        decodeEsc(aFetcher, aInst, aOpcode);
+        break;
+    case 0xE0:
+        aInst.theImmediate = aFetcher.signExtendedByte();
+        relativeBranch(aInst, LOOPNE, &relative<&SingleCore::LOOPNE>);
+        break;
+    case 0xE1:
+        aInst.theImmediate = aFetcher.signExtendedByte();
+        relativeBranch(aInst, LOOPE, &relative<&SingleCore::LOOPE>);
+        break;
+    case 0xE2:
+        aInst.theImmediate = aFetcher.signExtendedByte();
+        relativeBranch(aInst, LOOP, &relative<&SingleCore::LOOP>);
+        break;
+    case 0xE3:
+        aInst.theImmediate = aFetcher.signExtendedByte();
+        relativeBranch(aInst, JCXZ, &relative<&SingleCore::JCXZ>);
+        break;
+    // IN ends its block so a replayed interrupt logged right after it is delivered on time
+    case 0xE4:
+        aInst.theImmediate = aFetcher.byte();
+        branch(aInst, IN, &portIn<arch::OperandSize::Byte, false>);
+        break;
+    case 0xE5:
+        aInst.theImmediate = aFetcher.byte();
+        branch(aInst, IN, &portIn<arch::OperandSize::Word, false>);
+        break;
+    case 0xE6:
+        aInst.theInst = OUT;
+        aInst.theImmediate = aFetcher.byte();
+        aInst.theHandler = &portOut<arch::OperandSize::Byte, false>;
+        break;
+    case 0xE7:
+        aInst.theInst = OUT;
+        aInst.theImmediate = aFetcher.byte();
+        aInst.theHandler = &portOut<arch::OperandSize::Word, false>;
+        break;
+    case 0xE8:
+        aInst.theImmediate = aFetcher.word();
+        relativeBranch(aInst, CALL, &relative<&SingleCore::CALL>);
+        break;
+    case 0xE9:
+        aInst.theImmediate = aFetcher.word();
+        relativeBranch(aInst, JMP, &relative<&SingleCore::JMP>);
+        break;
+    case 0xEA:
+        aInst.theImmediate = aFetcher.word();
+        aInst.theDisplacement = aFetcher.word();
+        branch(aInst, JMP, &far<&SingleCore::JMP>);
+        break;
+    case 0xEB:
+        aInst.theImmediate = aFetcher.signExtendedByte();
+        relativeBranch(aInst, JMP, &relative<&SingleCore::JMP>);
+        break;
+    case 0xEC:
+        branch(aInst, IN, &portIn<arch::OperandSize::Byte, true>);
+        break;
+    case 0xED:
+        branch(aInst, IN, &portIn<arch::OperandSize::Word, true>);
+        break;
+    case 0xEE:
+        aInst.theInst = OUT;
+        aInst.theHandler = &portOut<arch::OperandSize::Byte, true>;
+        break;
+    case 0xEF:
+        aInst.theInst = OUT;
+        aInst.theHandler = &portOut<arch::OperandSize::Word, true>;
+        break;
+    case 0xF4:
+        branch(aInst, HLT, &none<&SingleCore::HLT>);
+        break;
+    case 0xF5:
+        aInst.theInst = CMC;
+        aInst.theHandler = &none<&SingleCore::CMC>;
+        break;
+    case 0xF8:
+        aInst.theInst = CLC;
+        aInst.theHandler = &none<&SingleCore::CLC>;
+        break;
+    case 0xF9:
+        aInst.theInst = STC;
+        aInst.theHandler = &none<&SingleCore::STC>;
+        break;
+    case 0xFA:
+        aInst.theInst = CLI;
+        aInst.theHandler = &none<&SingleCore::CLI>;
+        break;
+    case 0xFB:
+        aInst.theInst = STI;
+        aInst.theHandler = &none<&SingleCore::STI>;
+        break;
+    case 0xFC:
+        aInst.theInst = CLD;
+        aInst.theHandler = &none<&SingleCore::CLD>;
+        break;
+    case 0xFD:
+        aInst.theInst = STD;
+        aInst.theHandler = &none<&SingleCore::STD>;
+        break;
+    case 0xFF:
+        decodeGroup5(aFetcher, aInst);
+        break;
+    default:
+        if (aOpcode >= 0x70 && aOpcode <= 0x7F)
+        {
+            decodeConditional(aFetcher, aInst, aOpcode & 0xF);
+        }
+        else
+        {
+            branch(aInst, NOP, &illegal);
+        }
+        break;
+    }
+}
+} // namespace
+
+DecodedInst Decoder::decode(const RandomAccessMemory &aMemory, arch::MemoryAddress aAddress) noexcept
+{
+    Fetcher myFetcher{.theMemory = aMemory, .theAddress = aAddress.theAddress};
+    DecodedInst myInst{};
+    std::optional<arch::Regs> mySegmentOverride;
+
+    auto myOpcode = myFetcher.byte();
+    for (bool myIsPrefix = true; myIsPrefix && myFetcher.theTrap == Trap::OK;)
+    {
+        switch (myOpcode)
+        {
+        case 0xF0:
+            myInst.theIsLocked = true;
+            myOpcode = myFetcher.byte();
+            break;
+        case 0x26:
+        case 0x2E:
+        case 0x36:
+        case 0x3E:
+            mySegmentOverride = SEGMENT_REGS[(myOpcode >> 3) & 0x3];
+            myOpcode = myFetcher.byte();
+            break;
+        default:
+            myIsPrefix = false;
+            break;
+        }
+    }
+
+    decodeOpcode(myFetcher, myInst, myOpcode);
+    if (mySegmentOverride)
+    {
+        myInst.theSegment = *mySegmentOverride;
+    }
+    myInst.theLength = myFetcher.theLength;
+
+    if (myFetcher.theTrap != Trap::OK)
+    {
+        branch(myInst, arch::Inst::NOP, &fetchFault);
+    }
+    return myInst;
+}
+
+arch::MemoryAddress Decoder::effectiveAddress(SingleCore &aCore, const DecodedInst &aInst) noexcept
+{
+    arch::Immediate myOffset = aInst.theDisplacement;
+    if ((aInst.theOperandFlags & DecodedInst::HasBase) != 0)
+    {
+        myOffset += aCore.readRegister(aInst.theBase);
+    }
+    if ((aInst.theOperandFlags & DecodedInst::HasIndex) != 0)
+    {
+        myOffset += aCore.readRegister(aInst.theIndex);
+    }
+    const std::uint32_t mySegment = aCore.readRegister(aInst.theSegment);
+    return arch::MemoryAddress{.theAddress = (mySegment << 4) + myOffset};
+}
+} // namespace svm
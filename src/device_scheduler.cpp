@@ -0,0 +1,295 @@
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <utility>
+
+#include "arch.hpp"
+#include "device_scheduler.hpp"
+#include "single_core.hpp"
+#include "trace.hpp"
+
+namespace svm
+{
+namespace
+{
+constexpr std::size_t INITIAL_QUEUE_CAPACITY = 64U;
+} // namespace
+
+FrameArena::FrameArena(std::size_t aCapacity)
+    : theStorage{std::make_unique_for_overwrite<std::byte[]>(aCapacity)}, theCapacity{aCapacity}
+{
+}
+
+void *FrameArena::allocate(std::size_t aSize) noexcept
+{
+    const auto mySize = HeaderSize + (aSize + Alignment - 1) / Alignment * Alignment;
+    void *myBlock{};
+    if (auto myIter = std::ranges::find(theFreeLists, mySize, &FreeList::theSize);
+        myIter != theFreeLists.end() && myIter->theHead != nullptr)
+    {
+        myBlock = myIter->theHead;
+        myIter->theHead = *static_cast<void **>(myBlock);
+    }
+    else if (theCapacity - theUsed >= mySize)
+    {
+        myBlock = theStorage.get() + theUsed;
+        theUsed += mySize;
+    }
+    else
+    {
+        return nullptr;
+    }
+
+    ::new (myBlock) Header{.theArena = this, .theSize = mySize};
+    return static_cast<std::byte *>(myBlock) + HeaderSize;
+}
+
+void FrameArena::deallocate(void *aFrame) noexcept
+{
+    void *myBlock = static_cast<std::byte *>(aFrame) - HeaderSize;
+    const auto myHeader = *static_cast<Header *>(myBlock);
+    auto &myLists = myHeader.theArena->theFreeLists;
+
+    auto myIter = std::ranges::find(myLists, myHeader.theSize, &FreeList::theSize);
+    if (myIter == myLists.end())
+    {
+        // Only happens for the first frame of a given size, not on the resume path
+        myLists.push_back(FreeList{.theSize = myHeader.theSize, .theHead = nullptr});
+        myIter = myLists.end() - 1;
+    }
+    *static_cast<void **>(myBlock) = myIter->theHead;
+    myIter->theHead = myBlock;
+}
+
+std::size_t FrameArena::used() const noexcept
+{
+    return theUsed;
+}
+
+thread_local FrameArena *DeviceScheduler::theSpawning{};
+
+void *DeviceTask::promise_type::operator new(std::size_t aSize) noexcept
+{
+    return DeviceScheduler::theSpawning != nullptr ? DeviceScheduler::theSpawning->allocate(aSize) : nullptr;
+}
+
+void DeviceTask::promise_type::operator delete(void *aFrame) noexcept
+{
+    FrameArena::deallocate(aFrame);
+}
+
+DeviceTask::DeviceTask(Handle aHandle) noexcept : theHandle{aHandle}
+{
+}
+
+DeviceTask::~DeviceTask()
+{
+    if (theHandle)
+    {
+        theHandle.destroy();
+    }
+}
+
+DeviceTask::DeviceTask(DeviceTask &&aOther) noexcept : theHandle{std::exchange(aOther.theHandle, nullptr)}
+{
+}
+
+DeviceTask &DeviceTask::operator=(DeviceTask &&aOther) noexcept
+{
+    if (this != &aOther)
+    {
+        if (theHandle)
+        {
+            theHandle.destroy();
+        }
+        theHandle = std::exchange(aOther.theHandle, nullptr);
+    }
+    return *this;
+}
+
+bool DeviceTask::isValid() const noexcept
+{
+    return static_cast<bool>(theHandle);
+}
+
+DeviceTask::Handle DeviceTask::handle() const noexcept
+{
+    return theHandle;
+}
+
+PortChannel::PortChannel(DeviceScheduler &aScheduler) noexcept : theScheduler{aScheduler}
+{
+}
+
+void PortChannel::post(PortAccess aAccess) noexcept
+{
+    if (theSize == Capacity)
+    {
+        ++theDropped;
+        return;
+    }
+    theAccesses[(theHead + theSize) % Capacity] = aAccess;
+    ++theSize;
+    if (theWaiter)
+    {
+        theScheduler.wake(std::exchange(theWaiter, nullptr));
+    }
+}
+
+std::optional<PortAccess> PortChannel::tryReceive() noexcept
+{
+    if (theSize == 0)
+    {
+        return std::nullopt;
+    }
+    return Awaiter{*this}.await_resume();
+}
+
+std::size_t PortChannel::dropped() const noexcept
+{
+    return theDropped;
+}
+
+bool PortChannel::Awaiter::await_ready() const noexcept
+{
+    return theChannel.theSize != 0;
+}
+
+void PortChannel::Awaiter::await_suspend(std::coroutine_handle<> aHandle) noexcept
+{
+    theChannel.theWaiter = aHandle;
+}
+
+PortAccess PortChannel::Awaiter::await_resume() noexcept
+{
+    const auto myAccess = theChannel.theAccesses[theChannel.theHead];
+    theChannel.theHead = (theChannel.theHead + 1) % Capacity;
+    --theChannel.theSize;
+    return myAccess;
+}
+
+PortChannel::Awaiter PortChannel::operator co_await() noexcept
+{
+    return Awaiter{*this};
+}
+
+DeviceScheduler::DeviceScheduler(std::size_t aArenaSize) : theArena{aArenaSize}
+{
+    theQueue.reserve(INITIAL_QUEUE_CAPACITY);
+}
+
+DeviceScheduler::~DeviceScheduler()
+{
+    theQueue.clear();
+    theTasks.clear();
+}
+
+bool DeviceScheduler::adopt(DeviceTask aTask)
+{
+    if (!aTask.isValid())
+    {
+        return false;
+    }
+    const auto myHandle = aTask.handle();
+    theTasks.push_back(std::move(aTask));
+    schedule(theNow, myHandle);
+    return true;
+}
+
+std::uint64_t DeviceScheduler::now() const noexcept
+{
+    return theNow;
+}
+
+std::uint64_t DeviceScheduler::nextDue() const noexcept
+{
+    return theQueue.empty() ? Idle : theQueue.front().theDue;
+}
+
+void DeviceScheduler::advanceTo(std::uint64_t aCycle) noexcept
+{
+    bool myHasResumed{};
+    while (!theQueue.empty() && theQueue.front().theDue <= aCycle)
+    {
+        std::pop_heap(theQueue.begin(), theQueue.end());
+        const auto myWakeup = theQueue.back();
+        theQueue.pop_back();
+        // Wakeups posted mid slice can be behind the clock, they run at the current cycle
+        theNow = std::max(theNow, myWakeup.theDue);
+        trace::Slice mySlice{trace::Category::Device, "wakeup", theNow};
+        myWakeup.theHandle.resume();
+        myHasResumed = true;
+    }
+    theNow = std::max(theNow, aCycle);
+    if (myHasResumed)
+    {
+        reapFinished();
+    }
+}
+
+Trap DeviceScheduler::run(SingleCore &aCore, std::size_t aBudget) noexcept
+{
+    std::size_t myRemaining = aBudget;
+    while (myRemaining != 0)
+    {
+        advanceTo(theNow + (aCore.instructionCount() - theLastInstructionCount));
+        theLastInstructionCount = aCore.instructionCount();
+
+        const auto mySlice = std::min<std::uint64_t>(myRemaining, nextDue() - theNow);
+        theRunning = &aCore;
+        const auto myTrap = aCore.run(static_cast<std::size_t>(std::max<std::uint64_t>(mySlice, 1U)));
+        theRunning = nullptr;
+        const auto myRetired = aCore.instructionCount() - theLastInstructionCount;
+        myRemaining -= std::min<std::uint64_t>(myRemaining, myRetired);
+        advanceTo(theNow + myRetired);
+        theLastInstructionCount = aCore.instructionCount();
+
+        if (myTrap == Trap::HALT && aCore.readFlag(arch::Flags::IF) != 0 && nextDue() != Idle)
+        {
+            // Nothing happens until a device acts, skip the idle cycles
+            advanceTo(nextDue());
+            continue;
+        }
+        if (myTrap != Trap::OK)
+        {
+            return myTrap;
+        }
+    }
+    return Trap::OK;
+}
+
+std::size_t DeviceScheduler::taskCount() const noexcept
+{
+    return theTasks.size();
+}
+
+std::size_t DeviceScheduler::arenaUsed() const noexcept
+{
+    return theArena.used();
+}
+
+void DeviceScheduler::wake(std::coroutine_handle<> aHandle) noexcept
+{
+    schedule(theNow, aHandle);
+    if (theRunning != nullptr)
+    {
+        theRunning->requestYield();
+    }
+}
+
+DeviceScheduler::Delay DeviceScheduler::delay(std::uint64_t aCycles) noexcept
+{
+    return Delay{.theScheduler = *this, .theCycles = aCycles};
+}
+
+void DeviceScheduler::schedule(std::uint64_t aDue, std::coroutine_handle<> aHandle) noexcept
+{
+    theQueue.push_back(Wakeup{.theDue = aDue, .theSequence = theSequence++, .theHandle = aHandle});
+    std::push_heap(theQueue.begin(), theQueue.end());
+}
+
+void DeviceScheduler::reapFinished() noexcept
+{
+    std::erase_if(theTasks, [](const DeviceTask &aTask) { return aTask.handle().done(); });
+}
+} // namespace svm
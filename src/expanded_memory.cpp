@@ -0,0 +1,492 @@
+#include <algorithm>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <tuple>
+
+#include "arch.hpp"
+#include "expanded_memory.hpp"
+
+namespace svm
+{
+namespace
+{
+static_assert(ExpandedMemory::PageSize % RandomAccessMemory::PageSize == 0);
+constexpr std::size_t GUEST_PAGES_PER_PAGE = ExpandedMemory::PageSize / RandomAccessMemory::PageSize;
+// Page numbers travel in 16 bit registers
+constexpr std::size_t MAX_PAGE_COUNT = 0xFFFFU;
+
+enum Function : std::uint8_t
+{
+    GetStatus = 0x40U,
+    GetPageFrame = 0x41U,
+    GetPageCounts = 0x42U,
+    Allocate = 0x43U,
+    MapPage = 0x44U,
+    Deallocate = 0x45U,
+    GetVersion = 0x46U,
+    GetHandleCount = 0x4BU,
+    GetHandlePages = 0x4CU,
+    MapMultiple = 0x50U,
+};
+
+// Section fields in host byte order like the rest of a SaveState image. Pool pages and frame windows are a kind byte,
+// zero for a page of zeros, then for any other page its bytes.
+struct SectionWriter
+{
+    std::vector<std::uint8_t> theData;
+
+    void word(std::uint16_t aValue)
+    {
+        const auto *myBytes = reinterpret_cast<const std::uint8_t *>(&aValue);
+        theData.insert(theData.end(), myBytes, myBytes + sizeof(aValue));
+    }
+
+    void page(std::span<const std::uint8_t> aPage)
+    {
+        const auto myIsZero = std::ranges::all_of(aPage, [](std::uint8_t aByte) { return aByte == 0; });
+        theData.push_back(myIsZero ? 0U : 1U);
+        if (!myIsZero)
+        {
+            theData.insert(theData.end(), aPage.begin(), aPage.end());
+        }
+    }
+};
+
+struct SectionReader
+{
+    std::span<const std::uint8_t> theData;
+
+    std::optional<std::uint16_t> word() noexcept
+    {
+        std::uint16_t myValue{};
+        if (theData.size() < sizeof(myValue))
+        {
+            return std::nullopt;
+        }
+        std::memcpy(&myValue, theData.data(), sizeof(myValue));
+        theData = theData.subspan(sizeof(myValue));
+        return myValue;
+    }
+
+    // Empty for a page of zeros
+    std::optional<std::span<const std::uint8_t>> page() noexcept
+    {
+        if (theData.empty() || theData[0] > 1U || (theData[0] == 1U && theData.size() < 1U + ExpandedMemory::PageSize))
+        {
+            return std::nullopt;
+        }
+        const auto myLength = theData[0] == 1U ? ExpandedMemory::PageSize : 0U;
+        const auto myPage = theData.subspan(1, myLength);
+        theData = theData.subspan(1 + myLength);
+        return myPage;
+    }
+};
+} // namespace
+
+ExpandedMemory::ExpandedMemory(RandomAccessMemory &aMemory, std::size_t aPageCount, std::uint16_t aFrameSegment)
+    : theMemory{aMemory}, theFrameSegment{static_cast<std::uint16_t>(aFrameSegment & ~0x3FFU)},
+      thePageCount{std::min(aPageCount, MAX_PAGE_COUNT)},
+      thePool{std::make_unique<std::uint8_t[]>(thePageCount * PageSize)}
+{
+    theFreePages.reserve(thePageCount);
+    for (auto myPage = thePageCount; myPage > 0; --myPage)
+    {
+        theFreePages.push_back(static_cast<std::uint16_t>(myPage - 1));
+    }
+    theHandles.reserve(MaxHandles);
+    theHandles.push_back(Handle{.theIsOpen = true, .thePages = {}});
+}
+
+// The pool goes with the board, so the frame must not point into it any more
+ExpandedMemory::~ExpandedMemory()
+{
+    for (std::uint8_t i{}; i < FramePages; ++i)
+    {
+        map(i, Unmapped, 0);
+    }
+}
+
+Trap ExpandedMemory::onInterrupt(SingleCore &aCore) noexcept
+{
+    const auto myAX = aCore.readRegister(arch::Regs::AX);
+    const auto myBX = aCore.readRegister(arch::Regs::BX);
+    const auto myDX = aCore.readRegister(arch::Regs::DX);
+    Status myStatus{OK};
+    switch (static_cast<Function>(myAX >> 8))
+    {
+    case GetStatus:
+        break;
+    case GetPageFrame:
+        aCore.writeRegister(arch::Regs::BX, theFrameSegment);
+        break;
+    case GetPageCounts:
+        aCore.writeRegister(arch::Regs::BX, static_cast<arch::Immediate>(freePageCount()));
+        aCore.writeRegister(arch::Regs::DX, static_cast<arch::Immediate>(thePageCount));
+        break;
+    case Allocate: {
+        std::uint16_t myHandle{};
+        myStatus = allocate(myBX, myHandle);
+        if (myStatus == OK)
+        {
+            aCore.writeRegister(arch::Regs::DX, myHandle);
+        }
+        break;
+    }
+    case MapPage:
+        myStatus = map(static_cast<std::uint8_t>(myAX & 0xFFU), myBX, myDX);
+        break;
+    case Deallocate:
+        myStatus = deallocate(myDX);
+        break;
+    case GetVersion:
+        aCore.writeRegister(arch::Regs::AX, Version);
+        return Trap::OK;
+    case GetHandleCount:
+        aCore.writeRegister(arch::Regs::BX, static_cast<arch::Immediate>(std::ranges::count_if(
+                                                theHandles, [](const Handle &aHandle) { return aHandle.theIsOpen; })));
+        break;
+    case GetHandlePages:
+        if (!isOpen(myDX))
+        {
+            myStatus = InvalidHandle;
+            break;
+        }
+        aCore.writeRegister(arch::Regs::BX, static_cast<arch::Immediate>(theHandles[myDX].thePages.size()));
+        break;
+    case MapMultiple:
+        myStatus = (myAX & 0xFFU) == 0 ? mapMultiple(aCore) : InvalidSubfunction;
+        break;
+    default:
+        myStatus = UndefinedFunction;
+        break;
+    }
+    aCore.writeRegister(arch::Regs::AX, static_cast<arch::Immediate>((myStatus << 8) | (myAX & 0xFFU)));
+    return Trap::OK;
+}
+
+ExpandedMemory::Status ExpandedMemory::allocate(std::uint16_t aPages, std::uint16_t &aHandle)
+{
+    if (aPages == 0)
+    {
+        return ZeroPages;
+    }
+    if (aPages > thePageCount)
+    {
+        return NotEnoughPages;
+    }
+    if (aPages > theFreePages.size())
+    {
+        return NotEnoughFreePages;
+    }
+    auto myHandle = std::ranges::find_if(theHandles, [](const Handle &aHandle) { return !aHandle.theIsOpen; });
+    if (myHandle == theHandles.end())
+    {
+        if (theHandles.size() == MaxHandles)
+        {
+            return NoMoreHandles;
+        }
+        myHandle = theHandles.insert(theHandles.end(), Handle{.theIsOpen = false, .thePages = {}});
+    }
+    myHandle->theIsOpen = true;
+    myHandle->thePages.assign(theFreePages.end() - aPages, theFreePages.end());
+    theFreePages.resize(theFreePages.size() - aPages);
+    aHandle = static_cast<std::uint16_t>(myHandle - theHandles.begin());
+    return OK;
+}
+
+// Windows still showing the handle's pages keep showing them until remapped, as on a real board
+ExpandedMemory::Status ExpandedMemory::deallocate(std::uint16_t aHandle) noexcept
+{
+    if (!isOpen(aHandle))
+    {
+        return InvalidHandle;
+    }
+    auto &myHandle = theHandles[aHandle];
+    theFreePages.insert(theFreePages.end(), myHandle.thePages.begin(), myHandle.thePages.end());
+    myHandle.thePages.clear();
+    myHandle.theIsOpen = aHandle == 0;
+    return OK;
+}
+
+ExpandedMemory::Status ExpandedMemory::map(std::uint8_t aPhysical, std::uint16_t aLogical,
+                                           std::uint16_t aHandle) noexcept
+{
+    if (!isOpen(aHandle))
+    {
+        return InvalidHandle;
+    }
+    if (aPhysical >= FramePages)
+    {
+        return PhysicalPageOutOfRange;
+    }
+    const auto &myPages = theHandles[aHandle].thePages;
+    if (aLogical != Unmapped && aLogical >= myPages.size())
+    {
+        return LogicalPageOutOfRange;
+    }
+
+    mapWindow(aPhysical, aLogical == Unmapped ? Unmapped : myPages[aLogical]);
+    return OK;
+}
+
+void ExpandedMemory::mapWindow(std::uint8_t aPhysical, std::uint16_t aPoolPage) noexcept
+{
+    const auto myFirst = ((std::size_t{theFrameSegment} << 4) + aPhysical * PageSize) / RandomAccessMemory::PageSize;
+    for (std::size_t i{}; i < GUEST_PAGES_PER_PAGE; ++i)
+    {
+        if (aPoolPage == Unmapped)
+        {
+            theMemory.unmapPage(myFirst + i);
+            continue;
+        }
+        auto *myBacking = thePool.get() + aPoolPage * PageSize + i * RandomAccessMemory::PageSize;
+        theMemory.mapPage(myFirst + i, std::span<std::uint8_t, RandomAccessMemory::PageSize>{
+                                           myBacking, RandomAccessMemory::PageSize});
+    }
+    theWindows[aPhysical] = aPoolPage;
+}
+
+// DS:SI holds CX pairs of logical and physical page words, all checked before any window changes
+ExpandedMemory::Status ExpandedMemory::mapMultiple(SingleCore &aCore) noexcept
+{
+    const auto myHandle = aCore.readRegister(arch::Regs::DX);
+    const auto myCount = aCore.readRegister(arch::Regs::CX);
+    const std::uint32_t mySegment = std::uint32_t{aCore.readRegister(arch::Regs::DS)} << 4;
+    const auto myOffset = aCore.readRegister(arch::Regs::SI);
+    if (!isOpen(myHandle))
+    {
+        return InvalidHandle;
+    }
+    if (myCount > FramePages)
+    {
+        return PhysicalPageOutOfRange;
+    }
+
+    std::array<std::array<arch::Immediate, 2>, FramePages> myPairs{};
+    for (std::size_t i{}; i < myCount; ++i)
+    {
+        for (std::size_t j{}; j < 2; ++j)
+        {
+            const auto myWord = static_cast<std::uint16_t>(myOffset + i * 4 + j * 2);
+            const auto [myTrap, myValue] = theMemory.read(arch::MemoryAddress{.theAddress = mySegment + myWord});
+            if (myTrap != Trap::OK)
+            {
+                return SoftwareMalfunction;
+            }
+            myPairs[i][j] = myValue;
+        }
+        if (myPairs[i][1] >= FramePages)
+        {
+            return PhysicalPageOutOfRange;
+        }
+        if (myPairs[i][0] != Unmapped && myPairs[i][0] >= theHandles[myHandle].thePages.size())
+        {
+            return LogicalPageOutOfRange;
+        }
+    }
+    for (std::size_t i{}; i < myCount; ++i)
+    {
+        map(static_cast<std::uint8_t>(myPairs[i][1]), myPairs[i][0], myHandle);
+    }
+    return OK;
+}
+
+// Pool size, frame segment, handle count, each handle as open flag and pool pages, the free list, the pool page of
+// each window, what conventional memory holds under each window, then every pool page
+SaveState::Section ExpandedMemory::saveSection() const
+{
+    SectionWriter myWriter;
+    myWriter.word(static_cast<std::uint16_t>(thePageCount));
+    myWriter.word(theFrameSegment);
+    myWriter.word(static_cast<std::uint16_t>(theHandles.size()));
+    for (const auto &myHandle : theHandles)
+    {
+        myWriter.word(myHandle.theIsOpen ? 1U : 0U);
+        myWriter.word(static_cast<std::uint16_t>(myHandle.thePages.size()));
+        std::ranges::for_each(myHandle.thePages, [&](std::uint16_t aPage) { myWriter.word(aPage); });
+    }
+    myWriter.word(static_cast<std::uint16_t>(theFreePages.size()));
+    std::ranges::for_each(theFreePages, [&](std::uint16_t aPage) { myWriter.word(aPage); });
+    std::ranges::for_each(theWindows, [&](std::uint16_t aPage) { myWriter.word(aPage); });
+
+    const auto myFrame = (std::size_t{theFrameSegment} << 4) / RandomAccessMemory::PageSize;
+    std::array<std::uint8_t, PageSize> myConventional{};
+    for (std::size_t i{}; i < FramePages; ++i)
+    {
+        for (std::size_t j{}; j < GUEST_PAGES_PER_PAGE; ++j)
+        {
+            std::ranges::copy(theMemory.ownPage(myFrame + i * GUEST_PAGES_PER_PAGE + j),
+                              myConventional.begin() + j * RandomAccessMemory::PageSize);
+        }
+        myWriter.page(myConventional);
+    }
+    for (std::size_t i{}; i < thePageCount; ++i)
+    {
+        myWriter.page(std::span{thePool.get() + i * PageSize, PageSize});
+    }
+    return SaveState::Section{.theTag = SectionTag, .theData = std::move(myWriter.theData)};
+}
+
+// Everything is read and checked before the board changes. Every pool page has to belong to exactly one open handle
+// or the free list.
+bool ExpandedMemory::restoreSection(const SaveState::Section &aSection)
+{
+    if (aSection.theTag != SectionTag)
+    {
+        return false;
+    }
+    SectionReader myReader{aSection.theData};
+    const auto myPageCount = myReader.word();
+    const auto myFrameSegment = myReader.word();
+    const auto myHandleCount = myReader.word();
+    if (!myPageCount || !myFrameSegment || !myHandleCount || (*myFrameSegment & 0x3FFU) != 0 ||
+        (std::size_t{*myFrameSegment} << 4) + FramePages * PageSize > RandomAccessMemory::Capacity ||
+        *myHandleCount == 0 || *myHandleCount > MaxHandles)
+    {
+        return false;
+    }
+
+    std::vector<bool> myIsOwned(*myPageCount);
+    const auto myTake = [&](std::optional<std::uint16_t> aPage) {
+        if (!aPage || *aPage >= *myPageCount || myIsOwned[*aPage])
+        {
+            return false;
+        }
+        myIsOwned[*aPage] = true;
+        return true;
+    };
+    std::vector<Handle> myHandles(*myHandleCount);
+    for (auto &myHandle : myHandles)
+    {
+        const auto myIsOpen = myReader.word();
+        const auto myCount = myReader.word();
+        if (!myIsOpen || !myCount || *myIsOpen > 1U || (*myIsOpen == 0 && *myCount != 0))
+        {
+            return false;
+        }
+        myHandle.theIsOpen = *myIsOpen == 1U;
+        for (std::size_t i{}; i < *myCount; ++i)
+        {
+            const auto myPage = myReader.word();
+            if (!myTake(myPage))
+            {
+                return false;
+            }
+            myHandle.thePages.push_back(*myPage);
+        }
+    }
+    const auto myFreeCount = myReader.word();
+    if (!myFreeCount || !myHandles[0].theIsOpen)
+    {
+        return false;
+    }
+    std::vector<std::uint16_t> myFreePages;
+    for (std::size_t i{}; i < *myFreeCount; ++i)
+    {
+        const auto myPage = myReader.word();
+        if (!myTake(myPage))
+        {
+            return false;
+        }
+        myFreePages.push_back(*myPage);
+    }
+    if (std::ranges::count(myIsOwned, false) != 0)
+    {
+        return false;
+    }
+    std::array<std::uint16_t, FramePages> myWindows{};
+    for (auto &myWindow : myWindows)
+    {
+        const auto myPage = myReader.word();
+        if (!myPage || (*myPage != Unmapped && *myPage >= *myPageCount))
+        {
+            return false;
+        }
+        myWindow = *myPage;
+    }
+    std::array<std::span<const std::uint8_t>, FramePages> myConventional{};
+    for (auto &myWindow : myConventional)
+    {
+        const auto myPage = myReader.page();
+        if (!myPage)
+        {
+            return false;
+        }
+        myWindow = *myPage;
+    }
+    std::vector<std::span<const std::uint8_t>> myPool(*myPageCount);
+    for (auto &myPoolPage : myPool)
+    {
+        const auto myPage = myReader.page();
+        if (!myPage)
+        {
+            return false;
+        }
+        myPoolPage = *myPage;
+    }
+    if (!myReader.theData.empty())
+    {
+        return false;
+    }
+
+    // With every window unmapped, writes to the frame reach conventional memory and the pool is not in view
+    for (std::uint8_t i{}; i < FramePages; ++i)
+    {
+        mapWindow(i, Unmapped);
+    }
+    theFrameSegment = *myFrameSegment;
+    if (*myPageCount != thePageCount)
+    {
+        thePageCount = *myPageCount;
+        thePool = std::make_unique<std::uint8_t[]>(thePageCount * PageSize);
+    }
+    // The frame was checked to lie within memory
+    for (std::size_t i{}; i < FramePages; ++i)
+    {
+        const arch::MemoryAddress myAddress{
+            .theAddress = static_cast<std::uint32_t>((std::size_t{theFrameSegment} << 4) + i * PageSize)};
+        std::ignore = myConventional[i].empty() ? theMemory.fill(myAddress, PageSize, 0)
+                                                : theMemory.writeBlock(myAddress, myConventional[i]);
+    }
+    for (std::size_t i{}; i < thePageCount; ++i)
+    {
+        auto *myPoolPage = thePool.get() + i * PageSize;
+        if (myPool[i].empty())
+        {
+            std::memset(myPoolPage, 0, PageSize);
+        }
+        else
+        {
+            std::ranges::copy(myPool[i], myPoolPage);
+        }
+    }
+    theHandles = std::move(myHandles);
+    theFreePages = std::move(myFreePages);
+    for (std::uint8_t i{}; i < FramePages; ++i)
+    {
+        mapWindow(i, myWindows[i]);
+    }
+    return true;
+}
+
+std::uint16_t ExpandedMemory::frameSegment() const noexcept
+{
+    return theFrameSegment;
+}
+
+std::size_t ExpandedMemory::pageCount() const noexcept
+{
+    return thePageCount;
+}
+
+std::size_t ExpandedMemory::freePageCount() const noexcept
+{
+    return theFreePages.size();
+}
+
+bool ExpandedMemory::isOpen(std::uint16_t aHandle) const noexcept
+{
+    return aHandle < theHandles.size() && theHandles[aHandle].theIsOpen;
+}
+} // namespace svm
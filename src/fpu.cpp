@@ -0,0 +1,926 @@
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "fpu.hpp"
+
+namespace svm
+{
+namespace
+{
+static_assert(std::numeric_limits<long double>::digits == 64 && std::endian::native == std::endian::little,
+              "registers are stored in the host's x87 extended format");
+
+constexpr std::size_t REAL80_SIZE = 10U;
+constexpr std::array<std::size_t, 7> OPERAND_SIZES{4U, 8U, 10U, 2U, 4U, 8U, 10U};
+constexpr std::uint16_t TOP_SHIFT = 11U;
+constexpr std::uint16_t TOP_MASK = 0x7U << TOP_SHIFT;
+constexpr std::uint16_t ROUNDING_SHIFT = 10U;
+constexpr std::uint16_t INTERRUPT_MASK = 1U << 7;
+constexpr std::uint16_t CONDITION_CODES = Fpu::C0 | Fpu::C1 | Fpu::C2 | Fpu::C3;
+constexpr long double BCD_LIMIT = 1e18L;
+
+constexpr std::array<long double, 7> CONSTANTS{1.0L,
+                                               3.321928094887362347870319429489390175864831393L,
+                                               1.442695040888963407359924681001892137426645954L,
+                                               3.141592653589793238462643383279502884197169399L,
+                                               0.301029995663981195213738894724493026768189881L,
+                                               0.693147180559945309417232121458176568075500134L,
+                                               0.0L};
+
+// Real indefinite, the quiet NaN every masked invalid operation produces
+long double indefinite() noexcept
+{
+    constexpr std::array<std::uint8_t, REAL80_SIZE> myBytes{0, 0, 0, 0, 0, 0, 0, 0xC0, 0xFF, 0xFF};
+    long double myValue{};
+    std::memcpy(&myValue, myBytes.data(), myBytes.size());
+    return myValue;
+}
+
+// Signaling NaNs have the top fraction bit clear, below the explicit integer bit
+bool isSignaling(long double aValue) noexcept
+{
+    if (!std::isnan(aValue))
+    {
+        return false;
+    }
+    std::uint64_t mySignificand{};
+    std::memcpy(&mySignificand, &aValue, sizeof(mySignificand));
+    return (mySignificand & (1ULL << 62)) == 0;
+}
+
+template <typename T> T load(std::span<const std::uint8_t> aBytes) noexcept
+{
+    T myValue{};
+    std::memcpy(&myValue, aBytes.data(), sizeof(T));
+    return myValue;
+}
+
+template <typename T> void store(std::span<std::uint8_t> aBytes, T aValue) noexcept
+{
+    std::memcpy(aBytes.data(), &aValue, sizeof(T));
+}
+
+// Nine bytes of two digits each, least significant first, then the sign in bit 7 of the tenth
+long double loadBcd(std::span<const std::uint8_t> aBytes) noexcept
+{
+    std::int64_t myValue{};
+    for (std::size_t i = 9; i-- > 0;)
+    {
+        myValue = myValue * 100 + (aBytes[i] >> 4) * 10 + (aBytes[i] & 0xF);
+    }
+    return (aBytes[9] & 0x80) != 0 ? -static_cast<long double>(myValue) : static_cast<long double>(myValue);
+}
+
+void storeBcd(std::span<std::uint8_t> aBytes, long double aValue) noexcept
+{
+    auto myValue = static_cast<std::uint64_t>(std::fabs(aValue));
+    for (std::size_t i{}; i < 9; ++i)
+    {
+        const auto myPair = myValue % 100;
+        aBytes[i] = static_cast<std::uint8_t>((myPair / 10) << 4 | myPair % 10);
+        myValue /= 100;
+    }
+    aBytes[9] = std::signbit(aValue) ? 0x80 : 0x00;
+}
+
+// Exceptions of a result the host computed from valid operands
+template <typename RealT> std::uint16_t resultExceptions(RealT aResult, bool aIsFromFinite) noexcept
+{
+    if (std::isnan(aResult))
+    {
+        return Fpu::InvalidOperation;
+    }
+    if (std::isinf(aResult) && aIsFromFinite)
+    {
+        return Fpu::Overflow;
+    }
+    if (std::fpclassify(aResult) == FP_SUBNORMAL)
+    {
+        return Fpu::Underflow;
+    }
+    return 0;
+}
+
+template <typename IntegerT> bool fitsInteger(long double aValue) noexcept
+{
+    return aValue >= static_cast<long double>(std::numeric_limits<IntegerT>::min()) &&
+           aValue < -static_cast<long double>(std::numeric_limits<IntegerT>::min());
+}
+} // namespace
+
+Fpu::Fpu(RandomAccessMemory &aMemory, CoreCounters &aCounters) : theMemory{aMemory}, theCounters{aCounters}
+{
+}
+
+Trap Fpu::FLD(arch::MemoryAddress aAddress, Format aFormat) noexcept
+{
+    const auto [myTrap, myValue] = readOperand(aAddress, aFormat);
+    if (myTrap != Trap::OK)
+    {
+        return myTrap;
+    }
+    push(myValue);
+    return Trap::OK;
+}
+
+Trap Fpu::FST(arch::MemoryAddress aAddress, Format aFormat, bool aPop) noexcept
+{
+    long double myValue{};
+    if (!operand(0, myValue))
+    {
+        return Trap::OK;
+    }
+
+    std::array<std::uint8_t, REAL80_SIZE> myBytes{};
+    std::uint16_t myExceptions{};
+    const auto myRounded = roundToInteger(myValue);
+    switch (aFormat)
+    {
+    case Format::Real32: {
+        const auto myResult = static_cast<float>(myValue);
+        myExceptions = std::isfinite(myValue) ? resultExceptions(myResult, true) : 0;
+        store(myBytes, myResult);
+        break;
+    }
+    case Format::Real64: {
+        const auto myResult = static_cast<double>(myValue);
+        myExceptions = std::isfinite(myValue) ? resultExceptions(myResult, true) : 0;
+        store(myBytes, myResult);
+        break;
+    }
+    case Format::Real80:
+        std::memcpy(myBytes.data(), &myValue, REAL80_SIZE);
+        break;
+    // Out of range and NaN store the integer indefinite, the most negative value
+    case Format::Int16:
+        myExceptions = fitsInteger<std::int16_t>(myRounded) ? 0 : InvalidOperation;
+        store(myBytes, myExceptions == 0 ? static_cast<std::int16_t>(myRounded)
+                                         : std::numeric_limits<std::int16_t>::min());
+        break;
+    case Format::Int32:
+        myExceptions = fitsInteger<std::int32_t>(myRounded) ? 0 : InvalidOperation;
+        store(myBytes, myExceptions == 0 ? static_cast<std::int32_t>(myRounded)
+                                         : std::numeric_limits<std::int32_t>::min());
+        break;
+    case Format::Int64:
+        myExceptions = fitsInteger<std::int64_t>(myRounded) ? 0 : InvalidOperation;
+        store(myBytes, myExceptions == 0 ? static_cast<std::int64_t>(myRounded)
+                                         : std::numeric_limits<std::int64_t>::min());
+        break;
+    case Format::Bcd80:
+        if (std::fabs(myRounded) < BCD_LIMIT)
+        {
+            storeBcd(myBytes, myRounded);
+        }
+        else
+        {
+            myExceptions = InvalidOperation;
+            myBytes[7] = 0xC0;
+            myBytes[8] = 0xFF;
+            myBytes[9] = 0xFF;
+        }
+        break;
+    }
+    if (!raise(myExceptions) && (myExceptions & InvalidOperation) != 0)
+    {
+        return Trap::OK;
+    }
+
+    const auto mySize = OPERAND_SIZES[std::to_underlying(aFormat)];
+    if (const auto myTrap = theMemory.writeBlock(aAddress, std::span{myBytes}.first(mySize)); myTrap != Trap::OK)
+    {
+        return myTrap;
+    }
+    if (aPop)
+    {
+        pop();
+    }
+    return Trap::OK;
+}
+
+Trap Fpu::arithmetic(Arith aArith, arch::MemoryAddress aAddress, Format aFormat) noexcept
+{
+    const auto [myTrap, mySource] = readOperand(aAddress, aFormat);
+    if (myTrap != Trap::OK)
+    {
+        return myTrap;
+    }
+    long double myValue{};
+    if (operand(0, myValue))
+    {
+        combine(aArith, 0, myValue, mySource);
+    }
+    return Trap::OK;
+}
+
+Trap Fpu::FLDCW(arch::MemoryAddress aAddress) noexcept
+{
+    counters::add(theCounters.theMemoryReads[std::to_underlying(arch::OperandSize::Word)]);
+    const auto [myTrap, myValue] = theMemory.read(aAddress);
+    if (myTrap == Trap::OK)
+    {
+        theControl = myValue;
+    }
+    return myTrap;
+}
+
+Trap Fpu::FSTCW(arch::MemoryAddress aAddress) noexcept
+{
+    counters::add(theCounters.theMemoryWrites[std::to_underlying(arch::OperandSize::Word)]);
+    return theMemory.write(aAddress, theControl);
+}
+
+Trap Fpu::FSTSW(arch::MemoryAddress aAddress) noexcept
+{
+    counters::add(theCounters.theMemoryWrites[std::to_underlying(arch::OperandSize::Word)]);
+    return theMemory.write(aAddress, theStatus);
+}
+
+Trap Fpu::FLDENV(arch::MemoryAddress aAddress) noexcept
+{
+    std::array<std::uint8_t, EnvironmentSize> myEnvironment{};
+    const auto myTrap = theMemory.readBlock(aAddress, myEnvironment);
+    if (myTrap == Trap::OK)
+    {
+        restoreEnvironment(myEnvironment);
+    }
+    return myTrap;
+}
+
+Trap Fpu::FSTENV(arch::MemoryAddress aAddress) noexcept
+{
+    std::array<std::uint8_t, EnvironmentSize> myEnvironment{};
+    saveEnvironment(myEnvironment);
+    return theMemory.writeBlock(aAddress, myEnvironment);
+}
+
+Trap Fpu::FRSTOR(arch::MemoryAddress aAddress) noexcept
+{
+    std::array<std::uint8_t, StateSize> myState{};
+    const auto myTrap = theMemory.readBlock(aAddress, myState);
+    if (myTrap == Trap::OK)
+    {
+        restoreState(myState);
+    }
+    return myTrap;
+}
+
+Trap Fpu::FSAVE(arch::MemoryAddress aAddress) noexcept
+{
+    std::array<std::uint8_t, StateSize> myState{};
+    saveState(myState);
+    const auto myTrap = theMemory.writeBlock(aAddress, myState);
+    if (myTrap == Trap::OK)
+    {
+        FINIT();
+    }
+    return myTrap;
+}
+
+Trap Fpu::arithmetic(Arith aArith, std::uint8_t aIndex, bool aToIndex, bool aPop) noexcept
+{
+    long double myTop{};
+    long double myOther{};
+    if (operands(0, aIndex, myTop, myOther))
+    {
+        if (aToIndex)
+        {
+            combine(aArith, aIndex, myOther, myTop);
+        }
+        else
+        {
+            combine(aArith, 0, myTop, myOther);
+        }
+    }
+    if (aPop)
+    {
+        pop();
+    }
+    return Trap::OK;
+}
+
+Trap Fpu::FLD(std::uint8_t aIndex) noexcept
+{
+    long double myValue{};
+    if (operand(aIndex, myValue))
+    {
+        push(myValue);
+    }
+    return Trap::OK;
+}
+
+Trap Fpu::FST(std::uint8_t aIndex, bool aPop) noexcept
+{
+    long double myValue{};
+    if (operand(0, myValue))
+    {
+        st(aIndex) = myValue;
+        setValid(aIndex);
+        if (aPop)
+        {
+            pop();
+        }
+    }
+    return Trap::OK;
+}
+
+Trap Fpu::FXCH(std::uint8_t aIndex) noexcept
+{
+    long double myTop{};
+    long double myOther{};
+    if (operands(0, aIndex, myTop, myOther))
+    {
+        st(0) = myOther;
+        st(aIndex) = myTop;
+        setValid(0);
+        setValid(aIndex);
+    }
+    return Trap::OK;
+}
+
+Trap Fpu::FFREE(std::uint8_t aIndex) noexcept
+{
+    theEmpty |= static_cast<std::uint8_t>(1U << physical(aIndex));
+    return Trap::OK;
+}
+
+Trap Fpu::FLD(Constant aConstant) noexcept
+{
+    push(CONSTANTS[std::to_underlying(aConstant)]);
+    return Trap::OK;
+}
+
+Trap Fpu::F2XM1(void) noexcept
+{
+    long double myValue{};
+    if (operand(0, myValue))
+    {
+        replace(0, std::expm1(myValue * CONSTANTS[std::to_underlying(Constant::LnTwo)]), 0);
+    }
+    return Trap::OK;
+}
+
+Trap Fpu::FABS(void) noexcept
+{
+    long double myValue{};
+    if (operand(0, myValue))
+    {
+        replace(0, std::fabs(myValue), 0);
+    }
+    return Trap::OK;
+}
+
+Trap Fpu::FCHS(void) noexcept
+{
+    long double myValue{};
+    if (operand(0, myValue))
+    {
+        replace(0, -myValue, 0);
+    }
+    return Trap::OK;
+}
+
+Trap Fpu::FCLEX(void) noexcept
+{
+    theStatus &= static_cast<std::uint16_t>(~(Exceptions | ErrorSummary | Busy));
+    return Trap::OK;
+}
+
+Trap Fpu::FCOMPP(void) noexcept
+{
+    long double myTop{};
+    long double myOther{};
+    if (operands(0, 1, myTop, myOther))
+    {
+        compare(myTop, myOther);
+    }
+    pop();
+    pop();
+    return Trap::OK;
+}
+
+Trap Fpu::FDECSTP(void) noexcept
+{
+    setTop(top() - 1U);
+    return Trap::OK;
+}
+
+Trap Fpu::FDISI(void) noexcept
+{
+    theControl |= INTERRUPT_MASK;
+    return Trap::OK;
+}
+
+Trap Fpu::FENI(void) noexcept
+{
+    theControl &= static_cast<std::uint16_t>(~INTERRUPT_MASK);
+    return Trap::OK;
+}
+
+Trap Fpu::FINCSTP(void) noexcept
+{
+    setTop(top() + 1U);
+    return Trap::OK;
+}
+
+Trap Fpu::FINIT(void) noexcept
+{
+    theControl = DefaultControl;
+    theStatus = 0;
+    theEmpty = 0xFFU;
+    return Trap::OK;
+}
+
+Trap Fpu::FNOP(void) noexcept
+{
+    return Trap::OK;
+}
+
+Trap Fpu::FPATAN(void) noexcept
+{
+    long double myX{};
+    long double myY{};
+    if (operands(0, 1, myX, myY))
+    {
+        replace(1, std::atan2(myY, myX), 0);
+    }
+    pop();
+    return Trap::OK;
+}
+
+// The remainder is exact in one step, the 8087's partial reduction of far apart exponents is not modelled. C0, C3
+// and C1 get quotient bits 2, 1 and 0, C2 clear reports the reduction complete.
+Trap Fpu::FPREM(void) noexcept
+{
+    long double myDividend{};
+    long double myDivisor{};
+    if (!operands(0, 1, myDividend, myDivisor))
+    {
+        return Trap::OK;
+    }
+    if (std::isnan(myDividend) || std::isnan(myDivisor))
+    {
+        replace(0, myDividend + myDivisor, isSignaling(myDividend) || isSignaling(myDivisor) ? InvalidOperation : 0);
+        return Trap::OK;
+    }
+    if (myDivisor == 0 || std::isinf(myDividend))
+    {
+        replace(0, indefinite(), InvalidOperation);
+        return Trap::OK;
+    }
+
+    const auto myRemainder = std::fmod(myDividend, myDivisor);
+    const auto myQuotient = std::fabs(std::trunc((myDividend - myRemainder) / myDivisor));
+    const auto myBits = myQuotient < 8.0L ? static_cast<unsigned>(myQuotient)
+                                          : static_cast<unsigned>(std::fmod(myQuotient, 8.0L));
+    theStatus &= static_cast<std::uint16_t>(~CONDITION_CODES);
+    theStatus |= ((myBits & 4U) != 0 ? C0 : 0) | ((myBits & 2U) != 0 ? C3 : 0) | ((myBits & 1U) != 0 ? C1 : 0);
+    replace(0, myRemainder, 0);
+    return Trap::OK;
+}
+
+// The ratio pushed is tan(x) over one
+Trap Fpu::FPTAN(void) noexcept
+{
+    long double myValue{};
+    if (operand(0, myValue))
+    {
+        replace(0, std::tan(myValue), std::isinf(myValue) ? InvalidOperation : 0);
+        push(1.0L);
+    }
+    return Trap::OK;
+}
+
+Trap Fpu::FRNDINT(void) noexcept
+{
+    long double myValue{};
+    if (operand(0, myValue))
+    {
+        replace(0, roundToInteger(myValue), 0);
+    }
+    return Trap::OK;
+}
+
+Trap Fpu::FSCALE(void) noexcept
+{
+    long double myValue{};
+    long double myScale{};
+    if (operands(0, 1, myValue, myScale))
+    {
+        const auto myExponent = std::clamp(std::trunc(myScale), -65536.0L, 65536.0L);
+        const auto myResult = std::scalbn(myValue, std::isnan(myExponent) ? 0 : static_cast<int>(myExponent));
+        replace(0, std::isnan(myScale) ? myScale : myResult,
+                std::isnan(myScale) ? 0 : resultExceptions(myResult, std::isfinite(myValue)));
+    }
+    return Trap::OK;
+}
+
+Trap Fpu::FSQRT(void) noexcept
+{
+    long double myValue{};
+    if (operand(0, myValue))
+    {
+        const auto myIsInvalid = myValue < 0 || isSignaling(myValue);
+        replace(0, myIsInvalid ? indefinite() : std::sqrt(myValue), myIsInvalid ? InvalidOperation : 0);
+    }
+    return Trap::OK;
+}
+
+Trap Fpu::FTST(void) noexcept
+{
+    long double myValue{};
+    if (operand(0, myValue))
+    {
+        compare(myValue, 0.0L);
+    }
+    return Trap::OK;
+}
+
+// C3, C2 and C0 give the class, C1 the sign
+Trap Fpu::FXAM(void) noexcept
+{
+    const auto myValue = st(0);
+    std::uint16_t myCodes = std::signbit(myValue) ? C1 : 0;
+    if (isEmpty(0))
+    {
+        myCodes |= C3 | C0;
+    }
+    else
+    {
+        switch (std::fpclassify(myValue))
+        {
+        case FP_NAN:
+            myCodes |= C0;
+            break;
+        case FP_INFINITE:
+            myCodes |= C2 | C0;
+            break;
+        case FP_ZERO:
+            myCodes |= C3;
+            break;
+        case FP_SUBNORMAL:
+            myCodes |= C3 | C2;
+            break;
+        default:
+            myCodes |= C2;
+            break;
+        }
+    }
+    theStatus = static_cast<std::uint16_t>((theStatus & ~CONDITION_CODES) | myCodes);
+    return Trap::OK;
+}
+
+// ST(0) becomes the unbiased exponent, then the significand scaled to [1, 2) is pushed
+Trap Fpu::FXTRACT(void) noexcept
+{
+    long double myValue{};
+    if (!operand(0, myValue))
+    {
+        return Trap::OK;
+    }
+    if (myValue == 0)
+    {
+        replace(0, -std::numeric_limits<long double>::infinity(), ZeroDivide);
+        push(myValue);
+        return Trap::OK;
+    }
+    const auto myIsFinite = std::isfinite(myValue);
+    replace(0, myIsFinite ? std::logb(myValue) : myValue, 0);
+    push(myIsFinite ? std::scalbn(myValue, -std::ilogb(myValue)) : myValue);
+    return Trap::OK;
+}
+
+Trap Fpu::FYL2X(void) noexcept
+{
+    long double myX{};
+    long double myY{};
+    if (operands(0, 1, myX, myY))
+    {
+        std::uint16_t myExceptions{};
+        if (myX < 0)
+        {
+            myExceptions = InvalidOperation;
+        }
+        else if (myX == 0 && myY != 0 && !std::isnan(myY))
+        {
+            myExceptions = ZeroDivide;
+        }
+        replace(1, myExceptions == InvalidOperation ? indefinite() : myY * std::log2(myX), myExceptions);
+    }
+    pop();
+    return Trap::OK;
+}
+
+Trap Fpu::FYL2XP1(void) noexcept
+{
+    long double myX{};
+    long double myY{};
+    if (operands(0, 1, myX, myY))
+    {
+        const auto myIsInvalid = myX < -1.0L;
+        replace(1, myIsInvalid ? indefinite() : myY * std::log1p(myX) / CONSTANTS[std::to_underlying(Constant::LnTwo)],
+                myIsInvalid ? InvalidOperation : 0);
+    }
+    pop();
+    return Trap::OK;
+}
+
+void Fpu::saveState(std::span<std::uint8_t, StateSize> aState) const noexcept
+{
+    saveEnvironment(aState.first<EnvironmentSize>());
+    for (std::uint8_t i{}; i < theRegisters.size(); ++i)
+    {
+        std::memcpy(aState.data() + EnvironmentSize + i * REAL80_SIZE, &theRegisters[physical(i)], REAL80_SIZE);
+    }
+}
+
+void Fpu::restoreState(std::span<const std::uint8_t, StateSize> aState) noexcept
+{
+    restoreEnvironment(aState.first<EnvironmentSize>());
+    for (std::uint8_t i{}; i < theRegisters.size(); ++i)
+    {
+        auto &myRegister = theRegisters[physical(i)];
+        myRegister = 0.0L;
+        std::memcpy(&myRegister, aState.data() + EnvironmentSize + i * REAL80_SIZE, REAL80_SIZE);
+    }
+}
+
+std::uint16_t Fpu::control() const noexcept
+{
+    return theControl;
+}
+
+std::uint16_t Fpu::status() const noexcept
+{
+    return theStatus;
+}
+
+// Two bits per physical register: valid, zero, special or empty
+std::uint16_t Fpu::tags() const noexcept
+{
+    std::uint16_t myTags{};
+    for (std::size_t i{}; i < theRegisters.size(); ++i)
+    {
+        std::uint16_t myTag = 2;
+        if ((theEmpty & (1U << i)) != 0)
+        {
+            myTag = 3;
+        }
+        else if (theRegisters[i] == 0)
+        {
+            myTag = 1;
+        }
+        else if (std::isnormal(theRegisters[i]))
+        {
+            myTag = 0;
+        }
+        myTags |= static_cast<std::uint16_t>(myTag << (2 * i));
+    }
+    return myTags;
+}
+
+long double Fpu::read(std::uint8_t aIndex) const noexcept
+{
+    return isEmpty(aIndex) ? indefinite() : theRegisters[physical(aIndex)];
+}
+
+std::uint8_t Fpu::top() const noexcept
+{
+    return static_cast<std::uint8_t>((theStatus & TOP_MASK) >> TOP_SHIFT);
+}
+
+void Fpu::setTop(std::uint8_t aTop) noexcept
+{
+    theStatus = static_cast<std::uint16_t>((theStatus & ~TOP_MASK) | ((aTop & 0x7U) << TOP_SHIFT));
+}
+
+std::uint8_t Fpu::physical(std::uint8_t aIndex) const noexcept
+{
+    return static_cast<std::uint8_t>((top() + aIndex) & 0x7U);
+}
+
+bool Fpu::isEmpty(std::uint8_t aIndex) const noexcept
+{
+    return (theEmpty & (1U << physical(aIndex))) != 0;
+}
+
+long double &Fpu::st(std::uint8_t aIndex) noexcept
+{
+    return theRegisters[physical(aIndex)];
+}
+
+void Fpu::setValid(std::uint8_t aIndex) noexcept
+{
+    theEmpty &= static_cast<std::uint8_t>(~(1U << physical(aIndex)));
+}
+
+// Records aExceptions, true when all of them are masked and the instruction goes on with the masked response
+bool Fpu::raise(std::uint16_t aExceptions) noexcept
+{
+    theStatus |= aExceptions;
+    if ((aExceptions & ~theControl & Exceptions) != 0)
+    {
+        theStatus |= ErrorSummary | Busy;
+        return false;
+    }
+    return true;
+}
+
+// Reading an empty register is a stack underflow, masked it reads as the indefinite
+bool Fpu::operand(std::uint8_t aIndex, long double &aValue) noexcept
+{
+    if (!isEmpty(aIndex))
+    {
+        aValue = st(aIndex);
+        return true;
+    }
+    aValue = indefinite();
+    return raise(InvalidOperation);
+}
+
+bool Fpu::operands(std::uint8_t aFirst, std::uint8_t aSecond, long double &aFirstValue,
+                   long double &aSecondValue) noexcept
+{
+    const auto myFirst = operand(aFirst, aFirstValue);
+    return operand(aSecond, aSecondValue) && myFirst;
+}
+
+// Pushing onto a full stack is a stack overflow, masked it pushes the indefinite
+void Fpu::push(long double aValue) noexcept
+{
+    const auto myTop = static_cast<std::uint8_t>((top() - 1U) & 0x7U);
+    if ((theEmpty & (1U << myTop)) == 0)
+    {
+        if (!raise(InvalidOperation))
+        {
+            return;
+        }
+        aValue = indefinite();
+    }
+    setTop(myTop);
+    st(0) = aValue;
+    setValid(0);
+}
+
+void Fpu::pop() noexcept
+{
+    theEmpty |= static_cast<std::uint8_t>(1U << top());
+    setTop(top() + 1U);
+}
+
+// Unmasked invalid operations and zero divides keep the old value
+void Fpu::replace(std::uint8_t aIndex, long double aValue, std::uint16_t aExceptions) noexcept
+{
+    if (!raise(aExceptions) && (aExceptions & (InvalidOperation | ZeroDivide)) != 0)
+    {
+        return;
+    }
+    st(aIndex) = aValue;
+    setValid(aIndex);
+}
+
+void Fpu::compare(long double aFirst, long double aSecond) noexcept
+{
+    std::uint16_t myCodes{};
+    if (std::isnan(aFirst) || std::isnan(aSecond))
+    {
+        raise(InvalidOperation);
+        myCodes = C3 | C2 | C0;
+    }
+    else if (aFirst < aSecond)
+    {
+        myCodes = C0;
+    }
+    else if (aFirst == aSecond)
+    {
+        myCodes = C3;
+    }
+    theStatus = static_cast<std::uint16_t>((theStatus & ~CONDITION_CODES) | myCodes);
+}
+
+void Fpu::combine(Arith aArith, std::uint8_t aDestination, long double aDestinationValue,
+                  long double aSource) noexcept
+{
+    long double myResult{};
+    switch (aArith)
+    {
+    case Arith::Com:
+    case Arith::ComPop:
+        compare(aDestinationValue, aSource);
+        if (aArith == Arith::ComPop)
+        {
+            pop();
+        }
+        return;
+    case Arith::Add:
+        myResult = aDestinationValue + aSource;
+        break;
+    case Arith::Mul:
+        myResult = aDestinationValue * aSource;
+        break;
+    case Arith::Sub:
+        myResult = aDestinationValue - aSource;
+        break;
+    case Arith::SubR:
+        myResult = aSource - aDestinationValue;
+        break;
+    case Arith::Div:
+        myResult = aDestinationValue / aSource;
+        break;
+    case Arith::DivR:
+        myResult = aSource / aDestinationValue;
+        break;
+    }
+
+    std::uint16_t myExceptions{};
+    if (std::isnan(aDestinationValue) || std::isnan(aSource))
+    {
+        myExceptions = isSignaling(aDestinationValue) || isSignaling(aSource) ? InvalidOperation : 0;
+    }
+    else if (std::isinf(myResult) && ((aArith == Arith::Div && aSource == 0 && std::isfinite(aDestinationValue)) ||
+                                      (aArith == Arith::DivR && aDestinationValue == 0 && std::isfinite(aSource))))
+    {
+        myExceptions = ZeroDivide;
+    }
+    else
+    {
+        myExceptions = resultExceptions(myResult, std::isfinite(aDestinationValue) && std::isfinite(aSource));
+    }
+    replace(aDestination, myResult, myExceptions);
+}
+
+long double Fpu::roundToInteger(long double aValue) const noexcept
+{
+    switch ((theControl >> ROUNDING_SHIFT) & 0x3U)
+    {
+    case 1:
+        return std::floor(aValue);
+    case 2:
+        return std::ceil(aValue);
+    case 3:
+        return std::trunc(aValue);
+    default:
+        // Nearest even, the host rounding mode is never changed
+        return std::nearbyint(aValue);
+    }
+}
+
+std::pair<Trap, long double> Fpu::readOperand(arch::MemoryAddress aAddress, Format aFormat) noexcept
+{
+    std::array<std::uint8_t, REAL80_SIZE> myBytes{};
+    const auto myTrap =
+        theMemory.readBlock(aAddress, std::span{myBytes}.first(OPERAND_SIZES[std::to_underlying(aFormat)]));
+    if (myTrap != Trap::OK)
+    {
+        return {myTrap, 0.0L};
+    }
+    switch (aFormat)
+    {
+    case Format::Real32:
+        return {Trap::OK, load<float>(myBytes)};
+    case Format::Real64:
+        return {Trap::OK, load<double>(myBytes)};
+    case Format::Real80: {
+        long double myValue{};
+        std::memcpy(&myValue, myBytes.data(), REAL80_SIZE);
+        return {Trap::OK, myValue};
+    }
+    case Format::Int16:
+        return {Trap::OK, load<std::int16_t>(myBytes)};
+    case Format::Int32:
+        return {Trap::OK, load<std::int32_t>(myBytes)};
+    case Format::Int64:
+        return {Trap::OK, static_cast<long double>(load<std::int64_t>(myBytes))};
+    case Format::Bcd80:
+        return {Trap::OK, loadBcd(myBytes)};
+    }
+    return {Trap::OK, 0.0L};
+}
+
+// Control, status and tag words, then the instruction and operand pointers left zero
+void Fpu::saveEnvironment(std::span<std::uint8_t, EnvironmentSize> aEnvironment) const noexcept
+{
+    std::ranges::fill(aEnvironment, 0);
+    store(aEnvironment, theControl);
+    store(aEnvironment.subspan<2>(), theStatus);
+    store(aEnvironment.subspan<4>(), tags());
+}
+
+void Fpu::restoreEnvironment(std::span<const std::uint8_t, EnvironmentSize> aEnvironment) noexcept
+{
+    theControl = load<std::uint16_t>(aEnvironment);
+    theStatus = load<std::uint16_t>(aEnvironment.subspan<2>());
+    const auto myTags = load<std::uint16_t>(aEnvironment.subspan<4>());
+    theEmpty = 0;
+    for (std::size_t i{}; i < theRegisters.size(); ++i)
+    {
+        if (((myTags >> (2 * i)) & 0x3U) == 0x3U)
+        {
+            theEmpty |= static_cast<std::uint8_t>(1U << i);
+        }
+    }
+}
+} // namespace svm
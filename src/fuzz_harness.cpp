@@ -0,0 +1,74 @@
+#include <algorithm>
+#include <utility>
+
+#include "fuzz_harness.hpp"
+
+namespace svm
+{
+FuzzHarness::FuzzHarness(SingleCore &aCore, RandomAccessMemory &aMemory, std::span<std::uint8_t> aCoverage,
+                         std::uint32_t aInputAddress, std::size_t aMaxInputSize, std::size_t aBudget)
+    : theCore{aCore}, theMemory{aMemory}, theCoverage{aCoverage}, theInputAddress{aInputAddress},
+      theMaxInputSize{aMaxInputSize}, theBudget{aBudget}
+{
+}
+
+void FuzzHarness::prepare()
+{
+    for (std::size_t i{}; i < theRegisters.size(); ++i)
+    {
+        theRegisters[i] = theCore.readRegister(static_cast<arch::Regs>(i));
+    }
+    theCore.fpu().saveState(theFpuState);
+    theMemory.takeSnapshot();
+}
+
+void FuzzHarness::attachInputDevice(InputDevice aDevice)
+{
+    theInputDevice = std::move(aDevice);
+}
+
+Trap FuzzHarness::execute(std::span<const std::uint8_t> aInput) noexcept
+{
+    theRestoredPages = theMemory.restoreSnapshot();
+    for (std::size_t i{}; i < theRegisters.size(); ++i)
+    {
+        theCore.writeRegister(static_cast<arch::Regs>(i), theRegisters[i]);
+    }
+    theCore.fpu().restoreState(theFpuState);
+    theCore.clearPendingInterrupts();
+    theCore.attachCoverage(theCoverage);
+
+    const auto myInput = aInput.first(std::min(aInput.size(), theMaxInputSize));
+    if (theInputDevice)
+    {
+        theInputDevice(myInput);
+    }
+    else
+    {
+        const auto myLength = static_cast<arch::Immediate>(myInput.size());
+        const arch::MemoryAddress myData{.theAddress = theInputAddress.theAddress + 2U};
+        if (theMemory.write(theInputAddress, myLength) != Trap::OK ||
+            theMemory.writeBlock(myData, myInput) != Trap::OK)
+        {
+            return Trap::SEG_FAULT;
+        }
+    }
+    ++theExecutions;
+    return theCore.run(theBudget);
+}
+
+bool FuzzHarness::isCrash(Trap aTrap) noexcept
+{
+    return aTrap == Trap::ILLEGAL || aTrap == Trap::SEG_FAULT || aTrap == Trap::MEM_FAULT;
+}
+
+std::uint64_t FuzzHarness::executions() const noexcept
+{
+    return theExecutions;
+}
+
+std::size_t FuzzHarness::restoredPages() const noexcept
+{
+    return theRestoredPages;
+}
+} // namespace svm
@@ -0,0 +1,889 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <tuple>
+#include <utility>
+
+#include "arch.hpp"
+#include "graphics_video.hpp"
+#include "trace.hpp"
+
+namespace svm
+{
+namespace
+{
+#if defined(__x86_64__)
+// Variable byte shuffles need SSSE3, the AVX2 clone gets the VEX forms and the default one falls back to SSE2 code
+#define SVM_SHUFFLE_KERNEL [[gnu::target_clones("avx2", "ssse3", "default")]]
+#else
+#define SVM_SHUFFLE_KERNEL
+#endif
+
+using Bytes = std::uint8_t __attribute__((vector_size(16)));
+using Palette = std::array<std::uint32_t, 16>;
+
+constexpr std::size_t LANES = sizeof(Bytes);
+constexpr std::size_t CGA_BYTES_PER_LINE = 80U;
+constexpr std::size_t CGA_LINES_PER_BANK = 100U;
+constexpr std::size_t WINDOW_PAGES = GraphicsAdapter::PlaneSize / RandomAccessMemory::PageSize;
+
+// Lanes 0-7 of both operands interleaved, then lanes 8-15
+constexpr Bytes LOW_BYTES{0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23};
+constexpr Bytes HIGH_BYTES{8, 24, 9, 25, 10, 26, 11, 27, 12, 28, 13, 29, 14, 30, 15, 31};
+// The same for byte pairs
+constexpr Bytes LOW_PAIRS{0, 1, 16, 17, 2, 3, 18, 19, 4, 5, 20, 21, 6, 7, 22, 23};
+constexpr Bytes HIGH_PAIRS{8, 9, 24, 25, 10, 11, 26, 27, 12, 13, 28, 29, 14, 15, 30, 31};
+// Each pixel's bit within its byte, leftmost pixel first
+constexpr Bytes PIXEL_BITS{0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+                           0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01};
+
+enum Port : std::uint16_t
+{
+    AttributeController = 0x3C0U,
+    SequencerIndex = 0x3C4U,
+    SequencerData = 0x3C5U,
+    GraphicsIndex = 0x3CEU,
+    GraphicsData = 0x3CFU,
+    CgaModeControl = 0x3D8U,
+    CgaColorSelect = 0x3D9U,
+    InputStatus = 0x3DAU,
+};
+
+enum Function : std::uint8_t
+{
+    SetMode = 0x00U,
+    SetCgaPalette = 0x0BU,
+    GetMode = 0x0FU,
+    SetEgaPalette = 0x10U,
+};
+
+constexpr std::uint8_t MAP_MASK = 0x02U;
+constexpr std::uint8_t READ_MAP_SELECT = 0x04U;
+constexpr std::uint8_t CGA_GRAPHICS = 1U << 1;
+constexpr std::uint8_t CGA_HIGH_RESOLUTION = 1U << 4;
+constexpr std::uint8_t CGA_PALETTE_SET = 1U << 5;
+constexpr std::uint8_t CGA_INTENSITY = 1U << 4;
+constexpr std::uint8_t KEEP_MEMORY = 0x80U;
+// Display enable and vertical retrace of the input status register
+constexpr std::uint8_t RETRACE = 0x09U;
+
+constexpr std::uint32_t rgba(std::uint32_t aRed, std::uint32_t aGreen, std::uint32_t aBlue) noexcept
+{
+    return aRed | (aGreen << 8) | (aBlue << 16) | 0xFF000000U;
+}
+
+// The sixteen CGA colours, dark yellow turned brown as the IBM monitor did
+constexpr std::uint32_t rgbi(std::size_t aColor) noexcept
+{
+    const std::uint32_t myBright = (aColor & 8U) != 0 ? 0x55U : 0U;
+    const auto myLevel = [&](std::size_t aBit) { return ((aColor & aBit) != 0 ? 0xAAU : 0U) + myBright; };
+    return rgba(myLevel(4U), aColor == 6U ? 0x55U : myLevel(2U), myLevel(1U));
+}
+
+// rgbRGB, the secondary bits adding a third of full intensity
+constexpr std::uint32_t egaColor(std::uint8_t aValue) noexcept
+{
+    const auto myLevel = [&](unsigned aPrimary, unsigned aSecondary) {
+        return ((aValue >> aPrimary) & 1U) * 0xAAU + ((aValue >> aSecondary) & 1U) * 0x55U;
+    };
+    return rgba(myLevel(2, 5), myLevel(1, 4), myLevel(0, 3));
+}
+
+// The palette registers as set by the BIOS, the 200 line modes drive a CGA monitor and read bit 4 as intensity
+constexpr std::array<std::uint8_t, 16> RGBI_ATTRIBUTES{0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+                                                       0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17};
+constexpr std::array<std::uint8_t, 16> EGA_ATTRIBUTES{0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x14, 0x07,
+                                                      0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F};
+
+// Shuffle mask repeating byte aFirst over eight lanes, then the byte after it over the other eight
+constexpr Bytes spread(std::uint8_t aFirst) noexcept
+{
+    Bytes mySpread{};
+    for (std::size_t i{}; i < LANES; ++i)
+    {
+        mySpread[i] = static_cast<std::uint8_t>(aFirst + i / 8);
+    }
+    return mySpread;
+}
+
+void load(Bytes &aBytes, const std::uint8_t *aSource) noexcept
+{
+    std::memcpy(&aBytes, aSource, sizeof(Bytes));
+}
+
+void store(std::uint8_t *aDestination, const Bytes &aBytes) noexcept
+{
+    std::memcpy(aDestination, &aBytes, sizeof(Bytes));
+}
+
+// Four pixels per byte, leftmost in the top two bits
+SVM_SHUFFLE_KERNEL
+void unpackPairs(const std::uint8_t *aBytes, std::size_t aCount, std::uint8_t *aIndexes) noexcept
+{
+    std::size_t i{};
+    for (; i + LANES <= aCount; i += LANES)
+    {
+        Bytes myBytes;
+        load(myBytes, aBytes + i);
+        const Bytes myFirst = myBytes >> 6;
+        const Bytes mySecond = (myBytes >> 4) & 3;
+        const Bytes myThird = (myBytes >> 2) & 3;
+        const Bytes myFourth = myBytes & 3;
+        const Bytes myLowFront = __builtin_shuffle(myFirst, mySecond, LOW_BYTES);
+        const Bytes myHighFront = __builtin_shuffle(myFirst, mySecond, HIGH_BYTES);
+        const Bytes myLowBack = __builtin_shuffle(myThird, myFourth, LOW_BYTES);
+        const Bytes myHighBack = __builtin_shuffle(myThird, myFourth, HIGH_BYTES);
+        auto *myOut = aIndexes + i * 4;
+        store(myOut, __builtin_shuffle(myLowFront, myLowBack, LOW_PAIRS));
+        store(myOut + LANES, __builtin_shuffle(myLowFront, myLowBack, HIGH_PAIRS));
+        store(myOut + 2 * LANES, __builtin_shuffle(myHighFront, myHighBack, LOW_PAIRS));
+        store(myOut + 3 * LANES, __builtin_shuffle(myHighFront, myHighBack, HIGH_PAIRS));
+    }
+    for (; i < aCount; ++i)
+    {
+        for (std::size_t j{}; j < 4; ++j)
+        {
+            aIndexes[i * 4 + j] = static_cast<std::uint8_t>((aBytes[i] >> (6 - 2 * j)) & 3U);
+        }
+    }
+}
+
+// Eight pixels per byte of each plane, leftmost in bit 7, plane p giving bit p of the index
+SVM_SHUFFLE_KERNEL
+void unpackPlanes(std::span<const std::uint8_t *const> aPlanes, std::size_t aCount, std::uint8_t *aIndexes) noexcept
+{
+    std::size_t i{};
+    for (; i + LANES <= aCount; i += LANES)
+    {
+        std::array<Bytes, LANES / 2> myIndexes{};
+        for (std::size_t myPlane{}; myPlane < aPlanes.size(); ++myPlane)
+        {
+            Bytes myBytes;
+            load(myBytes, aPlanes[myPlane] + i);
+            const auto myWeight = static_cast<std::uint8_t>(1U << myPlane);
+            for (std::size_t j{}; j < myIndexes.size(); ++j)
+            {
+                const Bytes mySpread = __builtin_shuffle(myBytes, spread(static_cast<std::uint8_t>(2 * j)));
+                myIndexes[j] |= static_cast<Bytes>((mySpread & PIXEL_BITS) != 0) & myWeight;
+            }
+        }
+        for (std::size_t j{}; j < myIndexes.size(); ++j)
+        {
+            store(aIndexes + i * 8 + j * LANES, myIndexes[j]);
+        }
+    }
+    for (; i < aCount; ++i)
+    {
+        for (std::size_t j{}; j < 8; ++j)
+        {
+            std::uint8_t myIndex{};
+            for (std::size_t myPlane{}; myPlane < aPlanes.size(); ++myPlane)
+            {
+                myIndex |= static_cast<std::uint8_t>(((aPlanes[myPlane][i] >> (7 - j)) & 1U) << myPlane);
+            }
+            aIndexes[i * 8 + j] = myIndex;
+        }
+    }
+}
+
+// One shuffle per channel looks sixteen pixels up at once, the channels are then interleaved into RGBA
+SVM_SHUFFLE_KERNEL
+void expandPalette(const std::uint8_t *aIndexes, std::size_t aCount, const Palette &aPalette,
+                   std::uint8_t *aPixels) noexcept
+{
+    std::array<Bytes, GraphicsAdapter::BytesPerPixel> myChannels{};
+    for (std::size_t myChannel{}; myChannel < myChannels.size(); ++myChannel)
+    {
+        for (std::size_t myColor{}; myColor < aPalette.size(); ++myColor)
+        {
+            myChannels[myChannel][myColor] = static_cast<std::uint8_t>(aPalette[myColor] >> (8 * myChannel));
+        }
+    }
+
+    std::size_t i{};
+    for (; i + LANES <= aCount; i += LANES)
+    {
+        Bytes myIndexes;
+        load(myIndexes, aIndexes + i);
+        myIndexes &= 0x0F;
+        const Bytes myRed = __builtin_shuffle(myChannels[0], myIndexes);
+        const Bytes myGreen = __builtin_shuffle(myChannels[1], myIndexes);
+        const Bytes myBlue = __builtin_shuffle(myChannels[2], myIndexes);
+        const Bytes myAlpha = __builtin_shuffle(myChannels[3], myIndexes);
+        const Bytes myLowRg = __builtin_shuffle(myRed, myGreen, LOW_BYTES);
+        const Bytes myHighRg = __builtin_shuffle(myRed, myGreen, HIGH_BYTES);
+        const Bytes myLowBa = __builtin_shuffle(myBlue, myAlpha, LOW_BYTES);
+        const Bytes myHighBa = __builtin_shuffle(myBlue, myAlpha, HIGH_BYTES);
+        auto *myOut = aPixels + i * GraphicsAdapter::BytesPerPixel;
+        store(myOut, __builtin_shuffle(myLowRg, myLowBa, LOW_PAIRS));
+        store(myOut + LANES, __builtin_shuffle(myLowRg, myLowBa, HIGH_PAIRS));
+        store(myOut + 2 * LANES, __builtin_shuffle(myHighRg, myHighBa, LOW_PAIRS));
+        store(myOut + 3 * LANES, __builtin_shuffle(myHighRg, myHighBa, HIGH_PAIRS));
+    }
+    for (; i < aCount; ++i)
+    {
+        const auto myColor = aPalette[aIndexes[i] & 0x0FU];
+        for (std::size_t myChannel{}; myChannel < GraphicsAdapter::BytesPerPixel; ++myChannel)
+        {
+            aPixels[i * GraphicsAdapter::BytesPerPixel + myChannel] =
+                static_cast<std::uint8_t>(myColor >> (8 * myChannel));
+        }
+    }
+}
+
+constexpr std::array<std::uint32_t, 256> CRC_TABLE = [] {
+    std::array<std::uint32_t, 256> myTable{};
+    for (std::uint32_t i{}; i < myTable.size(); ++i)
+    {
+        auto myCrc = i;
+        for (int j{}; j < 8; ++j)
+        {
+            myCrc = (myCrc & 1U) != 0 ? 0xEDB88320U ^ (myCrc >> 1) : myCrc >> 1;
+        }
+        myTable[i] = myCrc;
+    }
+    return myTable;
+}();
+
+void appendBigEndian(std::vector<std::uint8_t> &aData, std::uint32_t aValue)
+{
+    for (int myShift = 24; myShift >= 0; myShift -= 8)
+    {
+        aData.push_back(static_cast<std::uint8_t>(aValue >> myShift));
+    }
+}
+
+// Length, type, data and the CRC of type and data
+void appendChunk(std::vector<std::uint8_t> &aFile, const char *aType, std::span<const std::uint8_t> aData)
+{
+    appendBigEndian(aFile, static_cast<std::uint32_t>(aData.size()));
+    const auto myStart = aFile.size();
+    aFile.insert(aFile.end(), aType, aType + 4);
+    aFile.insert(aFile.end(), aData.begin(), aData.end());
+    std::uint32_t myCrc = 0xFFFFFFFFU;
+    for (auto myIter = aFile.begin() + static_cast<std::ptrdiff_t>(myStart); myIter != aFile.end(); ++myIter)
+    {
+        myCrc = CRC_TABLE[(myCrc ^ *myIter) & 0xFFU] ^ (myCrc >> 8);
+    }
+    appendBigEndian(aFile, ~myCrc);
+}
+} // namespace
+
+GraphicsAdapter::GraphicsAdapter(RandomAccessMemory &aMemory)
+    : theMemory{aMemory}, thePlanes{std::make_unique<std::array<Plane, PlaneCount>>()},
+      theWindow{std::make_unique<Plane>()}, theFrame(MaxWidth * MaxHeight * BytesPerPixel)
+{
+    theMemory.attachObserver(*this, CgaAddress, CgaSize);
+    theMemory.attachObserver(*this, EgaAddress, PlaneSize);
+}
+
+// The window goes with the adapter, so A000:0000 must not point into it any more
+GraphicsAdapter::~GraphicsAdapter()
+{
+    theMemory.detachObserver(*this);
+    mapWindow(false);
+}
+
+void GraphicsAdapter::onWrite(arch::MemoryAddress aMemoryAddress, std::size_t aLength) noexcept
+{
+    if (theIsSwitching)
+    {
+        return;
+    }
+    const std::size_t myBegin = aMemoryAddress.theAddress;
+    const std::size_t myEnd = myBegin + aLength;
+    if (isEga() && myEnd > EgaAddress.theAddress && myBegin < EgaAddress.theAddress + PlaneSize)
+    {
+        writeEga(std::max<std::size_t>(myBegin, EgaAddress.theAddress) - EgaAddress.theAddress,
+                 std::min<std::size_t>(myEnd - EgaAddress.theAddress, PlaneSize));
+    }
+    else if ((theMode == Mode::Cga320 || theMode == Mode::Cga640) && myEnd > CgaAddress.theAddress &&
+             myBegin < CgaAddress.theAddress + CgaSize)
+    {
+        writeCga(std::max<std::size_t>(myBegin, CgaAddress.theAddress) - CgaAddress.theAddress,
+                 std::min<std::size_t>(myEnd - CgaAddress.theAddress, CgaSize));
+    }
+}
+
+// The store landed in the window, from where it goes to the enabled planes before the window shows the read plane
+void GraphicsAdapter::writeEga(std::size_t aBegin, std::size_t aEnd) noexcept
+{
+    auto &myWindow = *theWindow;
+    auto &myPlanes = *thePlanes;
+    for (auto i = aBegin; i < aEnd; ++i)
+    {
+        const auto myValue = myWindow[i];
+        for (std::size_t myPlane{}; myPlane < PlaneCount; ++myPlane)
+        {
+            if (((theMapMask >> myPlane) & 1U) != 0)
+            {
+                myPlanes[myPlane][i] = myValue;
+            }
+        }
+        myWindow[i] = myPlanes[theReadPlane][i];
+    }
+    markLines(aBegin / bytesPerLine(), (aEnd - 1) / bytesPerLine());
+}
+
+void GraphicsAdapter::writeCga(std::size_t aBegin, std::size_t aEnd) noexcept
+{
+    for (std::size_t myBank{}; myBank < 2; ++myBank)
+    {
+        const auto myBankBegin = myBank * CgaBankSize;
+        const auto myFirst = std::max(aBegin, myBankBegin);
+        const auto myLast = std::min(aEnd, myBankBegin + CGA_LINES_PER_BANK * CGA_BYTES_PER_LINE);
+        if (myFirst >= myLast)
+        {
+            continue;
+        }
+        for (auto myRow = (myFirst - myBankBegin) / CGA_BYTES_PER_LINE;
+             myRow <= (myLast - 1 - myBankBegin) / CGA_BYTES_PER_LINE; ++myRow)
+        {
+            theDirtyLines.set(myRow * 2 + myBank);
+        }
+    }
+}
+
+void GraphicsAdapter::markLines(std::size_t aFirst, std::size_t aLast) noexcept
+{
+    for (auto myLine = aFirst; myLine <= aLast && myLine < height(); ++myLine)
+    {
+        theDirtyLines.set(myLine);
+    }
+}
+
+std::uint16_t GraphicsAdapter::in(std::uint16_t aPort, arch::OperandSize aSize) noexcept
+{
+    if (aSize == arch::OperandSize::Word)
+    {
+        const auto myLow = readByte(aPort);
+        return static_cast<std::uint16_t>(myLow | (readByte(static_cast<std::uint16_t>(aPort + 1)) << 8));
+    }
+    return readByte(aPort);
+}
+
+// A word goes to the port and the next one, which is how index and data registers are usually set in one OUT
+void GraphicsAdapter::out(std::uint16_t aPort, std::uint16_t aValue, arch::OperandSize aSize) noexcept
+{
+    writeByte(aPort, static_cast<std::uint8_t>(aValue));
+    if (aSize == arch::OperandSize::Word)
+    {
+        writeByte(static_cast<std::uint16_t>(aPort + 1), static_cast<std::uint8_t>(aValue >> 8));
+    }
+}
+
+std::uint8_t GraphicsAdapter::readByte(std::uint16_t aPort) noexcept
+{
+    switch (static_cast<Port>(aPort))
+    {
+    case AttributeController:
+        return theAttributeIndex;
+    case SequencerIndex:
+        return theSequencerIndex;
+    case SequencerData:
+        return theSequencerIndex == MAP_MASK ? theMapMask : 0;
+    case GraphicsIndex:
+        return theGraphicsIndex;
+    case GraphicsData:
+        return theGraphicsIndex == READ_MAP_SELECT ? theReadPlane : 0;
+    case CgaModeControl:
+        return theCgaMode;
+    case CgaColorSelect:
+        return theColorSelect;
+    case InputStatus:
+        // Also points the attribute controller back at its index
+        theAttributeIsData = false;
+        return (++theStatusReads & 1U) != 0 ? RETRACE : 0;
+    default:
+        return 0xFF;
+    }
+}
+
+void GraphicsAdapter::writeByte(std::uint16_t aPort, std::uint8_t aValue) noexcept
+{
+    switch (static_cast<Port>(aPort))
+    {
+    case AttributeController:
+        writeAttribute(aValue);
+        return;
+    case SequencerIndex:
+        theSequencerIndex = aValue;
+        return;
+    case SequencerData:
+        if (theSequencerIndex == MAP_MASK)
+        {
+            theMapMask = aValue & 0x0FU;
+        }
+        return;
+    case GraphicsIndex:
+        theGraphicsIndex = aValue;
+        return;
+    case GraphicsData:
+        if (theGraphicsIndex == READ_MAP_SELECT)
+        {
+            selectReadPlane(aValue & 0x03U);
+        }
+        return;
+    case CgaModeControl: {
+        theCgaMode = aValue;
+        if (isEga())
+        {
+            return;
+        }
+        const auto myMode = (aValue & CGA_GRAPHICS) == 0          ? Mode::Text
+                            : (aValue & CGA_HIGH_RESOLUTION) != 0 ? Mode::Cga640
+                                                                  : Mode::Cga320;
+        if (myMode != theMode)
+        {
+            theMode = myMode;
+            updatePalette();
+        }
+        return;
+    }
+    case CgaColorSelect:
+        theColorSelect = aValue;
+        updatePalette();
+        return;
+    default:
+        return;
+    }
+}
+
+// Index and data alternate on the same port, palette registers are the first sixteen indexes
+void GraphicsAdapter::writeAttribute(std::uint8_t aValue) noexcept
+{
+    if (!theAttributeIsData)
+    {
+        theAttributeIndex = aValue & 0x1FU;
+    }
+    else if (theAttributeIndex < theAttributes.size())
+    {
+        theAttributes[theAttributeIndex] = aValue & 0x3FU;
+        updatePalette();
+    }
+    theAttributeIsData = !theAttributeIsData;
+}
+
+Trap GraphicsAdapter::onInterrupt(SingleCore &aCore) noexcept
+{
+    const auto myAX = aCore.readRegister(arch::Regs::AX);
+    const auto myBX = aCore.readRegister(arch::Regs::BX);
+    const auto myAL = static_cast<std::uint8_t>(myAX);
+    const auto myBL = static_cast<std::uint8_t>(myBX);
+    switch (static_cast<Function>(myAX >> 8))
+    {
+    case SetMode:
+        setMode(myAL);
+        break;
+    case SetCgaPalette:
+        // BH 0 sets the background and intensity, BH 1 picks one of the two palettes
+        if ((myBX >> 8) == 0)
+        {
+            theColorSelect = static_cast<std::uint8_t>((theColorSelect & 0xE0U) | (myBL & 0x1FU));
+        }
+        else if ((myBX >> 8) == 1)
+        {
+            theColorSelect = static_cast<std::uint8_t>((theColorSelect & ~CGA_PALETTE_SET) | ((myBL & 1U) << 5));
+        }
+        updatePalette();
+        break;
+    case GetMode: {
+        const std::size_t myColumns = theMode == Mode::Cga320 || theMode == Mode::Ega320 ? 40U : 80U;
+        aCore.writeRegister(arch::Regs::AX,
+                            static_cast<arch::Immediate>((myColumns << 8) | std::to_underlying(theMode)));
+        aCore.writeRegister(arch::Regs::BX, static_cast<arch::Immediate>(myBX & 0x00FFU));
+        break;
+    }
+    case SetEgaPalette:
+        if (myAL == 0 && myBL < theAttributes.size())
+        {
+            theAttributes[myBL] = static_cast<std::uint8_t>((myBX >> 8) & 0x3FU);
+            updatePalette();
+        }
+        break;
+    default:
+        break;
+    }
+    return Trap::OK;
+}
+
+bool GraphicsAdapter::setMode(std::uint8_t aMode) noexcept
+{
+    Mode myMode{};
+    switch (aMode & ~KEEP_MEMORY)
+    {
+    case 0x02U:
+    case 0x03U:
+        myMode = Mode::Text;
+        break;
+    case 0x04U:
+    case 0x05U:
+        myMode = Mode::Cga320;
+        break;
+    case 0x06U:
+        myMode = Mode::Cga640;
+        break;
+    case 0x0DU:
+        myMode = Mode::Ega320;
+        break;
+    case 0x0EU:
+        myMode = Mode::Ega640;
+        break;
+    case 0x10U:
+        myMode = Mode::Ega640x350;
+        break;
+    default:
+        return false;
+    }
+
+    const bool myWasEga = isEga();
+    theMode = myMode;
+    if (isEga() != myWasEga)
+    {
+        mapWindow(isEga());
+    }
+    theMapMask = 0x0FU;
+    theReadPlane = 0;
+    theAttributeIsData = false;
+    theAttributes = theMode == Mode::Ega640x350 ? EGA_ATTRIBUTES : RGBI_ATTRIBUTES;
+    theCgaMode = theMode == Mode::Text ? 0x29U : theMode == Mode::Cga640 ? 0x1EU : 0x2AU;
+    // What the BIOS programs: bright cyan, magenta and white in 320x200, white on black in 640x200
+    theColorSelect = theMode == Mode::Cga640 ? 0x0FU : 0x30U;
+
+    if ((aMode & KEEP_MEMORY) == 0)
+    {
+        if (isEga())
+        {
+            for (auto &myPlane : *thePlanes)
+            {
+                myPlane.fill(0);
+            }
+            theWindow->fill(0);
+        }
+        else
+        {
+            // Blank cells in light grey on black for text, background pixels for graphics
+            std::array<std::uint8_t, RandomAccessMemory::PageSize> myBlank{};
+            for (std::size_t i{}; theMode == Mode::Text && i < myBlank.size(); i += 2)
+            {
+                myBlank[i] = ' ';
+                myBlank[i + 1] = 0x07U;
+            }
+            for (std::size_t myOffset{}; myOffset < CgaSize; myOffset += myBlank.size())
+            {
+                std::ignore = theMemory.writeBlock(
+                    arch::MemoryAddress{.theAddress = static_cast<std::uint32_t>(CgaAddress.theAddress + myOffset)},
+                    myBlank);
+            }
+        }
+    }
+    updatePalette();
+    return true;
+}
+
+GraphicsAdapter::Mode GraphicsAdapter::mode() const noexcept
+{
+    return theMode;
+}
+
+std::size_t GraphicsAdapter::width() const noexcept
+{
+    switch (theMode)
+    {
+    case Mode::Cga320:
+    case Mode::Ega320:
+        return 320U;
+    case Mode::Cga640:
+    case Mode::Ega640:
+    case Mode::Ega640x350:
+        return 640U;
+    default:
+        return 0;
+    }
+}
+
+std::size_t GraphicsAdapter::height() const noexcept
+{
+    switch (theMode)
+    {
+    case Mode::Text:
+        return 0;
+    case Mode::Ega640x350:
+        return 350U;
+    default:
+        return 200U;
+    }
+}
+
+bool GraphicsAdapter::isEga() const noexcept
+{
+    return theMode == Mode::Ega320 || theMode == Mode::Ega640 || theMode == Mode::Ega640x350;
+}
+
+// Of each plane in the EGA modes
+std::size_t GraphicsAdapter::bytesPerLine() const noexcept
+{
+    return width() / 8;
+}
+
+// Points the guest pages under A000:0000 at the window, or back at conventional memory
+void GraphicsAdapter::mapWindow(bool aMapped) noexcept
+{
+    theIsSwitching = true;
+    const auto myFirst = EgaAddress.theAddress / RandomAccessMemory::PageSize;
+    for (std::size_t i{}; i < WINDOW_PAGES; ++i)
+    {
+        if (!aMapped)
+        {
+            theMemory.unmapPage(myFirst + i);
+            continue;
+        }
+        theMemory.mapPage(myFirst + i, std::span<std::uint8_t, RandomAccessMemory::PageSize>{
+                                           theWindow->data() + i * RandomAccessMemory::PageSize,
+                                           RandomAccessMemory::PageSize});
+    }
+    theIsSwitching = false;
+}
+
+// Copies the whole plane, so reading the planes in turn costs 64K per switch
+void GraphicsAdapter::selectReadPlane(std::uint8_t aPlane) noexcept
+{
+    if (aPlane == theReadPlane)
+    {
+        return;
+    }
+    theReadPlane = aPlane;
+    *theWindow = (*thePlanes)[aPlane];
+}
+
+void GraphicsAdapter::updatePalette() noexcept
+{
+    switch (theMode)
+    {
+    case Mode::Text:
+        return;
+    case Mode::Cga320: {
+        const std::size_t myFirst = (theColorSelect & CGA_PALETTE_SET) != 0 ? 3U : 2U;
+        const std::size_t myIntensity = (theColorSelect & CGA_INTENSITY) != 0 ? 8U : 0U;
+        thePalette[0] = rgbi(theColorSelect & 0x0FU);
+        for (std::size_t i{1}; i < 4; ++i)
+        {
+            thePalette[i] = rgbi((myFirst + 2 * (i - 1)) | myIntensity);
+        }
+        break;
+    }
+    case Mode::Cga640:
+        thePalette[0] = rgbi(0);
+        thePalette[1] = rgbi(theColorSelect & 0x0FU);
+        break;
+    case Mode::Ega640x350:
+        std::ranges::transform(theAttributes, thePalette.begin(), egaColor);
+        break;
+    default:
+        std::ranges::transform(theAttributes, thePalette.begin(), [](std::uint8_t aValue) {
+            return rgbi((aValue & 0x07U) | ((aValue >> 1) & 0x08U));
+        });
+        break;
+    }
+    markAllDirty();
+}
+
+std::size_t GraphicsAdapter::convert() noexcept
+{
+    std::size_t myCount{};
+    for (std::size_t myLine{}; myLine < height(); ++myLine)
+    {
+        if (theDirtyLines.test(myLine))
+        {
+            convertLine(myLine);
+            ++myCount;
+        }
+    }
+    theDirtyLines.reset();
+    return myCount;
+}
+
+void GraphicsAdapter::convertLine(std::size_t aLine) noexcept
+{
+    std::array<std::uint8_t, MaxWidth> myIndexes;
+    if (isEga())
+    {
+        const auto myOffset = aLine * bytesPerLine();
+        std::array<const std::uint8_t *, PlaneCount> myPlanes{};
+        for (std::size_t i{}; i < PlaneCount; ++i)
+        {
+            myPlanes[i] = (*thePlanes)[i].data() + myOffset;
+        }
+        unpackPlanes(myPlanes, bytesPerLine(), myIndexes.data());
+    }
+    else
+    {
+        std::array<std::uint8_t, CGA_BYTES_PER_LINE> myBytes;
+        const auto myOffset = (aLine & 1U) * CgaBankSize + (aLine >> 1) * CGA_BYTES_PER_LINE;
+        if (theMemory.readBlock(
+                arch::MemoryAddress{.theAddress = static_cast<std::uint32_t>(CgaAddress.theAddress + myOffset)},
+                myBytes) != Trap::OK)
+        {
+            return;
+        }
+        if (theMode == Mode::Cga320)
+        {
+            unpackPairs(myBytes.data(), myBytes.size(), myIndexes.data());
+        }
+        else
+        {
+            const std::array<const std::uint8_t *, 1> myPlane{myBytes.data()};
+            unpackPlanes(myPlane, myBytes.size(), myIndexes.data());
+        }
+    }
+    expandPalette(myIndexes.data(), width(), thePalette, theFrame.data() + aLine * width() * BytesPerPixel);
+}
+
+std::span<const std::uint8_t> GraphicsAdapter::frame() const noexcept
+{
+    return std::span<const std::uint8_t>{theFrame.data(), width() * height() * BytesPerPixel};
+}
+
+std::size_t GraphicsAdapter::dirtyLineCount() const noexcept
+{
+    return theDirtyLines.count();
+}
+
+void GraphicsAdapter::markAllDirty() noexcept
+{
+    markLines(0, MaxHeight);
+}
+
+std::span<const std::uint8_t, GraphicsAdapter::PlaneSize> GraphicsAdapter::plane(std::size_t aIndex) const noexcept
+{
+    return (*thePlanes)[aIndex % PlaneCount];
+}
+
+FrameCapture::FrameCapture(GraphicsAdapter &aAdapter, std::filesystem::path aPath, Format aFormat)
+    : theAdapter{aAdapter}, thePath{std::move(aPath)}, theFormat{aFormat}
+{
+    if (theFormat == Format::RawVideo)
+    {
+        theStream.open(thePath, std::ios::binary | std::ios::trunc);
+        return;
+    }
+    std::error_code myError;
+    std::filesystem::create_directories(thePath, myError);
+}
+
+bool FrameCapture::capture()
+{
+    trace::Slice mySlice{trace::Category::HostIo, "frame capture", theFrames};
+    theAdapter.convert();
+    const auto myWidth = theAdapter.width();
+    const auto myHeight = theAdapter.height();
+    if (myWidth == 0)
+    {
+        return false;
+    }
+    const auto myFrame = theAdapter.frame();
+    if (theFormat == Format::PngSequence)
+    {
+        std::array<char, 32> myName{};
+        std::snprintf(myName.data(), myName.size(), "%06zu.png", theFrames);
+        if (!writePng(thePath / myName.data(), myWidth, myHeight, myFrame))
+        {
+            return false;
+        }
+        ++theFrames;
+        return true;
+    }
+
+    if (theFrames == 0)
+    {
+        theWidth = myWidth;
+        theHeight = myHeight;
+    }
+    if (myWidth != theWidth || myHeight != theHeight)
+    {
+        return false;
+    }
+    theStream.write(reinterpret_cast<const char *>(myFrame.data()), static_cast<std::streamsize>(myFrame.size()));
+    if (!theStream.flush())
+    {
+        return false;
+    }
+    ++theFrames;
+    return true;
+}
+
+std::size_t FrameCapture::frames() const noexcept
+{
+    return theFrames;
+}
+
+// Eight bit RGBA, every row unfiltered, the zlib stream made of stored blocks
+bool FrameCapture::writePng(const std::filesystem::path &aPath, std::size_t aWidth, std::size_t aHeight,
+                            std::span<const std::uint8_t> aPixels)
+{
+    constexpr std::size_t MAX_STORED = 0xFFFFU;
+    constexpr std::uint32_t ADLER_MODULUS = 65521U;
+    // Sums stay within 32 bits for this many bytes between reductions
+    constexpr std::size_t ADLER_RUN = 5552U;
+    const auto myStride = aWidth * GraphicsAdapter::BytesPerPixel;
+    if (aWidth == 0 || aHeight == 0 || aPixels.size() < myStride * aHeight)
+    {
+        return false;
+    }
+
+    std::vector<std::uint8_t> myRaw;
+    myRaw.reserve((myStride + 1) * aHeight);
+    for (std::size_t myRow{}; myRow < aHeight; ++myRow)
+    {
+        myRaw.push_back(0);
+        const auto myLine = aPixels.subspan(myRow * myStride, myStride);
+        myRaw.insert(myRaw.end(), myLine.begin(), myLine.end());
+    }
+
+    // zlib header for deflate with a 32K window and no preset dictionary
+    std::vector<std::uint8_t> myData{0x78, 0x01};
+    myData.reserve(myRaw.size() + myRaw.size() / MAX_STORED * 5 + 16);
+    for (std::size_t myOffset{}; myOffset < myRaw.size(); myOffset += MAX_STORED)
+    {
+        const auto myLength = std::min(MAX_STORED, myRaw.size() - myOffset);
+        const bool myIsLast = myOffset + myLength == myRaw.size();
+        myData.push_back(myIsLast ? 1U : 0U);
+        myData.push_back(static_cast<std::uint8_t>(myLength));
+        myData.push_back(static_cast<std::uint8_t>(myLength >> 8));
+        myData.push_back(static_cast<std::uint8_t>(~myLength));
+        myData.push_back(static_cast<std::uint8_t>(~myLength >> 8));
+        const auto myBlock = myRaw.begin() + static_cast<std::ptrdiff_t>(myOffset);
+        myData.insert(myData.end(), myBlock, myBlock + static_cast<std::ptrdiff_t>(myLength));
+    }
+    std::uint32_t myLow = 1;
+    std::uint32_t myHigh = 0;
+    for (std::size_t myOffset{}; myOffset < myRaw.size(); myOffset += ADLER_RUN)
+    {
+        const auto myEnd = std::min(myOffset + ADLER_RUN, myRaw.size());
+        for (auto i = myOffset; i < myEnd; ++i)
+        {
+            myLow += myRaw[i];
+            myHigh += myLow;
+        }
+        myLow %= ADLER_MODULUS;
+        myHigh %= ADLER_MODULUS;
+    }
+    appendBigEndian(myData, (myHigh << 16) | myLow);
+
+    std::vector<std::uint8_t> myHeader;
+    appendBigEndian(myHeader, static_cast<std::uint32_t>(aWidth));
+    appendBigEndian(myHeader, static_cast<std::uint32_t>(aHeight));
+    // Bit depth, colour type RGBA, compression, filter and interlace methods
+    myHeader.insert(myHeader.end(), {8, 6, 0, 0, 0});
+
+    std::vector<std::uint8_t> myFile{0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    myFile.reserve(myData.size() + 64);
+    appendChunk(myFile, "IHDR", myHeader);
+    appendChunk(myFile, "IDAT", myData);
+    appendChunk(myFile, "IEND", {});
+
+    std::ofstream myStream{aPath, std::ios::binary | std::ios::trunc};
+    myStream.write(reinterpret_cast<const char *>(myFile.data()), static_cast<std::streamsize>(myFile.size()));
+    return static_cast<bool>(myStream);
+}
+} // namespace svm
@@ -0,0 +1,308 @@
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <optional>
+#include <sstream>
+
+#include "guest_profiler.hpp"
+
+namespace svm
+{
+namespace
+{
+// Entry point of the root context, above every linear address
+constexpr std::uint32_t NoAddress = 0xFFFFFFFFU;
+constexpr std::uint32_t HighestAddress = 0x10FFEFU;
+
+std::optional<std::uint32_t> parseHex(std::string_view aText, std::uint32_t aLimit) noexcept
+{
+    std::uint32_t myValue{};
+    const auto [myEnd, myError] = std::from_chars(aText.data(), aText.data() + aText.size(), myValue, 16);
+    if (aText.empty() || myError != std::errc{} || myEnd != aText.data() + aText.size() || myValue > aLimit)
+    {
+        return std::nullopt;
+    }
+    return myValue;
+}
+
+std::optional<std::uint32_t> parseAddress(std::string_view aText) noexcept
+{
+    const auto myColon = aText.find(':');
+    if (myColon == std::string_view::npos)
+    {
+        return parseHex(aText, HighestAddress);
+    }
+    const auto mySegment = parseHex(aText.substr(0, myColon), 0xFFFFU);
+    const auto myOffset = parseHex(aText.substr(myColon + 1), 0xFFFFU);
+    if (!mySegment || !myOffset)
+    {
+        return std::nullopt;
+    }
+    return (*mySegment << 4) + *myOffset;
+}
+} // namespace
+
+GuestProfiler::GuestProfiler()
+    : theContexts{Context{.theParent = Root,
+                          .theAddress = NoAddress,
+                          .theSegment = 0,
+                          .theOffset = 0,
+                          .theCalls = 0,
+                          .theExclusive = 0}}
+{
+    // Calls never allocate a frame
+    theFrames.reserve(MaxDepth);
+}
+
+bool GuestProfiler::parseSymbols(std::string_view aText)
+{
+    std::unordered_map<std::uint32_t, std::string> mySymbols;
+    while (!aText.empty())
+    {
+        const auto myEnd = std::min(aText.find('\n'), aText.size());
+        auto myLine = aText.substr(0, std::min(aText.find('#'), myEnd));
+        aText.remove_prefix(std::min(myEnd + 1, aText.size()));
+
+        std::vector<std::string_view> myFields;
+        while (!myLine.empty())
+        {
+            const auto myBegin = myLine.find_first_not_of(" \t\r");
+            if (myBegin == std::string_view::npos)
+            {
+                break;
+            }
+            myLine.remove_prefix(myBegin);
+            const auto myLength = std::min(myLine.find_first_of(" \t\r"), myLine.size());
+            myFields.push_back(myLine.substr(0, myLength));
+            myLine.remove_prefix(myLength);
+        }
+        if (myFields.empty())
+        {
+            continue;
+        }
+        const auto myAddress = myFields.size() == 2 ? parseAddress(myFields[0]) : std::nullopt;
+        if (!myAddress)
+        {
+            return false;
+        }
+        mySymbols.insert_or_assign(*myAddress, std::string{myFields[1]});
+    }
+    for (auto &[myAddress, myName] : mySymbols)
+    {
+        theSymbols.insert_or_assign(myAddress, std::move(myName));
+    }
+    return true;
+}
+
+bool GuestProfiler::loadSymbols(const std::filesystem::path &aPath)
+{
+    std::ifstream myFile{aPath};
+    if (!myFile)
+    {
+        return false;
+    }
+    const std::string myContent{std::istreambuf_iterator<char>{myFile}, {}};
+    return parseSymbols(myContent);
+}
+
+void GuestProfiler::addSymbol(std::uint32_t aAddress, std::string aName)
+{
+    theSymbols.insert_or_assign(aAddress, std::move(aName));
+}
+
+// A context that cannot be allocated leaves the call untracked like one past MaxDepth
+void GuestProfiler::onCall(std::uint16_t aSegment, std::uint16_t aOffset, std::uint32_t aFrame) noexcept
+{
+    if (theFrames.size() == MaxDepth)
+    {
+        ++theTruncated;
+        return;
+    }
+    const auto myParent = current();
+    const std::uint32_t myAddress = (std::uint32_t{aSegment} << 4) + aOffset;
+    const auto myKey = std::uint64_t{myParent} << 32 | myAddress;
+    std::uint32_t myContext{};
+    try
+    {
+        if (const auto myFound = theChildren.find(myKey); myFound != theChildren.end())
+        {
+            myContext = myFound->second;
+        }
+        else
+        {
+            myContext = static_cast<std::uint32_t>(theContexts.size());
+            theContexts.push_back(Context{.theParent = myParent,
+                                          .theAddress = myAddress,
+                                          .theSegment = aSegment,
+                                          .theOffset = aOffset,
+                                          .theCalls = 0,
+                                          .theExclusive = 0});
+            theChildren.emplace(myKey, myContext);
+        }
+    }
+    catch (...)
+    {
+        ++theTruncated;
+        return;
+    }
+    ++theContexts[myContext].theCalls;
+    theFrames.push_back(Frame{.theContext = myContext, .theStack = aFrame});
+}
+
+void GuestProfiler::onReturn(std::uint32_t aFrame) noexcept
+{
+    while (!theFrames.empty() && theFrames.back().theStack <= aFrame)
+    {
+        theFrames.pop_back();
+    }
+}
+
+void GuestProfiler::retire(std::uint64_t aInstructions) noexcept
+{
+    theContexts[theBlockContext].theExclusive += aInstructions;
+    theTotal += aInstructions;
+    theBlockContext = current();
+}
+
+std::size_t GuestProfiler::depth() const noexcept
+{
+    return theFrames.size();
+}
+
+std::uint64_t GuestProfiler::total() const noexcept
+{
+    return theTotal;
+}
+
+std::uint64_t GuestProfiler::truncated() const noexcept
+{
+    return theTruncated;
+}
+
+// Contexts are created after their parents, so one backward pass sums every subtree. A context whose function is
+// also one of its callers is already inside that caller's inclusive count.
+std::vector<GuestProfiler::Function> GuestProfiler::functions() const
+{
+    std::vector<std::uint64_t> mySubtree(theContexts.size());
+    for (std::size_t i = theContexts.size(); i-- > 0;)
+    {
+        mySubtree[i] += theContexts[i].theExclusive;
+        if (i != Root)
+        {
+            mySubtree[theContexts[i].theParent] += mySubtree[i];
+        }
+    }
+
+    std::unordered_map<std::uint32_t, Function> myFunctions;
+    for (std::uint32_t i{}; i < theContexts.size(); ++i)
+    {
+        const auto &myContext = theContexts[i];
+        auto [myFound, myIsNew] = myFunctions.try_emplace(myContext.theAddress);
+        auto &myFunction = myFound->second;
+        if (myIsNew)
+        {
+            myFunction.theName = nameOf(myContext);
+            myFunction.theAddress = myContext.theAddress;
+        }
+        myFunction.theCalls += myContext.theCalls;
+        myFunction.theExclusive += myContext.theExclusive;
+
+        auto myIsRecursive = false;
+        for (auto myCaller = i; myCaller != Root && !myIsRecursive;)
+        {
+            myCaller = theContexts[myCaller].theParent;
+            myIsRecursive = theContexts[myCaller].theAddress == myContext.theAddress;
+        }
+        if (!myIsRecursive)
+        {
+            myFunction.theInclusive += mySubtree[i];
+        }
+    }
+
+    std::vector<Function> myResult;
+    for (auto &myEntry : myFunctions)
+    {
+        if (myEntry.second.theInclusive != 0)
+        {
+            myResult.push_back(std::move(myEntry.second));
+        }
+    }
+    std::ranges::sort(myResult, [](const Function &aLeft, const Function &aRight) {
+        return aLeft.theInclusive != aRight.theInclusive ? aLeft.theInclusive > aRight.theInclusive
+                                                         : aLeft.theAddress < aRight.theAddress;
+    });
+    return myResult;
+}
+
+std::string GuestProfiler::formatTable(std::size_t aLimit) const
+{
+    std::ostringstream myOut;
+    myOut << std::left << std::setw(24) << "function" << std::right << std::setw(12) << "calls" << std::setw(16)
+          << "inclusive" << std::setw(16) << "exclusive" << std::setw(9) << "incl %" << '\n';
+    const auto myFunctions = functions();
+    for (std::size_t i{}; i < std::min(aLimit, myFunctions.size()); ++i)
+    {
+        const auto &myFunction = myFunctions[i];
+        const auto myShare = theTotal != 0 ? 100.0 * static_cast<double>(myFunction.theInclusive) /
+                                                 static_cast<double>(theTotal)
+                                           : 0.0;
+        myOut << std::left << std::setw(24) << myFunction.theName << std::right << std::setw(12) << myFunction.theCalls
+              << std::setw(16) << myFunction.theInclusive << std::setw(16) << myFunction.theExclusive << std::setw(9)
+              << std::fixed << std::setprecision(1) << myShare << '\n';
+    }
+    return myOut.str();
+}
+
+void GuestProfiler::writeCollapsed(std::ostream &aStream) const
+{
+    std::vector<std::uint32_t> myPath;
+    for (std::uint32_t i{}; i < theContexts.size(); ++i)
+    {
+        if (theContexts[i].theExclusive == 0)
+        {
+            continue;
+        }
+        myPath.clear();
+        for (auto myContext = i; myContext != Root; myContext = theContexts[myContext].theParent)
+        {
+            myPath.push_back(myContext);
+        }
+        aStream << nameOf(theContexts[Root]);
+        for (auto myContext = myPath.rbegin(); myContext != myPath.rend(); ++myContext)
+        {
+            aStream << ';' << nameOf(theContexts[*myContext]);
+        }
+        aStream << ' ' << theContexts[i].theExclusive << '\n';
+    }
+}
+
+bool GuestProfiler::writeCollapsedFile(const std::filesystem::path &aPath) const
+{
+    std::ofstream myFile{aPath, std::ios::trunc};
+    writeCollapsed(myFile);
+    return static_cast<bool>(myFile);
+}
+
+std::uint32_t GuestProfiler::current() const noexcept
+{
+    return theFrames.empty() ? Root : theFrames.back().theContext;
+}
+
+std::string GuestProfiler::nameOf(const Context &aContext) const
+{
+    if (aContext.theAddress == NoAddress)
+    {
+        return "(root)";
+    }
+    if (const auto myFound = theSymbols.find(aContext.theAddress); myFound != theSymbols.end())
+    {
+        return myFound->second;
+    }
+    std::ostringstream myOut;
+    myOut << std::hex << std::uppercase << std::setfill('0') << std::setw(4) << aContext.theSegment << ':'
+          << std::setw(4) << aContext.theOffset;
+    return myOut.str();
+}
+} // namespace svm
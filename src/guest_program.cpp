@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <memory>
+
+#include "aot_runtime.hpp"
+#include "expanded_memory.hpp"
+#include "guest_program.hpp"
+#include "memory.hpp"
+#include "port_bus.hpp"
+#include "single_core.hpp"
+#include "text_video.hpp"
+#include "uart.hpp"
+
+namespace svm
+{
+namespace
+{
+std::optional<std::uint8_t> hexDigit(char aChar) noexcept
+{
+    if (aChar >= '0' && aChar <= '9')
+    {
+        return static_cast<std::uint8_t>(aChar - '0');
+    }
+    if (aChar >= 'A' && aChar <= 'F')
+    {
+        return static_cast<std::uint8_t>(aChar - 'A' + 10);
+    }
+    if (aChar >= 'a' && aChar <= 'f')
+    {
+        return static_cast<std::uint8_t>(aChar - 'a' + 10);
+    }
+    return std::nullopt;
+}
+
+// Everything a program touches, allocated per run so runs never see each other's state
+struct Guest
+{
+    RandomAccessMemory theMemory{};
+    TextModeVideo theVideo{theMemory};
+    ExpandedMemory theExpanded{theMemory};
+    SingleCore theCore{theMemory};
+    PortBus theBus{};
+    // After the core, the port flushes what is left on destruction and reads the core's clock doing so
+    std::optional<Uart> theSerial;
+};
+} // namespace
+
+double GuestProgram::Result::mips() const noexcept
+{
+    return theSeconds > 0.0 ? static_cast<double>(theInstructions) / theSeconds / 1e6 : 0.0;
+}
+
+std::optional<std::vector<std::uint8_t>> GuestProgram::parseListing(std::string_view aText)
+{
+    std::vector<std::uint8_t> myBytes;
+    for (std::size_t i{}; i < aText.size(); ++i)
+    {
+        const auto myChar = aText[i];
+        if (myChar == ';')
+        {
+            i = std::min(aText.find('\n', i), aText.size());
+            continue;
+        }
+        if (myChar == ' ' || myChar == '\t' || myChar == '\r' || myChar == '\n')
+        {
+            continue;
+        }
+        const auto myHigh = hexDigit(myChar);
+        const auto myLow = i + 1 < aText.size() ? hexDigit(aText[i + 1]) : std::nullopt;
+        if (!myHigh || !myLow)
+        {
+            return std::nullopt;
+        }
+        myBytes.push_back(static_cast<std::uint8_t>(*myHigh << 4 | *myLow));
+        ++i;
+    }
+    return myBytes;
+}
+
+std::optional<std::vector<std::uint8_t>> GuestProgram::load(const std::filesystem::path &aPath)
+{
+    std::ifstream myFile{aPath, std::ios::binary};
+    if (!myFile)
+    {
+        return std::nullopt;
+    }
+    const std::string myContent{std::istreambuf_iterator<char>{myFile}, {}};
+    if (aPath.extension() == ".hex")
+    {
+        return parseListing(myContent);
+    }
+    return std::vector<std::uint8_t>{myContent.begin(), myContent.end()};
+}
+
+GuestProgram::Result GuestProgram::run(std::span<const std::uint8_t> aImage, std::size_t aBudget,
+                                       std::span<const CompiledBlock> aBlocks, GuestProfiler *aProfiler, int aSerial)
+{
+    // A whole megabyte of guest memory, too large for the stack
+    const auto myGuest = std::make_unique<Guest>();
+    if (const auto myTrap = myGuest->theMemory.writeBlock({.theAddress = LoadAddress}, aImage); myTrap != Trap::OK)
+    {
+        return {.theTrap = myTrap, .theInstructions = 0, .theSeconds = 0.0, .theAX = 0};
+    }
+    auto &myCore = myGuest->theCore;
+    myCore.attachService(ExpandedMemory::Vector, &myGuest->theExpanded);
+    myCore.writeRegister(arch::Regs::IP, LoadAddress);
+    myCore.writeRegister(arch::Regs::SP, StackPointer);
+    myCore.attachProfiler(aProfiler);
+    if (aSerial >= 0)
+    {
+        myGuest->theBus.attach(myGuest->theSerial.emplace(myCore, aSerial), Uart::BasePort, Uart::PortCount);
+        myCore.attachPortBus(&myGuest->theBus);
+    }
+
+    std::optional<AotRuntime> myRuntime;
+    if (!aBlocks.empty())
+    {
+        myRuntime.emplace(myCore, myGuest->theMemory, aBlocks);
+    }
+
+    const auto myStart = std::chrono::steady_clock::now();
+    const auto myTrap = myRuntime ? myRuntime->run(aBudget) : myCore.run(aBudget);
+    const std::chrono::duration<double> myElapsed = std::chrono::steady_clock::now() - myStart;
+    return {.theTrap = myTrap,
+            .theInstructions = myCore.instructionCount(),
+            .theSeconds = myElapsed.count(),
+            .theAX = myCore.readRegister(arch::Regs::AX)};
+}
+} // namespace svm
@@ -0,0 +1,112 @@
+#include <type_traits>
+#include <utility>
+
+#include "hypercall.hpp"
+#include "single_core.hpp"
+#include "trace.hpp"
+
+namespace svm
+{
+template <typename ByteT> std::span<const std::span<ByteT>> GuestBuffer<ByteT>::parts() const noexcept
+{
+    return std::span{theParts}.first(theCount);
+}
+
+template <typename ByteT> std::optional<std::span<ByteT>> GuestBuffer<ByteT>::contiguous() const noexcept
+{
+    if (theCount > 1)
+    {
+        return std::nullopt;
+    }
+    return theCount == 1 ? theParts[0] : std::span<ByteT>{};
+}
+
+template struct GuestBuffer<const std::uint8_t>;
+template struct GuestBuffer<std::uint8_t>;
+
+Hypercalls::Call::Call(SingleCore &aCore, RandomAccessMemory &aMemory) noexcept : theCore{aCore}, theMemory{aMemory}
+{
+}
+
+std::optional<GuestBuffer<const std::uint8_t>> Hypercalls::Call::read(std::uint16_t aSegment, std::uint16_t aOffset,
+                                                                      std::size_t aLength) noexcept
+{
+    auto myBuffer = lend<const std::uint8_t>(aSegment, aOffset, aLength);
+    if (myBuffer)
+    {
+        theMemory.reportLoad(arch::MemoryAddress{.theAddress = (std::uint32_t{aSegment} << 4) + aOffset}, aLength);
+    }
+    return myBuffer;
+}
+
+// The store is reported when the routine returns, once it is actually made
+std::optional<GuestBuffer<std::uint8_t>> Hypercalls::Call::write(std::uint16_t aSegment, std::uint16_t aOffset,
+                                                                 std::size_t aLength) noexcept
+{
+    if (theWrittenCount == MaxWrittenBuffers)
+    {
+        return std::nullopt;
+    }
+    auto myBuffer = lend<std::uint8_t>(aSegment, aOffset, aLength);
+    if (myBuffer)
+    {
+        theWritten[theWrittenCount++] = {arch::MemoryAddress{.theAddress = (std::uint32_t{aSegment} << 4) + aOffset},
+                                         aLength};
+    }
+    return myBuffer;
+}
+
+// The const memory hands out read only spans
+template <typename ByteT>
+std::optional<GuestBuffer<ByteT>> Hypercalls::Call::lend(std::uint16_t aSegment, std::uint16_t aOffset,
+                                                         std::size_t aLength) noexcept
+{
+    if (std::size_t{aOffset} + aLength > 0x10000U)
+    {
+        return std::nullopt;
+    }
+    using MemoryT = std::conditional_t<std::is_const_v<ByteT>, const RandomAccessMemory, RandomAccessMemory>;
+    MemoryT &myMemory = theMemory;
+    GuestBuffer<ByteT> myBuffer{};
+    const auto [myTrap, myCount] = myMemory.hostSpans(
+        arch::MemoryAddress{.theAddress = (std::uint32_t{aSegment} << 4) + aOffset}, aLength, myBuffer.theParts);
+    if (myTrap != Trap::OK)
+    {
+        return std::nullopt;
+    }
+    myBuffer.theCount = myCount;
+    myBuffer.theSize = aLength;
+    return myBuffer;
+}
+
+Hypercalls::Hypercalls(RandomAccessMemory &aMemory) : theMemory{aMemory}
+{
+}
+
+void Hypercalls::define(std::uint8_t aNumber, Routine aRoutine)
+{
+    theRoutines[aNumber] = std::move(aRoutine);
+}
+
+bool Hypercalls::isDefined(std::uint8_t aNumber) const noexcept
+{
+    return static_cast<bool>(theRoutines[aNumber]);
+}
+
+Trap Hypercalls::dispatch(SingleCore &aCore, std::uint8_t aNumber) noexcept
+{
+    const auto &myRoutine = theRoutines[aNumber];
+    if (!myRoutine)
+    {
+        return Trap::ILLEGAL;
+    }
+    trace::Slice mySlice{trace::Category::Service, "hypercall", aNumber};
+    Call myCall{aCore, theMemory};
+    const auto myTrap = myRoutine(myCall);
+    for (std::size_t i{}; i < myCall.theWrittenCount; ++i)
+    {
+        theMemory.reportStore(myCall.theWritten[i].first, myCall.theWritten[i].second);
+    }
+    return myTrap;
+}
+} // namespace svm
@@ -0,0 +1,74 @@
+#include "interval_timer.hpp"
+#include "single_core.hpp"
+
+namespace svm
+{
+IntervalTimer::IntervalTimer(SingleCore &aCore, DeviceScheduler &aScheduler, std::uint8_t aVector)
+    : theCore{aCore}, theScheduler{aScheduler}, theChannel{aScheduler}, theVector{aVector}
+{
+    theScheduler.spawn(&IntervalTimer::tick, *this);
+}
+
+// Reads return the live count, low byte first
+std::uint16_t IntervalTimer::in(std::uint16_t aPort, arch::OperandSize) noexcept
+{
+    if (aPort != BasePort)
+    {
+        return 0xFF;
+    }
+    if (!theReadHighByteNext)
+    {
+        const auto myElapsed = theScheduler.now() - thePeriodStart;
+        theLatch = theReload == 0 ? 0 : static_cast<std::uint16_t>(theReload - myElapsed % theReload);
+    }
+    const auto myByte = theReadHighByteNext ? theLatch >> 8 : theLatch & 0xFF;
+    theReadHighByteNext = !theReadHighByteNext;
+    return static_cast<std::uint16_t>(myByte);
+}
+
+void IntervalTimer::out(std::uint16_t aPort, std::uint16_t aValue, arch::OperandSize) noexcept
+{
+    if (aPort != BasePort)
+    {
+        return;
+    }
+    if (!theHighByteNext)
+    {
+        theLatch = aValue & 0xFF;
+        theHighByteNext = true;
+        return;
+    }
+    theReload = static_cast<std::uint16_t>(theLatch | ((aValue & 0xFF) << 8));
+    theHighByteNext = false;
+    theChannel.post(PortAccess{.thePort = aPort, .theValue = theReload, .theIsWrite = true});
+}
+
+std::uint16_t IntervalTimer::reload() const noexcept
+{
+    return theReload;
+}
+
+std::uint64_t IntervalTimer::ticks() const noexcept
+{
+    return theTicks;
+}
+
+DeviceTask IntervalTimer::tick(DeviceScheduler &aScheduler, IntervalTimer &aTimer)
+{
+    while (true)
+    {
+        // Sleeps until programmed, like the 8253 a new reload value takes effect when the current period ends
+        (void)co_await aTimer.theChannel;
+        while (aTimer.theReload != 0)
+        {
+            aTimer.thePeriodStart = aScheduler.now();
+            co_await aScheduler.delay(aTimer.theReload);
+            ++aTimer.theTicks;
+            aTimer.theCore.raiseInterrupt(aTimer.theVector);
+            while (aTimer.theChannel.tryReceive())
+            {
+            }
+        }
+    }
+}
+} // namespace svm
@@ -0,0 +1,46 @@
+#include "keyboard_controller.hpp"
+#include "single_core.hpp"
+
+namespace svm
+{
+KeyboardController::KeyboardController(SingleCore &aCore, std::uint8_t aVector) : theCore{aCore}, theVector{aVector}
+{
+}
+
+bool KeyboardController::press(std::uint8_t aScancode) noexcept
+{
+    if (!theQueue.tryPush(aScancode))
+    {
+        return false;
+    }
+    theCore.raiseInterrupt(theVector);
+    return true;
+}
+
+std::uint16_t KeyboardController::in(std::uint16_t aPort, arch::OperandSize) noexcept
+{
+    if (aPort == StatusPort)
+    {
+        return theQueue.isEmpty() ? 0 : Status::OutputFull;
+    }
+    if (aPort != DataPort)
+    {
+        return 0xFF;
+    }
+    if (const auto myScancode = theQueue.tryPop())
+    {
+        theScancode = *myScancode;
+        // Bytes pushed while the previous interrupt was in flight may share its raise, ask again for the rest
+        if (!theQueue.isEmpty())
+        {
+            theCore.raiseInterrupt(theVector);
+        }
+    }
+    return theScancode;
+}
+
+// Controller commands are not modelled
+void KeyboardController::out(std::uint16_t, std::uint16_t, arch::OperandSize) noexcept
+{
+}
+} // namespace svm
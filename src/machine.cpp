@@ -0,0 +1,88 @@
+#include <string>
+#include <thread>
+
+#include "machine.hpp"
+#include "trace.hpp"
+
+namespace svm
+{
+Machine::Machine(RandomAccessMemory &aMemory, std::size_t aCoreCount) : theMemory{aMemory}
+{
+    theCores.reserve(aCoreCount);
+    for (std::size_t i{}; i < aCoreCount; ++i)
+    {
+        theCores.push_back(std::make_unique<SingleCore>(theMemory));
+        theCores.back()->blockCache().share();
+    }
+    // Plain host accesses would race as soon as two cores share a word
+    theMemory.setMemoryModel(RandomAccessMemory::MemoryModel::TotalStoreOrder);
+}
+
+std::size_t Machine::coreCount() const noexcept
+{
+    return theCores.size();
+}
+
+SingleCore &Machine::core(std::size_t aIndex) noexcept
+{
+    return *theCores[aIndex];
+}
+
+void Machine::attachPortBus(PortBus *aPortBus) noexcept
+{
+    for (auto &myCore : theCores)
+    {
+        myCore->attachPortBus(aPortBus);
+    }
+}
+
+void Machine::setMemoryModel(RandomAccessMemory::MemoryModel aModel) noexcept
+{
+    theMemory.setMemoryModel(aModel);
+}
+
+std::vector<Trap> Machine::run(std::size_t aBudget)
+{
+    std::vector<Trap> myTraps(theCores.size(), Trap::OK);
+    {
+        std::vector<std::jthread> myThreads;
+        myThreads.reserve(theCores.size());
+        for (std::size_t i{}; i < theCores.size(); ++i)
+        {
+            myThreads.emplace_back([this, aBudget, i, &myTraps] {
+                if (trace::isActive())
+                {
+                    trace::nameThread("core " + std::to_string(i));
+                }
+                myTraps[i] = theCores[i]->run(aBudget);
+            });
+        }
+    }
+    return myTraps;
+}
+
+void Machine::sendInterrupt(std::size_t aTarget, std::uint8_t aVector) noexcept
+{
+    if (aTarget < theCores.size())
+    {
+        theCores[aTarget]->raiseInterrupt(aVector);
+    }
+}
+
+InterprocessorPort::InterprocessorPort(Machine &aMachine) : theMachine{aMachine}
+{
+}
+
+std::uint16_t InterprocessorPort::in(std::uint16_t, arch::OperandSize) noexcept
+{
+    return static_cast<std::uint16_t>(theMachine.coreCount());
+}
+
+void InterprocessorPort::out(std::uint16_t, std::uint16_t aValue, arch::OperandSize aSize) noexcept
+{
+    if (aSize == arch::OperandSize::Word)
+    {
+        theMachine.sendInterrupt(aValue >> 8, static_cast<std::uint8_t>(aValue));
+    }
+}
+} // namespace svm
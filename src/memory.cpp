@@ -1,19 +1,70 @@
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <optional>
+
 #include "memory.hpp"
+#include "memory_heatmap.hpp"
 #include "arch.hpp"
 #include "constants.hpp"
 #include "trap.hpp"
 
 namespace svm
 {
+namespace
+{
+// Guest memory is a byte array, atomic accesses view its aligned words and eight byte cells through types allowed to
+// alias it
+using LockedCell [[gnu::may_alias]] = std::uint64_t;
+using LockedWord [[gnu::may_alias]] = std::uint16_t;
+} // namespace
+
+RandomAccessMemory::RandomAccessMemory()
+{
+    for (std::size_t i{}; i < PageCount; ++i)
+    {
+        thePageTable[i].store(theMemory.data() + i * PageSize, std::memory_order_relaxed);
+    }
+}
+
+std::uint8_t *RandomAccessMemory::hostByte(std::uint32_t aAddress) const noexcept
+{
+    return thePageTable[aAddress / PageSize].load(std::memory_order_relaxed) + aAddress % PageSize;
+}
+
+// Calls aPart(host bytes, bytes done so far, length) for the part of the range on each page it touches
+template <typename PartT>
+void RandomAccessMemory::forEachPage(std::uint32_t aBegin, std::size_t aLength, PartT aPart) const noexcept
+{
+    for (std::size_t myDone{}; myDone < aLength;)
+    {
+        const auto myAddress = static_cast<std::uint32_t>(aBegin + myDone);
+        const auto myLength = std::min(aLength - myDone, PageSize - myAddress % PageSize);
+        aPart(hostByte(myAddress), myDone, myLength);
+        myDone += myLength;
+    }
+}
+
 std::pair<Trap, arch::Immediate> RandomAccessMemory::read(arch::MemoryAddress aMemoryAddress) const noexcept
 {
-    if (isMemoryInBound(aMemoryAddress))
+    if (isMemoryInBound(aMemoryAddress, RandomAccessMemory::WordSize))
     {
+        const auto myFlags = pageFlags(aMemoryAddress.theAddress, RandomAccessMemory::WordSize);
         arch::Immediate myReadValue{};
-        for (std::size_t i{}; i < RandomAccessMemory::MemoryAlign; ++i)
+        if ((myFlags & PageFlag::Ordered) != 0) [[unlikely]]
+        {
+            myReadValue = loadOrdered(aMemoryAddress.theAddress, RandomAccessMemory::WordSize);
+        }
+        else
+        {
+            for (std::size_t i{}; i < RandomAccessMemory::WordSize; ++i)
+            {
+                myReadValue |= *hostByte(aMemoryAddress.theAddress + i) << (constants::CHAR_SIZE * i);
+            }
+        }
+        if ((myFlags & (PageFlag::ObservedRead | PageFlag::Counted)) != 0) [[unlikely]]
         {
-            myReadValue |= theMemory[aMemoryAddress.theAddress + i]
-                           << (constants::CHAR_SIZE * (RandomAccessMemory::MemoryAlign - 1 - i));
+            afterLoad(aMemoryAddress, RandomAccessMemory::WordSize, myFlags);
         }
         return {Trap::OK, myReadValue};
     }
@@ -25,9 +76,16 @@ std::pair<Trap, arch::Immediate> RandomAccessMemory::read(arch::MemoryAddress aM
 
 std::pair<Trap, arch::Immediate> RandomAccessMemory::readByte(arch::MemoryAddress aMemoryAddress) const noexcept
 {
-    if (isMemoryInBound(aMemoryAddress))
+    if (isMemoryInBound(aMemoryAddress, 1U))
     {
-        arch::Immediate myReadValue = theMemory[aMemoryAddress.theAddress];
+        const auto myFlags = pageFlags(aMemoryAddress.theAddress, 1U);
+        const arch::Immediate myReadValue = (myFlags & PageFlag::Ordered) != 0
+                                                ? loadOrdered(aMemoryAddress.theAddress, 1U)
+                                                : *hostByte(aMemoryAddress.theAddress);
+        if ((myFlags & (PageFlag::ObservedRead | PageFlag::Counted)) != 0) [[unlikely]]
+        {
+            afterLoad(aMemoryAddress, 1U, myFlags);
+        }
         return {Trap::OK, myReadValue};
     }
     else
@@ -36,19 +94,114 @@ std::pair<Trap, arch::Immediate> RandomAccessMemory::readByte(arch::MemoryAddres
     }
 }
 
-bool RandomAccessMemory::isMemoryInBound(arch::MemoryAddress aMemoryAddress) const noexcept
+std::pair<Trap, std::uint8_t> RandomAccessMemory::fetchByte(arch::MemoryAddress aMemoryAddress) const noexcept
+{
+    if (isMemoryInBound(aMemoryAddress, 1U))
+    {
+        return {Trap::OK, *hostByte(aMemoryAddress.theAddress)};
+    }
+    else
+    {
+        return {Trap::SEG_FAULT, 0};
+    }
+}
+
+void RandomAccessMemory::takeSnapshot()
+{
+    theSnapshot.resize(Capacity);
+    forEachPage(0, Capacity, [&](const std::uint8_t *aHost, std::size_t aDone, std::size_t aLength) {
+        std::memcpy(theSnapshot.data() + aDone, aHost, aLength);
+    });
+    const std::lock_guard myGuard{theObserverLock};
+    for (auto &myWord : theDirtyPages)
+    {
+        myWord.store(0, std::memory_order_relaxed);
+    }
+    refreshPageFlags();
+}
+
+std::size_t RandomAccessMemory::restoreSnapshot() noexcept
+{
+    if (theSnapshot.empty())
+    {
+        return 0;
+    }
+    std::size_t myRestored{};
+    for (std::size_t i{}; i < theDirtyPages.size(); ++i)
+    {
+        for (auto myPages = theDirtyPages[i].exchange(0, std::memory_order_relaxed); myPages != 0;
+             myPages &= myPages - 1)
+        {
+            const auto myPage = i * 64 + static_cast<std::size_t>(std::countr_zero(myPages));
+            const auto myBegin = myPage * PageSize;
+            std::memcpy(hostByte(static_cast<std::uint32_t>(myBegin)), theSnapshot.data() + myBegin, PageSize);
+            // Decoded code on the page has to go like after any other store
+            if ((thePageFlags[myPage].fetch_or(PageFlag::Clean, std::memory_order_relaxed) &
+                 PageFlag::ObservedWrite) != 0)
+            {
+                notifyWrite(arch::MemoryAddress{.theAddress = static_cast<std::uint32_t>(myBegin)}, PageSize);
+            }
+            ++myRestored;
+        }
+    }
+    counters::add(theBulkBytes, myRestored * PageSize);
+    return myRestored;
+}
+
+bool RandomAccessMemory::hasSnapshot() const noexcept
+{
+    return !theSnapshot.empty();
+}
+
+void RandomAccessMemory::attachHeatmap(MemoryHeatmap *aHeatmap) noexcept
+{
+    const std::lock_guard myGuard{theObserverLock};
+    theHeatmap = aHeatmap;
+    refreshPageFlags();
+}
+
+MemoryHeatmap *RandomAccessMemory::heatmap() const noexcept
+{
+    return theHeatmap;
+}
+
+void RandomAccessMemory::setMemoryModel(MemoryModel aModel) noexcept
+{
+    const std::lock_guard myGuard{theObserverLock};
+    theMemoryModel = aModel;
+    refreshPageFlags();
+}
+
+RandomAccessMemory::MemoryModel RandomAccessMemory::memoryModel() const noexcept
+{
+    return theMemoryModel;
+}
+
+bool RandomAccessMemory::isMemoryInBound(arch::MemoryAddress aMemoryAddress, std::size_t aLength) const noexcept
 {
-    return aMemoryAddress.theAddress + RandomAccessMemory::MemoryAlign < RandomAccessMemory::Capacity;
+    return std::size_t{aMemoryAddress.theAddress} + aLength <= RandomAccessMemory::Capacity;
 }
 
 Trap RandomAccessMemory::write(arch::MemoryAddress aMemoryAddress, arch::Immediate aValue) noexcept
 {
-    if (isMemoryInBound(aMemoryAddress))
+    if (isMemoryInBound(aMemoryAddress, RandomAccessMemory::WordSize))
     {
-        for (std::size_t i{}; i < RandomAccessMemory::MemoryAlign; ++i)
+        const auto myFlags = pageFlags(aMemoryAddress.theAddress, RandomAccessMemory::WordSize);
+        if ((myFlags & PageFlag::Ordered) != 0) [[unlikely]]
         {
-            const std::size_t myShift = constants::CHAR_SIZE * (RandomAccessMemory::MemoryAlign - 1 - i);
-            theMemory[aMemoryAddress.theAddress + i] = (aValue >> myShift) & constants::BYTE_MASK;
+            storeOrdered(aMemoryAddress.theAddress, RandomAccessMemory::WordSize, aValue);
+        }
+        else
+        {
+            for (std::size_t i{}; i < RandomAccessMemory::WordSize; ++i)
+            {
+                const std::size_t myShift = constants::CHAR_SIZE * i;
+                *hostByte(aMemoryAddress.theAddress + i) = (aValue >> myShift) & constants::BYTE_MASK;
+            }
+        }
+        if ((myFlags & (PageFlag::ObservedWrite | PageFlag::Clean | PageFlag::Counted)) != 0) [[unlikely]]
+        {
+            afterStore(aMemoryAddress, RandomAccessMemory::WordSize, myFlags);
         }
         return Trap::OK;
     }
@@ -60,9 +213,21 @@ Trap RandomAccessMemory::write(arch::MemoryAddress aMemoryAddress, arch::Immedia
 
 Trap RandomAccessMemory::writeByte(arch::MemoryAddress aMemoryAddress, arch::Immediate aValue) noexcept
 {
-    if (isMemoryInBound(aMemoryAddress))
+    if (isMemoryInBound(aMemoryAddress, 1U))
     {
-        theMemory[aMemoryAddress.theAddress] = aValue;
+        const auto myFlags = pageFlags(aMemoryAddress.theAddress, 1U);
+        if ((myFlags & PageFlag::Ordered) != 0) [[unlikely]]
+        {
+            storeOrdered(aMemoryAddress.theAddress, 1U, aValue);
+        }
+        else
+        {
+            *hostByte(aMemoryAddress.theAddress) = aValue;
+        }
+        if ((myFlags & (PageFlag::ObservedWrite | PageFlag::Clean | PageFlag::Counted)) != 0) [[unlikely]]
+        {
+            afterStore(aMemoryAddress, 1U, myFlags);
+        }
         return Trap::OK;
     }
     else
@@ -70,4 +235,535 @@ Trap RandomAccessMemory::writeByte(arch::MemoryAddress aMemoryAddress, arch::Imm
         return Trap::SEG_FAULT;
     }
 }
+
+std::pair<Trap, bool> RandomAccessMemory::compareExchange(arch::MemoryAddress aMemoryAddress,
+                                                         arch::Immediate aExpected, arch::Immediate aDesired) noexcept
+{
+    const auto [myTrap, myOld] = updateLocked(aMemoryAddress, [&](arch::Immediate aOld) -> std::optional<arch::Immediate> {
+        return aOld == aExpected ? std::optional{aDesired} : std::nullopt;
+    });
+    return {myTrap, myTrap == Trap::OK && myOld == aExpected};
+}
+
+std::pair<Trap, arch::Immediate> RandomAccessMemory::exchange(arch::MemoryAddress aMemoryAddress,
+                                                              arch::Immediate aImmediate) noexcept
+{
+    return updateLocked(aMemoryAddress, [&](arch::Immediate) { return std::optional{aImmediate}; });
+}
+
+// Replaces the word with aUpdate(old) unless it returns nullopt, returns the old word. The word is updated with a
+// compare exchange on the eight byte cell holding it. Stores to the rest of the cell made meanwhile are not lost when
+// they are atomic too, as every store to an Ordered page is; a plain store racing it is the caller's data race.
+template <typename UpdateT>
+std::pair<Trap, arch::Immediate> RandomAccessMemory::updateLocked(arch::MemoryAddress aMemoryAddress,
+                                                                  UpdateT aUpdate) noexcept
+{
+    if (!isMemoryInBound(aMemoryAddress, RandomAccessMemory::WordSize))
+    {
+        return {Trap::SEG_FAULT, 0};
+    }
+
+    const auto myOffset = aMemoryAddress.theAddress % sizeof(LockedCell);
+    arch::Immediate myOld{};
+    std::optional<arch::Immediate> myNew;
+    if (myOffset + RandomAccessMemory::WordSize <= sizeof(LockedCell)) [[likely]]
+    {
+        // Cells never straddle pages
+        auto *myCell = reinterpret_cast<LockedCell *>(hostByte(aMemoryAddress.theAddress - myOffset));
+        const auto myShift = myOffset * constants::CHAR_SIZE;
+        const auto myMask = LockedCell{0xFFFF} << myShift;
+        auto myExpected = __atomic_load_n(myCell, __ATOMIC_SEQ_CST);
+        while (true)
+        {
+            myOld = static_cast<arch::Immediate>((myExpected & myMask) >> myShift);
+            myNew = aUpdate(myOld);
+            if (!myNew)
+            {
+                return {Trap::OK, myOld};
+            }
+            const auto myDesired = (myExpected & ~myMask) | (LockedCell{*myNew} << myShift);
+            if (__atomic_compare_exchange_n(myCell, &myExpected, myDesired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+            {
+                break;
+            }
+        }
+    }
+    else
+    {
+        const std::lock_guard myGuard{theSplitLock};
+        auto *myLow = hostByte(aMemoryAddress.theAddress);
+        auto *myHigh = hostByte(aMemoryAddress.theAddress + 1);
+        myOld = static_cast<arch::Immediate>(__atomic_load_n(myLow, __ATOMIC_SEQ_CST) |
+                                             (__atomic_load_n(myHigh, __ATOMIC_SEQ_CST) << constants::CHAR_SIZE));
+        myNew = aUpdate(myOld);
+        if (!myNew)
+        {
+            return {Trap::OK, myOld};
+        }
+        __atomic_store_n(myLow, static_cast<std::uint8_t>(*myNew), __ATOMIC_SEQ_CST);
+        __atomic_store_n(myHigh, static_cast<std::uint8_t>(*myNew >> constants::CHAR_SIZE), __ATOMIC_SEQ_CST);
+    }
+
+    const auto myFlags = pageFlags(aMemoryAddress.theAddress, RandomAccessMemory::WordSize);
+    if ((myFlags & PageFlag::Clean) != 0) [[unlikely]]
+    {
+        markDirty(aMemoryAddress.theAddress, RandomAccessMemory::WordSize);
+    }
+    if ((myFlags & PageFlag::Counted) != 0) [[unlikely]]
+    {
+        countAccess(true, aMemoryAddress.theAddress, RandomAccessMemory::WordSize);
+    }
+    if ((myFlags & PageFlag::ObservedWrite) != 0) [[unlikely]]
+    {
+        notifyWrite(aMemoryAddress, RandomAccessMemory::WordSize);
+    }
+    return {Trap::OK, myOld};
+}
+
+Trap RandomAccessMemory::writeBlock(arch::MemoryAddress aMemoryAddress, std::span<const std::uint8_t> aData) noexcept
+{
+    if (!isMemoryInBound(aMemoryAddress, aData.size()))
+    {
+        return Trap::SEG_FAULT;
+    }
+    if (aData.empty())
+    {
+        return Trap::OK;
+    }
+    forEachPage(aMemoryAddress.theAddress, aData.size(),
+                [&](std::uint8_t *aHost, std::size_t aDone, std::size_t aLength) {
+                    std::memcpy(aHost, aData.data() + aDone, aLength);
+                });
+    counters::add(theBulkBytes, aData.size());
+    if (hasPageFlag(aMemoryAddress.theAddress, aData.size(), PageFlag::Clean)) [[unlikely]]
+    {
+        markDirty(aMemoryAddress.theAddress, aData.size());
+    }
+    if (hasPageFlag(aMemoryAddress.theAddress, aData.size(), PageFlag::Counted)) [[unlikely]]
+    {
+        countAccess(true, aMemoryAddress.theAddress, aData.size());
+    }
+    if (hasPageFlag(aMemoryAddress.theAddress, aData.size(), PageFlag::ObservedWrite)) [[unlikely]]
+    {
+        notifyWrite(aMemoryAddress, aData.size());
+    }
+    return Trap::OK;
+}
+
+Trap RandomAccessMemory::readBlock(arch::MemoryAddress aMemoryAddress, std::span<std::uint8_t> aData) const noexcept
+{
+    if (!isMemoryInBound(aMemoryAddress, aData.size()))
+    {
+        return Trap::SEG_FAULT;
+    }
+    if (aData.empty())
+    {
+        return Trap::OK;
+    }
+    forEachPage(aMemoryAddress.theAddress, aData.size(),
+                [&](const std::uint8_t *aHost, std::size_t aDone, std::size_t aLength) {
+                    std::memcpy(aData.data() + aDone, aHost, aLength);
+                });
+    counters::add(theBulkBytes, aData.size());
+    if (hasPageFlag(aMemoryAddress.theAddress, aData.size(), PageFlag::Counted)) [[unlikely]]
+    {
+        countAccess(false, aMemoryAddress.theAddress, aData.size());
+    }
+    if (hasPageFlag(aMemoryAddress.theAddress, aData.size(), PageFlag::ObservedRead)) [[unlikely]]
+    {
+        notifyRead(aMemoryAddress, aData.size());
+    }
+    return Trap::OK;
+}
+
+Trap RandomAccessMemory::fill(arch::MemoryAddress aMemoryAddress, std::size_t aLength, std::uint8_t aValue) noexcept
+{
+    if (!isMemoryInBound(aMemoryAddress, aLength))
+    {
+        return Trap::SEG_FAULT;
+    }
+    if (aLength == 0)
+    {
+        return Trap::OK;
+    }
+    forEachPage(aMemoryAddress.theAddress, aLength,
+                [&](std::uint8_t *aHost, std::size_t, std::size_t aPart) { std::memset(aHost, aValue, aPart); });
+    counters::add(theBulkBytes, aLength);
+    if (hasPageFlag(aMemoryAddress.theAddress, aLength, PageFlag::Clean)) [[unlikely]]
+    {
+        markDirty(aMemoryAddress.theAddress, aLength);
+    }
+    if (hasPageFlag(aMemoryAddress.theAddress, aLength, PageFlag::Counted)) [[unlikely]]
+    {
+        countAccess(true, aMemoryAddress.theAddress, aLength);
+    }
+    if (hasPageFlag(aMemoryAddress.theAddress, aLength, PageFlag::ObservedWrite)) [[unlikely]]
+    {
+        notifyWrite(aMemoryAddress, aLength);
+    }
+    return Trap::OK;
+}
+
+template <typename ByteT>
+std::pair<Trap, std::size_t> RandomAccessMemory::collectSpans(arch::MemoryAddress aMemoryAddress, std::size_t aLength,
+                                                              std::span<std::span<ByteT>> aParts) const noexcept
+{
+    if (!isMemoryInBound(aMemoryAddress, aLength))
+    {
+        return {Trap::SEG_FAULT, 0};
+    }
+    std::size_t myCount{};
+    const std::uint8_t *myEnd{};
+    forEachPage(aMemoryAddress.theAddress, aLength, [&](std::uint8_t *aHost, std::size_t, std::size_t aPart) {
+        if (aHost != myEnd)
+        {
+            ++myCount;
+            if (myCount <= aParts.size())
+            {
+                aParts[myCount - 1] = std::span{aHost, 0};
+            }
+        }
+        if (myCount <= aParts.size())
+        {
+            aParts[myCount - 1] = std::span{aParts[myCount - 1].data(), aParts[myCount - 1].size() + aPart};
+        }
+        myEnd = aHost + aPart;
+    });
+    return {Trap::OK, myCount};
+}
+
+std::pair<Trap, std::size_t> RandomAccessMemory::hostSpans(arch::MemoryAddress aMemoryAddress, std::size_t aLength,
+                                                           std::span<std::span<const std::uint8_t>> aParts)
+    const noexcept
+{
+    return collectSpans(aMemoryAddress, aLength, aParts);
+}
+
+std::pair<Trap, std::size_t> RandomAccessMemory::hostSpans(arch::MemoryAddress aMemoryAddress, std::size_t aLength,
+                                                           std::span<std::span<std::uint8_t>> aParts) noexcept
+{
+    return collectSpans(aMemoryAddress, aLength, aParts);
+}
+
+void RandomAccessMemory::reportLoad(arch::MemoryAddress aMemoryAddress, std::size_t aLength) const noexcept
+{
+    if (aLength == 0 || !isMemoryInBound(aMemoryAddress, aLength))
+    {
+        return;
+    }
+    counters::add(theBulkBytes, aLength);
+    if (hasPageFlag(aMemoryAddress.theAddress, aLength, PageFlag::Counted)) [[unlikely]]
+    {
+        countAccess(false, aMemoryAddress.theAddress, aLength);
+    }
+    if (hasPageFlag(aMemoryAddress.theAddress, aLength, PageFlag::ObservedRead)) [[unlikely]]
+    {
+        notifyRead(aMemoryAddress, aLength);
+    }
+}
+
+void RandomAccessMemory::reportStore(arch::MemoryAddress aMemoryAddress, std::size_t aLength) noexcept
+{
+    if (aLength == 0 || !isMemoryInBound(aMemoryAddress, aLength))
+    {
+        return;
+    }
+    counters::add(theBulkBytes, aLength);
+    if (hasPageFlag(aMemoryAddress.theAddress, aLength, PageFlag::Clean)) [[unlikely]]
+    {
+        markDirty(aMemoryAddress.theAddress, aLength);
+    }
+    if (hasPageFlag(aMemoryAddress.theAddress, aLength, PageFlag::Counted)) [[unlikely]]
+    {
+        countAccess(true, aMemoryAddress.theAddress, aLength);
+    }
+    if (hasPageFlag(aMemoryAddress.theAddress, aLength, PageFlag::ObservedWrite)) [[unlikely]]
+    {
+        notifyWrite(aMemoryAddress, aLength);
+    }
+}
+
+std::span<const std::uint8_t, RandomAccessMemory::PageSize> RandomAccessMemory::page(std::size_t aIndex) const noexcept
+{
+    return std::span<const std::uint8_t, PageSize>{thePageTable[aIndex].load(std::memory_order_relaxed), PageSize};
+}
+
+std::span<const std::uint8_t, RandomAccessMemory::PageSize> RandomAccessMemory::ownPage(std::size_t aIndex) const noexcept
+{
+    return std::span<const std::uint8_t, PageSize>{theMemory.data() + aIndex * PageSize, PageSize};
+}
+
+void RandomAccessMemory::mapPage(std::size_t aIndex, std::span<std::uint8_t, PageSize> aBacking) noexcept
+{
+    switchPage(aIndex, aBacking.data());
+}
+
+void RandomAccessMemory::unmapPage(std::size_t aIndex) noexcept
+{
+    switchPage(aIndex, theMemory.data() + aIndex * PageSize);
+}
+
+// Only the table entry changes, what the page held stays in the backing it was switched away from
+void RandomAccessMemory::switchPage(std::size_t aIndex, std::uint8_t *aBacking) noexcept
+{
+    if (thePageTable[aIndex].exchange(aBacking, std::memory_order_acq_rel) == aBacking)
+    {
+        return;
+    }
+    const auto myBegin = aIndex * PageSize;
+    const auto myFlags = thePageFlags[aIndex].load(std::memory_order_relaxed);
+    if ((myFlags & PageFlag::Clean) != 0)
+    {
+        markDirty(myBegin, PageSize);
+    }
+    if ((myFlags & PageFlag::ObservedWrite) != 0)
+    {
+        notifyWrite(arch::MemoryAddress{.theAddress = static_cast<std::uint32_t>(myBegin)}, PageSize);
+    }
+}
+
+// Flags of every page the access touches, an access spans at most two pages
+std::uint8_t RandomAccessMemory::pageFlags(std::uint32_t aBegin, std::size_t aLength) const noexcept
+{
+    return thePageFlags[aBegin / PageSize].load(std::memory_order_relaxed) |
+           thePageFlags[(aBegin + aLength - 1) / PageSize].load(std::memory_order_relaxed);
+}
+
+// Loads acquire and stores release under TotalStoreOrder, both are sequentially consistent under
+// SequentiallyConsistent. A word within an eight byte cell is a single host access, so no other core ever sees half
+// of it; a word straddling two cells is two byte accesses, as the 8086 itself makes for a word at an odd address.
+arch::Immediate RandomAccessMemory::loadOrdered(std::uint32_t aAddress, std::size_t aLength) const noexcept
+{
+    const auto myOrder = theMemoryModel == MemoryModel::SequentiallyConsistent ? __ATOMIC_SEQ_CST : __ATOMIC_ACQUIRE;
+    const auto myOffset = aAddress % sizeof(LockedCell);
+    if (aLength == 1U)
+    {
+        return __atomic_load_n(hostByte(aAddress), myOrder);
+    }
+    if (myOffset % WordSize == 0) [[likely]]
+    {
+        return __atomic_load_n(reinterpret_cast<LockedWord *>(hostByte(aAddress)), myOrder);
+    }
+    if (myOffset + WordSize <= sizeof(LockedCell))
+    {
+        const auto myCell = __atomic_load_n(reinterpret_cast<LockedCell *>(hostByte(aAddress - myOffset)), myOrder);
+        return static_cast<arch::Immediate>(myCell >> (myOffset * constants::CHAR_SIZE));
+    }
+    return static_cast<arch::Immediate>(__atomic_load_n(hostByte(aAddress), myOrder) |
+                                        (__atomic_load_n(hostByte(aAddress + 1), myOrder) << constants::CHAR_SIZE));
+}
+
+void RandomAccessMemory::storeOrdered(std::uint32_t aAddress, std::size_t aLength, arch::Immediate aValue) noexcept
+{
+    const auto myOrder = theMemoryModel == MemoryModel::SequentiallyConsistent ? __ATOMIC_SEQ_CST : __ATOMIC_RELEASE;
+    const auto myOffset = aAddress % sizeof(LockedCell);
+    if (aLength == 1U)
+    {
+        __atomic_store_n(hostByte(aAddress), static_cast<std::uint8_t>(aValue), myOrder);
+    }
+    else if (myOffset % WordSize == 0) [[likely]]
+    {
+        __atomic_store_n(reinterpret_cast<LockedWord *>(hostByte(aAddress)), aValue, myOrder);
+    }
+    else if (myOffset + WordSize <= sizeof(LockedCell))
+    {
+        // No atomic store covers an odd word, the cell holding it is swapped whole
+        auto *myCell = reinterpret_cast<LockedCell *>(hostByte(aAddress - myOffset));
+        const auto myShift = myOffset * constants::CHAR_SIZE;
+        const auto myMask = LockedCell{0xFFFF} << myShift;
+        auto myExpected = __atomic_load_n(myCell, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(myCell, &myExpected, (myExpected & ~myMask) | (LockedCell{aValue} << myShift),
+                                            true, myOrder, __ATOMIC_RELAXED))
+        {
+        }
+    }
+    else
+    {
+        __atomic_store_n(hostByte(aAddress), static_cast<std::uint8_t>(aValue), myOrder);
+        __atomic_store_n(hostByte(aAddress + 1), static_cast<std::uint8_t>(aValue >> constants::CHAR_SIZE), myOrder);
+    }
+}
+
+void RandomAccessMemory::afterStore(arch::MemoryAddress aMemoryAddress, std::size_t aLength,
+                                   std::uint8_t aFlags) noexcept
+{
+    if ((aFlags & PageFlag::Clean) != 0)
+    {
+        markDirty(aMemoryAddress.theAddress, aLength);
+    }
+    if ((aFlags & PageFlag::Counted) != 0)
+    {
+        countAccess(true, aMemoryAddress.theAddress, aLength);
+    }
+    if ((aFlags & PageFlag::ObservedWrite) != 0)
+    {
+        notifyWrite(aMemoryAddress, aLength);
+    }
+}
+
+void RandomAccessMemory::afterLoad(arch::MemoryAddress aMemoryAddress, std::size_t aLength,
+                                   std::uint8_t aFlags) const noexcept
+{
+    if ((aFlags & PageFlag::Counted) != 0)
+    {
+        countAccess(false, aMemoryAddress.theAddress, aLength);
+    }
+    if ((aFlags & PageFlag::ObservedRead) != 0)
+    {
+        notifyRead(aMemoryAddress, aLength);
+    }
+}
+
+bool RandomAccessMemory::hasPageFlag(std::size_t aBegin, std::size_t aLength, std::uint8_t aFlag) const noexcept
+{
+    for (auto myPage = aBegin / PageSize; myPage <= (aBegin + aLength - 1) / PageSize; ++myPage)
+    {
+        if ((thePageFlags[myPage].load(std::memory_order_relaxed) & aFlag) != 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void RandomAccessMemory::markDirty(std::size_t aBegin, std::size_t aLength) noexcept
+{
+    for (auto myPage = aBegin / PageSize; myPage <= (aBegin + aLength - 1) / PageSize; ++myPage)
+    {
+        theDirtyPages[myPage / 64].fetch_or(std::uint64_t{1} << (myPage % 64), std::memory_order_relaxed);
+        thePageFlags[myPage].fetch_and(static_cast<std::uint8_t>(~PageFlag::Clean), std::memory_order_relaxed);
+    }
+}
+
+// Word and byte accesses count on their first page, block transfers on every page they touch
+void RandomAccessMemory::countAccess(bool aIsWrite, std::size_t aBegin, std::size_t aLength) const noexcept
+{
+    if (theHeatmap == nullptr)
+    {
+        return;
+    }
+    const auto myAccess = aIsWrite ? MemoryHeatmap::Access::Write : MemoryHeatmap::Access::Read;
+    const auto myLastPage = aLength <= WordSize ? aBegin / PageSize : (aBegin + aLength - 1) / PageSize;
+    for (auto myPage = aBegin / PageSize; myPage <= myLastPage; ++myPage)
+    {
+        theHeatmap->record(myAccess, myPage);
+    }
+}
+
+bool RandomAccessMemory::isDirty(std::size_t aPage) const noexcept
+{
+    return (theDirtyPages[aPage / 64].load(std::memory_order_relaxed) & (std::uint64_t{1} << (aPage % 64))) != 0;
+}
+
+void RandomAccessMemory::attachObserver(MemoryObserver &aObserver, arch::MemoryAddress aMemoryAddress,
+                                        std::size_t aLength, std::uint8_t aAccess)
+{
+    const auto myEnd = std::min(std::size_t{aMemoryAddress.theAddress} + aLength, RandomAccessMemory::Capacity);
+    const std::lock_guard myGuard{theObserverLock};
+    theObservers.push_back(ObservedRange{.theObserver = &aObserver,
+                                         .theBegin = aMemoryAddress.theAddress,
+                                         .theEnd = static_cast<std::uint32_t>(myEnd),
+                                         .theAccess = aAccess});
+    refreshPageFlags();
+}
+
+void RandomAccessMemory::detachObserver(MemoryObserver &aObserver) noexcept
+{
+    const std::lock_guard myGuard{theObserverLock};
+    std::erase_if(theObservers, [&](const ObservedRange &aRange) { return aRange.theObserver == &aObserver; });
+    refreshPageFlags();
+}
+
+MemoryCounters RandomAccessMemory::counters() const noexcept
+{
+    return MemoryCounters{.theBulkBytes = theBulkBytes.load(std::memory_order_relaxed)};
+}
+
+void RandomAccessMemory::resetCounters() noexcept
+{
+    theBulkBytes.store(0, std::memory_order_relaxed);
+}
+
+void RandomAccessMemory::notifyWrite(arch::MemoryAddress aMemoryAddress, std::size_t aLength) noexcept
+{
+    const std::lock_guard myGuard{theObserverLock};
+    for (std::size_t i{}; i < theObservers.size(); ++i)
+    {
+        if (isFirstMatch(i, aMemoryAddress, aLength, MemoryObserver::Write))
+        {
+            theObservers[i].theObserver->onWrite(aMemoryAddress, aLength);
+        }
+    }
+}
+
+void RandomAccessMemory::notifyRead(arch::MemoryAddress aMemoryAddress, std::size_t aLength) const noexcept
+{
+    const std::lock_guard myGuard{theObserverLock};
+    for (std::size_t i{}; i < theObservers.size(); ++i)
+    {
+        if (isFirstMatch(i, aMemoryAddress, aLength, MemoryObserver::Read))
+        {
+            theObservers[i].theObserver->onRead(aMemoryAddress, aLength);
+        }
+    }
+}
+
+// An observer attached to several overlapping ranges still hears about an access once
+bool RandomAccessMemory::isFirstMatch(std::size_t aIndex, arch::MemoryAddress aMemoryAddress, std::size_t aLength,
+                                      std::uint8_t aAccess) const noexcept
+{
+    const auto myBegin = aMemoryAddress.theAddress;
+    const auto myEnd = myBegin + aLength;
+    const auto myMatches = [&](const ObservedRange &aRange) {
+        return (aRange.theAccess & aAccess) != 0 && myBegin < aRange.theEnd && aRange.theBegin < myEnd;
+    };
+    if (!myMatches(theObservers[aIndex]))
+    {
+        return false;
+    }
+    for (std::size_t i{}; i < aIndex; ++i)
+    {
+        if (theObservers[i].theObserver == theObservers[aIndex].theObserver && myMatches(theObservers[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Built aside and stored page by page so a concurrent access never sees a still observed page unflagged
+void RandomAccessMemory::refreshPageFlags() noexcept
+{
+    std::array<std::uint8_t, PageCount> myFlags{};
+    if (theMemoryModel != MemoryModel::Relaxed)
+    {
+        myFlags.fill(PageFlag::Ordered);
+    }
+    if (theHeatmap != nullptr)
+    {
+        for (auto &myPage : myFlags)
+        {
+            myPage |= PageFlag::Counted;
+        }
+    }
+    for (std::size_t i{}; i < PageCount && !theSnapshot.empty(); ++i)
+    {
+        myFlags[i] |= isDirty(i) ? 0 : PageFlag::Clean;
+    }
+    for (const auto &myRange : theObservers)
+    {
+        if (myRange.theBegin == myRange.theEnd)
+        {
+            continue;
+        }
+        for (std::size_t myPage = myRange.theBegin / PageSize; myPage <= (myRange.theEnd - 1) / PageSize; ++myPage)
+        {
+            myFlags[myPage] |= myRange.theAccess;
+        }
+    }
+    for (std::size_t i{}; i < PageCount; ++i)
+    {
+        thePageFlags[i].store(myFlags[i], std::memory_order_relaxed);
+    }
+}
 } // namespace svm
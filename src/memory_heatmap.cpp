@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <bit>
+#include <iomanip>
+#include <numeric>
+#include <sstream>
+#include <string_view>
+#include <utility>
+
+#include "memory_heatmap.hpp"
+
+namespace svm
+{
+namespace
+{
+constexpr std::size_t PagesPerRow = 16U;
+constexpr std::string_view Shades = " .:-=+*#%@";
+constexpr std::array<const char *, MemoryHeatmap::AccessKinds> AccessNames{"reads", "writes", "executes",
+                                                                            "invalidations"};
+
+// Events left until the next sampled one, per host thread so cores never share it
+thread_local std::uint32_t theCountdown{};
+} // namespace
+
+std::uint64_t MemoryHeatmap::PageHeat::total() const noexcept
+{
+    return std::accumulate(theCounts.begin(), theCounts.end(), std::uint64_t{});
+}
+
+MemoryHeatmap::MemoryHeatmap(std::uint32_t aPeriod) : thePeriod{std::max(aPeriod, 1U)}
+{
+}
+
+void MemoryHeatmap::record(Access aAccess, std::size_t aPage, std::uint64_t aCount) noexcept
+{
+    if (thePeriod > 1U)
+    {
+        if (theCountdown > 1U)
+        {
+            --theCountdown;
+            return;
+        }
+        theCountdown = thePeriod;
+        aCount *= thePeriod;
+    }
+    theCounts[std::to_underlying(aAccess)][aPage % PageCount].fetch_add(aCount, std::memory_order_relaxed);
+}
+
+std::uint64_t MemoryHeatmap::count(Access aAccess, std::size_t aPage) const noexcept
+{
+    return theCounts[std::to_underlying(aAccess)][aPage].load(std::memory_order_relaxed);
+}
+
+std::uint32_t MemoryHeatmap::period() const noexcept
+{
+    return thePeriod;
+}
+
+void MemoryHeatmap::reset() noexcept
+{
+    for (auto &myKind : theCounts)
+    {
+        for (auto &myCount : myKind)
+        {
+            myCount.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+std::vector<MemoryHeatmap::PageHeat> MemoryHeatmap::hottest(std::size_t aLimit) const
+{
+    std::vector<PageHeat> myPages;
+    for (std::size_t myPage{}; myPage < PageCount; ++myPage)
+    {
+        PageHeat myHeat{.thePage = myPage, .theCounts = {}};
+        for (std::size_t i{}; i < AccessKinds; ++i)
+        {
+            myHeat.theCounts[i] = theCounts[i][myPage].load(std::memory_order_relaxed);
+        }
+        if (myHeat.total() != 0)
+        {
+            myPages.push_back(myHeat);
+        }
+    }
+    std::ranges::stable_sort(myPages, std::ranges::greater{}, &PageHeat::total);
+    myPages.resize(std::min(myPages.size(), aLimit));
+    return myPages;
+}
+
+std::string MemoryHeatmap::formatMap(Access aAccess) const
+{
+    const auto &myCounts = theCounts[std::to_underlying(aAccess)];
+    std::uint64_t myMax{};
+    for (const auto &myCount : myCounts)
+    {
+        myMax = std::max(myMax, myCount.load(std::memory_order_relaxed));
+    }
+    const auto myMaxWidth = static_cast<std::size_t>(std::bit_width(myMax));
+
+    std::ostringstream myOut;
+    // Indented past the "00000 |" that starts each row
+    myOut << AccessNames[std::to_underlying(aAccess)] << ", max " << myMax << " per page\n       ";
+    for (std::size_t i{}; i < PagesPerRow; ++i)
+    {
+        myOut << std::hex << std::uppercase << i;
+    }
+    myOut << '\n';
+    for (std::size_t myRow{}; myRow < PageCount / PagesPerRow; ++myRow)
+    {
+        myOut << std::setw(5) << std::setfill('0') << myRow * PagesPerRow * PageSize << " |";
+        for (std::size_t i{}; i < PagesPerRow; ++i)
+        {
+            const auto myCount = myCounts[myRow * PagesPerRow + i].load(std::memory_order_relaxed);
+            std::size_t myShade{};
+            if (myCount != 0)
+            {
+                // Log scale, a page touched once still shows
+                const auto myWidth = static_cast<std::size_t>(std::bit_width(myCount));
+                myShade = 1U + (myWidth - 1U) * (Shades.size() - 2U) / std::max<std::size_t>(myMaxWidth - 1U, 1U);
+            }
+            myOut << Shades[myShade];
+        }
+        myOut << "|\n";
+    }
+    return myOut.str();
+}
+
+std::string MemoryHeatmap::formatTable(std::size_t aLimit) const
+{
+    std::ostringstream myOut;
+    myOut << std::left << std::setw(10) << "address";
+    for (const auto *myName : AccessNames)
+    {
+        myOut << std::right << std::setw(16) << myName;
+    }
+    myOut << '\n';
+    for (const auto &myHeat : hottest(aLimit))
+    {
+        myOut << std::hex << std::uppercase << std::right << std::setw(5) << std::setfill('0')
+              << myHeat.thePage * PageSize << std::dec << std::setfill(' ') << "     ";
+        for (const auto myCount : myHeat.theCounts)
+        {
+            myOut << std::setw(16) << myCount;
+        }
+        myOut << '\n';
+    }
+    return myOut.str();
+}
+} // namespace svm
@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <spanstream>
+#include <thread>
+
+#include "parallel_replay.hpp"
+#include "save_state.hpp"
+
+namespace svm
+{
+namespace
+{
+// A machine per segment, nothing an instrument attached survives into the next one
+struct SegmentMachine
+{
+    RandomAccessMemory theMemory{};
+    SingleCore theCore{theMemory};
+    // Destroyed first, its windows are unmapped while the memory is still there
+    std::unique_ptr<ExpandedMemory> theExpanded;
+};
+
+std::vector<std::uint8_t> encode(SingleCore &aCore, const RandomAccessMemory &aMemory,
+                                 const ExpandedMemory *aExpandedMemory)
+{
+    if (aExpandedMemory == nullptr)
+    {
+        return SaveState::encode(aCore, aMemory);
+    }
+    const std::array mySections{aExpandedMemory->saveSection()};
+    return SaveState::encode(aCore, aMemory, mySections);
+}
+
+void replaySegment(std::span<const std::uint8_t> aLog, const ReplayCheckpoint &aFirst, const ReplayCheckpoint &aLast,
+                   const ParallelReplay::Instrument &aInstrument, ParallelReplay::Segment &aSegment)
+{
+    const auto myMachine = std::make_unique<SegmentMachine>();
+    auto &myCore = myMachine->theCore;
+    std::vector<SaveState::Section> mySections;
+    if (SaveState::decode(aFirst.theState, myCore, myMachine->theMemory, &mySections) != SaveState::Status::OK)
+    {
+        return;
+    }
+    const auto myBoard = std::ranges::find(mySections, ExpandedMemory::SectionTag, &SaveState::Section::theTag);
+    if (myBoard != mySections.end())
+    {
+        // Sized by the section
+        myMachine->theExpanded = std::make_unique<ExpandedMemory>(myMachine->theMemory, 0);
+        if (!myMachine->theExpanded->restoreSection(*myBoard))
+        {
+            return;
+        }
+        myCore.attachService(ExpandedMemory::Vector, myMachine->theExpanded.get());
+    }
+    std::ispanstream myStream{std::span{reinterpret_cast<const char *>(aLog.data()), aLog.size()}};
+    Replayer myReplayer{myStream, aFirst.thePosition};
+    myCore.attachReplayer(&myReplayer);
+    if (aInstrument)
+    {
+        aInstrument(aSegment, myCore, myMachine->theMemory);
+    }
+
+    // The fresh core counts from zero
+    const auto myLength = aLast.theInstruction - aFirst.theInstruction;
+    aSegment.theTrap = myCore.runTo(myLength);
+    myCore.attachReplayer(nullptr);
+    aSegment.theIsVerified = myCore.instructionCount() == myLength && !myReplayer.diverged() &&
+                             encode(myCore, myMachine->theMemory, myMachine->theExpanded.get()) == aLast.theState;
+}
+} // namespace
+
+ReplayCheckpoint ParallelReplay::checkpoint(SingleCore &aCore, const RandomAccessMemory &aMemory,
+                                            const Recorder &aRecorder, const ExpandedMemory *aExpandedMemory)
+{
+    return {.theInstruction = aCore.instructionCount(),
+            .thePosition = aRecorder.position(aCore.instructionCount()),
+            .theState = encode(aCore, aMemory, aExpandedMemory)};
+}
+
+std::vector<ParallelReplay::Segment> ParallelReplay::replay(std::span<const std::uint8_t> aLog,
+                                                            std::span<const ReplayCheckpoint> aCheckpoints,
+                                                            const Instrument &aInstrument, std::size_t aThreads)
+{
+    std::vector<Segment> mySegments;
+    for (std::size_t i = 1; i < aCheckpoints.size(); ++i)
+    {
+        mySegments.push_back(Segment{.theIndex = i - 1,
+                                     .theFirst = aCheckpoints[i - 1].theInstruction,
+                                     .theLast = aCheckpoints[i].theInstruction,
+                                     .theTrap = Trap::OK,
+                                     .theIsVerified = false});
+    }
+    if (aThreads == 0)
+    {
+        aThreads = std::max(std::thread::hardware_concurrency(), 1U);
+    }
+
+    // Segments are handed out one at a time so a slow one does not hold up a fixed share of the others
+    std::atomic<std::size_t> myNext{};
+    const auto myThreadCount = std::min(aThreads, mySegments.size());
+    {
+        std::vector<std::jthread> myThreads;
+        myThreads.reserve(myThreadCount);
+        for (std::size_t i{}; i < myThreadCount; ++i)
+        {
+            myThreads.emplace_back([&] {
+                for (auto myIndex = myNext++; myIndex < mySegments.size(); myIndex = myNext++)
+                {
+                    replaySegment(aLog, aCheckpoints[myIndex], aCheckpoints[myIndex + 1], aInstrument,
+                                  mySegments[myIndex]);
+                }
+            });
+        }
+    }
+    return mySegments;
+}
+} // namespace svm
@@ -0,0 +1,154 @@
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "perf_counters.hpp"
+
+namespace svm
+{
+namespace
+{
+constexpr std::array<std::uint64_t, 4> HOST_EVENTS{PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                   PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES};
+
+int openEvent(std::uint64_t aConfig, int aGroup) noexcept
+{
+    perf_event_attr myAttr{};
+    myAttr.size = sizeof(myAttr);
+    myAttr.type = PERF_TYPE_HARDWARE;
+    myAttr.config = aConfig;
+    myAttr.read_format = PERF_FORMAT_GROUP;
+    myAttr.disabled = aGroup == -1 ? 1 : 0;
+    myAttr.exclude_kernel = 1;
+    myAttr.exclude_hv = 1;
+    return static_cast<int>(::syscall(SYS_perf_event_open, &myAttr, 0, -1, aGroup, 0));
+}
+} // namespace
+
+HostPerf::HostPerf()
+{
+    for (std::size_t i{}; i < EventCount; ++i)
+    {
+        theFds[i] = openEvent(HOST_EVENTS[i], theFds[0]);
+        if (theFds[i] < 0)
+        {
+            for (auto &myFd : theFds)
+            {
+                if (myFd >= 0)
+                {
+                    ::close(myFd);
+                }
+                myFd = -1;
+            }
+            return;
+        }
+    }
+}
+
+HostPerf::~HostPerf()
+{
+    for (const auto myFd : theFds)
+    {
+        if (myFd >= 0)
+        {
+            ::close(myFd);
+        }
+    }
+}
+
+bool HostPerf::isAvailable() const noexcept
+{
+    return theFds[0] >= 0;
+}
+
+void HostPerf::start() noexcept
+{
+    if (!isAvailable())
+    {
+        return;
+    }
+    ::ioctl(theFds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ::ioctl(theFds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+std::optional<HostPerf::Sample> HostPerf::stop() noexcept
+{
+    if (!isAvailable())
+    {
+        return std::nullopt;
+    }
+    ::ioctl(theFds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+    // PERF_FORMAT_GROUP: event count followed by one value per event in opening order
+    std::array<std::uint64_t, EventCount + 1> myValues{};
+    if (::read(theFds[0], myValues.data(), sizeof(myValues)) != static_cast<ssize_t>(sizeof(myValues)) ||
+        myValues[0] != EventCount)
+    {
+        return std::nullopt;
+    }
+    return Sample{.theCycles = myValues[1],
+                  .theInstructions = myValues[2],
+                  .theBranchMisses = myValues[3],
+                  .theCacheMisses = myValues[4]};
+}
+
+double PerfReport::hostCyclesPerInstruction(const CoreCounters &aCore) noexcept
+{
+    return aCore.theInstructions == 0 ? 0.0
+                                      : static_cast<double>(aCore.theHostCycles) /
+                                            static_cast<double>(aCore.theInstructions);
+}
+
+double PerfReport::perMillion(std::uint64_t aEvents, std::uint64_t aGuestInstructions) noexcept
+{
+    return aGuestInstructions == 0 ? 0.0
+                                   : static_cast<double>(aEvents) * 1e6 / static_cast<double>(aGuestInstructions);
+}
+
+std::string PerfReport::format(const CoreCounters &aCore, const MemoryCounters &aMemory,
+                               const std::optional<HostPerf::Sample> &aHost)
+{
+    std::ostringstream myOut;
+    myOut << std::fixed << std::setprecision(2);
+    const auto myLine = [&](const char *aName, const auto &aValue) {
+        myOut << std::left << std::setw(28) << aName << aValue << '\n';
+    };
+
+    myLine("instructions", aCore.theInstructions);
+    myLine("blocks", aCore.theBlocks);
+    myLine("block_cache_hits", aCore.theBlockCacheHits);
+    myLine("block_cache_misses", aCore.theBlockCacheMisses);
+    myLine("block_links", aCore.theBlockLinks);
+    myLine("return_hits", aCore.theReturnHits);
+    myLine("return_misses", aCore.theReturnMisses);
+    myLine("memory_reads_byte", aCore.theMemoryReads[0]);
+    myLine("memory_reads_word", aCore.theMemoryReads[1]);
+    myLine("memory_writes_byte", aCore.theMemoryWrites[0]);
+    myLine("memory_writes_word", aCore.theMemoryWrites[1]);
+    myLine("memory_bulk_bytes", aMemory.theBulkBytes);
+    myLine("port_reads", aCore.thePortReads);
+    myLine("port_writes", aCore.thePortWrites);
+    myLine("interrupts", aCore.theInterrupts);
+    for (std::size_t i{}; i < TRAP_KINDS; ++i)
+    {
+        myLine((std::string{"trap_"} + TRAP_NAMES[i]).c_str(), aCore.theTraps[i]);
+    }
+    myLine("host_cycles_per_instruction", hostCyclesPerInstruction(aCore));
+
+    if (aHost)
+    {
+        const double myIpc = aHost->theCycles == 0 ? 0.0
+                                                   : static_cast<double>(aHost->theInstructions) /
+                                                         static_cast<double>(aHost->theCycles);
+        myLine("host_ipc", myIpc);
+        myLine("host_branch_misses_per_M", perMillion(aHost->theBranchMisses, aCore.theInstructions));
+        myLine("host_cache_misses_per_M", perMillion(aHost->theCacheMisses, aCore.theInstructions));
+    }
+    return myOut.str();
+}
+} // namespace svm
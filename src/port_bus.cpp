@@ -0,0 +1,59 @@
+#include <algorithm>
+
+#include "port_bus.hpp"
+
+namespace svm
+{
+PortBus::PortBus() : theSlots(PortCount, 0), theDevices{nullptr}
+{
+}
+
+void PortBus::attach(PortDevice &aDevice, std::uint16_t aFirst, std::size_t aCount)
+{
+    auto myIter = std::ranges::find(theDevices, &aDevice);
+    if (myIter == theDevices.end())
+    {
+        // Slot zero stays reserved for unclaimed ports
+        myIter = std::find(theDevices.begin() + 1, theDevices.end(), nullptr);
+        if (myIter == theDevices.end())
+        {
+            myIter = theDevices.insert(myIter, &aDevice);
+        }
+        *myIter = &aDevice;
+    }
+
+    const auto mySlot = static_cast<std::uint8_t>(myIter - theDevices.begin());
+    const auto myEnd = std::min<std::size_t>(std::size_t{aFirst} + aCount, PortCount);
+    std::fill(theSlots.begin() + aFirst, theSlots.begin() + static_cast<std::ptrdiff_t>(myEnd), mySlot);
+}
+
+void PortBus::detach(PortDevice &aDevice)
+{
+    const auto myIter = std::ranges::find(theDevices, &aDevice);
+    if (myIter == theDevices.end())
+    {
+        return;
+    }
+    const auto mySlot = static_cast<std::uint8_t>(myIter - theDevices.begin());
+    std::ranges::replace(theSlots, mySlot, std::uint8_t{0});
+    *myIter = nullptr;
+}
+
+std::uint16_t PortBus::in(std::uint16_t aPort, arch::OperandSize aSize) noexcept
+{
+    auto *myDevice = theDevices[theSlots[aPort]];
+    if (myDevice == nullptr)
+    {
+        return aSize == arch::OperandSize::Byte ? FloatingBus & 0xFF : FloatingBus;
+    }
+    return myDevice->in(aPort, aSize);
+}
+
+void PortBus::out(std::uint16_t aPort, std::uint16_t aValue, arch::OperandSize aSize) noexcept
+{
+    if (auto *myDevice = theDevices[theSlots[aPort]]; myDevice != nullptr)
+    {
+        myDevice->out(aPort, aValue, aSize);
+    }
+}
+} // namespace svm
@@ -0,0 +1,232 @@
+#include <algorithm>
+#include <array>
+#include <utility>
+
+#include "record_replay.hpp"
+
+namespace svm
+{
+namespace
+{
+constexpr std::array<std::uint8_t, 4> MAGIC{'S', 'V', 'M', 'R'};
+constexpr std::size_t READ_CHUNK = 64U * 1024U;
+// Largest encoded event: tag and two ten byte varints
+constexpr std::size_t MAX_EVENT_SIZE = 21U;
+} // namespace
+
+Recorder::Recorder(std::ostream &aStream, std::size_t aBufferSize)
+    : theStream{aStream}, theBufferSize{std::max(aBufferSize, MAX_EVENT_SIZE)}
+{
+    theBuffer.reserve(theBufferSize);
+    theBuffer.insert(theBuffer.end(), MAGIC.begin(), MAGIC.end());
+    theBuffer.push_back(ReplayLog::Version);
+}
+
+Recorder::~Recorder()
+{
+    flush();
+}
+
+void Recorder::start(std::uint64_t aInstruction) noexcept
+{
+    theLastInterrupt = aInstruction;
+}
+
+void Recorder::portIn(std::uint16_t aPort, std::uint16_t aValue) noexcept
+{
+    reserve();
+    theBuffer.push_back(std::to_underlying(ReplayLog::Event::PortIn));
+    putVarint(aPort);
+    putVarint(aValue);
+}
+
+void Recorder::interrupt(std::uint64_t aInstruction, std::uint8_t aVector) noexcept
+{
+    reserve();
+    theBuffer.push_back(std::to_underlying(ReplayLog::Event::Interrupt));
+    putVarint(aInstruction - theLastInterrupt);
+    putVarint(aVector);
+    theLastInterrupt = aInstruction;
+}
+
+void Recorder::flush() noexcept
+{
+    if (theBuffer.empty())
+    {
+        return;
+    }
+    theStream.write(reinterpret_cast<const char *>(theBuffer.data()), static_cast<std::streamsize>(theBuffer.size()));
+    theStream.flush();
+    theBytesWritten += theBuffer.size();
+    theBuffer.clear();
+}
+
+std::size_t Recorder::bytesWritten() const noexcept
+{
+    return theBytesWritten + theBuffer.size();
+}
+
+ReplayLog::Position Recorder::position(std::uint64_t aInstruction) const noexcept
+{
+    return {.theOffset = bytesWritten(), .theSinceInterrupt = aInstruction - theLastInterrupt};
+}
+
+void Recorder::putVarint(std::uint64_t aValue) noexcept
+{
+    while (aValue >= 0x80)
+    {
+        theBuffer.push_back(static_cast<std::uint8_t>(aValue | 0x80));
+        aValue >>= 7;
+    }
+    theBuffer.push_back(static_cast<std::uint8_t>(aValue));
+}
+
+void Recorder::reserve() noexcept
+{
+    if (theBuffer.size() + MAX_EVENT_SIZE > theBufferSize) [[unlikely]]
+    {
+        flush();
+    }
+}
+
+Replayer::Replayer(std::istream &aStream) : theStream{aStream}
+{
+    for (const auto myExpected : MAGIC)
+    {
+        if (nextByte() != myExpected)
+        {
+            theDiverged = true;
+            return;
+        }
+    }
+    if (nextByte() != ReplayLog::Version)
+    {
+        theDiverged = true;
+    }
+}
+
+Replayer::Replayer(std::istream &aStream, ReplayLog::Position aPosition)
+    : theStream{aStream}, theSinceInterrupt{aPosition.theSinceInterrupt}
+{
+    if (!theStream.seekg(static_cast<std::streamoff>(aPosition.theOffset)))
+    {
+        theDiverged = true;
+    }
+}
+
+void Replayer::start(std::uint64_t aInstruction) noexcept
+{
+    theLastInterrupt = aInstruction - theSinceInterrupt;
+}
+
+std::uint16_t Replayer::portIn(std::uint16_t aPort) noexcept
+{
+    const auto &myPending = peek();
+    if (!myPending || myPending->theEvent != ReplayLog::Event::PortIn || myPending->theFirst != aPort)
+    {
+        theDiverged = true;
+        return 0xFFFF;
+    }
+    const auto myValue = static_cast<std::uint16_t>(myPending->theSecond);
+    theHasPending = false;
+    return myValue;
+}
+
+std::uint64_t Replayer::nextInterruptAt() noexcept
+{
+    const auto &myPending = peek();
+    if (!myPending || myPending->theEvent != ReplayLog::Event::Interrupt)
+    {
+        return NoInterrupt;
+    }
+    return theLastInterrupt + myPending->theFirst;
+}
+
+std::optional<std::uint8_t> Replayer::interruptAt(std::uint64_t aInstruction) noexcept
+{
+    const auto myDue = nextInterruptAt();
+    if (myDue == NoInterrupt || myDue > aInstruction)
+    {
+        return std::nullopt;
+    }
+    if (myDue < aInstruction)
+    {
+        theDiverged = true;
+    }
+    const auto myVector = static_cast<std::uint8_t>(thePending->theSecond);
+    theLastInterrupt = myDue;
+    theHasPending = false;
+    return myVector;
+}
+
+bool Replayer::diverged() const noexcept
+{
+    return theDiverged;
+}
+
+bool Replayer::finished() noexcept
+{
+    return !peek().has_value();
+}
+
+const std::optional<Replayer::Pending> &Replayer::peek() noexcept
+{
+    if (theHasPending)
+    {
+        return thePending;
+    }
+    theHasPending = true;
+    thePending.reset();
+
+    const auto myTag = nextByte();
+    if (!myTag)
+    {
+        return thePending;
+    }
+    const auto myEvent = static_cast<ReplayLog::Event>(*myTag);
+    const auto myFirst = nextVarint();
+    const auto mySecond = nextVarint();
+    if ((myEvent != ReplayLog::Event::PortIn && myEvent != ReplayLog::Event::Interrupt) || !myFirst || !mySecond)
+    {
+        theDiverged = true;
+        return thePending;
+    }
+    thePending = Pending{.theEvent = myEvent, .theFirst = *myFirst, .theSecond = *mySecond};
+    return thePending;
+}
+
+std::optional<std::uint8_t> Replayer::nextByte() noexcept
+{
+    if (thePosition == theBuffer.size())
+    {
+        theBuffer.resize(READ_CHUNK);
+        theStream.read(reinterpret_cast<char *>(theBuffer.data()), static_cast<std::streamsize>(theBuffer.size()));
+        theBuffer.resize(static_cast<std::size_t>(theStream.gcount()));
+        thePosition = 0;
+        if (theBuffer.empty())
+        {
+            return std::nullopt;
+        }
+    }
+    return theBuffer[thePosition++];
+}
+
+std::optional<std::uint64_t> Replayer::nextVarint() noexcept
+{
+    std::uint64_t myValue{};
+    for (unsigned myShift{}; myShift < 64; myShift += 7)
+    {
+        const auto myByte = nextByte();
+        if (!myByte)
+        {
+            return std::nullopt;
+        }
+        myValue |= std::uint64_t{*myByte & 0x7FU} << myShift;
+        if ((*myByte & 0x80) == 0)
+        {
+            return myValue;
+        }
+    }
+    return std::nullopt;
+}
+} // namespace svm
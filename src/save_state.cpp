@@ -0,0 +1,483 @@
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "arch.hpp"
+#include "save_state.hpp"
+
+namespace svm
+{
+namespace
+{
+constexpr std::array<char, 4> MAGIC{'S', 'V', 'M', 'S'};
+constexpr std::size_t REGISTER_COUNT = std::to_underlying(arch::Regs::FLAG) + 1;
+constexpr auto PAGE_SIZE = RandomAccessMemory::PageSize;
+constexpr auto PAGE_COUNT = RandomAccessMemory::PageCount;
+
+// Every field is stored in host byte order
+struct Header
+{
+    std::array<char, 4> theMagic;
+    std::uint16_t theVersion;
+    std::uint16_t theRegisterCount;
+    std::uint32_t thePageSize;
+    std::uint32_t thePageCount;
+    std::uint32_t theSectionCount;
+    std::uint32_t theReserved;
+    std::uint64_t theSectionOffset;
+    std::uint64_t theDataOffset;
+    std::array<std::uint16_t, REGISTER_COUNT> theRegisters;
+    // FSAVE image of the coprocessor
+    std::array<std::uint8_t, Fpu::StateSize> theFpu;
+    // Written as zeroes, so images of the same state are byte identical
+    std::array<std::uint8_t, 6> thePadding;
+};
+
+struct PageEntry
+{
+    SaveState::PageKind theKind;
+    std::array<std::uint8_t, 3> theReserved;
+    // Encoded size for RunLength pages
+    std::uint32_t theLength;
+    // Image offset for Raw and RunLength pages, first copy's page index for Duplicate pages
+    std::uint64_t theOffset;
+};
+
+struct SectionHeader
+{
+    std::uint32_t theTag;
+    std::uint32_t theLength;
+};
+
+// put copies whole structs into the image, any padding byte would carry whatever the stack held
+static_assert(std::has_unique_object_representations_v<Header>);
+static_assert(std::has_unique_object_representations_v<PageEntry>);
+static_assert(std::has_unique_object_representations_v<SectionHeader>);
+
+constexpr std::size_t DIRECTORY_OFFSET = sizeof(Header);
+constexpr std::size_t SECTION_OFFSET = DIRECTORY_OFFSET + PAGE_COUNT * sizeof(PageEntry);
+
+template <typename T> void put(std::vector<std::uint8_t> &aImage, std::size_t aOffset, const T &aValue) noexcept
+{
+    std::memcpy(aImage.data() + aOffset, &aValue, sizeof(T));
+}
+
+template <typename T> T get(std::span<const std::uint8_t> aImage, std::size_t aOffset) noexcept
+{
+    T myValue;
+    std::memcpy(&myValue, aImage.data() + aOffset, sizeof(T));
+    return myValue;
+}
+
+std::uint64_t hashPage(std::span<const std::uint8_t, PAGE_SIZE> aPage) noexcept
+{
+    // FNV-1a
+    std::uint64_t myHash = 0xcbf29ce484222325ULL;
+    for (const auto myByte : aPage)
+    {
+        myHash = (myHash ^ myByte) * 0x100000001b3ULL;
+    }
+    return myHash;
+}
+
+// Runs are stored as (value, 16 bit count) triples
+std::vector<std::uint8_t> runLengthEncode(std::span<const std::uint8_t, PAGE_SIZE> aPage)
+{
+    std::vector<std::uint8_t> myEncoded;
+    for (std::size_t i{}; i < aPage.size();)
+    {
+        std::size_t myRun = 1;
+        while (i + myRun < aPage.size() && aPage[i + myRun] == aPage[i])
+        {
+            ++myRun;
+        }
+        myEncoded.push_back(aPage[i]);
+        myEncoded.push_back(static_cast<std::uint8_t>(myRun & 0xFF));
+        myEncoded.push_back(static_cast<std::uint8_t>(myRun >> 8));
+        i += myRun;
+        if (myEncoded.size() > PAGE_SIZE / 2)
+        {
+            break;
+        }
+    }
+    return myEncoded;
+}
+
+std::size_t runLength(std::span<const std::uint8_t> aEncoded, std::size_t aIndex) noexcept
+{
+    return aEncoded[aIndex + 1] | (aEncoded[aIndex + 2] << 8);
+}
+
+// What validate checks, without expanding the page: whole triples whose runs add up to a page
+bool isRunLengthPage(std::span<const std::uint8_t> aEncoded) noexcept
+{
+    if (aEncoded.size() % 3 != 0)
+    {
+        return false;
+    }
+    std::size_t myLength{};
+    for (std::size_t i{}; i < aEncoded.size(); i += 3)
+    {
+        myLength += runLength(aEncoded, i);
+    }
+    return myLength == PAGE_SIZE;
+}
+
+void runLengthDecode(std::span<const std::uint8_t> aEncoded, std::span<std::uint8_t, PAGE_SIZE> aPage) noexcept
+{
+    std::size_t myWritten{};
+    for (std::size_t i{}; i < aEncoded.size(); i += 3)
+    {
+        const auto myRun = runLength(aEncoded, i);
+        std::memset(aPage.data() + myWritten, aEncoded[i], myRun);
+        myWritten += myRun;
+    }
+}
+
+// Compares the page with the runs as they are, so an unchanged page is never expanded
+bool holdsRuns(std::span<const std::uint8_t, PAGE_SIZE> aPage, std::span<const std::uint8_t> aEncoded) noexcept
+{
+    std::size_t myRead{};
+    for (std::size_t i{}; i < aEncoded.size(); i += 3)
+    {
+        const auto myRun = runLength(aEncoded, i);
+        const auto myValue = aEncoded[i];
+        const auto myBytes = aPage.subspan(myRead, myRun);
+        if (std::ranges::any_of(myBytes, [myValue](std::uint8_t aByte) { return aByte != myValue; }))
+        {
+            return false;
+        }
+        myRead += myRun;
+    }
+    return true;
+}
+
+bool isZeroPage(std::span<const std::uint8_t, PAGE_SIZE> aPage) noexcept
+{
+    return std::ranges::all_of(aPage, [](std::uint8_t aByte) { return aByte == 0; });
+}
+
+// Checks everything decode reads, so a bad image is refused before anything is restored
+SaveState::Status validate(std::span<const std::uint8_t> aImage, Header &aHeader)
+{
+    if (aImage.size() < SECTION_OFFSET)
+    {
+        return SaveState::Status::BAD_FORMAT;
+    }
+    aHeader = get<Header>(aImage, 0);
+    if (aHeader.theMagic != MAGIC)
+    {
+        return SaveState::Status::BAD_FORMAT;
+    }
+    if (aHeader.theVersion != SaveState::Version)
+    {
+        return SaveState::Status::VERSION_MISMATCH;
+    }
+    if (aHeader.theRegisterCount != REGISTER_COUNT || aHeader.thePageSize != PAGE_SIZE ||
+        aHeader.thePageCount != PAGE_COUNT || aHeader.theDataOffset > aImage.size() ||
+        aHeader.theSectionOffset < SECTION_OFFSET || aHeader.theSectionOffset > aHeader.theDataOffset)
+    {
+        return SaveState::Status::BAD_FORMAT;
+    }
+
+    // Lengths are compared against what is left so no file supplied value can wrap the offset
+    auto mySectionOffset = aHeader.theSectionOffset;
+    for (std::size_t i{}; i < aHeader.theSectionCount; ++i)
+    {
+        if (aHeader.theDataOffset - mySectionOffset < sizeof(SectionHeader))
+        {
+            return SaveState::Status::BAD_FORMAT;
+        }
+        const auto mySectionHeader = get<SectionHeader>(aImage, mySectionOffset);
+        mySectionOffset += sizeof(SectionHeader);
+        if (aHeader.theDataOffset - mySectionOffset < mySectionHeader.theLength)
+        {
+            return SaveState::Status::BAD_FORMAT;
+        }
+        mySectionOffset += mySectionHeader.theLength;
+    }
+
+    for (std::size_t i{}; i < PAGE_COUNT; ++i)
+    {
+        const auto myEntry = get<PageEntry>(aImage, DIRECTORY_OFFSET + i * sizeof(PageEntry));
+        switch (myEntry.theKind)
+        {
+        case SaveState::PageKind::Zero:
+            break;
+        case SaveState::PageKind::Raw:
+            if (myEntry.theOffset > aImage.size() || aImage.size() - myEntry.theOffset < PAGE_SIZE)
+            {
+                return SaveState::Status::BAD_FORMAT;
+            }
+            break;
+        case SaveState::PageKind::RunLength:
+            if (myEntry.theOffset > aImage.size() || aImage.size() - myEntry.theOffset < myEntry.theLength ||
+                !isRunLengthPage(aImage.subspan(myEntry.theOffset, myEntry.theLength)))
+            {
+                return SaveState::Status::BAD_FORMAT;
+            }
+            break;
+        case SaveState::PageKind::Duplicate: {
+            if (myEntry.theOffset >= i)
+            {
+                return SaveState::Status::BAD_FORMAT;
+            }
+            const auto myFirst = get<PageEntry>(aImage, DIRECTORY_OFFSET + myEntry.theOffset * sizeof(PageEntry));
+            if (myFirst.theKind == SaveState::PageKind::Duplicate)
+            {
+                return SaveState::Status::BAD_FORMAT;
+            }
+            break;
+        }
+        default:
+            return SaveState::Status::BAD_FORMAT;
+        }
+    }
+    return SaveState::Status::OK;
+}
+} // namespace
+
+std::vector<std::uint8_t> SaveState::encode(SingleCore &aCore, const RandomAccessMemory &aMemory,
+                                            std::span<const Section> aSections)
+{
+    std::array<PageEntry, PAGE_COUNT> myEntries{};
+    std::vector<std::size_t> myRawPages;
+    std::vector<std::vector<std::uint8_t>> myRunLengthPages;
+    std::unordered_map<std::uint64_t, std::size_t> myFirstCopy;
+
+    for (std::size_t i{}; i < PAGE_COUNT; ++i)
+    {
+        const auto myPage = aMemory.page(i);
+        auto &myEntry = myEntries[i];
+        if (isZeroPage(myPage))
+        {
+            myEntry.theKind = PageKind::Zero;
+            continue;
+        }
+
+        const auto [myIter, myIsNew] = myFirstCopy.try_emplace(hashPage(myPage), i);
+        if (!myIsNew && std::ranges::equal(myPage, aMemory.page(myIter->second)))
+        {
+            myEntry.theKind = PageKind::Duplicate;
+            myEntry.theOffset = myIter->second;
+            continue;
+        }
+
+        auto myEncoded = runLengthEncode(myPage);
+        if (myEncoded.size() <= PAGE_SIZE / 2)
+        {
+            myEntry.theKind = PageKind::RunLength;
+            myEntry.theLength = static_cast<std::uint32_t>(myEncoded.size());
+            myEntry.theOffset = myRunLengthPages.size();
+            myRunLengthPages.push_back(std::move(myEncoded));
+        }
+        else
+        {
+            myEntry.theKind = PageKind::Raw;
+            myEntry.theOffset = myRawPages.size();
+            myRawPages.push_back(i);
+        }
+    }
+
+    std::size_t mySectionBytes{};
+    for (const auto &mySection : aSections)
+    {
+        mySectionBytes += sizeof(SectionHeader) + mySection.theData.size();
+    }
+    const auto myDataOffset = (SECTION_OFFSET + mySectionBytes + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+    auto myRunLengthOffset = myDataOffset + myRawPages.size() * PAGE_SIZE;
+    std::size_t myImageSize = myRunLengthOffset;
+    for (const auto &myEncoded : myRunLengthPages)
+    {
+        myImageSize += myEncoded.size();
+    }
+
+    std::vector<std::uint8_t> myImage(myImageSize);
+    Header myHeader{.theMagic = MAGIC,
+                    .theVersion = Version,
+                    .theRegisterCount = REGISTER_COUNT,
+                    .thePageSize = PAGE_SIZE,
+                    .thePageCount = PAGE_COUNT,
+                    .theSectionCount = static_cast<std::uint32_t>(aSections.size()),
+                    .theReserved = 0,
+                    .theSectionOffset = SECTION_OFFSET,
+                    .theDataOffset = myDataOffset,
+                    .theRegisters = {},
+                    .theFpu = {},
+                    .thePadding = {}};
+    for (std::size_t i{}; i < REGISTER_COUNT; ++i)
+    {
+        myHeader.theRegisters[i] = aCore.readRegister(static_cast<arch::Regs>(i));
+    }
+    aCore.fpu().saveState(myHeader.theFpu);
+    put(myImage, 0, myHeader);
+
+    auto mySectionOffset = SECTION_OFFSET;
+    for (const auto &mySection : aSections)
+    {
+        put(myImage, mySectionOffset,
+            SectionHeader{.theTag = mySection.theTag, .theLength = static_cast<std::uint32_t>(mySection.theData.size())});
+        mySectionOffset += sizeof(SectionHeader);
+        std::ranges::copy(mySection.theData, myImage.begin() + mySectionOffset);
+        mySectionOffset += mySection.theData.size();
+    }
+
+    for (std::size_t i{}; i < PAGE_COUNT; ++i)
+    {
+        auto myEntry = myEntries[i];
+        if (myEntry.theKind == PageKind::Raw)
+        {
+            const auto myOffset = myDataOffset + myEntry.theOffset * PAGE_SIZE;
+            std::ranges::copy(aMemory.page(i), myImage.begin() + myOffset);
+            myEntry.theOffset = myOffset;
+        }
+        else if (myEntry.theKind == PageKind::RunLength)
+        {
+            const auto &myEncoded = myRunLengthPages[myEntry.theOffset];
+            std::ranges::copy(myEncoded, myImage.begin() + myRunLengthOffset);
+            myEntry.theOffset = myRunLengthOffset;
+            myRunLengthOffset += myEncoded.size();
+        }
+        put(myImage, DIRECTORY_OFFSET + i * sizeof(PageEntry), myEntry);
+    }
+    return myImage;
+}
+
+SaveState::Status SaveState::decode(std::span<const std::uint8_t> aImage, SingleCore &aCore,
+                                    RandomAccessMemory &aMemory, std::vector<Section> *aSections)
+{
+    Header myHeader;
+    if (const auto myStatus = validate(aImage, myHeader); myStatus != Status::OK)
+    {
+        return myStatus;
+    }
+
+    std::vector<Section> mySections;
+    auto mySectionOffset = myHeader.theSectionOffset;
+    for (std::size_t i{}; i < myHeader.theSectionCount; ++i)
+    {
+        const auto mySectionHeader = get<SectionHeader>(aImage, mySectionOffset);
+        mySectionOffset += sizeof(SectionHeader);
+        const auto myData = aImage.subspan(mySectionOffset, mySectionHeader.theLength);
+        mySections.push_back(Section{.theTag = mySectionHeader.theTag, .theData = {myData.begin(), myData.end()}});
+        mySectionOffset += mySectionHeader.theLength;
+    }
+
+    // Pages already holding what the image says are left alone: a fresh memory only takes stores for the pages with
+    // data, and observers and the dirty bits only hear about pages that changed
+    std::array<std::uint8_t, PAGE_SIZE> myExpanded;
+    for (std::size_t i{}; i < PAGE_COUNT; ++i)
+    {
+        const auto myEntry = get<PageEntry>(aImage, DIRECTORY_OFFSET + i * sizeof(PageEntry));
+        const arch::MemoryAddress myAddress{.theAddress = static_cast<std::uint32_t>(i * PAGE_SIZE)};
+        const auto myCurrent = aMemory.page(i);
+        Trap myTrap{Trap::OK};
+        switch (myEntry.theKind)
+        {
+        case PageKind::Zero:
+            if (!isZeroPage(myCurrent))
+            {
+                myTrap = aMemory.fill(myAddress, PAGE_SIZE, 0);
+            }
+            break;
+        case PageKind::Raw:
+            if (const auto myData = aImage.subspan(myEntry.theOffset, PAGE_SIZE);
+                !std::ranges::equal(myData, myCurrent))
+            {
+                myTrap = aMemory.writeBlock(myAddress, myData);
+            }
+            break;
+        case PageKind::RunLength:
+            // Checked by validate
+            if (const auto myRuns = aImage.subspan(myEntry.theOffset, myEntry.theLength); !holdsRuns(myCurrent, myRuns))
+            {
+                runLengthDecode(myRuns, myExpanded);
+                myTrap = aMemory.writeBlock(myAddress, myExpanded);
+            }
+            break;
+        case PageKind::Duplicate:
+            if (!std::ranges::equal(aMemory.page(myEntry.theOffset), myCurrent))
+            {
+                myTrap = aMemory.writeBlock(myAddress, aMemory.page(myEntry.theOffset));
+            }
+            break;
+        }
+        if (myTrap != Trap::OK)
+        {
+            return Status::BAD_FORMAT;
+        }
+    }
+
+    for (std::size_t i{}; i < REGISTER_COUNT; ++i)
+    {
+        aCore.writeRegister(static_cast<arch::Regs>(i), myHeader.theRegisters[i]);
+    }
+    aCore.fpu().restoreState(myHeader.theFpu);
+    if (aSections != nullptr)
+    {
+        *aSections = std::move(mySections);
+    }
+    return Status::OK;
+}
+
+SaveState::Status SaveState::save(const std::filesystem::path &aPath, SingleCore &aCore,
+                                  const RandomAccessMemory &aMemory, std::span<const Section> aSections)
+{
+    const auto myImage = encode(aCore, aMemory, aSections);
+    std::ofstream myFile{aPath, std::ios::binary | std::ios::trunc};
+    myFile.write(reinterpret_cast<const char *>(myImage.data()), static_cast<std::streamsize>(myImage.size()));
+    return myFile ? Status::OK : Status::IO_ERROR;
+}
+
+SaveState::Status SaveState::load(const std::filesystem::path &aPath, SingleCore &aCore, RandomAccessMemory &aMemory,
+                                  std::vector<Section> *aSections)
+{
+    const int myFd = ::open(aPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (myFd < 0)
+    {
+        return Status::IO_ERROR;
+    }
+    struct stat myStat{};
+    if (::fstat(myFd, &myStat) != 0 || myStat.st_size <= 0)
+    {
+        ::close(myFd);
+        return Status::IO_ERROR;
+    }
+    const auto mySize = static_cast<std::size_t>(myStat.st_size);
+    void *myMapping = ::mmap(nullptr, mySize, PROT_READ, MAP_PRIVATE, myFd, 0);
+    ::close(myFd);
+    if (myMapping == MAP_FAILED)
+    {
+        return Status::IO_ERROR;
+    }
+
+    const auto myStatus =
+        decode(std::span<const std::uint8_t>{static_cast<const std::uint8_t *>(myMapping), mySize}, aCore, aMemory,
+               aSections);
+    ::munmap(myMapping, mySize);
+    return myStatus;
+}
+
+std::vector<SaveState::PageKind> SaveState::pageKinds(std::span<const std::uint8_t> aImage)
+{
+    Header myHeader;
+    if (validate(aImage, myHeader) != Status::OK)
+    {
+        return {};
+    }
+    std::vector<PageKind> myKinds;
+    for (std::size_t i{}; i < PAGE_COUNT; ++i)
+    {
+        myKinds.push_back(get<PageEntry>(aImage, DIRECTORY_OFFSET + i * sizeof(PageEntry)).theKind);
+    }
+    return myKinds;
+}
+} // namespace svm
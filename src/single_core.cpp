@@ -4,13 +4,18 @@
 
 #include "arch.hpp"
 #include "constants.hpp"
+#include "guest_profiler.hpp"
+#include "hypercall.hpp"
+#include "port_bus.hpp"
 #include "single_core.hpp"
 #include "single_core_util.hpp"
+#include "stack_accessor.hpp"
+#include "trace.hpp"
 #include "trap.hpp"
 
 namespace svm
 {
-SingleCore::SingleCore(RandomAccessMemory &aMemory) : theMemory{aMemory}
+SingleCore::SingleCore(RandomAccessMemory &aMemory) : theMemory{aMemory}, theBlockCache{aMemory, theCounters}
 {
 }
 
@@ -88,6 +93,12 @@ arch::Immediate SingleCore::readFlag(arch::Flags aFlag) noexcept
     return (theFlag.theRegisterValue & myFlagMask) >> myFlagLocation;
 }
 
+arch::MemoryAddress SingleCore::getEffectiveAddr(arch::Regs aSegment, arch::Regs aOffset) noexcept
+{
+    const std::uint32_t mySegment = readRegister(aSegment);
+    return arch::MemoryAddress{.theAddress = (mySegment << 4) + readRegister(aOffset)};
+}
+
 Trap SingleCore::AAA(void) noexcept
 {
     const auto myAxValue = theAX.theRegisterValue;
@@ -168,7 +179,7 @@ arch::Immediate SingleCore::setFlagOnAdd(std::uint32_t aSource, std::uint32_t aD
 Trap SingleCore::ADC(arch::Regs aRegister, arch::MemoryAddress aMemory) noexcept
 {
     auto &myRegister = getReg(aRegister);
-    const auto [myTrap, myMemoryValue] = theMemory.read(aMemory);
+    const auto [myTrap, myMemoryValue] = load(aMemory);
     if (myTrap != Trap::OK)
     {
         return myTrap;
@@ -201,7 +212,7 @@ Trap SingleCore::ADC(arch::Regs aFirst, arch::Immediate aSecond) noexcept
 
 Trap SingleCore::ADC(arch::MemoryAddress aFirst, arch::Immediate aSecond) noexcept
 {
-    const auto [myTrap, myValue] = theMemory.read(aFirst);
+    const auto [myTrap, myValue] = readDestination(aFirst);
     if (myTrap != Trap::OK)
     {
         return myTrap;
@@ -209,12 +220,12 @@ Trap SingleCore::ADC(arch::MemoryAddress aFirst, arch::Immediate aSecond) noexce
     const auto myFlag = readFlag(arch::Flags::CF);
 
     const arch::Immediate myResult = setFlagOnAdd(myValue, aSecond, myFlag);
-    return theMemory.write(aFirst, myResult);
+    return writeDestination(aFirst, myResult);
 }
 
 Trap SingleCore::ADC(arch::MemoryAddress aFirst, arch::Regs aSecond) noexcept
 {
-    const auto [myTrap, myValue] = theMemory.read(aFirst);
+    const auto [myTrap, myValue] = readDestination(aFirst);
     if (myTrap != Trap::OK)
     {
         return myTrap;
@@ -223,7 +234,7 @@ Trap SingleCore::ADC(arch::MemoryAddress aFirst, arch::Regs aSecond) noexcept
     const auto myRegister = getReg(aSecond).theRegisterValue;
     const arch::Immediate myResult = setFlagOnAdd(myValue, myRegister, myFlag);
 
-    return theMemory.write(aFirst, myResult);
+    return writeDestination(aFirst, myResult);
 }
 
 Trap SingleCore::STC(void) noexcept
@@ -292,7 +303,7 @@ Trap SingleCore::AND(arch::Regs aFirst, arch::Regs aSecond) noexcept
 
 Trap SingleCore::AND(arch::Regs aFirst, arch::MemoryAddress aSecond) noexcept
 {
-    const auto [myTrap, myMemoryValue] = theMemory.read(aSecond);
+    const auto [myTrap, myMemoryValue] = load(aSecond);
     if (myTrap != Trap::OK)
     {
         return myTrap;
@@ -310,13 +321,13 @@ Trap SingleCore::AND(arch::Regs aFirst, arch::Immediate aSecond) noexcept
 
 Trap SingleCore::AND(arch::MemoryAddress aFirst, arch::Immediate aSecond) noexcept
 {
-    const auto [myTrap, myMemoryValue] = theMemory.read(aFirst);
+    const auto [myTrap, myMemoryValue] = readDestination(aFirst);
     if (myTrap != Trap::OK)
     {
         return myTrap;
     }
     const auto myResult = myMemoryValue & aSecond;
-    const auto myWriteTrap = theMemory.write(aFirst, myResult);
+    const auto myWriteTrap = writeDestination(aFirst, myResult);
     if (myWriteTrap != Trap::OK)
     {
         return myWriteTrap;
@@ -331,14 +342,66 @@ Trap SingleCore::AND(arch::MemoryAddress aFirst, arch::Regs aSecond) noexcept
     return AND(aFirst, mySecond);
 }
 
-Trap SingleCore::CALL(arch::MemoryAddress) noexcept
+Trap SingleCore::CALL(arch::MemoryAddress aTarget) noexcept
+{
+    if (const auto myTrap = stack().push(theIP.theRegisterValue); myTrap != Trap::OK)
+    {
+        return myTrap;
+    }
+    return profileCall(JMP(aTarget));
+}
+
+Trap SingleCore::CALL(arch::Regs aTarget) noexcept
+{
+    return CALL(arch::MemoryAddress{.theAddress = readRegister(aTarget)});
+}
+
+Trap SingleCore::CALL(arch::Immediate aSegment, arch::Immediate aOffset) noexcept
+{
+    const std::array<arch::Immediate, 2> myFrame{theCS.theRegisterValue, theIP.theRegisterValue};
+    if (const auto myTrap = stack().pushAll(myFrame); myTrap != Trap::OK)
+    {
+        return myTrap;
+    }
+    return profileCall(JMP(aSegment, aOffset));
+}
+
+// A near pointer is one offset word, a far pointer an offset word then a segment word
+std::pair<Trap, std::array<arch::Immediate, 2>> SingleCore::readPointer(arch::MemoryAddress aPointer,
+                                                                       bool aIsFar) noexcept
+{
+    std::array<arch::Immediate, 2> myPointer{0, theCS.theRegisterValue};
+    for (std::size_t i{}; i < (aIsFar ? 2U : 1U); ++i)
+    {
+        const auto [myTrap, myValue] = load(aPointer);
+        if (myTrap != Trap::OK)
+        {
+            return {myTrap, myPointer};
+        }
+        myPointer[i] = myValue;
+        aPointer.theAddress += constants::WORD_SIZE;
+    }
+    return {Trap::OK, myPointer};
+}
+
+Trap SingleCore::callThrough(arch::MemoryAddress aPointer, bool aIsFar) noexcept
 {
-    return Trap::ILLEGAL;
+    const auto [myTrap, myPointer] = readPointer(aPointer, aIsFar);
+    if (myTrap != Trap::OK)
+    {
+        return myTrap;
+    }
+    return aIsFar ? CALL(myPointer[1], myPointer[0]) : CALL(arch::MemoryAddress{.theAddress = myPointer[0]});
 }
 
-Trap SingleCore::CALL(arch::Regs) noexcept
+Trap SingleCore::jumpThrough(arch::MemoryAddress aPointer, bool aIsFar) noexcept
 {
-    return Trap::ILLEGAL;
+    const auto [myTrap, myPointer] = readPointer(aPointer, aIsFar);
+    if (myTrap != Trap::OK)
+    {
+        return myTrap;
+    }
+    return JMP(myPointer[1], myPointer[0]);
 }
 
 Trap SingleCore::CBW(void) noexcept
@@ -356,7 +419,7 @@ Trap SingleCore::CMP(arch::Regs aFirst, arch::Regs aSecond) noexcept
 
 Trap SingleCore::CMP(arch::Regs aFirst, arch::MemoryAddress aSecond) noexcept
 {
-    const auto [myTrap, myMemoryValue] = theMemory.read(aSecond);
+    const auto [myTrap, myMemoryValue] = load(aSecond);
     if (myTrap != Trap::OK)
     {
         return myTrap;
@@ -372,7 +435,7 @@ Trap SingleCore::CMP(arch::Regs aFirst, arch::Immediate aSecond) noexcept
 
 Trap SingleCore::CMP(arch::MemoryAddress aFirst, arch::Immediate aSecond) noexcept
 {
-    const auto [myTrap, myMemoryValue] = theMemory.read(aFirst);
+    const auto [myTrap, myMemoryValue] = load(aFirst);
     if (myTrap != Trap::OK)
     {
         return myTrap;
@@ -430,11 +493,11 @@ Trap SingleCore::CMPSB(void) noexcept
     const auto myES = theES.theRegisterValue;
     const auto myDI = theDI.theRegisterValue;
 
-    const auto [mySrcTrap, mySrcValue] = theMemory.readByte(arch::MemoryAddress{.theAddress = (myDS * 16U) + mySI});
+    const auto [mySrcTrap, mySrcValue] = loadByte(arch::MemoryAddress{.theAddress = (myDS * 16U) + mySI});
     if (mySrcTrap != Trap::OK)
         return mySrcTrap;
 
-    const auto [myDestTrap, myDestValue] = theMemory.readByte(arch::MemoryAddress{.theAddress = (myES * 16U) + myDI});
+    const auto [myDestTrap, myDestValue] = loadByte(arch::MemoryAddress{.theAddress = (myES * 16U) + myDI});
     if (myDestTrap != Trap::OK)
         return myDestTrap;
 
@@ -462,11 +525,11 @@ Trap SingleCore::CMPSW(void) noexcept
     const auto myES = theES.theRegisterValue;
     const auto myDI = theDI.theRegisterValue;
 
-    const auto [mySrcTrap, mySrcValue] = theMemory.read(arch::MemoryAddress{.theAddress = (myDS * 16U) + mySI});
+    const auto [mySrcTrap, mySrcValue] = load(arch::MemoryAddress{.theAddress = (myDS * 16U) + mySI});
     if (mySrcTrap != Trap::OK)
         return mySrcTrap;
 
-    const auto [myDestTrap, myDestValue] = theMemory.read(arch::MemoryAddress{.theAddress = (myES * 16U) + myDI});
+    const auto [myDestTrap, myDestValue] = load(arch::MemoryAddress{.theAddress = (myES * 16U) + myDI});
     if (myDestTrap != Trap::OK)
         return myDestTrap;
 
@@ -501,4 +564,575 @@ Trap SingleCore::CWD(void) noexcept
     return Trap::OK;
 }
 
+Trap SingleCore::HLT(void) noexcept
+{
+    return Trap::HALT;
+}
+
+Trap SingleCore::NOP(void) noexcept
+{
+    return Trap::OK;
+}
+
+Trap SingleCore::WAIT(void) noexcept
+{
+    return Trap::OK;
+}
+
+Fpu &SingleCore::fpu() noexcept
+{
+    return theFpu;
+}
+
+Trap SingleCore::MOV(arch::Regs aFirst, arch::Regs aSecond) noexcept
+{
+    writeRegister(aFirst, readRegister(aSecond));
+    return Trap::OK;
+}
+
+Trap SingleCore::MOV(arch::Regs aFirst, arch::MemoryAddress aSecond) noexcept
+{
+    const auto [myTrap, myMemoryValue] = load(aSecond);
+    if (myTrap != Trap::OK)
+    {
+        return myTrap;
+    }
+    writeRegister(aFirst, myMemoryValue);
+    return Trap::OK;
+}
+
+Trap SingleCore::MOV(arch::Regs aFirst, arch::Immediate aSecond) noexcept
+{
+    writeRegister(aFirst, aSecond);
+    return Trap::OK;
+}
+
+Trap SingleCore::MOV(arch::MemoryAddress aFirst, arch::Immediate aSecond) noexcept
+{
+    return store(aFirst, aSecond);
+}
+
+Trap SingleCore::MOV(arch::MemoryAddress aFirst, arch::Regs aSecond) noexcept
+{
+    return store(aFirst, readRegister(aSecond));
+}
+
+// INC and DEC leave the carry flag untouched
+Trap SingleCore::incDec(arch::Regs aRegister, SingleCore::BinaryOp aOp) noexcept
+{
+    const auto myCarry = readFlag(arch::Flags::CF);
+    const auto myValue = readRegister(aRegister);
+    const auto myResult = aOp == SingleCore::BinaryOp::Add
+                              ? computeArithmeticFlags<SingleCore::BinaryOp::Add, std::uint16_t>(myValue, 1, 0)
+                              : computeArithmeticFlags<SingleCore::BinaryOp::Sub, std::uint16_t>(myValue, 1, 0);
+    setFlag(arch::Flags::CF, myCarry);
+    writeRegister(aRegister, myResult);
+    return Trap::OK;
+}
+
+Trap SingleCore::incDec(arch::MemoryAddress aMemory, SingleCore::BinaryOp aOp) noexcept
+{
+    const auto [myTrap, myValue] = readDestination(aMemory);
+    if (myTrap != Trap::OK)
+    {
+        return myTrap;
+    }
+    const auto myCarry = readFlag(arch::Flags::CF);
+    const auto myResult = aOp == SingleCore::BinaryOp::Add
+                              ? computeArithmeticFlags<SingleCore::BinaryOp::Add, std::uint16_t>(myValue, 1, 0)
+                              : computeArithmeticFlags<SingleCore::BinaryOp::Sub, std::uint16_t>(myValue, 1, 0);
+    setFlag(arch::Flags::CF, myCarry);
+    return writeDestination(aMemory, myResult);
+}
+
+Trap SingleCore::INC(arch::Regs aRegister) noexcept
+{
+    return incDec(aRegister, SingleCore::BinaryOp::Add);
+}
+
+Trap SingleCore::INC(arch::MemoryAddress aMemory) noexcept
+{
+    return incDec(aMemory, SingleCore::BinaryOp::Add);
+}
+
+Trap SingleCore::DEC(arch::Regs aRegister) noexcept
+{
+    return incDec(aRegister, SingleCore::BinaryOp::Sub);
+}
+
+Trap SingleCore::DEC(arch::MemoryAddress aMemory) noexcept
+{
+    return incDec(aMemory, SingleCore::BinaryOp::Sub);
+}
+
+Trap SingleCore::IN(arch::Immediate aPort, arch::OperandSize aSize) noexcept
+{
+    const auto myValue = portIn(aPort, aSize);
+    if (aSize == arch::OperandSize::Byte)
+    {
+        theAX.theRegisterValue = (theAX.theRegisterValue & 0xFF00) | (myValue & 0x00FF);
+    }
+    else
+    {
+        theAX.theRegisterValue = myValue;
+    }
+    return Trap::OK;
+}
+
+Trap SingleCore::OUT(arch::Immediate aPort, arch::OperandSize aSize) noexcept
+{
+    counters::add(theCounters.thePortWrites);
+    trace::burst(trace::Category::Port, "out");
+    if (thePortBus != nullptr)
+    {
+        const auto myValue = aSize == arch::OperandSize::Byte ? theAX.theRegisterValue & 0x00FF : theAX.theRegisterValue;
+        thePortBus->out(aPort, static_cast<std::uint16_t>(myValue), aSize);
+    }
+    return Trap::OK;
+}
+
+StackAccessor SingleCore::stack() noexcept
+{
+    return StackAccessor{theMemory, theCounters, theSS.theRegisterValue, theSP.theRegisterValue};
+}
+
+// The 8086 pushes SP as it is after the decrement
+Trap SingleCore::PUSH(arch::Regs aRegister) noexcept
+{
+    const auto myValue = aRegister == arch::Regs::SP ? static_cast<arch::Immediate>(theSP.theRegisterValue - 2)
+                                                     : readRegister(aRegister);
+    return stack().push(myValue);
+}
+
+Trap SingleCore::PUSH(arch::MemoryAddress aSource) noexcept
+{
+    const auto [myTrap, myValue] = load(aSource);
+    if (myTrap != Trap::OK)
+    {
+        return myTrap;
+    }
+    return stack().push(myValue);
+}
+
+Trap SingleCore::PUSH(arch::Immediate aValue) noexcept
+{
+    return stack().push(aValue);
+}
+
+Trap SingleCore::PUSHF(void) noexcept
+{
+    return stack().push(theFlag.theRegisterValue);
+}
+
+Trap SingleCore::PUSHA(void) noexcept
+{
+    const std::array<arch::Immediate, 8> myRegisters{theAX.theRegisterValue, theCX.theRegisterValue,
+                                                     theDX.theRegisterValue, theBX.theRegisterValue,
+                                                     theSP.theRegisterValue, theBP.theRegisterValue,
+                                                     theSI.theRegisterValue, theDI.theRegisterValue};
+    return stack().pushAll(myRegisters);
+}
+
+Trap SingleCore::POP(arch::Regs aRegister) noexcept
+{
+    const auto [myTrap, myValue] = stack().pop();
+    if (myTrap != Trap::OK)
+    {
+        return myTrap;
+    }
+    writeRegister(aRegister, myValue);
+    return Trap::OK;
+}
+
+// Nothing moves when the destination faults
+Trap SingleCore::POP(arch::MemoryAddress aDestination) noexcept
+{
+    const auto mySavedPointer = theSP.theRegisterValue;
+    const auto [myTrap, myValue] = stack().pop();
+    if (myTrap != Trap::OK)
+    {
+        return myTrap;
+    }
+    if (const auto myWriteTrap = store(aDestination, myValue); myWriteTrap != Trap::OK)
+    {
+        theSP.theRegisterValue = mySavedPointer;
+        return myWriteTrap;
+    }
+    return Trap::OK;
+}
+
+Trap SingleCore::POPF(void) noexcept
+{
+    return POP(arch::Regs::FLAG);
+}
+
+// The saved SP is skipped
+Trap SingleCore::POPA(void) noexcept
+{
+    std::array<arch::Immediate, 8> myRegisters{};
+    if (const auto myTrap = stack().popAll(myRegisters); myTrap != Trap::OK)
+    {
+        return myTrap;
+    }
+    theAX.theRegisterValue = myRegisters[0];
+    theCX.theRegisterValue = myRegisters[1];
+    theDX.theRegisterValue = myRegisters[2];
+    theBX.theRegisterValue = myRegisters[3];
+    theBP.theRegisterValue = myRegisters[5];
+    theSI.theRegisterValue = myRegisters[6];
+    theDI.theRegisterValue = myRegisters[7];
+    return Trap::OK;
+}
+
+// Pushes FLAGS, CS and IP and enters the handler from the interrupt vector table at 0000:0000
+Trap SingleCore::interrupt(std::uint8_t aVector) noexcept
+{
+    const std::uint32_t myEntry = std::uint32_t{aVector} * 4;
+    const auto [myOffsetTrap, myOffset] = load(arch::MemoryAddress{.theAddress = myEntry});
+    const auto [mySegmentTrap, mySegment] = load(arch::MemoryAddress{.theAddress = myEntry + 2});
+    if (myOffsetTrap != Trap::OK || mySegmentTrap != Trap::OK)
+    {
+        return myOffsetTrap != Trap::OK ? myOffsetTrap : mySegmentTrap;
+    }
+
+    const std::array<arch::Immediate, 3> myFrame{theFlag.theRegisterValue, theCS.theRegisterValue,
+                                                 theIP.theRegisterValue};
+    if (const auto myTrap = stack().pushAll(myFrame); myTrap != Trap::OK)
+    {
+        return myTrap;
+    }
+    setFlag(arch::Flags::IF, 0);
+    setFlag(arch::Flags::TF, 0);
+    theCS.theRegisterValue = mySegment;
+    theIP.theRegisterValue = myOffset;
+    return profileCall(Trap::OK);
+}
+
+Trap SingleCore::INT(arch::Immediate aVector) noexcept
+{
+    if (auto *myService = theServices[aVector & 0xFFU]; myService != nullptr)
+    {
+        trace::Slice mySlice{trace::Category::Service, "service", aVector & 0xFFU};
+        return myService->onInterrupt(*this);
+    }
+    return interrupt(static_cast<std::uint8_t>(aVector));
+}
+
+Trap SingleCore::HCALL(arch::Immediate aNumber) noexcept
+{
+    return theHypercalls != nullptr ? theHypercalls->dispatch(*this, static_cast<std::uint8_t>(aNumber))
+                                    : Trap::ILLEGAL;
+}
+
+Trap SingleCore::INTO(void) noexcept
+{
+    return readFlag(arch::Flags::OF) != 0 ? interrupt(4) : Trap::OK;
+}
+
+Trap SingleCore::IRET(void) noexcept
+{
+    const auto myReturnAddress = getEffectiveAddr(arch::Regs::SS, arch::Regs::SP);
+    std::array<arch::Immediate, 3> myFrame{};
+    if (const auto myTrap = stack().popAll(myFrame); myTrap != Trap::OK)
+    {
+        return myTrap;
+    }
+    theFlag.theRegisterValue = myFrame[0];
+    theCS.theRegisterValue = myFrame[1];
+    theIP.theRegisterValue = myFrame[2];
+    return profileReturn(myReturnAddress, Trap::OK);
+}
+
+// Pops IP, and CS when far, then drops aRelease bytes of arguments
+Trap SingleCore::returnFrom(bool aIsFar, arch::Immediate aRelease) noexcept
+{
+    const auto myReturnAddress = getEffectiveAddr(arch::Regs::SS, arch::Regs::SP);
+    auto myStack = stack();
+    // Segment then offset, as the far call pushed them
+    std::array<arch::Immediate, 2> myFrame{theCS.theRegisterValue, 0};
+    if (const auto myTrap = aIsFar ? myStack.popAll(myFrame) : myStack.popAll(std::span{myFrame}.last(1));
+        myTrap != Trap::OK)
+    {
+        return myTrap;
+    }
+    myStack.release(aRelease);
+    return profileReturn(myReturnAddress, JMP(myFrame[0], myFrame[1]));
+}
+
+// Called once a transfer has succeeded, with SS:SP on the return address it pushed
+Trap SingleCore::profileCall(Trap aTrap) noexcept
+{
+    if (theProfiler != nullptr && aTrap == Trap::OK) [[unlikely]]
+    {
+        theProfiler->onCall(theCS.theRegisterValue, theIP.theRegisterValue,
+                            getEffectiveAddr(arch::Regs::SS, arch::Regs::SP).theAddress);
+    }
+    return aTrap;
+}
+
+Trap SingleCore::profileReturn(arch::MemoryAddress aReturnAddress, Trap aTrap) noexcept
+{
+    if (theProfiler != nullptr && aTrap == Trap::OK) [[unlikely]]
+    {
+        theProfiler->onReturn(aReturnAddress.theAddress);
+    }
+    return aTrap;
+}
+
+Trap SingleCore::RET(void) noexcept
+{
+    return returnFrom(false, 0);
+}
+
+Trap SingleCore::RET(arch::Immediate aRelease) noexcept
+{
+    return returnFrom(false, aRelease);
+}
+
+Trap SingleCore::RETF(void) noexcept
+{
+    return returnFrom(true, 0);
+}
+
+Trap SingleCore::RETF(arch::Immediate aRelease) noexcept
+{
+    return returnFrom(true, aRelease);
+}
+
+Trap SingleCore::jumpIf(bool aCondition, arch::MemoryAddress aTarget) noexcept
+{
+    if (aCondition)
+    {
+        theIP.theRegisterValue = static_cast<arch::Immediate>(aTarget.theAddress);
+    }
+    return Trap::OK;
+}
+
+Trap SingleCore::JMP(arch::MemoryAddress aTarget) noexcept
+{
+    return jumpIf(true, aTarget);
+}
+
+Trap SingleCore::JMP(arch::Regs aTarget) noexcept
+{
+    return JMP(arch::MemoryAddress{.theAddress = readRegister(aTarget)});
+}
+
+Trap SingleCore::JMP(arch::Immediate aSegment, arch::Immediate aOffset) noexcept
+{
+    theCS.theRegisterValue = aSegment;
+    theIP.theRegisterValue = aOffset;
+    return Trap::OK;
+}
+
+Trap SingleCore::JA(arch::MemoryAddress aTarget) noexcept
+{
+    return jumpIf(readFlag(arch::Flags::CF) == 0 && readFlag(arch::Flags::ZF) == 0, aTarget);
+}
+
+Trap SingleCore::JAE(arch::MemoryAddress aTarget) noexcept
+{
+    return jumpIf(readFlag(arch::Flags::CF) == 0, aTarget);
+}
+
+Trap SingleCore::JB(arch::MemoryAddress aTarget) noexcept
+{
+    return jumpIf(readFlag(arch::Flags::CF) != 0, aTarget);
+}
+
+Trap SingleCore::JBE(arch::MemoryAddress aTarget) noexcept
+{
+    return jumpIf(readFlag(arch::Flags::CF) != 0 || readFlag(arch::Flags::ZF) != 0, aTarget);
+}
+
+Trap SingleCore::JC(arch::MemoryAddress aTarget) noexcept
+{
+    return JB(aTarget);
+}
+
+Trap SingleCore::JCXZ(arch::MemoryAddress aTarget) noexcept
+{
+    return jumpIf(theCX.theRegisterValue == 0, aTarget);
+}
+
+Trap SingleCore::JE(arch::MemoryAddress aTarget) noexcept
+{
+    return jumpIf(readFlag(arch::Flags::ZF) != 0, aTarget);
+}
+
+Trap SingleCore::JG(arch::MemoryAddress aTarget) noexcept
+{
+    return jumpIf(readFlag(arch::Flags::ZF) == 0 && readFlag(arch::Flags::SF) == readFlag(arch::Flags::OF), aTarget);
+}
+
+Trap SingleCore::JGE(arch::MemoryAddress aTarget) noexcept
+{
+    return jumpIf(readFlag(arch::Flags::SF) == readFlag(arch::Flags::OF), aTarget);
+}
+
+Trap SingleCore::JL(arch::MemoryAddress aTarget) noexcept
+{
+    return jumpIf(readFlag(arch::Flags::SF) != readFlag(arch::Flags::OF), aTarget);
+}
+
+Trap SingleCore::JLE(arch::MemoryAddress aTarget) noexcept
+{
+    return jumpIf(readFlag(arch::Flags::ZF) != 0 || readFlag(arch::Flags::SF) != readFlag(arch::Flags::OF), aTarget);
+}
+
+Trap SingleCore::JNA(arch::MemoryAddress aTarget) noexcept
+{
+    return JBE(aTarget);
+}
+
+Trap SingleCore::JNAE(arch::MemoryAddress aTarget) noexcept
+{
+    return JB(aTarget);
+}
+
+Trap SingleCore::JNB(arch::MemoryAddress aTarget) noexcept
+{
+    return JAE(aTarget);
+}
+
+Trap SingleCore::JNBE(arch::MemoryAddress aTarget) noexcept
+{
+    return JA(aTarget);
+}
+
+Trap SingleCore::JNC(arch::MemoryAddress aTarget) noexcept
+{
+    return JAE(aTarget);
+}
+
+Trap SingleCore::JNE(arch::MemoryAddress aTarget) noexcept
+{
+    return jumpIf(readFlag(arch::Flags::ZF) == 0, aTarget);
+}
+
+Trap SingleCore::JNG(arch::MemoryAddress aTarget) noexcept
+{
+    return JLE(aTarget);
+}
+
+Trap SingleCore::JNGE(arch::MemoryAddress aTarget) noexcept
+{
+    return JL(aTarget);
+}
+
+Trap SingleCore::JNL(arch::MemoryAddress aTarget) noexcept
+{
+    return JGE(aTarget);
+}
+
+Trap SingleCore::JNLE(arch::MemoryAddress aTarget) noexcept
+{
+    return JG(aTarget);
+}
+
+Trap SingleCore::JNO(arch::MemoryAddress aTarget) noexcept
+{
+    return jumpIf(readFlag(arch::Flags::OF) == 0, aTarget);
+}
+
+Trap SingleCore::JNP(arch::MemoryAddress aTarget) noexcept
+{
+    return jumpIf(readFlag(arch::Flags::PF) == 0, aTarget);
+}
+
+Trap SingleCore::JNS(arch::MemoryAddress aTarget) noexcept
+{
+    return jumpIf(readFlag(arch::Flags::SF) == 0, aTarget);
+}
+
+Trap SingleCore::JNZ(arch::MemoryAddress aTarget) noexcept
+{
+    return JNE(aTarget);
+}
+
+Trap SingleCore::JO(arch::MemoryAddress aTarget) noexcept
+{
+    return jumpIf(readFlag(arch::Flags::OF) != 0, aTarget);
+}
+
+Trap SingleCore::JP(arch::MemoryAddress aTarget) noexcept
+{
+    return jumpIf(readFlag(arch::Flags::PF) != 0, aTarget);
+}
+
+Trap SingleCore::JPE(arch::MemoryAddress aTarget) noexcept
+{
+    return JP(aTarget);
+}
+
+Trap SingleCore::JPO(arch::MemoryAddress aTarget) noexcept
+{
+    return JNP(aTarget);
+}
+
+Trap SingleCore::JS(arch::MemoryAddress aTarget) noexcept
+{
+    return jumpIf(readFlag(arch::Flags::SF) != 0, aTarget);
+}
+
+Trap SingleCore::JZ(arch::MemoryAddress aTarget) noexcept
+{
+    return JE(aTarget);
+}
+
+Trap SingleCore::LOOP(arch::MemoryAddress aTarget) noexcept
+{
+    theCX.theRegisterValue -= 1;
+    return jumpIf(theCX.theRegisterValue != 0, aTarget);
+}
+
+Trap SingleCore::LOOPE(arch::MemoryAddress aTarget) noexcept
+{
+    theCX.theRegisterValue -= 1;
+    return jumpIf(theCX.theRegisterValue != 0 && readFlag(arch::Flags::ZF) != 0, aTarget);
+}
+
+Trap SingleCore::LOOPNE(arch::MemoryAddress aTarget) noexcept
+{
+    theCX.theRegisterValue -= 1;
+    return jumpIf(theCX.theRegisterValue != 0 && readFlag(arch::Flags::ZF) == 0, aTarget);
+}
+
+Trap SingleCore::LOOPNZ(arch::MemoryAddress aTarget) noexcept
+{
+    return LOOPNE(aTarget);
+}
+
+Trap SingleCore::LOOPZ(arch::MemoryAddress aTarget) noexcept
+{
+    return LOOPE(aTarget);
+}
+
+Trap SingleCore::XCHG(arch::Regs aFirst, arch::Regs aSecond) noexcept
+{
+    const auto myFirst = readRegister(aFirst);
+    writeRegister(aFirst, readRegister(aSecond));
+    writeRegister(aSecond, myFirst);
+    return Trap::OK;
+}
+
+// Exchanges with memory are atomic whether or not they carry a LOCK prefix
+Trap SingleCore::XCHG(arch::Regs aFirst, arch::MemoryAddress aSecond) noexcept
+{
+    const auto [myTrap, myOld] = theMemory.exchange(aSecond, readRegister(aFirst));
+    counters::add(theCounters.theMemoryReads[std::to_underlying(arch::OperandSize::Word)]);
+    counters::add(theCounters.theMemoryWrites[std::to_underlying(arch::OperandSize::Word)]);
+    if (myTrap != Trap::OK)
+    {
+        return myTrap;
+    }
+    writeRegister(aFirst, myOld);
+    return Trap::OK;
+}
+
+Trap SingleCore::XCHG(arch::MemoryAddress aFirst, arch::Regs aSecond) noexcept
+{
+    return XCHG(aSecond, aFirst);
+}
+
 } // namespace svm
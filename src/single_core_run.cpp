@@ -0,0 +1,468 @@
+#include <algorithm>
+#include <bit>
+
+#include "block_cache.hpp"
+#include "debugger.hpp"
+#include "decoder.hpp"
+#include "guest_profiler.hpp"
+#include "memory_heatmap.hpp"
+#include "port_bus.hpp"
+#include "record_replay.hpp"
+#include "single_core.hpp"
+#include "trace.hpp"
+#include "trap.hpp"
+
+namespace svm
+{
+namespace
+{
+arch::MemoryAddress linearAddress(std::uint16_t aSegment, std::uint16_t aOffset) noexcept
+{
+    return arch::MemoryAddress{.theAddress = (std::uint32_t{aSegment} << 4) + aOffset};
+}
+} // namespace
+
+// The trace slice carries the instructions retired, tying guest progress to host time
+Trap SingleCore::run(std::size_t aBudget) noexcept
+{
+    trace::Slice mySlice{trace::Category::Run, "run"};
+    const auto myFirst = theInstructionCount;
+    Trap myTrap{};
+    if constexpr (counters::ENABLED)
+    {
+        const auto myStart = counters::hostCycles();
+        myTrap = runBlocks(aBudget);
+        theCounters.theHostCycles += counters::hostCycles() - myStart;
+        ++theCounters.theTraps[std::to_underlying(myTrap)];
+    }
+    else
+    {
+        myTrap = runBlocks(aBudget);
+    }
+    mySlice.setValue(theInstructionCount - myFirst);
+    return myTrap;
+}
+
+Trap SingleCore::runBlocks(std::size_t aBudget) noexcept
+{
+    theStopRequested = false;
+    theRunBudget = aBudget;
+    theBlockCache.enter();
+    Block *myPrevious{};
+    while (theRunBudget != 0)
+    {
+        if (theInstructionCount >= theEventHorizon || hasPendingInterrupt()) [[unlikely]]
+        {
+            if (const auto myTrap = serviceEvents(); myTrap != Trap::OK)
+            {
+                return myTrap;
+            }
+        }
+        auto &myBlock = theBlockCache.follow(myPrevious, linearAddress(theCS.theRegisterValue, theIP.theRegisterValue));
+        myPrevious = &myBlock;
+        counters::add(theCounters.theBlocks);
+        if (!theCoverage.empty())
+        {
+            recordEdge(myBlock.theBegin);
+        }
+        if (auto *myHeatmap = theMemory.heatmap(); myHeatmap != nullptr) [[unlikely]]
+        {
+            myHeatmap->record(MemoryHeatmap::Access::Execute, myBlock.theBegin / RandomAccessMemory::PageSize,
+                              blockLimit(myBlock));
+        }
+        const auto myTrap = myBlock.theIsMarked ? runMarkedBlock(myBlock) : runBlock(myBlock);
+        if (myTrap != Trap::OK)
+        {
+            return myTrap;
+        }
+    }
+    return theStopRequested ? Trap::BREAK : Trap::OK;
+}
+
+Trap SingleCore::runTo(std::uint64_t aInstruction) noexcept
+{
+    if (theInstructionCount >= aInstruction)
+    {
+        return Trap::OK;
+    }
+    theStopAt = aInstruction;
+    theEventHorizon = nextEvent();
+    const auto myTrap = run(static_cast<std::size_t>(aInstruction - theInstructionCount));
+    theStopAt = std::numeric_limits<std::uint64_t>::max();
+    theEventHorizon = nextEvent();
+    return myTrap;
+}
+
+Trap SingleCore::step() noexcept
+{
+    theBlockCache.enter();
+    const auto &myBlock = theBlockCache.lookup(linearAddress(theCS.theRegisterValue, theIP.theRegisterValue));
+    ++theInstructionCount;
+    counters::add(theCounters.theInstructions);
+    const auto myTrap = execute(myBlock.theInsts.front());
+    if (theProfiler != nullptr) [[unlikely]]
+    {
+        theProfiler->retire(1);
+    }
+    return myTrap;
+}
+
+// AFL style: the block address is scrambled so neighbouring blocks land on unrelated counters, and the previous one
+// is shifted so A to B and B to A are different edges
+void SingleCore::recordEdge(std::uint32_t aAddress) noexcept
+{
+    auto myLocation = aAddress * 0x9E3779B1U;
+    myLocation ^= myLocation >> 16;
+    ++theCoverage[(myLocation ^ thePreviousBlock) & (theCoverage.size() - 1)];
+    thePreviousBlock = myLocation >> 1;
+}
+
+void SingleCore::requestStop() noexcept
+{
+    theStopRequested = true;
+    theRunBudget = 0;
+}
+
+void SingleCore::requestYield() noexcept
+{
+    theRunBudget = 0;
+}
+
+void SingleCore::attachDebugger(Debugger *aDebugger) noexcept
+{
+    theDebugger = aDebugger;
+}
+
+BlockCache &SingleCore::blockCache() noexcept
+{
+    return theBlockCache;
+}
+
+std::uint64_t SingleCore::instructionCount() const noexcept
+{
+    return theInstructionCount;
+}
+
+void SingleCore::retire(std::uint64_t aInstructions) noexcept
+{
+    theInstructionCount += aInstructions;
+    counters::add(theCounters.theInstructions, aInstructions);
+    if (theProfiler != nullptr) [[unlikely]]
+    {
+        theProfiler->retire(aInstructions);
+    }
+}
+
+std::uint64_t SingleCore::eventDistance() noexcept
+{
+    if (theReplayer == nullptr && hasPendingInterrupt() && readFlag(arch::Flags::IF) != 0)
+    {
+        return 0;
+    }
+    return theEventHorizon - std::min(theEventHorizon, theInstructionCount);
+}
+
+const CoreCounters &SingleCore::counters() const noexcept
+{
+    return theCounters;
+}
+
+void SingleCore::resetCounters() noexcept
+{
+    theCounters = CoreCounters{};
+}
+
+void SingleCore::attachPortBus(PortBus *aPortBus) noexcept
+{
+    thePortBus = aPortBus;
+}
+
+void SingleCore::attachService(std::uint8_t aVector, InterruptService *aService) noexcept
+{
+    theServices[aVector] = aService;
+}
+
+void SingleCore::attachHypercalls(Hypercalls *aHypercalls) noexcept
+{
+    theHypercalls = aHypercalls;
+}
+
+void SingleCore::raiseInterrupt(std::uint8_t aVector) noexcept
+{
+    if (theReplayer == nullptr)
+    {
+        const auto myBit = std::uint64_t{1} << (aVector % 64U);
+        thePendingInterrupts[aVector / 64U].fetch_or(myBit, std::memory_order_release);
+    }
+}
+
+void SingleCore::clearPendingInterrupts() noexcept
+{
+    for (auto &myWord : thePendingInterrupts)
+    {
+        myWord.store(0, std::memory_order_relaxed);
+    }
+}
+
+void SingleCore::attachRecorder(Recorder *aRecorder) noexcept
+{
+    theRecorder = aRecorder;
+    if (theRecorder != nullptr)
+    {
+        theRecorder->start(theInstructionCount);
+    }
+}
+
+void SingleCore::attachCoverage(std::span<std::uint8_t> aMap) noexcept
+{
+    theCoverage = aMap;
+    thePreviousBlock = 0;
+}
+
+void SingleCore::attachProfiler(GuestProfiler *aProfiler) noexcept
+{
+    theProfiler = aProfiler;
+}
+
+void SingleCore::attachReplayer(Replayer *aReplayer) noexcept
+{
+    theReplayer = aReplayer;
+    if (theReplayer != nullptr)
+    {
+        clearPendingInterrupts();
+        theReplayer->start(theInstructionCount);
+    }
+    theEventHorizon = nextEvent();
+}
+
+Trap SingleCore::runBlock(const Block &aBlock) noexcept
+{
+    const auto mySize = blockLimit(aBlock);
+    for (std::size_t i{}; i < mySize; ++i)
+    {
+        const auto myTrap = execute(aBlock.theInsts[i]);
+        if (myTrap != Trap::OK) [[unlikely]]
+        {
+            consumeBudget(i + 1);
+            return myTrap;
+        }
+    }
+    consumeBudget(mySize);
+    return Trap::OK;
+}
+
+Trap SingleCore::runMarkedBlock(const Block &aBlock) noexcept
+{
+    const auto mySize = blockLimit(aBlock);
+    for (std::size_t i{}; i < mySize; ++i)
+    {
+        const Debugger::Location myLocation{.theSegment = theCS.theRegisterValue, .theOffset = theIP.theRegisterValue};
+        if (theDebugger != nullptr && theDebugger->shouldBreak(myLocation))
+        {
+            consumeBudget(i);
+            return Trap::BREAK;
+        }
+        const auto myTrap = execute(aBlock.theInsts[i]);
+        if (myTrap != Trap::OK)
+        {
+            consumeBudget(i + 1);
+            return myTrap;
+        }
+    }
+    consumeBudget(mySize);
+    return Trap::OK;
+}
+
+Trap SingleCore::execute(const DecodedInst &aInst) noexcept
+{
+    theIP.theRegisterValue += aInst.theLength;
+    const auto myTrap = aInst.theHandler(*this, aInst);
+    // Faults leave IP on the faulting instruction, HLT resumes after itself
+    if (myTrap != Trap::OK && myTrap != Trap::HALT) [[unlikely]]
+    {
+        theIP.theRegisterValue -= aInst.theLength;
+    }
+    return myTrap;
+}
+
+Trap SingleCore::executeLocked(const DecodedInst &aInst, DecodedInst::Handler aBody) noexcept
+{
+    // Lockable instructions change nothing but FLAGS besides their memory destination
+    const auto myFlags = theFlag.theRegisterValue;
+    while (true)
+    {
+        theLockedAccess = LockedAccess{.theIsActive = true, .theIsConflict = false, .theValue = 0};
+        const auto myTrap = aBody(*this, aInst);
+        const auto myIsConflict = theLockedAccess.theIsConflict;
+        theLockedAccess = LockedAccess{};
+        if (!myIsConflict)
+        {
+            return myTrap;
+        }
+        theFlag.theRegisterValue = myFlags;
+    }
+}
+
+// Read-modify-write instructions access their destination through these, under LOCK the store becomes a compare
+// exchange against the value read
+std::pair<Trap, arch::Immediate> SingleCore::readDestination(arch::MemoryAddress aAddress) noexcept
+{
+    const auto myResult = load(aAddress);
+    theLockedAccess.theValue = myResult.second;
+    return myResult;
+}
+
+Trap SingleCore::writeDestination(arch::MemoryAddress aAddress, arch::Immediate aValue) noexcept
+{
+    if (!theLockedAccess.theIsActive) [[likely]]
+    {
+        return store(aAddress, aValue);
+    }
+    const auto [myTrap, myIsExchanged] = theMemory.compareExchange(aAddress, theLockedAccess.theValue, aValue);
+    theLockedAccess.theIsConflict = myTrap == Trap::OK && !myIsExchanged;
+    if (myIsExchanged)
+    {
+        counters::add(theCounters.theMemoryWrites[std::to_underlying(arch::OperandSize::Word)]);
+    }
+    return myTrap;
+}
+
+// Counted here rather than in the memory, which every core shares
+std::pair<Trap, arch::Immediate> SingleCore::load(arch::MemoryAddress aAddress) noexcept
+{
+    counters::add(theCounters.theMemoryReads[std::to_underlying(arch::OperandSize::Word)]);
+    return theMemory.read(aAddress);
+}
+
+std::pair<Trap, arch::Immediate> SingleCore::loadByte(arch::MemoryAddress aAddress) noexcept
+{
+    counters::add(theCounters.theMemoryReads[std::to_underlying(arch::OperandSize::Byte)]);
+    return theMemory.readByte(aAddress);
+}
+
+Trap SingleCore::store(arch::MemoryAddress aAddress, arch::Immediate aValue) noexcept
+{
+    counters::add(theCounters.theMemoryWrites[std::to_underlying(arch::OperandSize::Word)]);
+    return theMemory.write(aAddress, aValue);
+}
+
+void SingleCore::consumeBudget(std::size_t aRetired) noexcept
+{
+    theRunBudget -= std::min(theRunBudget, aRetired);
+    theInstructionCount += aRetired;
+    counters::add(theCounters.theInstructions, aRetired);
+    if (theProfiler != nullptr) [[unlikely]]
+    {
+        theProfiler->retire(aRetired);
+    }
+}
+
+// A block is cut short when an event is due inside it
+std::size_t SingleCore::blockLimit(const Block &aBlock) const noexcept
+{
+    const auto myRemaining = theEventHorizon - theInstructionCount;
+    return static_cast<std::size_t>(std::min<std::uint64_t>(aBlock.theInsts.size(), myRemaining));
+}
+
+// Runs between blocks when an interrupt is pending or the event horizon is reached
+Trap SingleCore::serviceEvents() noexcept
+{
+    if (theReplayer != nullptr)
+    {
+        while (const auto myVector = theReplayer->interruptAt(theInstructionCount))
+        {
+            counters::add(theCounters.theInterrupts);
+            trace::instant(trace::Category::Interrupt, "interrupt", *myVector);
+            if (const auto myTrap = interrupt(*myVector); myTrap != Trap::OK)
+            {
+                return myTrap;
+            }
+            if (theProfiler != nullptr) [[unlikely]]
+            {
+                theProfiler->retire(0);
+            }
+        }
+        theEventHorizon = nextEvent();
+        return Trap::OK;
+    }
+
+    if (readFlag(arch::Flags::IF) == 0)
+    {
+        return Trap::OK;
+    }
+    const auto myVector = takePendingInterrupt();
+    if (!myVector)
+    {
+        return Trap::OK;
+    }
+    counters::add(theCounters.theInterrupts);
+    trace::instant(trace::Category::Interrupt, "interrupt", *myVector);
+    if (theRecorder != nullptr)
+    {
+        theRecorder->interrupt(theInstructionCount, *myVector);
+    }
+    const auto myTrap = interrupt(*myVector);
+    // Between blocks, the handler's instructions are the first the profiler sees in its frame
+    if (theProfiler != nullptr) [[unlikely]]
+    {
+        theProfiler->retire(0);
+    }
+    return myTrap;
+}
+
+// The next logged interrupt or the runTo boundary, whichever comes first
+std::uint64_t SingleCore::nextEvent() noexcept
+{
+    const auto myInterrupt = theReplayer != nullptr ? theReplayer->nextInterruptAt() : Replayer::NoInterrupt;
+    return std::min(myInterrupt, theStopAt);
+}
+
+// Relaxed loads keep the per block check to four reads of one cache line, the acquire happens when a vector is taken
+bool SingleCore::hasPendingInterrupt() const noexcept
+{
+    std::uint64_t myAny{};
+    for (const auto &myWord : thePendingInterrupts)
+    {
+        myAny |= myWord.load(std::memory_order_relaxed);
+    }
+    return myAny != 0;
+}
+
+// Lowest vector first, the bit is cleared atomically so a raise racing with the take is never lost
+std::optional<std::uint8_t> SingleCore::takePendingInterrupt() noexcept
+{
+    for (std::size_t i{}; i < thePendingInterrupts.size(); ++i)
+    {
+        auto myWord = thePendingInterrupts[i].load(std::memory_order_relaxed);
+        while (myWord != 0)
+        {
+            const auto myBit = myWord & (~myWord + 1);
+            if (thePendingInterrupts[i].compare_exchange_weak(myWord, myWord & ~myBit, std::memory_order_acquire,
+                                                              std::memory_order_relaxed))
+            {
+                return static_cast<std::uint8_t>(i * 64U + static_cast<std::size_t>(std::countr_zero(myBit)));
+            }
+        }
+    }
+    return std::nullopt;
+}
+
+std::uint16_t SingleCore::portIn(std::uint16_t aPort, arch::OperandSize aSize) noexcept
+{
+    counters::add(theCounters.thePortReads);
+    trace::burst(trace::Category::Port, "in");
+    if (theReplayer != nullptr)
+    {
+        const auto myValue = theReplayer->portIn(aPort);
+        // IN ends its block, so an interrupt logged right after it is seen before the next block starts
+        theEventHorizon = nextEvent();
+        return myValue;
+    }
+    const auto myValue = thePortBus != nullptr ? thePortBus->in(aPort, aSize) : PortBus::FloatingBus;
+    if (theRecorder != nullptr)
+    {
+        theRecorder->portIn(aPort, myValue);
+    }
+    return myValue;
+}
+} // namespace svm
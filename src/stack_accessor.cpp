@@ -0,0 +1,149 @@
+#include <array>
+#include <utility>
+
+#include "constants.hpp"
+#include "stack_accessor.hpp"
+
+namespace svm
+{
+StackAccessor::StackAccessor(RandomAccessMemory &aMemory, CoreCounters &aCounters, arch::Immediate aSegment,
+                             arch::Immediate &aPointer) noexcept
+    : theMemory{aMemory}, theCounters{aCounters}, theBase{std::uint32_t{aSegment} << 4}, thePointer{aPointer}
+{
+}
+
+Trap StackAccessor::push(arch::Immediate aValue) noexcept
+{
+    const auto myPointer = static_cast<arch::Immediate>(thePointer - constants::WORD_SIZE);
+    if (const auto myTrap = writeWord(myPointer, aValue); myTrap != Trap::OK)
+    {
+        return myTrap;
+    }
+    thePointer = myPointer;
+    return Trap::OK;
+}
+
+std::pair<Trap, arch::Immediate> StackAccessor::pop() noexcept
+{
+    const auto myResult = readWord(thePointer);
+    if (myResult.first == Trap::OK)
+    {
+        thePointer += constants::WORD_SIZE;
+    }
+    return myResult;
+}
+
+Trap StackAccessor::pushAll(std::span<const arch::Immediate> aValues) noexcept
+{
+    const auto myLength = aValues.size() * constants::WORD_SIZE;
+    const auto myPointer = static_cast<arch::Immediate>(thePointer - myLength);
+    if (thePointer >= myLength && aValues.size() <= MaxWords) [[likely]]
+    {
+        // Lowest address first, which is the last value pushed
+        std::array<std::uint8_t, MaxWords * constants::WORD_SIZE> myBytes{};
+        for (std::size_t i{}; i < aValues.size(); ++i)
+        {
+            const auto myValue = aValues[aValues.size() - 1 - i];
+            myBytes[i * constants::WORD_SIZE] = static_cast<std::uint8_t>(myValue & constants::BYTE_MASK);
+            myBytes[i * constants::WORD_SIZE + 1] = static_cast<std::uint8_t>(myValue >> constants::CHAR_SIZE);
+        }
+        if (const auto myTrap = theMemory.writeBlock(at(myPointer), std::span{myBytes}.first(myLength));
+            myTrap != Trap::OK)
+        {
+            return myTrap;
+        }
+        thePointer = myPointer;
+        return Trap::OK;
+    }
+
+    auto myOffset = thePointer;
+    for (const auto myValue : aValues)
+    {
+        myOffset -= constants::WORD_SIZE;
+        if (const auto myTrap = writeWord(myOffset, myValue); myTrap != Trap::OK)
+        {
+            return myTrap;
+        }
+    }
+    thePointer = myPointer;
+    return Trap::OK;
+}
+
+Trap StackAccessor::popAll(std::span<arch::Immediate> aValues) noexcept
+{
+    const auto myLength = aValues.size() * constants::WORD_SIZE;
+    if (std::size_t{thePointer} + myLength <= constants::SEGMENT_SIZE && aValues.size() <= MaxWords) [[likely]]
+    {
+        std::array<std::uint8_t, MaxWords * constants::WORD_SIZE> myBytes{};
+        if (const auto myTrap = theMemory.readBlock(at(thePointer), std::span{myBytes}.first(myLength));
+            myTrap != Trap::OK)
+        {
+            return myTrap;
+        }
+        for (std::size_t i{}; i < aValues.size(); ++i)
+        {
+            aValues[aValues.size() - 1 - i] = static_cast<arch::Immediate>(
+                myBytes[i * constants::WORD_SIZE] | (myBytes[i * constants::WORD_SIZE + 1] << constants::CHAR_SIZE));
+        }
+        thePointer += static_cast<arch::Immediate>(myLength);
+        return Trap::OK;
+    }
+
+    auto myOffset = thePointer;
+    for (auto myValue = aValues.rbegin(); myValue != aValues.rend(); ++myValue)
+    {
+        const auto [myTrap, myWord] = readWord(myOffset);
+        if (myTrap != Trap::OK)
+        {
+            return myTrap;
+        }
+        *myValue = myWord;
+        myOffset += constants::WORD_SIZE;
+    }
+    thePointer = myOffset;
+    return Trap::OK;
+}
+
+void StackAccessor::release(arch::Immediate aBytes) noexcept
+{
+    thePointer += aBytes;
+}
+
+// A word at offset 0xFFFF has its high byte at offset 0 of the segment
+Trap StackAccessor::writeWord(arch::Immediate aOffset, arch::Immediate aValue) noexcept
+{
+    if (aOffset != constants::SEGMENT_SIZE - 1) [[likely]]
+    {
+        counters::add(theCounters.theMemoryWrites[std::to_underlying(arch::OperandSize::Word)]);
+        return theMemory.write(at(aOffset), aValue);
+    }
+    counters::add(theCounters.theMemoryWrites[std::to_underlying(arch::OperandSize::Byte)], 2);
+    if (const auto myTrap = theMemory.writeByte(at(aOffset), aValue & constants::BYTE_MASK); myTrap != Trap::OK)
+    {
+        return myTrap;
+    }
+    return theMemory.writeByte(at(0), aValue >> constants::CHAR_SIZE);
+}
+
+std::pair<Trap, arch::Immediate> StackAccessor::readWord(arch::Immediate aOffset) const noexcept
+{
+    if (aOffset != constants::SEGMENT_SIZE - 1) [[likely]]
+    {
+        counters::add(theCounters.theMemoryReads[std::to_underlying(arch::OperandSize::Word)]);
+        return theMemory.read(at(aOffset));
+    }
+    counters::add(theCounters.theMemoryReads[std::to_underlying(arch::OperandSize::Byte)], 2);
+    const auto [myLowTrap, myLow] = theMemory.readByte(at(aOffset));
+    const auto [myHighTrap, myHigh] = theMemory.readByte(at(0));
+    if (myLowTrap != Trap::OK || myHighTrap != Trap::OK)
+    {
+        return {myLowTrap != Trap::OK ? myLowTrap : myHighTrap, 0};
+    }
+    return {Trap::OK, static_cast<arch::Immediate>(myLow | (myHigh << constants::CHAR_SIZE))};
+}
+
+arch::MemoryAddress StackAccessor::at(arch::Immediate aOffset) const noexcept
+{
+    return arch::MemoryAddress{.theAddress = theBase + aOffset};
+}
+} // namespace svm
@@ -0,0 +1,330 @@
+#include <algorithm>
+#include <array>
+#include <deque>
+#include <iomanip>
+#include <map>
+#include <set>
+#include <utility>
+
+#include "static_recompiler.hpp"
+
+namespace svm
+{
+namespace
+{
+using enum arch::Inst;
+using Form = DecodedInst::Form;
+
+struct NativeName
+{
+    arch::Inst theInst;
+    const char *theName;
+};
+
+// Instructions translated to direct SingleCore calls, every other one keeps its decoded handler
+constexpr std::array<NativeName, 19> NATIVE{{{ADC, "ADC"}, {AND, "AND"}, {CMP, "CMP"}, {MOV, "MOV"},
+                                              {XCHG, "XCHG"}, {INC, "INC"}, {DEC, "DEC"}, {PUSH, "PUSH"},
+                                              {POP, "POP"}, {NOP, "NOP"}, {CLC, "CLC"}, {STC, "STC"},
+                                              {CMC, "CMC"}, {CLD, "CLD"}, {STD, "STD"}, {CBW, "CBW"},
+                                              {CWD, "CWD"}, {AAA, "AAA"}, {AAS, "AAS"}}};
+
+constexpr std::array<const char *, 14> REGISTER_NAMES{"AX", "BX", "CX", "DX", "CS", "DS", "SS",
+                                                      "ES", "SP", "BP", "SI", "DI", "IP", "FLAG"};
+
+const char *nativeName(arch::Inst aInst) noexcept
+{
+    const auto myFound = std::ranges::find(NATIVE, aInst, &NativeName::theInst);
+    return myFound != NATIVE.end() ? myFound->theName : nullptr;
+}
+
+bool hasFallThrough(const DecodedInst &aInst) noexcept
+{
+    return aInst.theInst != JMP && aInst.theInst != RET && aInst.theInst != RETF && aInst.theInst != IRET;
+}
+
+std::string registerName(arch::Regs aRegister)
+{
+    return std::string{"Regs::"} + REGISTER_NAMES[std::to_underlying(aRegister)];
+}
+
+std::string hex(std::uint32_t aValue)
+{
+    std::ostringstream myOut;
+    myOut << "0x" << std::hex << std::uppercase << std::setw(4) << std::setfill('0') << aValue;
+    return myOut.str();
+}
+
+std::string memoryOperand(const DecodedInst &aInst)
+{
+    std::string myOffset = hex(aInst.theDisplacement);
+    if ((aInst.theOperandFlags & DecodedInst::HasBase) != 0)
+    {
+        myOffset = "aCore.readRegister(" + registerName(aInst.theBase) + ") + " + myOffset;
+    }
+    if ((aInst.theOperandFlags & DecodedInst::HasIndex) != 0)
+    {
+        myOffset = "aCore.readRegister(" + registerName(aInst.theIndex) + ") + " + myOffset;
+    }
+    return "at(aCore, " + registerName(aInst.theSegment) + ", static_cast<std::uint16_t>(" + myOffset + "))";
+}
+
+std::string immediate(const DecodedInst &aInst)
+{
+    return "Immediate{" + hex(aInst.theImmediate) + "}";
+}
+
+std::string nativeCall(const DecodedInst &aInst)
+{
+    std::string myOperands;
+    switch (aInst.theForm)
+    {
+    case Form::Other:
+        break;
+    case Form::RegReg:
+        myOperands = registerName(aInst.theFirst) + ", " + registerName(aInst.theSecond);
+        break;
+    case Form::RegImm:
+        myOperands = registerName(aInst.theFirst) + ", " + immediate(aInst);
+        break;
+    case Form::RegMem:
+        myOperands = registerName(aInst.theFirst) + ", " + memoryOperand(aInst);
+        break;
+    case Form::MemReg:
+        myOperands = memoryOperand(aInst) + ", " + registerName(aInst.theSecond);
+        break;
+    case Form::MemImm:
+        myOperands = memoryOperand(aInst) + ", " + immediate(aInst);
+        break;
+    case Form::Reg:
+        myOperands = registerName(aInst.theFirst);
+        break;
+    case Form::Mem:
+        myOperands = memoryOperand(aInst);
+        break;
+    case Form::Relative:
+        break;
+    }
+    return std::string{"aCore."} + nativeName(aInst.theInst) + "(" + myOperands + ")";
+}
+
+template <typename RangeT> void emitBytes(std::ostream &aStream, const RangeT &aBytes)
+{
+    for (std::size_t i{}; i < aBytes.size(); ++i)
+    {
+        aStream << (i % 16 == 0 ? "\n    " : " ") << hex(aBytes[i]).replace(2, 2, "") << ',';
+    }
+}
+
+// Prologue shared by every generated file
+constexpr const char *PROLOGUE = R"(#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <span>
+#include <utility>
+
+#include "aot_runtime.hpp"
+#include "guest_program.hpp"
+
+namespace
+{
+using svm::Trap;
+using svm::arch::Immediate;
+using svm::arch::Regs;
+
+svm::arch::MemoryAddress at(svm::SingleCore &aCore, Regs aSegment, std::uint16_t aOffset) noexcept
+{
+    return {.theAddress = (std::uint32_t{aCore.readRegister(aSegment)} << 4) + aOffset};
+}
+
+// Leaves IP on the faulting instruction like the interpreter, HLT resumes after itself
+Trap stop(svm::SingleCore &aCore, Trap aTrap, std::uint16_t aOffset, std::uint32_t aRetired,
+          std::uint32_t &aOut) noexcept
+{
+    if (aTrap != Trap::HALT)
+    {
+        aCore.writeRegister(Regs::IP, aOffset);
+    }
+    aOut = aRetired;
+    return aTrap;
+}
+)";
+} // namespace
+
+StaticRecompiler::Program StaticRecompiler::discover(RandomAccessMemory &aMemory, std::span<const std::uint8_t> aImage,
+                                                     std::uint16_t aSegment, std::uint16_t aBegin,
+                                                     std::uint16_t aEntry)
+{
+    Program myProgram{.theSegment = aSegment,
+                      .theEntry = aEntry,
+                      .theBegin = aBegin,
+                      .theImage = {aImage.begin(), aImage.end()},
+                      .theBlocks = {}};
+    const auto myBase = std::uint32_t{aSegment} << 4;
+    if (aMemory.writeBlock({.theAddress = myBase + aBegin}, aImage) != Trap::OK)
+    {
+        return myProgram;
+    }
+    const auto myEnd = std::uint32_t{aBegin} + aImage.size();
+    const auto isInside = [&](std::uint32_t aOffset) { return aOffset >= aBegin && aOffset < myEnd; };
+
+    std::map<std::uint16_t, Block> myBlocks;
+    std::deque<std::uint16_t> myWork{aEntry};
+    while (!myWork.empty())
+    {
+        const auto myStart = myWork.front();
+        myWork.pop_front();
+        if (!isInside(myStart) || myBlocks.contains(myStart))
+        {
+            continue;
+        }
+
+        Block myBlock{.theOffset = myStart, .theInstructions = {}, .theSuccessors = {}};
+        std::uint32_t myOffset = myStart;
+        while (true)
+        {
+            const auto myInst = Decoder::decode(aMemory, {.theAddress = myBase + myOffset});
+            const auto myNext = myOffset + myInst.theLength;
+            // An instruction running off the image is left to the interpreter
+            if (myInst.theLength == 0 || myNext > myEnd)
+            {
+                if (!myBlock.theInstructions.empty())
+                {
+                    myBlock.theSuccessors.push_back(static_cast<std::uint16_t>(myOffset));
+                }
+                break;
+            }
+            myBlock.theInstructions.push_back({.theOffset = static_cast<std::uint16_t>(myOffset), .theDecoded = myInst});
+            if (myInst.theForm == Form::Relative)
+            {
+                myBlock.theSuccessors.push_back(static_cast<std::uint16_t>(myNext + myInst.theImmediate));
+            }
+            if (myInst.theEndsBlock || myBlock.theInstructions.size() == MaxBlockInstructions)
+            {
+                if (!myInst.theEndsBlock || hasFallThrough(myInst))
+                {
+                    myBlock.theSuccessors.push_back(static_cast<std::uint16_t>(myNext));
+                }
+                break;
+            }
+            myOffset = myNext;
+        }
+        if (myBlock.theInstructions.empty())
+        {
+            continue;
+        }
+        myWork.insert(myWork.end(), myBlock.theSuccessors.begin(), myBlock.theSuccessors.end());
+        myBlocks.emplace(myStart, std::move(myBlock));
+    }
+
+    for (auto &[myOffset, myBlock] : myBlocks)
+    {
+        myProgram.theBlocks.push_back(std::move(myBlock));
+    }
+    return myProgram;
+}
+
+bool StaticRecompiler::isNative(const DecodedInst &aInst) noexcept
+{
+    if (aInst.theEndsBlock || aInst.theIsLocked || nativeName(aInst.theInst) == nullptr ||
+        aInst.theForm == Form::Relative)
+    {
+        return false;
+    }
+    // XCHG with memory is atomic, its handler knows how
+    if (aInst.theInst == XCHG && aInst.theForm != Form::RegReg)
+    {
+        return false;
+    }
+    // The operand-less forms of the two operand instructions do not exist, anything else is a decoder special case
+    const auto myHasOperands = aInst.theForm != Form::Other;
+    const auto myIsOperandless = aInst.theInst == NOP || aInst.theInst == CLC || aInst.theInst == STC ||
+                                 aInst.theInst == CMC || aInst.theInst == CLD || aInst.theInst == STD ||
+                                 aInst.theInst == CBW || aInst.theInst == CWD || aInst.theInst == AAA ||
+                                 aInst.theInst == AAS;
+    return myHasOperands != myIsOperandless;
+}
+
+void StaticRecompiler::emit(std::ostream &aStream, const Program &aProgram, std::string_view aName)
+{
+    aStream << "// Generated by SvmAot from " << aName << ", " << aProgram.theBlocks.size() << " blocks\n"
+            << PROLOGUE << "\nconstexpr std::array<std::uint8_t, " << aProgram.theImage.size() << "> Image{";
+    emitBytes(aStream, aProgram.theImage);
+    aStream << "\n};\n";
+
+    for (std::size_t myIndex{}; myIndex < aProgram.theBlocks.size(); ++myIndex)
+    {
+        const auto &myBlock = aProgram.theBlocks[myIndex];
+        const auto &myLast = myBlock.theInstructions.back();
+        const auto myEnd = myLast.theOffset + myLast.theDecoded.theLength;
+        std::vector<std::uint16_t> myInterpreted;
+
+        aStream << "\n// " << hex(aProgram.theSegment).substr(2) << ':' << hex(myBlock.theOffset).substr(2) << '\n'
+                << "Trap block" << myIndex
+                << "(svm::SingleCore &aCore, [[maybe_unused]] const svm::DecodedInst *aInterpreted, "
+                   "std::uint32_t &aRetired) noexcept\n{\n    Trap myTrap{};\n";
+        for (std::size_t i{}; i < myBlock.theInstructions.size(); ++i)
+        {
+            const auto &[myOffset, myInst] = myBlock.theInstructions[i];
+            aStream << "    //";
+            for (std::size_t myByte{}; myByte < myInst.theLength; ++myByte)
+            {
+                aStream << ' ' << hex(aProgram.theImage[myOffset - aProgram.theBegin + myByte]).substr(4);
+            }
+            aStream << '\n';
+            std::string myCall;
+            if (isNative(myInst))
+            {
+                myCall = nativeCall(myInst);
+            }
+            else
+            {
+                // Handlers expect IP past the instruction, as the interpreter leaves it
+                aStream << "    aCore.writeRegister(Regs::IP, " << hex(myOffset + myInst.theLength) << ");\n";
+                myCall = "aInterpreted[" + std::to_string(myInterpreted.size()) + "].theHandler(aCore, aInterpreted[" +
+                         std::to_string(myInterpreted.size()) + "])";
+                myInterpreted.push_back(myOffset);
+            }
+            aStream << "    if ((myTrap = " << myCall << ") != Trap::OK)\n    {\n        return stop(aCore, myTrap, "
+                    << hex(myOffset) << ", " << i + 1 << ", aRetired);\n    }\n";
+        }
+        if (isNative(myLast.theDecoded))
+        {
+            aStream << "    aCore.writeRegister(Regs::IP, " << hex(myEnd) << ");\n";
+        }
+        aStream << "    aRetired = " << myBlock.theInstructions.size() << ";\n    return Trap::OK;\n}\n";
+
+        aStream << "constexpr std::array<std::uint8_t, " << myEnd - myBlock.theOffset << "> Bytes" << myIndex << "{";
+        emitBytes(aStream, std::span{aProgram.theImage}.subspan(myBlock.theOffset - aProgram.theBegin,
+                                                                 myEnd - myBlock.theOffset));
+        aStream << "\n};\nconstexpr std::array<std::uint16_t, " << myInterpreted.size() << "> Interpreted" << myIndex
+                << "{";
+        for (const auto myOffset : myInterpreted)
+        {
+            aStream << hex(myOffset) << ", ";
+        }
+        aStream << "};\n";
+    }
+
+    aStream << "\nconst std::array<svm::CompiledBlock, " << aProgram.theBlocks.size() << "> Blocks{{\n";
+    for (std::size_t myIndex{}; myIndex < aProgram.theBlocks.size(); ++myIndex)
+    {
+        const auto &myBlock = aProgram.theBlocks[myIndex];
+        aStream << "    {.theSegment = " << hex(aProgram.theSegment) << ", .theOffset = " << hex(myBlock.theOffset)
+                << ", .theBytes = Bytes" << myIndex << ", .theInstructions = " << myBlock.theInstructions.size()
+                << ", .theInterpreted = Interpreted" << myIndex << ", .theBody = &block" << myIndex << "},\n";
+    }
+    aStream << "}};\n} // namespace\n\n"
+            << "int main()\n{\n"
+            << "    const auto myResult = svm::GuestProgram::run(Image, svm::GuestProgram::DefaultBudget, Blocks);\n"
+            << "    std::cout << \"" << aName << ": \" << svm::TRAP_NAMES[std::to_underlying(myResult.theTrap)] "
+               "<< \" after \" << myResult.theInstructions\n"
+            << "              << \" instructions in \" << std::fixed << std::setprecision(3) << myResult.theSeconds "
+               "<< \" s, \"\n"
+            << "              << std::setprecision(1) << myResult.mips() << \" MIPS, AX=\" << std::hex << "
+               "std::uppercase\n"
+            << "              << std::setw(4) << std::setfill('0') << myResult.theAX << '\\n';\n"
+            << "    return myResult.theTrap == Trap::HALT ? EXIT_SUCCESS : EXIT_FAILURE;\n}\n";
+}
+} // namespace svm
@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <array>
+#include <fstream>
+
+#include "constants.hpp"
+#include "text_video.hpp"
+#include "trace.hpp"
+#include "trap.hpp"
+
+namespace svm
+{
+namespace
+{
+// CGA colour index to ANSI colour index
+constexpr std::array<std::uint8_t, 8> ANSI_COLOR{0, 4, 2, 6, 1, 5, 3, 7};
+
+char printable(std::uint8_t aCharacter) noexcept
+{
+    if (aCharacter == 0)
+    {
+        return ' ';
+    }
+    return (aCharacter >= 0x20 && aCharacter < 0x7F) ? static_cast<char>(aCharacter) : '.';
+}
+} // namespace
+
+TextModeVideo::TextModeVideo(RandomAccessMemory &aMemory) : theMemory{aMemory}
+{
+    theMemory.attachObserver(*this, BaseAddress, BufferSize);
+}
+
+TextModeVideo::~TextModeVideo()
+{
+    theMemory.detachObserver(*this);
+}
+
+void TextModeVideo::onWrite(arch::MemoryAddress aMemoryAddress, std::size_t aLength) noexcept
+{
+    const auto myBegin = std::max(aMemoryAddress.theAddress, BaseAddress.theAddress) - BaseAddress.theAddress;
+    const auto myEnd = std::min<std::size_t>(aMemoryAddress.theAddress + aLength - BaseAddress.theAddress, BufferSize);
+    for (std::size_t myIndex = myBegin / CellSize; myIndex * CellSize < myEnd; ++myIndex)
+    {
+        markDirty(myIndex);
+    }
+}
+
+void TextModeVideo::markDirty(std::size_t aIndex) noexcept
+{
+    if (!theDirtyBits.test(aIndex))
+    {
+        theDirtyBits.set(aIndex);
+        theDirtyList[theDirtyCount++] = static_cast<std::uint16_t>(aIndex);
+    }
+}
+
+TextModeVideo::Cell TextModeVideo::cell(std::size_t aIndex) const noexcept
+{
+    const arch::MemoryAddress myAddress{.theAddress = static_cast<std::uint32_t>(BaseAddress.theAddress + aIndex * CellSize)};
+    const auto [myCharTrap, myCharacter] = theMemory.readByte(myAddress);
+    const auto [myAttrTrap, myAttribute] = theMemory.readByte({.theAddress = myAddress.theAddress + 1});
+    if (myCharTrap != Trap::OK || myAttrTrap != Trap::OK)
+    {
+        return Cell{};
+    }
+    return Cell{.theCharacter = static_cast<std::uint8_t>(myCharacter),
+                .theAttribute = static_cast<std::uint8_t>(myAttribute)};
+}
+
+std::size_t TextModeVideo::dirtyCount() const noexcept
+{
+    return theDirtyCount;
+}
+
+std::span<const std::uint16_t> TextModeVideo::dirtyCells() const noexcept
+{
+    return std::span<const std::uint16_t>{theDirtyList.data(), theDirtyCount};
+}
+
+void TextModeVideo::clearDirty() noexcept
+{
+    for (std::size_t i{}; i < theDirtyCount; ++i)
+    {
+        theDirtyBits.reset(theDirtyList[i]);
+    }
+    theDirtyCount = 0;
+}
+
+void TextModeVideo::markAllDirty() noexcept
+{
+    for (std::size_t i{}; i < CellCount; ++i)
+    {
+        markDirty(i);
+    }
+}
+
+HeadlessRenderer::HeadlessRenderer(TextModeVideo &aVideo, std::ostream &aStream, Mode aMode) noexcept
+    : theVideo{aVideo}, theStream{aStream}, theMode{aMode}
+{
+}
+
+std::size_t HeadlessRenderer::flush()
+{
+    const auto myDirty = theVideo.dirtyCells();
+    const auto myCount = myDirty.size();
+    trace::Slice mySlice{trace::Category::HostIo, "text flush", myCount};
+
+    // Row major order lets neighbouring cells share a single cursor move
+    std::array<std::uint16_t, TextModeVideo::CellCount> mySorted;
+    std::copy(myDirty.begin(), myDirty.end(), mySorted.begin());
+    std::sort(mySorted.begin(), mySorted.begin() + myCount);
+    theVideo.clearDirty();
+
+    for (std::size_t i{}; i < myCount; ++i)
+    {
+        const auto myIndex = mySorted[i];
+        const auto myCell = theVideo.cell(myIndex);
+        if (theMode == Mode::Terminal)
+        {
+            emitTerminal(myIndex, myCell);
+        }
+        else
+        {
+            emitLog(myIndex, myCell);
+        }
+    }
+    if (myCount != 0)
+    {
+        theStream.flush();
+        theScreenshotPending = true;
+    }
+
+    ++theFrame;
+    if (theScreenshotPeriod != 0 && theScreenshotPending && theFrame % theScreenshotPeriod == 0)
+    {
+        theScreenshotPending = !writeScreenshot(theScreenshotPath);
+    }
+    return myCount;
+}
+
+void HeadlessRenderer::enableScreenshots(std::filesystem::path aPath, std::size_t aPeriod)
+{
+    theScreenshotPath = std::move(aPath);
+    theScreenshotPeriod = aPeriod;
+    theScreenshotPending = true;
+}
+
+bool HeadlessRenderer::writeScreenshot(const std::filesystem::path &aPath) const
+{
+    std::ofstream myFile{aPath, std::ios::trunc};
+    if (!myFile)
+    {
+        return false;
+    }
+    std::array<char, TextModeVideo::Columns + 1> myLine;
+    myLine.back() = '\n';
+    for (std::size_t myRow{}; myRow < TextModeVideo::Rows; ++myRow)
+    {
+        for (std::size_t myColumn{}; myColumn < TextModeVideo::Columns; ++myColumn)
+        {
+            myLine[myColumn] = printable(theVideo.cell(myRow * TextModeVideo::Columns + myColumn).theCharacter);
+        }
+        myFile.write(myLine.data(), myLine.size());
+    }
+    return static_cast<bool>(myFile);
+}
+
+void HeadlessRenderer::emitTerminal(std::uint16_t aIndex, TextModeVideo::Cell aCell)
+{
+    if (aIndex != theCursor)
+    {
+        theStream << "\x1b[" << (aIndex / TextModeVideo::Columns + 1) << ';' << (aIndex % TextModeVideo::Columns + 1)
+                  << 'H';
+    }
+    if (aCell.theAttribute != theLastAttribute)
+    {
+        const auto myForeground = aCell.theAttribute & 0x0F;
+        const auto myBackground = (aCell.theAttribute >> 4) & 0x07;
+        const auto myForegroundBase = myForeground >= 8 ? 90 : 30;
+        theStream << "\x1b[0;" << (myForegroundBase + ANSI_COLOR[myForeground & 0x07]) << ';'
+                  << (40 + ANSI_COLOR[myBackground]) << 'm';
+        theLastAttribute = aCell.theAttribute;
+    }
+    theStream << printable(aCell.theCharacter);
+    // The terminal cursor advances by itself, except past the last column where it does not wrap reliably
+    theCursor = (aIndex % TextModeVideo::Columns == TextModeVideo::Columns - 1) ? TextModeVideo::CellCount : aIndex + 1;
+}
+
+void HeadlessRenderer::emitLog(std::uint16_t aIndex, TextModeVideo::Cell aCell)
+{
+    constexpr auto HEX_DIGITS = "0123456789ABCDEF";
+    theStream << (aIndex / TextModeVideo::Columns) << ',' << (aIndex % TextModeVideo::Columns) << ' '
+              << printable(aCell.theCharacter) << ' ' << HEX_DIGITS[aCell.theAttribute >> 4]
+              << HEX_DIGITS[aCell.theAttribute & 0x0F] << '\n';
+}
+} // namespace svm
@@ -0,0 +1,258 @@
+#include <array>
+#include <fstream>
+#include <iomanip>
+#include <utility>
+
+#include "trace.hpp"
+
+namespace svm
+{
+namespace
+{
+// Nanoseconds, a burst event closer than this to the end of the previous one extends it
+constexpr std::uint64_t BURST_GAP = 2000U;
+
+constexpr std::array<const char *, 7> CATEGORY_NAMES{"run",  "block_cache", "interrupt", "device",
+                                                    "port", "service",     "host_io"};
+
+std::atomic<std::uint64_t> theGenerations{};
+
+struct ThreadBuffer
+{
+    std::uint64_t theGeneration;
+    void *theBuffer;
+};
+thread_local ThreadBuffer theThreadBuffer{};
+
+// Microseconds with three decimals, as the format wants them
+void writeMicroseconds(std::ostream &aStream, std::uint64_t aNanoseconds)
+{
+    aStream << aNanoseconds / 1000U << '.' << std::setw(3) << std::setfill('0') << aNanoseconds % 1000U
+            << std::setfill(' ');
+}
+
+void writeString(std::ostream &aStream, const std::string &aText)
+{
+    aStream << '"';
+    for (const auto myChar : aText)
+    {
+        if (myChar == '"' || myChar == '\\')
+        {
+            aStream << '\\';
+        }
+        aStream << (static_cast<unsigned char>(myChar) < 0x20 ? ' ' : myChar);
+    }
+    aStream << '"';
+}
+} // namespace
+
+namespace trace
+{
+void recordInstant(Category aCategory, const char *aName, std::uint64_t aValue) noexcept
+{
+    auto *mySession = theActiveSession.load(std::memory_order_acquire);
+    if (mySession == nullptr)
+    {
+        return;
+    }
+    if (auto *myBuffer = mySession->buffer(); myBuffer != nullptr)
+    {
+        mySession->append(*myBuffer, Event{.theName = aName,
+                                           .theBegin = now() - mySession->theStart,
+                                           .theDuration = 0,
+                                           .theValue = aValue,
+                                           .theCategory = aCategory,
+                                           .theIsSlice = false});
+    }
+}
+
+void recordBurst(Category aCategory, const char *aName) noexcept
+{
+    auto *mySession = theActiveSession.load(std::memory_order_acquire);
+    if (mySession == nullptr)
+    {
+        return;
+    }
+    auto *myBuffer = mySession->buffer();
+    if (myBuffer == nullptr)
+    {
+        return;
+    }
+    const auto myNow = now() - mySession->theStart;
+    if (!myBuffer->theEvents.empty())
+    {
+        auto &myLast = myBuffer->theEvents.back();
+        if (myLast.theIsSlice && myLast.theName == aName && myLast.theCategory == aCategory &&
+            myNow - (myLast.theBegin + myLast.theDuration) < BURST_GAP)
+        {
+            myLast.theDuration = myNow - myLast.theBegin;
+            ++myLast.theValue;
+            return;
+        }
+    }
+    mySession->append(*myBuffer, Event{.theName = aName,
+                                       .theBegin = myNow,
+                                       .theDuration = 0,
+                                       .theValue = 1,
+                                       .theCategory = aCategory,
+                                       .theIsSlice = true});
+}
+
+// A slice begun before the session started is left out
+void recordSlice(Category aCategory, const char *aName, std::uint64_t aBegin, std::uint64_t aValue) noexcept
+{
+    auto *mySession = theActiveSession.load(std::memory_order_acquire);
+    if (mySession == nullptr || aBegin < mySession->theStart)
+    {
+        return;
+    }
+    if (auto *myBuffer = mySession->buffer(); myBuffer != nullptr)
+    {
+        mySession->append(*myBuffer, Event{.theName = aName,
+                                           .theBegin = aBegin - mySession->theStart,
+                                           .theDuration = now() - aBegin,
+                                           .theValue = aValue,
+                                           .theCategory = aCategory,
+                                           .theIsSlice = true});
+    }
+}
+
+void nameThread(std::string aName)
+{
+    auto *mySession = theActiveSession.load(std::memory_order_acquire);
+    if (mySession == nullptr)
+    {
+        return;
+    }
+    if (auto *myBuffer = mySession->buffer(); myBuffer != nullptr)
+    {
+        myBuffer->theName = std::move(aName);
+    }
+}
+} // namespace trace
+
+TraceSession::TraceSession(std::size_t aCapacity)
+    : theCapacity{aCapacity}, theStart{trace::now()},
+      theGeneration{theGenerations.fetch_add(1, std::memory_order_relaxed) + 1}
+{
+    trace::theActiveSession.store(this, std::memory_order_release);
+}
+
+TraceSession::~TraceSession()
+{
+    stop();
+}
+
+void TraceSession::stop() noexcept
+{
+    auto *mySelf = this;
+    trace::theActiveSession.compare_exchange_strong(mySelf, nullptr, std::memory_order_acq_rel);
+}
+
+// The first event of a thread allocates its whole buffer, so recording never reallocates
+TraceSession::Buffer *TraceSession::buffer() noexcept
+{
+    if (theThreadBuffer.theGeneration == theGeneration)
+    {
+        return static_cast<Buffer *>(theThreadBuffer.theBuffer);
+    }
+    try
+    {
+        auto myBuffer = std::make_unique<Buffer>();
+        myBuffer->theEvents.reserve(theCapacity);
+        std::lock_guard myGuard{theLock};
+        myBuffer->theName = "thread " + std::to_string(theBuffers.size());
+        theBuffers.push_back(std::move(myBuffer));
+        theThreadBuffer = ThreadBuffer{.theGeneration = theGeneration, .theBuffer = theBuffers.back().get()};
+        return theBuffers.back().get();
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+void TraceSession::append(Buffer &aBuffer, const trace::Event &aEvent) noexcept
+{
+    if (aBuffer.theEvents.size() == theCapacity)
+    {
+        ++aBuffer.theDropped;
+        return;
+    }
+    aBuffer.theEvents.push_back(aEvent);
+}
+
+std::size_t TraceSession::eventCount() const
+{
+    std::lock_guard myGuard{theLock};
+    std::size_t myCount{};
+    for (const auto &myBuffer : theBuffers)
+    {
+        myCount += myBuffer->theEvents.size();
+    }
+    return myCount;
+}
+
+std::size_t TraceSession::dropped() const
+{
+    std::lock_guard myGuard{theLock};
+    std::size_t myCount{};
+    for (const auto &myBuffer : theBuffers)
+    {
+        myCount += myBuffer->theDropped;
+    }
+    return myCount;
+}
+
+std::vector<trace::Event> TraceSession::events(std::size_t aThread) const
+{
+    std::lock_guard myGuard{theLock};
+    return aThread < theBuffers.size() ? theBuffers[aThread]->theEvents : std::vector<trace::Event>{};
+}
+
+std::size_t TraceSession::threadCount() const
+{
+    std::lock_guard myGuard{theLock};
+    return theBuffers.size();
+}
+
+// Threads are numbered in the order they first recorded, all under one process
+void TraceSession::write(std::ostream &aStream) const
+{
+    std::lock_guard myGuard{theLock};
+    std::size_t myDropped{};
+    aStream << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    const char *mySeparator = "\n";
+    for (std::size_t myThread{}; myThread < theBuffers.size(); ++myThread)
+    {
+        const auto &myBuffer = *theBuffers[myThread];
+        myDropped += myBuffer.theDropped;
+        aStream << mySeparator << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << myThread
+                << ",\"args\":{\"name\":";
+        writeString(aStream, myBuffer.theName);
+        aStream << "}}";
+        mySeparator = ",\n";
+        for (const auto &myEvent : myBuffer.theEvents)
+        {
+            aStream << mySeparator << "{\"ph\":\"" << (myEvent.theIsSlice ? "X" : "i\",\"s\":\"t")
+                    << "\",\"cat\":\"" << CATEGORY_NAMES[std::to_underlying(myEvent.theCategory)]
+                    << "\",\"name\":\"" << myEvent.theName << "\",\"pid\":1,\"tid\":" << myThread << ",\"ts\":";
+            writeMicroseconds(aStream, myEvent.theBegin);
+            if (myEvent.theIsSlice)
+            {
+                aStream << ",\"dur\":";
+                writeMicroseconds(aStream, myEvent.theDuration);
+            }
+            aStream << ",\"args\":{\"value\":" << myEvent.theValue << "}}";
+        }
+    }
+    aStream << "\n],\"otherData\":{\"dropped\":\"" << myDropped << "\"}}\n";
+}
+
+bool TraceSession::writeFile(const std::filesystem::path &aPath) const
+{
+    std::ofstream myFile{aPath, std::ios::trunc};
+    write(myFile);
+    return static_cast<bool>(myFile);
+}
+} // namespace svm
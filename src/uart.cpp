@@ -0,0 +1,252 @@
+#include <array>
+#include <cerrno>
+#include <tuple>
+
+#include <unistd.h>
+
+#include "single_core.hpp"
+#include "trace.hpp"
+#include "uart.hpp"
+
+namespace svm
+{
+namespace
+{
+constexpr std::uint8_t DivisorLatchAccess = 1U << 7;
+constexpr std::uint8_t FifoEnable = 1U << 0;
+// Clear to send, data set ready and carrier detect, the host end is always there
+constexpr std::uint8_t ModemReady = 0xB0;
+
+enum InterruptIdValue : std::uint8_t
+{
+    NonePending = 0x01,
+    TransmitEmpty = 0x02,
+    DataAvailable = 0x04,
+    FifosEnabled = 0xC0,
+};
+} // namespace
+
+Uart::Uart(SingleCore &aCore, int aFd, std::uint16_t aBasePort, std::uint8_t aVector, std::size_t aBatchSize,
+           std::uint64_t aFlushDelay)
+    : theCore{aCore}, theFd{aFd}, theBasePort{aBasePort}, theVector{aVector}, theBatchSize{aBatchSize},
+      theFlushDelay{aFlushDelay}
+{
+    theTransmit.reserve(theBatchSize);
+}
+
+bool Uart::attachScheduler(DeviceScheduler &aScheduler)
+{
+    theChannel.emplace(aScheduler);
+    return aScheduler.spawn(&Uart::drain, *this);
+}
+
+Uart::~Uart()
+{
+    flush();
+}
+
+std::uint16_t Uart::in(std::uint16_t aPort, arch::OperandSize) noexcept
+{
+    switch (static_cast<Register>(aPort - theBasePort))
+    {
+    case Data:
+        if (isDivisorLatched())
+        {
+            return theDivisor & 0xFF;
+        }
+        if (const auto myByte = theReceive.tryPop())
+        {
+            theReceived = *myByte;
+            if ((theInterruptEnable.load(std::memory_order_relaxed) & ReceiveInterrupt) != 0 && !theReceive.isEmpty())
+            {
+                theCore.raiseInterrupt(theVector);
+            }
+        }
+        return theReceived;
+    case InterruptEnable:
+        return isDivisorLatched() ? theDivisor >> 8 : theInterruptEnable.load(std::memory_order_relaxed);
+    case InterruptId:
+        return interruptId();
+    case LineControl:
+        return theLineControl;
+    case ModemControl:
+        return theModemControl;
+    case LineStatus: {
+        std::uint8_t myStatus = TransmitHoldingEmpty | TransmitterEmpty;
+        if (!theReceive.isEmpty())
+        {
+            myStatus |= DataReady;
+        }
+        // Overrun clears on read like the real register
+        if (theOverrun.exchange(false, std::memory_order_relaxed))
+        {
+            myStatus |= OverrunError;
+        }
+        return myStatus;
+    }
+    case ModemStatus:
+        return ModemReady;
+    case Scratch:
+        return theScratch;
+    }
+    return 0xFF;
+}
+
+void Uart::out(std::uint16_t aPort, std::uint16_t aValue, arch::OperandSize) noexcept
+{
+    const auto myByte = static_cast<std::uint8_t>(aValue);
+    switch (static_cast<Register>(aPort - theBasePort))
+    {
+    case Data:
+        if (isDivisorLatched())
+        {
+            theDivisor = static_cast<std::uint16_t>((theDivisor & 0xFF00) | myByte);
+            return;
+        }
+        theTransmit.push_back(myByte);
+        ++theTransmitted;
+        if (theTransmit.size() >= theBatchSize ||
+            (myByte == '\n' && theCore.instructionCount() >= theNextLineFlush))
+        {
+            flush();
+        }
+        else if (theTransmit.size() == 1 && theChannel)
+        {
+            theChannel->post(PortAccess{.thePort = aPort, .theValue = myByte, .theIsWrite = true});
+        }
+        // The byte left at once, the holding register is empty again
+        if ((theInterruptEnable.load(std::memory_order_relaxed) & TransmitInterrupt) != 0)
+        {
+            theTransmitPending = true;
+            theCore.raiseInterrupt(theVector);
+        }
+        return;
+    case InterruptEnable:
+        if (isDivisorLatched())
+        {
+            theDivisor = static_cast<std::uint16_t>((theDivisor & 0x00FF) | (myByte << 8));
+            return;
+        }
+        theInterruptEnable.store(myByte & (ReceiveInterrupt | TransmitInterrupt), std::memory_order_relaxed);
+        // Enabling the transmit interrupt with an empty holding register interrupts straight away
+        theTransmitPending = (myByte & TransmitInterrupt) != 0;
+        if (theTransmitPending || ((myByte & ReceiveInterrupt) != 0 && !theReceive.isEmpty()))
+        {
+            theCore.raiseInterrupt(theVector);
+        }
+        return;
+    case InterruptId:
+        theFifoControl = myByte;
+        return;
+    case LineControl:
+        theLineControl = myByte;
+        return;
+    case ModemControl:
+        theModemControl = myByte;
+        return;
+    case LineStatus:
+    case ModemStatus:
+        return;
+    case Scratch:
+        theScratch = myByte;
+        return;
+    }
+}
+
+bool Uart::flush() noexcept
+{
+    if (theTransmit.empty())
+    {
+        return true;
+    }
+    ++theFlushes;
+    theNextLineFlush = theCore.instructionCount() + theFlushDelay;
+    trace::Slice mySlice{trace::Category::HostIo, "uart flush", theTransmit.size()};
+    std::size_t myWritten{};
+    while (theFd >= 0 && myWritten < theTransmit.size())
+    {
+        const auto myResult = ::write(theFd, theTransmit.data() + myWritten, theTransmit.size() - myWritten);
+        if (myResult < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (myResult <= 0)
+        {
+            theTransmit.clear();
+            return false;
+        }
+        myWritten += static_cast<std::size_t>(myResult);
+    }
+    theTransmit.clear();
+    return true;
+}
+
+DeviceTask Uart::drain(DeviceScheduler &aScheduler, Uart &aUart)
+{
+    while (true)
+    {
+        std::ignore = co_await *aUart.theChannel;
+        co_await aScheduler.delay(aUart.theFlushDelay);
+        while (aUart.theChannel->tryReceive())
+        {
+        }
+        aUart.flush();
+    }
+}
+
+void Uart::receive(std::uint8_t aByte) noexcept
+{
+    if (!theReceive.tryPush(aByte))
+    {
+        theOverrun.store(true, std::memory_order_relaxed);
+        return;
+    }
+    if ((theInterruptEnable.load(std::memory_order_relaxed) & ReceiveInterrupt) != 0)
+    {
+        theCore.raiseInterrupt(theVector);
+    }
+}
+
+long Uart::receiveFrom(int aFd) noexcept
+{
+    std::array<std::uint8_t, 256> myBuffer;
+    const auto myResult = ::read(aFd, myBuffer.data(), myBuffer.size());
+    for (long i{}; i < myResult; ++i)
+    {
+        receive(myBuffer[static_cast<std::size_t>(i)]);
+    }
+    return myResult;
+}
+
+std::uint64_t Uart::transmitted() const noexcept
+{
+    return theTransmitted;
+}
+
+std::uint64_t Uart::flushes() const noexcept
+{
+    return theFlushes;
+}
+
+// Received data outranks the transmit interrupt, reading the transmit identification acknowledges it
+std::uint8_t Uart::interruptId() noexcept
+{
+    const std::uint8_t myFifos = (theFifoControl & FifoEnable) != 0 ? FifosEnabled : 0;
+    const auto myEnable = theInterruptEnable.load(std::memory_order_relaxed);
+    if ((myEnable & ReceiveInterrupt) != 0 && !theReceive.isEmpty())
+    {
+        return myFifos | DataAvailable;
+    }
+    if ((myEnable & TransmitInterrupt) != 0 && theTransmitPending)
+    {
+        theTransmitPending = false;
+        return myFifos | TransmitEmpty;
+    }
+    return myFifos | NonePending;
+}
+
+bool Uart::isDivisorLatched() const noexcept
+{
+    return (theLineControl & DivisorLatchAccess) != 0;
+}
+} // namespace svm
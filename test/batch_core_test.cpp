@@ -0,0 +1,155 @@
+#include "arch.hpp"
+#include "batch_core.hpp"
+#include "guest_fixture.hpp"
+#include "memory.hpp"
+#include "single_core.hpp"
+#include "trap.hpp"
+
+#include <functional>
+#include <gtest/gtest.h>
+#include <initializer_list>
+
+namespace
+{
+using Trap = svm::Trap;
+using Regs = svm::arch::Regs;
+
+constexpr std::uint32_t CodeAddress = 0x100;
+constexpr std::uint32_t ResultAddress = 0x200;
+using svm::test::load;
+
+// Runs every lane on its own SingleCore and checks the batch ended in the same state
+void expectSameAsSingleCore(svm::BatchCore &aBatch, std::initializer_list<std::uint8_t> aCode,
+                            const std::function<void(std::size_t, svm::SingleCore &)> &aSetup)
+{
+    for (std::size_t myLane{}; myLane < aBatch.laneCount(); ++myLane)
+    {
+        svm::RandomAccessMemory myMemory;
+        load(myMemory, CodeAddress, aCode);
+        svm::SingleCore myCore{myMemory};
+        myCore.writeRegister(Regs::IP, CodeAddress);
+        aSetup(myLane, myCore);
+        EXPECT_EQ(myCore.run(10000), aBatch.trap(myLane));
+
+        for (std::size_t i{}; i < svm::BatchCore::RegisterCount; ++i)
+        {
+            const auto myRegister = static_cast<Regs>(i);
+            EXPECT_EQ(aBatch.readRegister(myLane, myRegister), myCore.readRegister(myRegister))
+                << "lane " << myLane << " register " << i;
+        }
+        EXPECT_EQ(aBatch.memory(myLane).read({.theAddress = ResultAddress}).second,
+                  myMemory.read({.theAddress = ResultAddress}).second);
+    }
+}
+} // namespace
+
+TEST(BatchCoreTest, UniformControlFlowStaysInOneGroup)
+{
+    // MOV CX, 10; again: ADC AX, BX; INC DX; AND SI, 0x0FF0; LOOP again; MOV [0x200], AX; HLT
+    const std::initializer_list<std::uint8_t> myCode{0xB9, 0x0A, 0x00, 0x11, 0xD8, 0x42, 0x81, 0xE6, 0xF0, 0x0F,
+                                                     0xE2, 0xF7, 0x89, 0x06, 0x00, 0x02, 0xF4};
+    svm::RandomAccessMemory myImage;
+    load(myImage, CodeAddress, myCode);
+    svm::BatchCore myBatch{myImage, 37};
+    myBatch.writeRegister(Regs::IP, CodeAddress);
+    const auto mySetup = [](std::size_t aLane, auto &&aWrite) {
+        aWrite(Regs::AX, static_cast<std::uint16_t>(0xFFF0 + aLane * 977));
+        aWrite(Regs::BX, static_cast<std::uint16_t>(aLane * 4099));
+        aWrite(Regs::SI, static_cast<std::uint16_t>(aLane * 31));
+    };
+    for (std::size_t myLane{}; myLane < myBatch.laneCount(); ++myLane)
+    {
+        mySetup(myLane, [&](Regs aRegister, std::uint16_t aValue) { myBatch.writeRegister(myLane, aRegister, aValue); });
+    }
+
+    EXPECT_EQ(myBatch.run(1000), 0U);
+    EXPECT_EQ(myBatch.stats().theIssues, 1U + 10U * 4U + 2U);
+    EXPECT_EQ(myBatch.stats().theDivergences, 0U);
+    EXPECT_EQ(myBatch.stats().theVectorLaneSteps, 37U * (1U + 10U * 4U + 1U));
+    expectSameAsSingleCore(myBatch, myCode, [&](std::size_t aLane, svm::SingleCore &aCore) {
+        mySetup(aLane, [&](Regs aRegister, std::uint16_t aValue) { aCore.writeRegister(aRegister, aValue); });
+    });
+}
+
+TEST(BatchCoreTest, DivergentLanesReconverge)
+{
+    // CMP AX, 5; JL less; MOV BX, 1; JMP done; less: MOV BX, 2; ADC BX, AX; done: XCHG AX, DX;
+    // MOV [0x200], BX; HLT
+    const std::initializer_list<std::uint8_t> myCode{0x3D, 0x05, 0x00, 0x7C, 0x05, 0xBB, 0x01, 0x00, 0xEB, 0x05, 0xBB,
+                                                     0x02, 0x00, 0x11, 0xC3, 0x92, 0x89, 0x1E, 0x00, 0x02, 0xF4};
+    svm::RandomAccessMemory myImage;
+    load(myImage, CodeAddress, myCode);
+    svm::BatchCore myBatch{myImage, 20};
+    myBatch.writeRegister(Regs::IP, CodeAddress);
+    for (std::size_t myLane{}; myLane < myBatch.laneCount(); ++myLane)
+    {
+        myBatch.writeRegister(myLane, Regs::AX, static_cast<std::uint16_t>(myLane));
+    }
+
+    EXPECT_EQ(myBatch.run(1000), 0U);
+    EXPECT_EQ(myBatch.stats().theDivergences, 1U);
+    // CMP borrowed in the lanes below 5 so ADC adds one more. Both paths issue once and the lanes meet again at
+    // XCHG, only the store goes lane by lane
+    EXPECT_EQ(myBatch.stats().theIssues, 9U);
+    EXPECT_EQ(myBatch.stats().theScalarLaneSteps, 20U);
+    for (std::size_t myLane{}; myLane < myBatch.laneCount(); ++myLane)
+    {
+        EXPECT_EQ(myBatch.trap(myLane), Trap::HALT);
+        EXPECT_EQ(myBatch.memory(myLane).read({.theAddress = ResultAddress}).second, myLane < 5 ? 3 + myLane : 1);
+    }
+    expectSameAsSingleCore(myBatch, myCode, [](std::size_t aLane, svm::SingleCore &aCore) {
+        aCore.writeRegister(Regs::AX, static_cast<std::uint16_t>(aLane));
+    });
+}
+
+TEST(BatchCoreTest, NearCallsAndStackStayInOneGroup)
+{
+    // MOV SP, 0x800; PUSH AX; CALL double; POP BX; MOV [0x200], BX; HLT; NOP; double: ADC AX, AX; RET
+    const std::initializer_list<std::uint8_t> myCode{0xBC, 0x00, 0x08, 0x50, 0xE8, 0x07, 0x00, 0x5B, 0x89,
+                                                     0x1E, 0x00, 0x02, 0xF4, 0x90, 0x11, 0xC0, 0xC3};
+    svm::RandomAccessMemory myImage;
+    load(myImage, CodeAddress, myCode);
+    svm::BatchCore myBatch{myImage, 19};
+    myBatch.writeRegister(Regs::IP, CodeAddress);
+    for (std::size_t myLane{}; myLane < myBatch.laneCount(); ++myLane)
+    {
+        myBatch.writeRegister(myLane, Regs::AX, static_cast<std::uint16_t>(myLane * 1000));
+    }
+
+    EXPECT_EQ(myBatch.run(1000), 0U);
+    // Every lane returns to the same address, RET does not split the group
+    EXPECT_EQ(myBatch.stats().theIssues, 8U);
+    EXPECT_EQ(myBatch.stats().theDivergences, 0U);
+    // PUSH, CALL, RET, POP and the store go lane by lane, without a SingleCore
+    EXPECT_EQ(myBatch.stats().theScalarLaneSteps, 5U * 19U);
+    for (std::size_t myLane{}; myLane < myBatch.laneCount(); ++myLane)
+    {
+        EXPECT_EQ(myBatch.memory(myLane).read({.theAddress = ResultAddress}).second, myLane * 1000);
+    }
+    expectSameAsSingleCore(myBatch, myCode, [](std::size_t aLane, svm::SingleCore &aCore) {
+        aCore.writeRegister(Regs::AX, static_cast<std::uint16_t>(aLane * 1000));
+    });
+}
+
+TEST(BatchCoreTest, DataDependentLoopCounts)
+{
+    // again: INC AX; DEC CX; JNE again; CMP AX, 3; JE skip; MOV [0x200], AX; skip: HLT
+    const std::initializer_list<std::uint8_t> myCode{0x40, 0x49, 0x75, 0xFC, 0x3D, 0x03, 0x00,
+                                                     0x74, 0x04, 0x89, 0x06, 0x00, 0x02, 0xF4};
+    svm::RandomAccessMemory myImage;
+    load(myImage, CodeAddress, myCode);
+    svm::BatchCore myBatch{myImage, 8};
+    myBatch.writeRegister(Regs::IP, CodeAddress);
+    for (std::size_t myLane{}; myLane < myBatch.laneCount(); ++myLane)
+    {
+        myBatch.writeRegister(myLane, Regs::CX, static_cast<std::uint16_t>(myLane + 1));
+    }
+
+    EXPECT_EQ(myBatch.run(1000), 0U);
+    EXPECT_GT(myBatch.stats().theDivergences, 0U);
+    // The longest lane sets the pace, the others wait at the loop exit instead of issuing alone
+    EXPECT_LT(myBatch.stats().theIssues, 8U * 3U + 10U);
+    expectSameAsSingleCore(myBatch, myCode, [](std::size_t aLane, svm::SingleCore &aCore) {
+        aCore.writeRegister(Regs::CX, static_cast<std::uint16_t>(aLane + 1));
+    });
+}
@@ -0,0 +1,113 @@
+#include "arch.hpp"
+#include "debugger.hpp"
+#include "guest_fixture.hpp"
+#include "memory.hpp"
+#include "single_core.hpp"
+#include "trap.hpp"
+
+#include <gtest/gtest.h>
+#include <initializer_list>
+
+class DebuggerTest : public ::testing::Test
+{
+  protected:
+    using Regs = svm::arch::Regs;
+    using MemoryAddr = svm::arch::MemoryAddress;
+    using Trap = svm::Trap;
+    using Location = svm::Debugger::Location;
+
+    static constexpr std::uint16_t ORIGIN = svm::test::ProgramOrigin;
+
+    svm::RandomAccessMemory theMemory{};
+    svm::SingleCore theCpu{theMemory};
+    svm::Debugger theDebugger{theCpu, theMemory};
+
+    void load(std::initializer_list<std::uint8_t> aProgram)
+    {
+        svm::test::loadProgram(theMemory, theCpu, aProgram);
+    }
+};
+
+TEST_F(DebuggerTest, BreakpointStopsBeforeInstruction)
+{
+    // MOV CX, 3; MOV AX, 0; INC AX; LOOP -3; HLT
+    load({0xB9, 0x03, 0x00, 0xB8, 0x00, 0x00, 0x40, 0xE2, 0xFD, 0xF4});
+    theDebugger.addBreakpoint(Location{.theSegment = 0, .theOffset = 0x106});
+
+    EXPECT_EQ(theCpu.run(1000), Trap::BREAK);
+    EXPECT_EQ(theCpu.readRegister(Regs::IP), 0x106);
+    EXPECT_EQ(theCpu.readRegister(Regs::AX), 0);
+
+    // Resuming executes the instruction under the breakpoint and stops on the next visit
+    EXPECT_EQ(theCpu.run(1000), Trap::BREAK);
+    EXPECT_EQ(theCpu.readRegister(Regs::AX), 1);
+
+    theDebugger.removeBreakpoint(Location{.theSegment = 0, .theOffset = 0x106});
+    EXPECT_EQ(theCpu.run(1000), Trap::HALT);
+    EXPECT_EQ(theCpu.readRegister(Regs::AX), 3);
+}
+
+TEST_F(DebuggerTest, BreakpointCallbackCanContinue)
+{
+    // MOV CX, 3; MOV AX, 0; INC AX; LOOP -3; HLT
+    load({0xB9, 0x03, 0x00, 0xB8, 0x00, 0x00, 0x40, 0xE2, 0xFD, 0xF4});
+    std::size_t myHits{};
+    theDebugger.onBreakpoint([&](const Location &) {
+        ++myHits;
+        return false;
+    });
+    theDebugger.addBreakpoint(Location{.theSegment = 0, .theOffset = 0x106});
+
+    EXPECT_EQ(theCpu.run(1000), Trap::HALT);
+    EXPECT_EQ(myHits, 3U);
+}
+
+TEST_F(DebuggerTest, BreakpointArmedAfterDecodeIsHonoured)
+{
+    // MOV AX, 1; MOV BX, 2; HLT
+    load({0xB8, 0x01, 0x00, 0xBB, 0x02, 0x00, 0xF4});
+    EXPECT_EQ(theCpu.run(1000), Trap::HALT);
+
+    theDebugger.addBreakpoint(Location{.theSegment = 0, .theOffset = 0x103});
+    theCpu.writeRegister(Regs::IP, ORIGIN);
+    theCpu.writeRegister(Regs::BX, 0);
+    EXPECT_EQ(theCpu.run(1000), Trap::BREAK);
+    EXPECT_EQ(theCpu.readRegister(Regs::IP), 0x103);
+    EXPECT_EQ(theCpu.readRegister(Regs::BX), 0);
+}
+
+TEST_F(DebuggerTest, WriteWatchpointStopsRunLoop)
+{
+    // MOV AX, 1234h; MOV [2000h], AX; MOV AX, 0; JMP +0; HLT
+    load({0xB8, 0x34, 0x12, 0x89, 0x06, 0x00, 0x20, 0xB8, 0x00, 0x00, 0xEB, 0x00, 0xF4});
+    std::optional<svm::Debugger::WatchHit> myHit;
+    theDebugger.onWatchpoint([&](const svm::Debugger::WatchHit &aHit) {
+        myHit = aHit;
+        return true;
+    });
+    theDebugger.addWatchpoint(MemoryAddr{.theAddress = 0x2000}, 2, svm::MemoryObserver::Write);
+
+    EXPECT_EQ(theCpu.run(1000), Trap::BREAK);
+    ASSERT_TRUE(myHit.has_value());
+    EXPECT_EQ(myHit->theAddress.theAddress, 0x2000U);
+    EXPECT_EQ(myHit->theAccess, svm::MemoryObserver::Write);
+    EXPECT_EQ(theMemory.read(MemoryAddr{.theAddress = 0x2000}).second, 0x1234);
+
+    EXPECT_EQ(theCpu.run(1000), Trap::HALT);
+}
+
+TEST_F(DebuggerTest, ReadWatchpointIgnoresWrites)
+{
+    // MOV [2000h], AX; MOV BX, [2000h]; HLT
+    load({0x89, 0x06, 0x00, 0x20, 0x8B, 0x1E, 0x00, 0x20, 0xF4});
+    std::size_t myHits{};
+    theDebugger.onWatchpoint([&](const svm::Debugger::WatchHit &aHit) {
+        EXPECT_EQ(aHit.theAccess, svm::MemoryObserver::Read);
+        ++myHits;
+        return false;
+    });
+    theDebugger.addWatchpoint(MemoryAddr{.theAddress = 0x2000}, 2, svm::MemoryObserver::Read);
+
+    EXPECT_EQ(theCpu.run(1000), Trap::HALT);
+    EXPECT_EQ(myHits, 1U);
+}
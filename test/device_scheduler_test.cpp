@@ -0,0 +1,142 @@
+#include "arch.hpp"
+#include "device_scheduler.hpp"
+#include "guest_fixture.hpp"
+#include "interval_timer.hpp"
+#include "memory.hpp"
+#include "port_bus.hpp"
+#include "single_core.hpp"
+#include "trap.hpp"
+
+#include <gtest/gtest.h>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+namespace
+{
+using Trap = svm::Trap;
+using Regs = svm::arch::Regs;
+using svm::test::load;
+
+svm::DeviceTask sleeper(svm::DeviceScheduler &aScheduler, std::uint64_t aPeriod, int aId,
+                        std::vector<std::pair<std::uint64_t, int>> &aLog)
+{
+    for (int i{}; i < 3; ++i)
+    {
+        co_await aScheduler.delay(aPeriod);
+        aLog.emplace_back(aScheduler.now(), aId);
+    }
+}
+
+svm::DeviceTask listener(svm::DeviceScheduler &, svm::PortChannel &aChannel, std::vector<std::uint16_t> &aValues)
+{
+    while (true)
+    {
+        const auto myAccess = co_await aChannel;
+        aValues.push_back(myAccess.theValue);
+    }
+}
+} // namespace
+
+TEST(DeviceSchedulerTest, ResumesInCycleOrder)
+{
+    svm::DeviceScheduler myScheduler;
+    std::vector<std::pair<std::uint64_t, int>> myLog;
+    EXPECT_TRUE(myScheduler.spawn(&sleeper, 5, 1, myLog));
+    EXPECT_TRUE(myScheduler.spawn(&sleeper, 3, 2, myLog));
+
+    myScheduler.advanceTo(0);
+    EXPECT_EQ(myScheduler.nextDue(), 3U);
+    myScheduler.advanceTo(100);
+
+    const std::vector<std::pair<std::uint64_t, int>> myExpected{{3, 2}, {5, 1}, {6, 2}, {9, 2}, {10, 1}, {15, 1}};
+    EXPECT_EQ(myLog, myExpected);
+    EXPECT_EQ(myScheduler.taskCount(), 0U);
+    EXPECT_EQ(myScheduler.nextDue(), svm::DeviceScheduler::Idle);
+}
+
+TEST(DeviceSchedulerTest, FramesAreRecycled)
+{
+    svm::DeviceScheduler myScheduler;
+    std::vector<std::pair<std::uint64_t, int>> myLog;
+    EXPECT_TRUE(myScheduler.spawn(&sleeper, 1, 1, myLog));
+    const auto myUsed = myScheduler.arenaUsed();
+    EXPECT_GT(myUsed, 0U);
+
+    myScheduler.advanceTo(10);
+    EXPECT_TRUE(myScheduler.spawn(&sleeper, 1, 2, myLog));
+    myScheduler.advanceTo(20);
+    EXPECT_EQ(myScheduler.arenaUsed(), myUsed);
+    EXPECT_EQ(myLog.size(), 6U);
+}
+
+TEST(DeviceSchedulerTest, SpawnFailsWhenArenaIsFull)
+{
+    svm::DeviceScheduler myScheduler{64};
+    std::vector<std::pair<std::uint64_t, int>> myLog;
+    EXPECT_FALSE(myScheduler.spawn(&sleeper, 1, 1, myLog));
+    EXPECT_EQ(myScheduler.taskCount(), 0U);
+}
+
+TEST(DeviceSchedulerTest, ChannelWakesWaitingDevice)
+{
+    svm::DeviceScheduler myScheduler;
+    svm::PortChannel myChannel{myScheduler};
+    std::vector<std::uint16_t> myValues;
+    EXPECT_TRUE(myScheduler.spawn(&listener, myChannel, myValues));
+    myScheduler.advanceTo(1);
+    EXPECT_EQ(myScheduler.nextDue(), svm::DeviceScheduler::Idle);
+
+    myChannel.post(svm::PortAccess{.thePort = 0x60, .theValue = 7, .theIsWrite = true});
+    myChannel.post(svm::PortAccess{.thePort = 0x60, .theValue = 9, .theIsWrite = true});
+    EXPECT_TRUE(myValues.empty());
+    myScheduler.advanceTo(2);
+    EXPECT_EQ(myValues, (std::vector<std::uint16_t>{7, 9}));
+    EXPECT_EQ(myScheduler.taskCount(), 1U);
+}
+
+class IntervalTimerTest : public ::testing::Test
+{
+  protected:
+    svm::RandomAccessMemory theMemory{};
+    svm::SingleCore theCpu{theMemory};
+    svm::PortBus theBus{};
+    svm::DeviceScheduler theScheduler{};
+    svm::IntervalTimer theTimer{theCpu, theScheduler};
+
+    void SetUp() override
+    {
+        theBus.attach(theTimer, svm::IntervalTimer::BasePort, svm::IntervalTimer::PortCount);
+        theCpu.attachPortBus(&theBus);
+        theCpu.writeRegister(Regs::SP, 0x1000);
+        // Vector 8 -> 0000:0200: INC BX; IRET
+        svm::test::loadHandler(theMemory, 0x08, {0x43, 0xCF});
+    }
+};
+
+TEST_F(IntervalTimerTest, InterruptsBusyGuestEveryReload)
+{
+    // STI; MOV AX, 100; OUT 0x40, AL; MOV AX, 0; OUT 0x40, AL; JMP $
+    svm::test::loadProgram(theMemory, theCpu,
+                           {0xFB, 0xB8, 0x64, 0x00, 0xE6, 0x40, 0xB8, 0x00, 0x00, 0xE6, 0x40, 0xEB, 0xFE});
+
+    EXPECT_EQ(theScheduler.run(theCpu, 1000), Trap::OK);
+    EXPECT_EQ(theTimer.reload(), 100);
+    // Each period is 100 guest cycles, two of them spent in the handler
+    EXPECT_GE(theTimer.ticks(), 9U);
+    EXPECT_LE(theTimer.ticks(), 10U);
+    EXPECT_GE(theCpu.readRegister(Regs::BX), theTimer.ticks() - 1);
+}
+
+TEST_F(IntervalTimerTest, HaltedGuestSkipsToNextTick)
+{
+    // STI; MOV AX, 0x1000; OUT 0x40, AL; MOV AL, AH via AX = 0x10; OUT 0x40, AL; again: HLT; JMP again
+    svm::test::loadProgram(theMemory, theCpu,
+                           {0xFB, 0xB8, 0x00, 0x00, 0xE6, 0x40, 0xB8, 0x10, 0x00, 0xE6, 0x40, 0xF4, 0xEB, 0xFD});
+
+    EXPECT_EQ(theScheduler.run(theCpu, 400), Trap::OK);
+    // HLT, INC BX, IRET, JMP per tick, the clock jumps 0x1000 cycles each time
+    EXPECT_GE(theCpu.readRegister(Regs::BX), 90);
+    EXPECT_GE(theScheduler.now(), theTimer.ticks() * 0x1000U);
+    EXPECT_LT(theCpu.instructionCount(), 410U);
+}
@@ -0,0 +1,175 @@
+#include "arch.hpp"
+#include "expanded_memory.hpp"
+#include "memory.hpp"
+#include "single_core.hpp"
+#include "trap.hpp"
+
+#include <array>
+#include <gtest/gtest.h>
+#include <span>
+
+namespace
+{
+using Regs = svm::arch::Regs;
+using MemoryAddr = svm::arch::MemoryAddress;
+using Trap = svm::Trap;
+using Ems = svm::ExpandedMemory;
+
+constexpr std::uint32_t FrameBase = std::uint32_t{Ems::DefaultFrameSegment} << 4;
+
+class ExpandedMemoryTest : public ::testing::Test
+{
+  protected:
+    svm::RandomAccessMemory theMemory{};
+    Ems theEms{theMemory, 16};
+    svm::SingleCore theCpu{theMemory};
+
+    void SetUp() override
+    {
+        theCpu.attachService(Ems::Vector, &theEms);
+        theCpu.writeRegister(Regs::SP, 0x1000);
+    }
+
+    // Runs INT 67h with the given registers and returns AX
+    svm::arch::Immediate call(svm::arch::Immediate aAX, svm::arch::Immediate aBX = 0, svm::arch::Immediate aDX = 0)
+    {
+        constexpr std::array<std::uint8_t, 3> myCode{0xCD, 0x67, 0xF4};
+        EXPECT_EQ(theMemory.writeBlock(MemoryAddr{.theAddress = 0x100}, myCode), Trap::OK);
+        theCpu.writeRegister(Regs::IP, 0x100);
+        theCpu.writeRegister(Regs::AX, aAX);
+        theCpu.writeRegister(Regs::BX, aBX);
+        theCpu.writeRegister(Regs::DX, aDX);
+        EXPECT_EQ(theCpu.run(10), Trap::HALT);
+        return theCpu.readRegister(Regs::AX);
+    }
+};
+
+TEST_F(ExpandedMemoryTest, ReportsTheBoard)
+{
+    EXPECT_EQ(call(0x4000) >> 8, Ems::OK);
+    EXPECT_EQ(call(0x4100) >> 8, Ems::OK);
+    EXPECT_EQ(theCpu.readRegister(Regs::BX), Ems::DefaultFrameSegment);
+    EXPECT_EQ(call(0x4600), Ems::Version);
+    EXPECT_EQ(call(0x4200) >> 8, Ems::OK);
+    EXPECT_EQ(theCpu.readRegister(Regs::BX), 16);
+    EXPECT_EQ(theCpu.readRegister(Regs::DX), 16);
+    EXPECT_EQ(call(0x4B00) >> 8, Ems::OK);
+    EXPECT_EQ(theCpu.readRegister(Regs::BX), 1);
+    EXPECT_EQ(call(0x5500) >> 8, Ems::UndefinedFunction);
+}
+
+TEST_F(ExpandedMemoryTest, AllocatesPagesToHandles)
+{
+    EXPECT_EQ(call(0x4300, 0) >> 8, Ems::ZeroPages);
+    EXPECT_EQ(call(0x4300, 17) >> 8, Ems::NotEnoughPages);
+    EXPECT_EQ(call(0x4300, 10) >> 8, Ems::OK);
+    const auto myHandle = theCpu.readRegister(Regs::DX);
+    EXPECT_EQ(myHandle, 1);
+    EXPECT_EQ(call(0x4300, 7) >> 8, Ems::NotEnoughFreePages);
+    EXPECT_EQ(call(0x4C00, 0, myHandle) >> 8, Ems::OK);
+    EXPECT_EQ(theCpu.readRegister(Regs::BX), 10);
+    EXPECT_EQ(theEms.freePageCount(), 6U);
+
+    EXPECT_EQ(call(0x4500, 0, myHandle) >> 8, Ems::OK);
+    EXPECT_EQ(call(0x4500, 0, myHandle) >> 8, Ems::InvalidHandle);
+    EXPECT_EQ(theEms.freePageCount(), 16U);
+}
+
+TEST_F(ExpandedMemoryTest, MappingSwitchesBanksWithoutCopying)
+{
+    ASSERT_EQ(call(0x4300, 2) >> 8, Ems::OK);
+    const auto myHandle = theCpu.readRegister(Regs::DX);
+
+    ASSERT_EQ(call(0x4400, 0, myHandle) >> 8, Ems::OK);
+    ASSERT_EQ(theMemory.write(MemoryAddr{.theAddress = FrameBase + 0x3FFE}, 0x1111), Trap::OK);
+    ASSERT_EQ(call(0x4400, 1, myHandle) >> 8, Ems::OK);
+    EXPECT_EQ(theMemory.read(MemoryAddr{.theAddress = FrameBase + 0x3FFE}).second, 0);
+    ASSERT_EQ(theMemory.write(MemoryAddr{.theAddress = FrameBase + 0x3FFE}, 0x2222), Trap::OK);
+
+    // Logical page 0 in window 3 keeps what was written through window 0
+    ASSERT_EQ(call(0x4403, 0, myHandle) >> 8, Ems::OK);
+    EXPECT_EQ(theMemory.read(MemoryAddr{.theAddress = FrameBase + 0xFFFE}).second, 0x1111);
+    EXPECT_EQ(theMemory.read(MemoryAddr{.theAddress = FrameBase + 0x3FFE}).second, 0x2222);
+
+    EXPECT_EQ(call(0x4404, 0, myHandle) >> 8, Ems::PhysicalPageOutOfRange);
+    EXPECT_EQ(call(0x4400, 2, myHandle) >> 8, Ems::LogicalPageOutOfRange);
+    EXPECT_EQ(call(0x4400, 0, 9) >> 8, Ems::InvalidHandle);
+
+    // Unmapped, the window shows conventional memory again
+    ASSERT_EQ(call(0x4400, Ems::Unmapped, myHandle) >> 8, Ems::OK);
+    EXPECT_EQ(theMemory.read(MemoryAddr{.theAddress = FrameBase + 0x3FFE}).second, 0);
+}
+
+TEST_F(ExpandedMemoryTest, MapsSeveralPagesFromATable)
+{
+    ASSERT_EQ(call(0x4300, 2) >> 8, Ems::OK);
+    const auto myHandle = theCpu.readRegister(Regs::DX);
+    ASSERT_EQ(call(0x4400, 1, myHandle) >> 8, Ems::OK);
+    ASSERT_EQ(theMemory.write(MemoryAddr{.theAddress = FrameBase}, 0xABCD), Trap::OK);
+
+    // Logical 1 into window 2, logical 0 into window 0
+    constexpr std::array<std::uint8_t, 8> myPairs{1, 0, 2, 0, 0, 0, 0, 0};
+    ASSERT_EQ(theMemory.writeBlock(MemoryAddr{.theAddress = 0x500}, myPairs), Trap::OK);
+    theCpu.writeRegister(Regs::SI, 0x500);
+    theCpu.writeRegister(Regs::CX, 2);
+    EXPECT_EQ(call(0x5000, 0, myHandle) >> 8, Ems::OK);
+    EXPECT_EQ(theMemory.read(MemoryAddr{.theAddress = FrameBase + 2 * Ems::PageSize}).second, 0xABCD);
+    EXPECT_EQ(theMemory.read(MemoryAddr{.theAddress = FrameBase}).second, 0);
+
+    EXPECT_EQ(call(0x5001, 0, myHandle) >> 8, Ems::InvalidSubfunction);
+}
+
+TEST_F(ExpandedMemoryTest, CodeInAWindowFollowsTheMapping)
+{
+    ASSERT_EQ(call(0x4300, 2) >> 8, Ems::OK);
+    const auto myHandle = theCpu.readRegister(Regs::DX);
+    // MOV AX, n; HLT in each logical page, run from D000:0000
+    for (std::uint16_t i{}; i < 2; ++i)
+    {
+        ASSERT_EQ(call(0x4400, i, myHandle) >> 8, Ems::OK);
+        const std::array<std::uint8_t, 4> myCode{0xB8, static_cast<std::uint8_t>(0x10 + i), 0x00, 0xF4};
+        ASSERT_EQ(theMemory.writeBlock(MemoryAddr{.theAddress = FrameBase}, myCode), Trap::OK);
+    }
+    for (std::uint16_t i{}; i < 2; ++i)
+    {
+        ASSERT_EQ(call(0x4400, i, myHandle) >> 8, Ems::OK);
+        theCpu.writeRegister(Regs::CS, Ems::DefaultFrameSegment);
+        theCpu.writeRegister(Regs::IP, 0);
+        EXPECT_EQ(theCpu.run(10), Trap::HALT);
+        EXPECT_EQ(theCpu.readRegister(Regs::AX), 0x10 + i);
+        theCpu.writeRegister(Regs::CS, 0);
+    }
+}
+} // namespace
+
+TEST_F(ExpandedMemoryTest, SectionKeepsPagesOutOfView)
+{
+    ASSERT_EQ(call(0x4300, 2) >> 8, Ems::OK);
+    const auto myHandle = theCpu.readRegister(Regs::DX);
+    ASSERT_EQ(theMemory.write(MemoryAddr{.theAddress = FrameBase + Ems::PageSize}, 0x4444), Trap::OK);
+    for (std::uint16_t i{}; i < 2; ++i)
+    {
+        ASSERT_EQ(call(0x4400, i, myHandle) >> 8, Ems::OK);
+        ASSERT_EQ(theMemory.write(MemoryAddr{.theAddress = FrameBase}, 0x1000 + i), Trap::OK);
+    }
+    ASSERT_EQ(call(0x4401, 0, myHandle) >> 8, Ems::OK);
+    const auto mySection = theEms.saveSection();
+
+    // A board of another size takes the saved one over, with the conventional memory the frame hides
+    svm::RandomAccessMemory myMemory{};
+    Ems myEms{myMemory, 4};
+    ASSERT_TRUE(myEms.restoreSection(mySection));
+    EXPECT_EQ(myEms.pageCount(), 16U);
+    EXPECT_EQ(myEms.freePageCount(), 14U);
+    EXPECT_EQ(myMemory.read(MemoryAddr{.theAddress = FrameBase}).second, 0x1001);
+    EXPECT_EQ(myMemory.read(MemoryAddr{.theAddress = FrameBase + Ems::PageSize}).second, 0x1000);
+    EXPECT_EQ(myEms.map(0, 0, myHandle), Ems::OK);
+    EXPECT_EQ(myMemory.read(MemoryAddr{.theAddress = FrameBase}).second, 0x1000);
+    EXPECT_EQ(myEms.map(1, Ems::Unmapped, myHandle), Ems::OK);
+    EXPECT_EQ(myMemory.read(MemoryAddr{.theAddress = FrameBase + Ems::PageSize}).second, 0x4444);
+
+    auto myDamaged = mySection;
+    myDamaged.theData.pop_back();
+    EXPECT_FALSE(myEms.restoreSection(myDamaged));
+    EXPECT_EQ(myMemory.read(MemoryAddr{.theAddress = FrameBase}).second, 0x1000);
+}
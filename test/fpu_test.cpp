@@ -0,0 +1,199 @@
+#include "arch.hpp"
+#include "fpu.hpp"
+#include "memory.hpp"
+#include "save_state.hpp"
+#include "single_core.hpp"
+#include "trap.hpp"
+
+#include <array>
+#include <bit>
+#include <cmath>
+#include <gtest/gtest.h>
+#include <limits>
+#include <numbers>
+#include <span>
+
+namespace
+{
+using Regs = svm::arch::Regs;
+using MemoryAddr = svm::arch::MemoryAddress;
+using Trap = svm::Trap;
+using Fpu = svm::Fpu;
+
+constexpr std::uint32_t CodeBase = 0x100;
+constexpr std::uint32_t DataBase = 0x200;
+
+class FpuTest : public ::testing::Test
+{
+  protected:
+    svm::RandomAccessMemory theMemory{};
+    svm::SingleCore theCpu{theMemory};
+
+    void SetUp() override
+    {
+        theCpu.writeRegister(Regs::IP, CodeBase);
+        theCpu.writeRegister(Regs::SP, 0x1000);
+    }
+
+    // Runs aCode followed by HLT
+    void run(std::span<const std::uint8_t> aCode)
+    {
+        ASSERT_EQ(theMemory.writeBlock(MemoryAddr{.theAddress = CodeBase}, aCode), Trap::OK);
+        constexpr std::array<std::uint8_t, 1> myHalt{0xF4};
+        ASSERT_EQ(theMemory.writeBlock(MemoryAddr{.theAddress = CodeBase + static_cast<std::uint32_t>(aCode.size())},
+                                       myHalt),
+                  Trap::OK);
+        ASSERT_EQ(theCpu.run(1000), Trap::HALT);
+    }
+
+    template <typename T> void put(std::uint32_t aOffset, T aValue)
+    {
+        const auto myBytes = std::bit_cast<std::array<std::uint8_t, sizeof(T)>>(aValue);
+        ASSERT_EQ(theMemory.writeBlock(MemoryAddr{.theAddress = DataBase + aOffset}, myBytes), Trap::OK);
+    }
+
+    template <typename T> T get(std::uint32_t aOffset)
+    {
+        std::array<std::uint8_t, sizeof(T)> myBytes{};
+        EXPECT_EQ(theMemory.readBlock(MemoryAddr{.theAddress = DataBase + aOffset}, myBytes), Trap::OK);
+        return std::bit_cast<T>(myBytes);
+    }
+};
+
+TEST_F(FpuTest, ArithmeticKeepsTheExtendedSignificand)
+{
+    put(0x00, 2.0F);
+    // FLD DWORD [0x200]; FSQRT; FLD1; FLDPI
+    constexpr std::array<std::uint8_t, 10> myCode{0xD9, 0x06, 0x00, 0x02, 0xD9, 0xFA, 0xD9, 0xE8, 0xD9, 0xEB};
+    run(myCode);
+
+    EXPECT_EQ(theCpu.fpu().read(0), std::numbers::pi_v<long double>);
+    EXPECT_EQ(theCpu.fpu().read(1), 1.0L);
+    EXPECT_EQ(theCpu.fpu().read(2), std::sqrt(2.0L));
+    // TOP is 5 after three pushes
+    EXPECT_EQ((theCpu.fpu().status() >> 11) & 0x7U, 5U);
+    EXPECT_EQ(theCpu.fpu().tags(), 0x03FF);
+}
+
+TEST_F(FpuTest, ReversedFormsSwapOperands)
+{
+    put(0x00, 10.0F);
+    put(0x04, 4.0F);
+    // FLD DWORD [0x200]; FLD DWORD [0x204]; FSUB ST(1), ST(0); FSUB ST(0), ST(1); FDIVP ST(1), ST(0)
+    constexpr std::array<std::uint8_t, 14> myCode{0xD9, 0x06, 0x00, 0x02, 0xD9, 0x06, 0x04,
+                                                  0x02, 0xDC, 0xE9, 0xD8, 0xE1, 0xDE, 0xF9};
+    run(myCode);
+
+    // ST(1) = 10 - 4, ST(0) = 4 - 6, then 6 / -2
+    EXPECT_EQ(theCpu.fpu().read(0), -3.0L);
+    EXPECT_TRUE(std::isnan(theCpu.fpu().read(1)));
+}
+
+TEST_F(FpuTest, IntegerStoresFollowRoundingControl)
+{
+    put(0x00, 2.5F);
+    put<std::uint16_t>(0x04, 0x0B7F);
+    // FLD DWORD [0x200]; FIST WORD [0x210]; FLDCW [0x204]; FISTP WORD [0x212]; FSTCW [0x214]
+    constexpr std::array<std::uint8_t, 20> myCode{0xD9, 0x06, 0x00, 0x02, 0xDF, 0x16, 0x10, 0x02, 0xD9, 0x2E,
+                                                  0x04, 0x02, 0xDF, 0x1E, 0x12, 0x02, 0xD9, 0x3E, 0x14, 0x02};
+    run(myCode);
+
+    // Nearest even, then up
+    EXPECT_EQ(get<std::int16_t>(0x10), 2);
+    EXPECT_EQ(get<std::int16_t>(0x12), 3);
+    EXPECT_EQ(get<std::uint16_t>(0x14), 0x0B7F);
+    EXPECT_EQ(theCpu.fpu().tags(), 0xFFFF);
+}
+
+TEST_F(FpuTest, CompareReportsThroughTheStatusWord)
+{
+    // FLD1; FLDZ; FCOM ST(1); FSTSW [0x210]; FCOMPP; FSTSW [0x212]
+    constexpr std::array<std::uint8_t, 16> myCode{0xD9, 0xE8, 0xD9, 0xEE, 0xD8, 0xD1, 0xDD, 0x3E,
+                                                  0x10, 0x02, 0xDE, 0xD9, 0xDD, 0x3E, 0x12, 0x02};
+    run(myCode);
+
+    // 0 < 1 sets C0 alone, FCOMPP compares the same pair and empties the stack
+    EXPECT_EQ(get<std::uint16_t>(0x10) & (Fpu::C0 | Fpu::C2 | Fpu::C3), Fpu::C0);
+    const auto mySecond = get<std::uint16_t>(0x12);
+    EXPECT_EQ(mySecond & (Fpu::C0 | Fpu::C2 | Fpu::C3), Fpu::C0);
+    EXPECT_EQ((mySecond >> 11) & 0x7U, 0U);
+    EXPECT_EQ(theCpu.fpu().tags(), 0xFFFF);
+}
+
+TEST_F(FpuTest, MaskedStackUnderflowProducesTheIndefinite)
+{
+    // FST QWORD [0x210] and FIST DWORD [0x218] with nothing loaded
+    constexpr std::array<std::uint8_t, 8> myCode{0xDD, 0x16, 0x10, 0x02, 0xDB, 0x16, 0x18, 0x02};
+    run(myCode);
+
+    const auto myReal = get<double>(0x10);
+    EXPECT_TRUE(std::isnan(myReal));
+    EXPECT_TRUE(std::signbit(myReal));
+    EXPECT_EQ(get<std::int32_t>(0x18), std::numeric_limits<std::int32_t>::min());
+    EXPECT_NE(theCpu.fpu().status() & Fpu::InvalidOperation, 0);
+    EXPECT_EQ(theCpu.fpu().status() & Fpu::ErrorSummary, 0);
+}
+
+TEST_F(FpuTest, UnmaskedZeroDivideKeepsTheDestination)
+{
+    // Every exception but zero divide masked
+    put<std::uint16_t>(0x00, 0x037B);
+    put(0x04, 0.0F);
+    // FLDCW [0x200]; FLD1; FDIV DWORD [0x204]
+    constexpr std::array<std::uint8_t, 10> myCode{0xD9, 0x2E, 0x00, 0x02, 0xD9, 0xE8, 0xD8, 0x36, 0x04, 0x02};
+    run(myCode);
+
+    EXPECT_EQ(theCpu.fpu().read(0), 1.0L);
+    EXPECT_EQ(theCpu.fpu().status() & (Fpu::ZeroDivide | Fpu::ErrorSummary | Fpu::Busy),
+              Fpu::ZeroDivide | Fpu::ErrorSummary | Fpu::Busy);
+}
+
+TEST_F(FpuTest, PackedDecimalRoundTrips)
+{
+    // -1234567 as packed BCD
+    constexpr std::array<std::uint8_t, 10> myBcd{0x67, 0x45, 0x23, 0x01, 0, 0, 0, 0, 0, 0x80};
+    ASSERT_EQ(theMemory.writeBlock(MemoryAddr{.theAddress = DataBase}, myBcd), Trap::OK);
+    // FBLD [0x200]; FLD ST(0); FBSTP [0x210]; FISTP QWORD [0x220]
+    constexpr std::array<std::uint8_t, 14> myCode{0xDF, 0x26, 0x00, 0x02, 0xD9, 0xC0, 0xDF,
+                                                  0x36, 0x10, 0x02, 0xDF, 0x3E, 0x20, 0x02};
+    run(myCode);
+
+    std::array<std::uint8_t, 10> myStored{};
+    ASSERT_EQ(theMemory.readBlock(MemoryAddr{.theAddress = DataBase + 0x10}, myStored), Trap::OK);
+    EXPECT_EQ(myStored, myBcd);
+    EXPECT_EQ(get<std::int64_t>(0x20), -1234567);
+}
+
+TEST_F(FpuTest, SaveAndRestoreMoveTheWholeState)
+{
+    // FLDPI; FLD1; FSAVE [0x200]; FLDZ; FRSTOR [0x200]
+    constexpr std::array<std::uint8_t, 14> myCode{0xD9, 0xEB, 0xD9, 0xE8, 0xDD, 0x36, 0x00,
+                                                  0x02, 0xD9, 0xEE, 0xDD, 0x26, 0x00, 0x02};
+    run(myCode);
+
+    EXPECT_EQ(theCpu.fpu().read(0), 1.0L);
+    EXPECT_EQ(theCpu.fpu().read(1), std::numbers::pi_v<long double>);
+    EXPECT_EQ(theCpu.fpu().control(), Fpu::DefaultControl);
+    // ST(0) sits right after the environment, 1.0 is 3FFF 8000000000000000
+    EXPECT_EQ(get<std::uint64_t>(Fpu::EnvironmentSize), 0x8000000000000000ULL);
+    EXPECT_EQ(get<std::uint16_t>(Fpu::EnvironmentSize + 8), 0x3FFF);
+}
+
+TEST_F(FpuTest, CheckpointsCarryTheCoprocessor)
+{
+    put<std::uint16_t>(0x00, 0x0F7F);
+    // FLDCW [0x200]; FLDPI
+    constexpr std::array<std::uint8_t, 6> myCode{0xD9, 0x2E, 0x00, 0x02, 0xD9, 0xEB};
+    run(myCode);
+
+    const auto myImage = svm::SaveState::encode(theCpu, theMemory);
+    svm::RandomAccessMemory myMemory{};
+    svm::SingleCore myCpu{myMemory};
+    ASSERT_EQ(svm::SaveState::decode(myImage, myCpu, myMemory), svm::SaveState::Status::OK);
+
+    EXPECT_EQ(myCpu.fpu().read(0), std::numbers::pi_v<long double>);
+    EXPECT_EQ(myCpu.fpu().control(), 0x0F7F);
+    EXPECT_EQ(myCpu.fpu().status(), theCpu.fpu().status());
+    EXPECT_EQ(myCpu.fpu().tags(), theCpu.fpu().tags());
+}
+} // namespace
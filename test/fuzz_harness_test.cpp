@@ -0,0 +1,108 @@
+#include "arch.hpp"
+#include "fpu.hpp"
+#include "fuzz_harness.hpp"
+#include "guest_fixture.hpp"
+#include "memory.hpp"
+#include "single_core.hpp"
+#include "trap.hpp"
+
+#include <algorithm>
+#include <array>
+#include <gtest/gtest.h>
+#include <initializer_list>
+#include <string_view>
+
+namespace
+{
+using Trap = svm::Trap;
+using Regs = svm::arch::Regs;
+using svm::test::load;
+
+class FuzzHarnessTest : public ::testing::Test
+{
+  protected:
+    svm::RandomAccessMemory theMemory{};
+    svm::SingleCore theCpu{theMemory};
+    std::array<std::uint8_t, 1U << 12> theCoverage{};
+    svm::FuzzHarness theHarness{theCpu, theMemory, theCoverage, 0x1000};
+
+    void SetUp() override
+    {
+        // MOV CX, [0x1000]; CMP CX, 2; JB done; MOV AX, [0x1002]; CMP AX, "FZ"; JNE done; (illegal 0x0F);
+        // done: MOV [0x2000], AX; HLT
+        svm::test::loadProgram(theMemory, theCpu,
+                               {0x8B, 0x0E, 0x00, 0x10, 0x83, 0xF9, 0x02, 0x72, 0x0A, 0x8B, 0x06, 0x02, 0x10, 0x3D,
+                                0x46, 0x5A, 0x75, 0x01, 0x0F, 0x89, 0x06, 0x00, 0x20, 0xF4});
+        theHarness.prepare();
+    }
+
+    Trap execute(std::string_view aInput)
+    {
+        return theHarness.execute({reinterpret_cast<const std::uint8_t *>(aInput.data()), aInput.size()});
+    }
+
+    std::size_t coveredEdges() const
+    {
+        return static_cast<std::size_t>(std::ranges::count_if(theCoverage, [](auto aCount) { return aCount != 0; }));
+    }
+};
+} // namespace
+
+TEST_F(FuzzHarnessTest, FindsCrashingInput)
+{
+    EXPECT_EQ(execute(""), Trap::HALT);
+    EXPECT_EQ(execute("AB"), Trap::HALT);
+    EXPECT_EQ(execute("FZ"), Trap::ILLEGAL);
+    EXPECT_TRUE(svm::FuzzHarness::isCrash(Trap::ILLEGAL));
+    EXPECT_FALSE(svm::FuzzHarness::isCrash(Trap::HALT));
+    EXPECT_EQ(theHarness.executions(), 3U);
+}
+
+TEST_F(FuzzHarnessTest, NewPathsAddEdges)
+{
+    EXPECT_EQ(execute(""), Trap::HALT);
+    const auto myShortInput = coveredEdges();
+    EXPECT_GT(myShortInput, 0U);
+
+    EXPECT_EQ(execute("AB"), Trap::HALT);
+    const auto myMismatch = coveredEdges();
+    EXPECT_GT(myMismatch, myShortInput);
+
+    EXPECT_EQ(execute("AC"), Trap::HALT);
+    EXPECT_EQ(coveredEdges(), myMismatch);
+}
+
+TEST_F(FuzzHarnessTest, RunsStartFromPreparedState)
+{
+    EXPECT_EQ(execute("AB"), Trap::HALT);
+    EXPECT_EQ(theMemory.read({.theAddress = 0x2000}).second, 0x4241);
+    EXPECT_EQ(theCpu.readRegister(Regs::CX), 2);
+
+    EXPECT_EQ(execute("FZ"), Trap::ILLEGAL);
+    // Input page and result page
+    EXPECT_EQ(theHarness.restoredPages(), 2U);
+    EXPECT_EQ(theMemory.read({.theAddress = 0x2000}).second, 0);
+    EXPECT_EQ(theCpu.readRegister(Regs::IP), 0x112);
+
+    EXPECT_EQ(execute(""), Trap::HALT);
+    EXPECT_EQ(theHarness.restoredPages(), 1U);
+    EXPECT_EQ(theCpu.readRegister(Regs::CX), 0);
+}
+
+TEST_F(FuzzHarnessTest, RunsDoNotInheritCoprocessorOrInterrupts)
+{
+    // INT 08h handler at 0000:0300: MOV BYTE [0x3000], 1; IRET
+    load(theMemory, 0x20, {0x00, 0x03, 0x00, 0x00});
+    load(theMemory, 0x300, {0xC6, 0x06, 0x00, 0x30, 0x01, 0xCF});
+    theCpu.writeRegister(Regs::FLAG, theCpu.readRegister(Regs::FLAG) | 0x0200);
+    theHarness.prepare();
+    const auto myStatus = theCpu.fpu().status();
+    const auto myTags = theCpu.fpu().tags();
+
+    EXPECT_EQ(theCpu.fpu().FLD(svm::Fpu::Constant::One), Trap::OK);
+    theCpu.raiseInterrupt(0x08);
+    EXPECT_EQ(execute("AB"), Trap::HALT);
+    EXPECT_EQ(theCpu.fpu().status(), myStatus);
+    EXPECT_EQ(theCpu.fpu().tags(), myTags);
+    EXPECT_EQ(theMemory.readByte({.theAddress = 0x3000}).second, 0);
+}
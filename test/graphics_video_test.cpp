@@ -0,0 +1,248 @@
+#include "arch.hpp"
+#include "graphics_video.hpp"
+#include "memory.hpp"
+#include "single_core.hpp"
+#include "trap.hpp"
+
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <iterator>
+#include <vector>
+
+namespace
+{
+using Regs = svm::arch::Regs;
+using MemoryAddr = svm::arch::MemoryAddress;
+using Trap = svm::Trap;
+using Adapter = svm::GraphicsAdapter;
+using Mode = Adapter::Mode;
+using Size = svm::arch::OperandSize;
+using Rgb = std::array<std::uint8_t, 3>;
+
+constexpr std::uint32_t CgaBase = Adapter::CgaAddress.theAddress;
+constexpr std::uint32_t EgaBase = Adapter::EgaAddress.theAddress;
+
+// The CGA colours as the default 200 line EGA palette shows them
+constexpr std::array<Rgb, 16> Colors{{{0x00, 0x00, 0x00},
+                                      {0x00, 0x00, 0xAA},
+                                      {0x00, 0xAA, 0x00},
+                                      {0x00, 0xAA, 0xAA},
+                                      {0xAA, 0x00, 0x00},
+                                      {0xAA, 0x00, 0xAA},
+                                      {0xAA, 0x55, 0x00},
+                                      {0xAA, 0xAA, 0xAA},
+                                      {0x55, 0x55, 0x55},
+                                      {0x55, 0x55, 0xFF},
+                                      {0x55, 0xFF, 0x55},
+                                      {0x55, 0xFF, 0xFF},
+                                      {0xFF, 0x55, 0x55},
+                                      {0xFF, 0x55, 0xFF},
+                                      {0xFF, 0xFF, 0x55},
+                                      {0xFF, 0xFF, 0xFF}}};
+
+class GraphicsAdapterTest : public ::testing::Test
+{
+  protected:
+    svm::RandomAccessMemory theMemory{};
+    Adapter theAdapter{theMemory};
+
+    Rgb pixel(std::size_t aX, std::size_t aY) const
+    {
+        const auto myPixel = theAdapter.frame().subspan((aY * theAdapter.width() + aX) * Adapter::BytesPerPixel, 4);
+        EXPECT_EQ(myPixel[3], 0xFF);
+        return Rgb{myPixel[0], myPixel[1], myPixel[2]};
+    }
+
+    void poke(std::uint32_t aAddress, std::uint8_t aValue)
+    {
+        ASSERT_EQ(theMemory.writeByte(MemoryAddr{.theAddress = aAddress}, aValue), Trap::OK);
+    }
+};
+
+TEST_F(GraphicsAdapterTest, CgaLinesInterleaveAndFollowTheColorSelect)
+{
+    ASSERT_TRUE(theAdapter.setMode(0x04));
+    EXPECT_EQ(theAdapter.convert(), 200U);
+    // Pixels 0 to 3 of line 0, then all of the first byte of line 1
+    poke(CgaBase, 0x1B);
+    poke(CgaBase + Adapter::CgaBankSize, 0xFF);
+    EXPECT_EQ(theAdapter.convert(), 2U);
+
+    // Bright cyan, magenta and white over black
+    EXPECT_EQ(pixel(0, 0), Colors[0]);
+    EXPECT_EQ(pixel(1, 0), Colors[11]);
+    EXPECT_EQ(pixel(2, 0), Colors[13]);
+    EXPECT_EQ(pixel(3, 0), Colors[15]);
+    EXPECT_EQ(pixel(3, 1), Colors[15]);
+    EXPECT_EQ(pixel(4, 1), Colors[0]);
+
+    // Green, red and brown on blue
+    theAdapter.out(0x3D9, 0x01, Size::Byte);
+    EXPECT_EQ(theAdapter.convert(), 200U);
+    EXPECT_EQ(pixel(0, 0), Colors[1]);
+    EXPECT_EQ(pixel(1, 0), Colors[2]);
+    EXPECT_EQ(pixel(2, 0), Colors[4]);
+    EXPECT_EQ(pixel(3, 0), Colors[6]);
+}
+
+TEST_F(GraphicsAdapterTest, OnlyTouchedLinesAreConverted)
+{
+    ASSERT_TRUE(theAdapter.setMode(0x06));
+    theAdapter.convert();
+    EXPECT_EQ(theAdapter.convert(), 0U);
+
+    // Line 2k + 1 starts 80k bytes into the second bank, the gap after line 199 belongs to no line
+    poke(CgaBase + Adapter::CgaBankSize + 80 * 50 + 79, 0x01);
+    poke(CgaBase + 100 * 80 + 4, 0xFF);
+    EXPECT_EQ(theAdapter.dirtyLineCount(), 1U);
+    EXPECT_EQ(theAdapter.convert(), 1U);
+    EXPECT_EQ(pixel(639, 101), Colors[15]);
+    EXPECT_EQ(pixel(638, 101), Colors[0]);
+
+    // Text mode writes the same memory and converts nothing
+    ASSERT_TRUE(theAdapter.setMode(0x03));
+    poke(CgaBase, 'A');
+    EXPECT_EQ(theAdapter.convert(), 0U);
+    EXPECT_TRUE(theAdapter.frame().empty());
+}
+
+TEST_F(GraphicsAdapterTest, EgaStoresGoToTheMaskedPlanes)
+{
+    ASSERT_TRUE(theAdapter.setMode(0x0E));
+    theAdapter.convert();
+    // Map mask planes 0 and 2 in one word OUT
+    theAdapter.out(0x3C4, 0x0502, Size::Word);
+    poke(EgaBase + 80, 0x80);
+    EXPECT_EQ(theAdapter.plane(0)[80], 0x80);
+    EXPECT_EQ(theAdapter.plane(1)[80], 0x00);
+    EXPECT_EQ(theAdapter.plane(2)[80], 0x80);
+    EXPECT_EQ(theAdapter.plane(3)[80], 0x00);
+
+    // Only plane 3, which the window does not show
+    theAdapter.out(0x3C4, 0x0802, Size::Word);
+    poke(EgaBase + 80, 0x40);
+    EXPECT_EQ(theMemory.readByte(MemoryAddr{.theAddress = EgaBase + 80}).second, 0x80);
+    theAdapter.out(0x3CE, 0x0304, Size::Word);
+    EXPECT_EQ(theMemory.readByte(MemoryAddr{.theAddress = EgaBase + 80}).second, 0x40);
+    EXPECT_EQ(theAdapter.in(0x3CE, Size::Word), 0x0304);
+
+    EXPECT_EQ(theAdapter.convert(), 1U);
+    EXPECT_EQ(pixel(0, 1), Colors[5]);
+    EXPECT_EQ(pixel(1, 1), Colors[8]);
+    EXPECT_EQ(pixel(2, 1), Colors[0]);
+
+    // Conventional memory shows again outside the EGA modes
+    ASSERT_TRUE(theAdapter.setMode(0x04));
+    EXPECT_EQ(theMemory.readByte(MemoryAddr{.theAddress = EgaBase + 80}).second, 0x00);
+}
+
+TEST_F(GraphicsAdapterTest, PlanarLinesMatchThePerPixelReference)
+{
+    ASSERT_TRUE(theAdapter.setMode(0x0D));
+    theAdapter.convert();
+    // 40 bytes a line, two vectors and a remainder
+    constexpr std::size_t Line = 7;
+    constexpr std::size_t BytesPerLine = 40;
+    std::array<std::array<std::uint8_t, BytesPerLine>, Adapter::PlaneCount> myPlanes{};
+    std::uint32_t mySeed = 12345;
+    for (std::size_t myPlane{}; myPlane < Adapter::PlaneCount; ++myPlane)
+    {
+        theAdapter.out(0x3C4, static_cast<std::uint16_t>(0x0002 | (1U << (myPlane + 8))), Size::Word);
+        for (std::size_t i{}; i < BytesPerLine; ++i)
+        {
+            mySeed = mySeed * 1103515245U + 12345U;
+            myPlanes[myPlane][i] = static_cast<std::uint8_t>(mySeed >> 16);
+            poke(static_cast<std::uint32_t>(EgaBase + Line * BytesPerLine + i), myPlanes[myPlane][i]);
+        }
+    }
+    EXPECT_EQ(theAdapter.convert(), 1U);
+
+    for (std::size_t x{}; x < theAdapter.width(); ++x)
+    {
+        std::size_t myIndex{};
+        for (std::size_t myPlane{}; myPlane < Adapter::PlaneCount; ++myPlane)
+        {
+            myIndex |= ((myPlanes[myPlane][x / 8] >> (7 - x % 8)) & 1U) << myPlane;
+        }
+        ASSERT_EQ(pixel(x, Line), Colors[myIndex]) << "x " << x;
+    }
+}
+
+TEST_F(GraphicsAdapterTest, AttributeControllerProgramsThePalette)
+{
+    ASSERT_TRUE(theAdapter.setMode(0x10));
+    EXPECT_EQ(theAdapter.height(), 350U);
+    poke(EgaBase + 349 * 80, 0x80);
+    theAdapter.convert();
+    EXPECT_EQ(pixel(0, 349), Colors[15]);
+
+    // Reading the status register resets the index/data flip-flop and toggles retrace
+    const auto myStatus = theAdapter.in(0x3DA, Size::Byte);
+    EXPECT_NE(theAdapter.in(0x3DA, Size::Byte), myStatus);
+    theAdapter.out(0x3C0, 0x0F, Size::Byte);
+    // rgbRGB 010100 is brown
+    theAdapter.out(0x3C0, 0x14, Size::Byte);
+    EXPECT_EQ(theAdapter.convert(), 350U);
+    EXPECT_EQ(pixel(0, 349), Colors[6]);
+}
+
+TEST_F(GraphicsAdapterTest, VideoServicesSetAndReportTheMode)
+{
+    svm::SingleCore myCpu{theMemory};
+    myCpu.attachService(Adapter::Vector, &theAdapter);
+    myCpu.writeRegister(Regs::SP, 0x1000);
+    myCpu.writeRegister(Regs::IP, 0x100);
+    // mov ax, 0004h; int 10h; mov ax, 0B00h; mov bx, 0100h; int 10h; mov ax, 0F00h; int 10h; hlt
+    constexpr std::array<std::uint8_t, 19> myCode{0xB8, 0x04, 0x00, 0xCD, 0x10, 0xB8, 0x00, 0x0B, 0xBB, 0x00,
+                                                  0x01, 0xCD, 0x10, 0xB8, 0x00, 0x0F, 0xCD, 0x10, 0xF4};
+    ASSERT_EQ(theMemory.writeBlock(MemoryAddr{.theAddress = 0x100}, myCode), Trap::OK);
+    ASSERT_EQ(myCpu.run(100), Trap::HALT);
+
+    EXPECT_EQ(theAdapter.mode(), Mode::Cga320);
+    EXPECT_EQ(myCpu.readRegister(Regs::AX), 0x2804);
+    EXPECT_EQ(myCpu.readRegister(Regs::BX), 0x0000);
+    poke(CgaBase, 0x40);
+    theAdapter.convert();
+    // Bright green from palette 0
+    EXPECT_EQ(pixel(0, 0), Colors[10]);
+}
+
+TEST_F(GraphicsAdapterTest, CaptureWritesRawFramesAndPngs)
+{
+    const auto myDirectory = std::filesystem::temp_directory_path() / "svm_graphics_video_test";
+    std::filesystem::remove_all(myDirectory);
+    std::filesystem::create_directories(myDirectory);
+    const auto myRaw = myDirectory / "capture.rgba";
+    ASSERT_TRUE(theAdapter.setMode(0x06));
+    {
+        svm::FrameCapture myCapture{theAdapter, myRaw, svm::FrameCapture::Format::RawVideo};
+        EXPECT_TRUE(myCapture.capture());
+        poke(CgaBase, 0xFF);
+        EXPECT_TRUE(myCapture.capture());
+        // 320 pixels wide no longer fits the stream
+        ASSERT_TRUE(theAdapter.setMode(0x04));
+        EXPECT_FALSE(myCapture.capture());
+        EXPECT_EQ(myCapture.frames(), 2U);
+    }
+    EXPECT_EQ(std::filesystem::file_size(myRaw), 2U * 640U * 200U * 4U);
+
+    const auto myPngs = myDirectory / "frames";
+    svm::FrameCapture myCapture{theAdapter, myPngs, svm::FrameCapture::Format::PngSequence};
+    EXPECT_TRUE(myCapture.capture());
+    std::ifstream myFile{myPngs / "000000.png", std::ios::binary};
+    const std::vector<std::uint8_t> myPng{std::istreambuf_iterator<char>{myFile}, {}};
+    // Signature, IHDR, IDAT of the zlib header, four stored blocks of 200 unfiltered rows and the checksum, IEND
+    constexpr std::size_t RowBytes = 200U * (1U + 320U * 4U);
+    ASSERT_EQ(myPng.size(), 8U + 25U + (12U + 2U + 4U * 5U + RowBytes + 4U) + 12U);
+    EXPECT_EQ(myPng[1], 'P');
+    EXPECT_EQ(myPng[12], 'I');
+    // Width and height, big endian
+    EXPECT_EQ(myPng[18], 0x01);
+    EXPECT_EQ(myPng[19], 0x40);
+    EXPECT_EQ(myPng[23], 200);
+
+    std::filesystem::remove_all(myDirectory);
+}
+} // namespace
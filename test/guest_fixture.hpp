@@ -0,0 +1,64 @@
+#pragma once
+#include "arch.hpp"
+#include "memory.hpp"
+#include "port_bus.hpp"
+#include "single_core.hpp"
+#include "trap.hpp"
+
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <initializer_list>
+
+// Helpers for the tests that run hand assembled guest code
+namespace svm::test
+{
+// Programs start at 0000:0100 like a COM image, the interrupt handler under test sits at 0000:0200
+constexpr std::uint16_t ProgramOrigin = 0x100U;
+constexpr std::uint16_t HandlerOrigin = 0x200U;
+
+inline void load(RandomAccessMemory &aMemory, std::uint32_t aAddress, std::initializer_list<std::uint8_t> aBytes)
+{
+    for (const auto myByte : aBytes)
+    {
+        EXPECT_EQ(aMemory.writeByte({.theAddress = aAddress++}, myByte), Trap::OK);
+    }
+}
+
+// Loads aProgram at ProgramOrigin and points IP at it
+inline void loadProgram(RandomAccessMemory &aMemory, SingleCore &aCore, std::initializer_list<std::uint8_t> aProgram)
+{
+    load(aMemory, ProgramOrigin, aProgram);
+    aCore.writeRegister(arch::Regs::IP, ProgramOrigin);
+}
+
+// Loads aHandler at HandlerOrigin and points aVector at it
+inline void loadHandler(RandomAccessMemory &aMemory, std::uint8_t aVector, std::initializer_list<std::uint8_t> aHandler)
+{
+    EXPECT_EQ(aMemory.write({.theAddress = aVector * 4U}, HandlerOrigin), Trap::OK);
+    load(aMemory, HandlerOrigin, aHandler);
+}
+
+// Stands in for anything the host decides: clock reads, keyboard scancodes. Every IN steps the value to
+// value * multiplier + increment and returns it, OUT is ignored.
+struct CounterDevice : PortDevice
+{
+    std::uint16_t theValue;
+    std::uint16_t theMultiplier;
+    std::uint16_t theIncrement;
+
+    CounterDevice(std::uint16_t aValue, std::uint16_t aMultiplier, std::uint16_t aIncrement)
+        : theValue{aValue}, theMultiplier{aMultiplier}, theIncrement{aIncrement}
+    {
+    }
+
+    std::uint16_t in(std::uint16_t, arch::OperandSize) noexcept override
+    {
+        theValue = static_cast<std::uint16_t>(theValue * theMultiplier + theIncrement);
+        return theValue;
+    }
+
+    void out(std::uint16_t, std::uint16_t, arch::OperandSize) noexcept override
+    {
+    }
+};
+} // namespace svm::test
@@ -0,0 +1,159 @@
+#include "arch.hpp"
+#include "guest_profiler.hpp"
+#include "memory.hpp"
+#include "single_core.hpp"
+#include "trap.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <span>
+#include <sstream>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+using Regs = svm::arch::Regs;
+using Trap = svm::Trap;
+using Function = svm::GuestProfiler::Function;
+
+const Function *find(const std::vector<Function> &aFunctions, std::string_view aName)
+{
+    const auto myFound = std::ranges::find(aFunctions, aName, &Function::theName);
+    return myFound != aFunctions.end() ? &*myFound : nullptr;
+}
+
+class GuestProfilerTest : public ::testing::Test
+{
+  protected:
+    svm::RandomAccessMemory theMemory{};
+    svm::SingleCore theCpu{theMemory};
+    svm::GuestProfiler theProfiler{};
+
+    void SetUp() override
+    {
+        theCpu.attachProfiler(&theProfiler);
+        theCpu.writeRegister(Regs::SP, 0x1000);
+        theCpu.writeRegister(Regs::IP, 0x100);
+    }
+
+    void place(std::uint32_t aAddress, std::span<const std::uint8_t> aCode)
+    {
+        ASSERT_EQ(theMemory.writeBlock({.theAddress = aAddress}, aCode), Trap::OK);
+    }
+};
+
+TEST_F(GuestProfilerTest, AttributesInstructionsPerCallingContext)
+{
+    // CALL f; CALL g; HLT
+    place(0x100, std::vector<std::uint8_t>{0xE8, 0x0D, 0x00, 0xE8, 0x1A, 0x00, 0xF4});
+    // f: CALL g; RET
+    place(0x110, std::vector<std::uint8_t>{0xE8, 0x0D, 0x00, 0xC3});
+    // g: NOP; NOP; RET
+    place(0x120, std::vector<std::uint8_t>{0x90, 0x90, 0xC3});
+    theProfiler.addSymbol(0x110, "f");
+
+    EXPECT_EQ(theCpu.run(1000), Trap::HALT);
+    EXPECT_EQ(theProfiler.depth(), 0U);
+    EXPECT_EQ(theProfiler.total(), 11U);
+
+    const auto myFunctions = theProfiler.functions();
+    ASSERT_EQ(myFunctions.size(), 3U);
+    EXPECT_EQ(myFunctions[0].theName, "(root)");
+    EXPECT_EQ(myFunctions[0].theInclusive, 11U);
+    EXPECT_EQ(myFunctions[0].theExclusive, 3U);
+    const auto *myG = find(myFunctions, "0000:0120");
+    ASSERT_NE(myG, nullptr);
+    EXPECT_EQ(myG->theCalls, 2U);
+    EXPECT_EQ(myG->theInclusive, 6U);
+    EXPECT_EQ(myG->theExclusive, 6U);
+    const auto *myF = find(myFunctions, "f");
+    ASSERT_NE(myF, nullptr);
+    EXPECT_EQ(myF->theAddress, 0x110U);
+    EXPECT_EQ(myF->theCalls, 1U);
+    EXPECT_EQ(myF->theInclusive, 5U);
+    EXPECT_EQ(myF->theExclusive, 2U);
+
+    std::ostringstream myCollapsed;
+    theProfiler.writeCollapsed(myCollapsed);
+    EXPECT_EQ(myCollapsed.str(), "(root) 3\n(root);f 2\n(root);f;0000:0120 3\n(root);0000:0120 3\n");
+}
+
+TEST_F(GuestProfilerTest, RecursionCountsOnceInclusive)
+{
+    // MOV CX, 3; CALL r; HLT
+    place(0x100, std::vector<std::uint8_t>{0xB9, 0x03, 0x00, 0xE8, 0x0A, 0x00, 0xF4});
+    // r: DEC CX; JZ done; CALL r; done: RET
+    place(0x110, std::vector<std::uint8_t>{0x49, 0x74, 0x03, 0xE8, 0xFA, 0xFF, 0xC3});
+    theProfiler.addSymbol(0x110, "r");
+
+    EXPECT_EQ(theCpu.run(1000), Trap::HALT);
+    const auto myFunctions = theProfiler.functions();
+    const auto *myR = find(myFunctions, "r");
+    ASSERT_NE(myR, nullptr);
+    EXPECT_EQ(myR->theCalls, 3U);
+    EXPECT_EQ(myR->theExclusive, 11U);
+    EXPECT_EQ(myR->theInclusive, 11U);
+
+    std::ostringstream myCollapsed;
+    theProfiler.writeCollapsed(myCollapsed);
+    EXPECT_EQ(myCollapsed.str(), "(root) 3\n(root);r 4\n(root);r;r 4\n(root);r;r;r 3\n");
+}
+
+TEST_F(GuestProfilerTest, ReturnUsedAsJumpKeepsTheFrame)
+{
+    // CALL f; HLT
+    place(0x100, std::vector<std::uint8_t>{0xE8, 0x0D, 0x00, 0xF4});
+    // f: MOV AX, 0118h; PUSH AX; RET; 0118: RET
+    place(0x110, std::vector<std::uint8_t>{0xB8, 0x18, 0x01, 0x50, 0xC3});
+    place(0x118, std::vector<std::uint8_t>{0xC3});
+    theProfiler.addSymbol(0x110, "f");
+
+    EXPECT_EQ(theCpu.run(1000), Trap::HALT);
+    EXPECT_EQ(theProfiler.depth(), 0U);
+    const auto *myF = find(theProfiler.functions(), "f");
+    ASSERT_NE(myF, nullptr);
+    EXPECT_EQ(myF->theExclusive, 4U);
+}
+
+TEST_F(GuestProfilerTest, InterruptHandlersAreFrames)
+{
+    ASSERT_EQ(theMemory.write({.theAddress = 0x21 * 4}, 0x0200), Trap::OK);
+    // INT 21h; HLT
+    place(0x100, std::vector<std::uint8_t>{0xCD, 0x21, 0xF4});
+    // Handler: NOP; IRET
+    place(0x200, std::vector<std::uint8_t>{0x90, 0xCF});
+    theProfiler.addSymbol(0x200, "int21");
+
+    EXPECT_EQ(theCpu.run(1000), Trap::HALT);
+    EXPECT_EQ(theProfiler.depth(), 0U);
+    const auto *myHandler = find(theProfiler.functions(), "int21");
+    ASSERT_NE(myHandler, nullptr);
+    EXPECT_EQ(myHandler->theCalls, 1U);
+    EXPECT_EQ(myHandler->theExclusive, 2U);
+}
+
+TEST(GuestProfilerSymbols, ParsesSegmentedAndLinearAddresses)
+{
+    svm::GuestProfiler myProfiler;
+    EXPECT_FALSE(myProfiler.parseSymbols("0000:0110 f\nnot-an-address g\n"));
+    EXPECT_FALSE(myProfiler.parseSymbols("0110 two names\n"));
+    EXPECT_FALSE(myProfiler.parseSymbols("10000:0000 wide\n"));
+    EXPECT_TRUE(myProfiler.parseSymbols("# entry points\n0010:0010 f\n\n120 g   # linear\r\n"));
+
+    // Functions entered at the mapped addresses take the mapped names
+    myProfiler.onCall(0x0000, 0x0110, 0xFFE);
+    myProfiler.retire(1);
+    myProfiler.onCall(0x0012, 0x0000, 0xFFC);
+    myProfiler.retire(2);
+    myProfiler.onReturn(0xFFC);
+    myProfiler.retire(3);
+    const auto myFunctions = myProfiler.functions();
+    ASSERT_EQ(myFunctions.size(), 3U);
+    EXPECT_NE(find(myFunctions, "f"), nullptr);
+    EXPECT_NE(find(myFunctions, "g"), nullptr);
+    EXPECT_EQ(myProfiler.depth(), 1U);
+    EXPECT_NE(myProfiler.formatTable(5).find("function"), std::string::npos);
+}
+} // namespace
@@ -0,0 +1,69 @@
+#include "guest_program.hpp"
+#include "trap.hpp"
+
+#include <array>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+using Trap = svm::Trap;
+using svm::GuestProgram;
+} // namespace
+
+TEST(GuestProgramTest, ListingSkipsBlanksAndComments)
+{
+    const auto myBytes = GuestProgram::parseListing("; header\nB8 34 12   ; mov ax, 0x1234\r\n\tf4;hlt");
+    ASSERT_TRUE(myBytes.has_value());
+    EXPECT_EQ(*myBytes, (std::vector<std::uint8_t>{0xB8, 0x34, 0x12, 0xF4}));
+}
+
+TEST(GuestProgramTest, ListingRejectsHalfBytesAndOtherText)
+{
+    EXPECT_FALSE(GuestProgram::parseListing("B8 3").has_value());
+    EXPECT_FALSE(GuestProgram::parseListing("B8 G4").has_value());
+    EXPECT_FALSE(GuestProgram::parseListing("mov ax, 1").has_value());
+    EXPECT_TRUE(GuestProgram::parseListing("; nothing but a comment").value().empty());
+}
+
+TEST(GuestProgramTest, RunStopsAtHaltWithTheAnswerInAx)
+{
+    // mov cx, 10 / mov ax, 0 / count: inc ax / loop count / hlt
+    constexpr std::array<std::uint8_t, 10> myProgram{0xB9, 0x0A, 0x00, 0xB8, 0x00, 0x00, 0x40, 0xE2, 0xFD, 0xF4};
+    const auto myResult = GuestProgram::run(myProgram, 1000U);
+    EXPECT_EQ(myResult.theTrap, Trap::HALT);
+    EXPECT_EQ(myResult.theAX, 10U);
+    EXPECT_EQ(myResult.theInstructions, 23U);
+    EXPECT_GE(myResult.mips(), 0.0);
+}
+
+TEST(GuestProgramTest, RunEndsWhenTheBudgetRunsOut)
+{
+    // spin: jmp spin
+    constexpr std::array<std::uint8_t, 2> myProgram{0xEB, 0xFE};
+    const auto myResult = GuestProgram::run(myProgram, 500U);
+    EXPECT_EQ(myResult.theTrap, Trap::OK);
+    EXPECT_GE(myResult.theInstructions, 500U);
+}
+
+TEST(GuestProgramTest, SerialOutputReachesTheHost)
+{
+    int myPipe[2]{-1, -1};
+    ASSERT_EQ(::pipe2(myPipe, O_NONBLOCK), 0);
+    // mov dx, 3F8h / mov ax, 'o' / out dx, al / mov ax, 'k' / out dx, al / hlt
+    constexpr std::array<std::uint8_t, 12> myProgram{0xBA, 0xF8, 0x03, 0xB8, 0x6F, 0x00,
+                                                     0xEE, 0xB8, 0x6B, 0x00, 0xEE, 0xF4};
+    EXPECT_EQ(GuestProgram::run(myProgram, 1000U, {}, nullptr, myPipe[1]).theTrap, Trap::HALT);
+
+    std::string myText(16, '\0');
+    const auto myRead = ::read(myPipe[0], myText.data(), myText.size());
+    myText.resize(myRead > 0 ? static_cast<std::size_t>(myRead) : 0U);
+    EXPECT_EQ(myText, "ok");
+    ::close(myPipe[0]);
+    ::close(myPipe[1]);
+}
@@ -0,0 +1,188 @@
+#include "arch.hpp"
+#include "hypercall.hpp"
+#include "memory.hpp"
+#include "single_core.hpp"
+#include "trap.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <numeric>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+namespace
+{
+using Regs = svm::arch::Regs;
+using Trap = svm::Trap;
+using Call = svm::Hypercalls::Call;
+
+constexpr std::uint8_t Checksum = 0x01;
+constexpr std::uint8_t Copy = 0x02;
+
+// AX = sum of the CX bytes at DS:SI
+Trap checksum(Call &aCall)
+{
+    const auto myBuffer = aCall.read(aCall.theCore.readRegister(Regs::DS), aCall.theCore.readRegister(Regs::SI),
+                                     aCall.theCore.readRegister(Regs::CX));
+    if (!myBuffer)
+    {
+        return Trap::SEG_FAULT;
+    }
+    std::uint16_t mySum{};
+    for (const auto myPart : myBuffer->parts())
+    {
+        mySum = std::accumulate(myPart.begin(), myPart.end(), mySum);
+    }
+    aCall.theCore.writeRegister(Regs::AX, mySum);
+    return Trap::OK;
+}
+
+// CX bytes from DS:SI to ES:DI, both contiguous
+Trap copy(Call &aCall)
+{
+    auto &myCore = aCall.theCore;
+    const auto myLength = myCore.readRegister(Regs::CX);
+    const auto mySource = aCall.read(myCore.readRegister(Regs::DS), myCore.readRegister(Regs::SI), myLength);
+    const auto myTarget = aCall.write(myCore.readRegister(Regs::ES), myCore.readRegister(Regs::DI), myLength);
+    if (!mySource || !myTarget || !mySource->contiguous() || !myTarget->contiguous())
+    {
+        return Trap::SEG_FAULT;
+    }
+    std::memmove(myTarget->contiguous()->data(), mySource->contiguous()->data(), myLength);
+    return Trap::OK;
+}
+
+class HypercallTest : public ::testing::Test
+{
+  protected:
+    svm::RandomAccessMemory theMemory{};
+    svm::SingleCore theCpu{theMemory};
+    svm::Hypercalls theHypercalls{theMemory};
+
+    void SetUp() override
+    {
+        theHypercalls.define(Checksum, &checksum);
+        theHypercalls.define(Copy, &copy);
+        theCpu.attachHypercalls(&theHypercalls);
+        theCpu.writeRegister(Regs::SP, 0x1000);
+        theCpu.writeRegister(Regs::IP, 0x100);
+    }
+
+    void place(std::uint32_t aAddress, std::span<const std::uint8_t> aCode)
+    {
+        ASSERT_EQ(theMemory.writeBlock({.theAddress = aAddress}, aCode), Trap::OK);
+    }
+};
+
+TEST_F(HypercallTest, RoutineReadsGuestMemoryInPlace)
+{
+    std::vector<std::uint8_t> myData(0x1800);
+    std::iota(myData.begin(), myData.end(), std::uint8_t{1});
+    place(0x2000, myData);
+    // MOV SI, 2000h; MOV CX, 1800h; HCALL 01h; HLT
+    place(0x100, std::vector<std::uint8_t>{0xBE, 0x00, 0x20, 0xB9, 0x00, 0x18, 0x0F, 0x3F, Checksum, 0xF4});
+
+    EXPECT_EQ(theCpu.run(1000), Trap::HALT);
+    EXPECT_EQ(theCpu.readRegister(Regs::AX), std::accumulate(myData.begin(), myData.end(), std::uint16_t{}));
+    EXPECT_EQ(theCpu.instructionCount(), 4U);
+}
+
+TEST_F(HypercallTest, StoresAreReportedToObservers)
+{
+    struct Watcher : svm::MemoryObserver
+    {
+        std::vector<std::pair<std::uint32_t, std::size_t>> theWrites;
+
+        void onWrite(svm::arch::MemoryAddress aAddress, std::size_t aLength) noexcept override
+        {
+            theWrites.emplace_back(aAddress.theAddress, aLength);
+        }
+    } myWatcher;
+    theMemory.attachObserver(myWatcher, {.theAddress = 0x5000}, 0x1000);
+
+    place(0x3000, std::vector<std::uint8_t>{'h', 'o', 's', 't'});
+    // MOV SI, 3000h; MOV DI, 5000h; MOV CX, 4; HCALL 02h; HLT
+    place(0x100, std::vector<std::uint8_t>{0xBE, 0x00, 0x30, 0xBF, 0x00, 0x50, 0xB9, 0x04, 0x00, 0x0F, 0x3F, Copy,
+                                           0xF4});
+
+    EXPECT_EQ(theCpu.run(1000), Trap::HALT);
+    std::array<std::uint8_t, 4> myCopied{};
+    EXPECT_EQ(theMemory.readBlock({.theAddress = 0x5000}, myCopied), Trap::OK);
+    EXPECT_EQ(myCopied, (std::array<std::uint8_t, 4>{'h', 'o', 's', 't'}));
+    ASSERT_EQ(myWatcher.theWrites.size(), 1U);
+    EXPECT_EQ(myWatcher.theWrites[0], (std::pair<std::uint32_t, std::size_t>{0x5000, 4}));
+    theMemory.detachObserver(myWatcher);
+}
+
+TEST_F(HypercallTest, StoresOverCodeEvictDecodedBlocks)
+{
+    // 0200: MOV AX, 1; HLT
+    place(0x200, std::vector<std::uint8_t>{0xB8, 0x01, 0x00, 0xF4});
+    // 0300: MOV AX, 2; HLT
+    place(0x300, std::vector<std::uint8_t>{0xB8, 0x02, 0x00, 0xF4});
+    theCpu.writeRegister(Regs::IP, 0x200);
+    EXPECT_EQ(theCpu.run(1000), Trap::HALT);
+    EXPECT_EQ(theCpu.readRegister(Regs::AX), 1);
+
+    // MOV SI, 300h; MOV DI, 200h; MOV CX, 4; HCALL 02h; JMP 200h
+    place(0x100, std::vector<std::uint8_t>{0xBE, 0x00, 0x03, 0xBF, 0x00, 0x02, 0xB9, 0x04, 0x00, 0x0F, 0x3F, Copy,
+                                           0xE9, 0xF1, 0x00});
+    theCpu.writeRegister(Regs::IP, 0x100);
+    EXPECT_EQ(theCpu.run(1000), Trap::HALT);
+    EXPECT_EQ(theCpu.readRegister(Regs::AX), 2);
+}
+
+TEST_F(HypercallTest, MappedPagesSplitTheBuffer)
+{
+    alignas(8) std::array<std::uint8_t, svm::RandomAccessMemory::PageSize> myBacking{};
+    myBacking.fill(0xAB);
+    theMemory.mapPage(3, myBacking);
+
+    svm::Hypercalls::Call myCall{theCpu, theMemory};
+    const auto myBuffer = myCall.read(0x0200, 0x0000, 0x3000);
+    ASSERT_TRUE(myBuffer);
+    // Nothing would report a store through a buffer lent for reading
+    static_assert(std::is_const_v<std::remove_reference_t<decltype(myBuffer->parts()[0][0])>>);
+    static_assert(!std::is_const_v<std::remove_reference_t<decltype(myCall.write(0, 0, 1)->parts()[0][0])>>);
+    EXPECT_EQ(myBuffer->theSize, 0x3000U);
+    ASSERT_EQ(myBuffer->parts().size(), 3U);
+    EXPECT_FALSE(myBuffer->contiguous());
+    EXPECT_EQ(myBuffer->parts()[0].size(), 0x1000U);
+    EXPECT_EQ(myBuffer->parts()[1].data(), myBacking.data());
+    EXPECT_EQ(myBuffer->parts()[2].size(), 0x1000U);
+    theMemory.unmapPage(3);
+
+    // Without mapped pages one span covers the whole segment
+    const auto myWhole = myCall.read(0x1000, 0x0000, 0x10000);
+    ASSERT_TRUE(myWhole);
+    ASSERT_TRUE(myWhole->contiguous());
+    EXPECT_EQ(myWhole->contiguous()->size(), 0x10000U);
+    // A buffer never wraps within its segment
+    EXPECT_FALSE(myCall.read(0x1000, 0xFFF0, 0x20));
+    EXPECT_FALSE(myCall.write(0xFFFF, 0x0000, 0x10000));
+}
+
+TEST_F(HypercallTest, UnknownRoutinesAreIllegal)
+{
+    // HCALL 7Fh
+    place(0x100, std::vector<std::uint8_t>{0x0F, 0x3F, 0x7F, 0xF4});
+    EXPECT_FALSE(theHypercalls.isDefined(0x7F));
+    EXPECT_EQ(theCpu.run(1000), Trap::ILLEGAL);
+    EXPECT_EQ(theCpu.readRegister(Regs::IP), 0x100);
+
+    theHypercalls.define(0x7F, [](Call &aCall) {
+        aCall.theCore.writeRegister(Regs::BX, 0x7F);
+        return Trap::OK;
+    });
+    EXPECT_EQ(theCpu.run(1000), Trap::HALT);
+    EXPECT_EQ(theCpu.readRegister(Regs::BX), 0x7F);
+
+    theCpu.attachHypercalls(nullptr);
+    theCpu.writeRegister(Regs::IP, 0x100);
+    EXPECT_EQ(theCpu.run(1000), Trap::ILLEGAL);
+}
+} // namespace
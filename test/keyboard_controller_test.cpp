@@ -0,0 +1,132 @@
+#include "arch.hpp"
+#include "guest_fixture.hpp"
+#include "keyboard_controller.hpp"
+#include "memory.hpp"
+#include "port_bus.hpp"
+#include "single_core.hpp"
+#include "spsc_queue.hpp"
+#include "trap.hpp"
+
+#include <gtest/gtest.h>
+#include <initializer_list>
+#include <thread>
+
+namespace
+{
+using Trap = svm::Trap;
+using Regs = svm::arch::Regs;
+
+TEST(SpscQueue, KeepsOrderAcrossThreads)
+{
+    constexpr std::uint32_t myCount = 10000U;
+    svm::SpscQueue<std::uint32_t, 64> myQueue;
+    std::thread myProducer{[&myQueue] {
+        for (std::uint32_t i{}; i < myCount;)
+        {
+            if (myQueue.tryPush(i))
+            {
+                ++i;
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+    }};
+
+    std::uint32_t myExpected{};
+    while (myExpected < myCount)
+    {
+        if (const auto myValue = myQueue.tryPop())
+        {
+            ASSERT_EQ(*myValue, myExpected);
+            ++myExpected;
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+    myProducer.join();
+    EXPECT_TRUE(myQueue.isEmpty());
+    EXPECT_FALSE(myQueue.tryPop());
+}
+
+TEST(SpscQueue, RejectsPushWhenFull)
+{
+    svm::SpscQueue<int, 4> myQueue;
+    for (int i{}; i < 4; ++i)
+    {
+        EXPECT_TRUE(myQueue.tryPush(i));
+    }
+    EXPECT_FALSE(myQueue.tryPush(4));
+    EXPECT_EQ(myQueue.tryPop(), 0);
+    EXPECT_TRUE(myQueue.tryPush(4));
+}
+
+class KeyboardControllerTest : public ::testing::Test
+{
+  protected:
+    svm::RandomAccessMemory theMemory{};
+    svm::SingleCore theCpu{theMemory};
+    svm::PortBus theBus{};
+    svm::KeyboardController theKeyboard{theCpu};
+
+    void SetUp() override
+    {
+        theBus.attach(theKeyboard, svm::KeyboardController::DataPort, 1);
+        theBus.attach(theKeyboard, svm::KeyboardController::StatusPort, 1);
+        theCpu.attachPortBus(&theBus);
+        theCpu.writeRegister(Regs::SP, 0x0800);
+        theCpu.writeRegister(Regs::DI, 0x1000);
+        // Vector 9 -> 0000:0200: IN AL, 0x64; AND AX, 1; JZ done; IN AL, 0x60; MOV [DI], AX; INC DI; INC DI;
+        // done: IRET
+        svm::test::loadHandler(theMemory, 0x09,
+                               {0xE4, 0x64, 0x25, 0x01, 0x00, 0x74, 0x06, 0xE4, 0x60, 0x89, 0x05, 0x47, 0x47, 0xCF});
+        // STI; JMP $
+        svm::test::loadProgram(theMemory, theCpu, {0xFB, 0xEB, 0xFE});
+    }
+};
+
+TEST_F(KeyboardControllerTest, StatusReportsWaitingScancode)
+{
+    EXPECT_EQ(theBus.in(svm::KeyboardController::StatusPort, svm::arch::OperandSize::Byte), 0);
+    EXPECT_TRUE(theKeyboard.press(0x1E));
+    EXPECT_EQ(theBus.in(svm::KeyboardController::StatusPort, svm::arch::OperandSize::Byte), 1);
+    EXPECT_EQ(theBus.in(svm::KeyboardController::DataPort, svm::arch::OperandSize::Byte), 0x1E);
+    EXPECT_EQ(theBus.in(svm::KeyboardController::StatusPort, svm::arch::OperandSize::Byte), 0);
+    // An empty controller keeps returning the last scancode
+    EXPECT_EQ(theBus.in(svm::KeyboardController::DataPort, svm::arch::OperandSize::Byte), 0x1E);
+}
+
+TEST_F(KeyboardControllerTest, HostThreadFeedsRunningGuest)
+{
+    constexpr std::uint16_t myCount = 1000U;
+    std::thread myHost{[this] {
+        for (std::uint16_t i{}; i < myCount;)
+        {
+            if (theKeyboard.press(static_cast<std::uint8_t>(i)))
+            {
+                ++i;
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+    }};
+
+    const auto myEnd = static_cast<std::uint16_t>(0x1000 + 2 * myCount);
+    for (int myRound{}; myRound < 100000 && theCpu.readRegister(Regs::DI) != myEnd; ++myRound)
+    {
+        ASSERT_EQ(theCpu.run(1000), Trap::OK);
+    }
+    myHost.join();
+
+    ASSERT_EQ(theCpu.readRegister(Regs::DI), myEnd);
+    for (std::uint16_t i{}; i < myCount; ++i)
+    {
+        EXPECT_EQ(theMemory.read({.theAddress = 0x1000U + 2U * i}).second, i & 0xFF);
+    }
+}
+} // namespace
@@ -0,0 +1,128 @@
+#include "arch.hpp"
+#include "guest_fixture.hpp"
+#include "machine.hpp"
+#include "memory.hpp"
+#include "port_bus.hpp"
+#include "single_core.hpp"
+#include "trap.hpp"
+
+#include <gtest/gtest.h>
+#include <initializer_list>
+#include <thread>
+
+namespace
+{
+using Trap = svm::Trap;
+using Regs = svm::arch::Regs;
+using svm::test::load;
+using MemoryModel = svm::RandomAccessMemory::MemoryModel;
+
+class MachineTest : public ::testing::Test
+{
+  protected:
+    static constexpr std::size_t CoreCount = 4U;
+
+    svm::RandomAccessMemory theMemory{};
+    svm::Machine theMachine{theMemory, CoreCount};
+
+    void startAll(std::uint16_t aIp)
+    {
+        for (std::size_t i{}; i < CoreCount; ++i)
+        {
+            theMachine.core(i).writeRegister(Regs::IP, aIp);
+        }
+    }
+
+    // Every program below parks on HLT; JMP back to the HLT once done
+    void runUntil(auto aIsDone)
+    {
+        for (int myRound{}; myRound < 1000 && !aIsDone(); ++myRound)
+        {
+            for (const auto myTrap : theMachine.run(100000))
+            {
+                ASSERT_TRUE(myTrap == Trap::OK || myTrap == Trap::HALT);
+            }
+        }
+    }
+};
+
+TEST_F(MachineTest, LockedIncrementsAreNotLost)
+{
+    constexpr std::uint16_t myIterations = 5000U;
+    theMachine.setMemoryModel(MemoryModel::SequentiallyConsistent);
+    EXPECT_EQ(theMemory.memoryModel(), MemoryModel::SequentiallyConsistent);
+    // MOV CX, N; again: LOCK INC word [0x2000]; LOOP again; done: HLT; JMP done
+    load(theMemory, 0x100,
+         {0xB9, myIterations & 0xFF, myIterations >> 8, 0xF0, 0xFF, 0x06, 0x00, 0x20, 0xE2, 0xF9, 0xF4, 0xEB, 0xFD});
+    startAll(0x100);
+
+    runUntil([this] { return theMemory.read({.theAddress = 0x2000}).second == CoreCount * myIterations; });
+    EXPECT_EQ(theMemory.read({.theAddress = 0x2000}).second, CoreCount * myIterations);
+}
+
+TEST_F(MachineTest, XchgSpinLockGuardsPlainIncrement)
+{
+    constexpr std::uint16_t myIterations = 500U;
+    theMachine.setMemoryModel(MemoryModel::TotalStoreOrder);
+    // MOV CX, N
+    // again: MOV AX, 1
+    // spin:  XCHG [0x3000], AX; CMP AX, 0; JNZ spin
+    //        MOV BX, [0x3002]; INC BX; MOV [0x3002], BX; MOV word [0x3000], 0; LOOP again
+    // done:  HLT; JMP done
+    load(theMemory, 0x100, {0xB9, myIterations & 0xFF, myIterations >> 8, 0xB8, 0x01, 0x00, 0x87, 0x06, 0x00, 0x30,
+                            0x3D, 0x00, 0x00, 0x75, 0xF7, 0x8B, 0x1E, 0x02, 0x30, 0x43, 0x89, 0x1E, 0x02, 0x30, 0xC7,
+                            0x06, 0x00, 0x30, 0x00, 0x00, 0xE2, 0xE3, 0xF4, 0xEB, 0xFD});
+    startAll(0x100);
+
+    runUntil([this] { return theMemory.read({.theAddress = 0x3002}).second == CoreCount * myIterations; });
+    EXPECT_EQ(theMemory.read({.theAddress = 0x3002}).second, CoreCount * myIterations);
+    EXPECT_EQ(theMemory.read({.theAddress = 0x3000}).second, 0);
+}
+
+TEST_F(MachineTest, InterprocessorInterruptWakesOtherCore)
+{
+    svm::PortBus myBus;
+    svm::InterprocessorPort myPort{theMachine};
+    myBus.attach(myPort, svm::InterprocessorPort::DefaultPort, 1);
+    theMachine.attachPortBus(&myBus);
+
+    // Vector 0x20 -> 0000:0300: MOV BX, 0x55; done: HLT; JMP done
+    EXPECT_EQ(theMemory.write({.theAddress = 0x20 * 4}, 0x0300), Trap::OK);
+    load(theMemory, 0x300, {0xBB, 0x55, 0x00, 0xF4, 0xEB, 0xFD});
+    // Sender: IN AX, 0xE0; MOV BX, AX; MOV AX, 0x0120; OUT 0xE0, AX; done: HLT; JMP done
+    load(theMemory, 0x100, {0xE5, 0xE0, 0x89, 0xC3, 0xB8, 0x20, 0x01, 0xE7, 0xE0, 0xF4, 0xEB, 0xFD});
+    // Receivers: STI; JMP $
+    load(theMemory, 0x200, {0xFB, 0xEB, 0xFE});
+    startAll(0x200);
+    theMachine.core(0).writeRegister(Regs::IP, 0x100);
+    for (std::size_t i{1}; i < CoreCount; ++i)
+    {
+        theMachine.core(i).writeRegister(Regs::SP, static_cast<std::uint16_t>(0x800 * i));
+    }
+
+    runUntil([this] { return theMachine.core(1).readRegister(Regs::BX) == 0x55; });
+    EXPECT_EQ(theMachine.core(0).readRegister(Regs::BX), CoreCount);
+    EXPECT_EQ(theMachine.core(1).readRegister(Regs::BX), 0x55);
+    EXPECT_EQ(theMachine.core(2).readRegister(Regs::BX), 0);
+}
+
+TEST_F(MachineTest, StoreFromOtherCoreEvictsCachedCode)
+{
+    // MOV BX, 1; HLT
+    load(theMemory, 0x500, {0xBB, 0x01, 0x00, 0xF4});
+    auto &myReader = theMachine.core(1);
+    myReader.writeRegister(Regs::IP, 0x500);
+    EXPECT_EQ(myReader.run(10), Trap::HALT);
+    EXPECT_EQ(myReader.readRegister(Regs::BX), 1);
+
+    // Writer on its own thread: MOV word [0x501], 2; HLT
+    load(theMemory, 0x100, {0xC7, 0x06, 0x01, 0x05, 0x02, 0x00, 0xF4});
+    auto &myWriter = theMachine.core(0);
+    myWriter.writeRegister(Regs::IP, 0x100);
+    std::thread{[&myWriter] { EXPECT_EQ(myWriter.run(10), Trap::HALT); }}.join();
+
+    myReader.writeRegister(Regs::IP, 0x500);
+    EXPECT_EQ(myReader.run(10), Trap::HALT);
+    EXPECT_EQ(myReader.readRegister(Regs::BX), 2);
+}
+} // namespace
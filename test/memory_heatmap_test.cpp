@@ -0,0 +1,83 @@
+#include "arch.hpp"
+#include "guest_fixture.hpp"
+#include "memory.hpp"
+#include "memory_heatmap.hpp"
+#include "single_core.hpp"
+#include "trap.hpp"
+
+#include <gtest/gtest.h>
+#include <initializer_list>
+
+namespace
+{
+using Trap = svm::Trap;
+using Regs = svm::arch::Regs;
+using Access = svm::MemoryHeatmap::Access;
+using svm::test::load;
+} // namespace
+
+TEST(MemoryHeatmapTest, CountsReadsAndWritesPerPage)
+{
+    svm::RandomAccessMemory myMemory;
+    svm::MemoryHeatmap myHeatmap;
+    myMemory.attachHeatmap(&myHeatmap);
+
+    EXPECT_EQ(myMemory.write({.theAddress = 0x1000}, 1), Trap::OK);
+    EXPECT_EQ(myMemory.writeByte({.theAddress = 0x1FFF}, 1), Trap::OK);
+    EXPECT_EQ(myMemory.read({.theAddress = 0x3000}).first, Trap::OK);
+    EXPECT_EQ(myMemory.readByte({.theAddress = 0x3001}).first, Trap::OK);
+    EXPECT_EQ(myMemory.fill({.theAddress = 0x4800}, 0x2000, 0), Trap::OK);
+
+    EXPECT_EQ(myHeatmap.count(Access::Write, 1), 2U);
+    EXPECT_EQ(myHeatmap.count(Access::Read, 3), 2U);
+    EXPECT_EQ(myHeatmap.count(Access::Write, 4), 1U);
+    EXPECT_EQ(myHeatmap.count(Access::Write, 5), 1U);
+    EXPECT_EQ(myHeatmap.count(Access::Write, 6), 1U);
+    EXPECT_EQ(myHeatmap.hottest(10).size(), 5U);
+    EXPECT_EQ(myHeatmap.hottest(1).front().thePage, 1U);
+
+    myMemory.attachHeatmap(nullptr);
+    EXPECT_EQ(myMemory.write({.theAddress = 0x1000}, 1), Trap::OK);
+    EXPECT_EQ(myHeatmap.count(Access::Write, 1), 2U);
+}
+
+TEST(MemoryHeatmapTest, SampledCountsAreWeighted)
+{
+    svm::RandomAccessMemory myMemory;
+    svm::MemoryHeatmap myHeatmap{8};
+    myMemory.attachHeatmap(&myHeatmap);
+    for (std::uint32_t i{}; i < 800; ++i)
+    {
+        EXPECT_EQ(myMemory.read({.theAddress = 0x2000 + i}).first, Trap::OK);
+    }
+    EXPECT_GE(myHeatmap.count(Access::Read, 2), 792U);
+    EXPECT_LE(myHeatmap.count(Access::Read, 2), 808U);
+    EXPECT_EQ(myHeatmap.count(Access::Read, 2) % 8, 0U);
+}
+
+TEST(MemoryHeatmapTest, CoresCountExecutionAndInvalidations)
+{
+    svm::RandomAccessMemory myMemory;
+    svm::SingleCore myCpu{myMemory};
+    // MOV CX, 5; again: INC AX; MOV [0x120], AX; LOOP again; HLT
+    load(myMemory, 0x100, {0xB9, 0x05, 0x00, 0x40, 0x89, 0x06, 0x20, 0x01, 0xE2, 0xF9, 0xF4});
+    myCpu.writeRegister(Regs::IP, 0x100);
+    svm::MemoryHeatmap myHeatmap;
+    myMemory.attachHeatmap(&myHeatmap);
+
+    EXPECT_EQ(myCpu.run(100), Trap::HALT);
+    EXPECT_EQ(myHeatmap.count(Access::Execute, 0), 1U + 5U * 3U + 1U);
+    EXPECT_EQ(myHeatmap.count(Access::Write, 0), 5U);
+
+    // The stores above hit a page holding code but no decoded bytes, one into the loop evicts the block entered at
+    // 0x100 and the one entered at 0x103
+    EXPECT_EQ(myHeatmap.count(Access::Invalidate, 0), 0U);
+    EXPECT_EQ(myMemory.writeByte({.theAddress = 0x103}, 0x40), Trap::OK);
+    EXPECT_EQ(myHeatmap.count(Access::Invalidate, 0), 2U);
+
+    const auto myMap = myHeatmap.formatMap(Access::Execute);
+    EXPECT_NE(myMap.find("00000 |@"), std::string::npos) << myMap;
+    // Page 0 of the header sits above the first page of each row
+    EXPECT_NE(myMap.find("\n       0123"), std::string::npos) << myMap;
+    EXPECT_NE(myHeatmap.formatTable(4).find("00000"), std::string::npos);
+}
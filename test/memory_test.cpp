@@ -2,7 +2,10 @@
 #include "memory.hpp"
 #include "trap.hpp"
 
+#include <array>
+#include <atomic>
 #include <gtest/gtest.h>
+#include <thread>
 
 class RandomAccessMemoryTest : public ::testing::Test
 {
@@ -40,3 +43,95 @@ TEST_F(RandomAccessMemoryTest, ReadInvalidAddressMustRaiseTrap)
     const auto [myTrap, _] = theMemory.read(svm::arch::MemoryAddress{.theAddress = 0xFFFFFFFF});
     EXPECT_TRUE(myTrap == svm::Trap::SEG_FAULT);
 }
+
+TEST_F(RandomAccessMemoryTest, RestoreSnapshotCopiesBackDirtyPagesOnly)
+{
+    EXPECT_EQ(theMemory.write(MemoryAddr{.theAddress = 0x1000}, 0x1111), svm::Trap::OK);
+    theMemory.takeSnapshot();
+    EXPECT_EQ(theMemory.restoreSnapshot(), 0U);
+
+    EXPECT_EQ(theMemory.write(MemoryAddr{.theAddress = 0x1000}, 0x2222), svm::Trap::OK);
+    EXPECT_EQ(theMemory.writeByte(MemoryAddr{.theAddress = 0x1001}, 0x33), svm::Trap::OK);
+    EXPECT_EQ(theMemory.fill(MemoryAddr{.theAddress = 0x5FFF}, 2, 0xAA), svm::Trap::OK);
+    EXPECT_EQ(theMemory.exchange(MemoryAddr{.theAddress = 0x9000}, 0x4444).first, svm::Trap::OK);
+    EXPECT_EQ(theMemory.restoreSnapshot(), 4U);
+
+    EXPECT_EQ(theMemory.read(MemoryAddr{.theAddress = 0x1000}).second, 0x1111);
+    EXPECT_EQ(theMemory.read(MemoryAddr{.theAddress = 0x5FFF}).second, 0);
+    EXPECT_EQ(theMemory.read(MemoryAddr{.theAddress = 0x9000}).second, 0);
+    // Restored pages are watched again
+    EXPECT_EQ(theMemory.write(MemoryAddr{.theAddress = 0x1000}, 0x5555), svm::Trap::OK);
+    EXPECT_EQ(theMemory.restoreSnapshot(), 1U);
+    EXPECT_EQ(theMemory.read(MemoryAddr{.theAddress = 0x1000}).second, 0x1111);
+}
+
+TEST_F(RandomAccessMemoryTest, MappedPagesUseTheirBackingInPlace)
+{
+    struct Watcher : svm::MemoryObserver
+    {
+        std::size_t theWrites{};
+        void onWrite(MemoryAddr, std::size_t) noexcept override
+        {
+            ++theWrites;
+        }
+    } myWatcher;
+    alignas(8) std::array<std::uint8_t, Memory::PageSize> myBacking{};
+    myBacking[0xFFF] = 0x12;
+    EXPECT_EQ(theMemory.write(MemoryAddr{.theAddress = 0x2000}, 0xBEEF), svm::Trap::OK);
+    theMemory.attachObserver(myWatcher, MemoryAddr{.theAddress = 0x2000}, 0x10);
+
+    theMemory.mapPage(2, myBacking);
+    EXPECT_EQ(myWatcher.theWrites, 1U);
+    EXPECT_EQ(theMemory.read(MemoryAddr{.theAddress = 0x2000}).second, 0);
+    // A word straddling into the next page, which is still the memory's own
+    EXPECT_EQ(theMemory.write(MemoryAddr{.theAddress = 0x2FFF}, 0x3456), svm::Trap::OK);
+    EXPECT_EQ(myBacking[0xFFF], 0x56);
+    EXPECT_EQ(theMemory.readByte(MemoryAddr{.theAddress = 0x3000}).second, 0x34);
+    EXPECT_EQ(theMemory.exchange(MemoryAddr{.theAddress = 0x2008}, 0x7788).first, svm::Trap::OK);
+    EXPECT_EQ(myBacking[8], 0x88);
+    constexpr std::array<std::uint8_t, 4> myBlock{1, 2, 3, 4};
+    EXPECT_EQ(theMemory.writeBlock(MemoryAddr{.theAddress = 0x1FFE}, myBlock), svm::Trap::OK);
+    EXPECT_EQ(myBacking[0], 3);
+    EXPECT_EQ(theMemory.page(2).data(), myBacking.data());
+
+    theMemory.unmapPage(2);
+    // The exchange, the block and the switch back
+    EXPECT_EQ(myWatcher.theWrites, 4U);
+    EXPECT_EQ(theMemory.read(MemoryAddr{.theAddress = 0x2000}).second, 0xBEEF);
+    EXPECT_EQ(myBacking[1], 4);
+    theMemory.detachObserver(myWatcher);
+}
+
+TEST_F(RandomAccessMemoryTest, OrderedWordsAreNeverSeenHalfWritten)
+{
+    theMemory.setMemoryModel(Memory::MemoryModel::TotalStoreOrder);
+    // An aligned word, an odd word within its eight byte cell and the untouched byte beside it
+    constexpr std::array<std::uint32_t, 2> myWords{0x2000, 0x2011};
+    ASSERT_EQ(theMemory.writeByte(MemoryAddr{.theAddress = 0x2013}, 0x5A), svm::Trap::OK);
+
+    std::atomic<bool> myIsDone{};
+    std::size_t myTorn{};
+    std::thread myReader{[&] {
+        while (!myIsDone.load(std::memory_order_relaxed))
+        {
+            for (const auto myAddress : myWords)
+            {
+                const auto myValue = theMemory.read(MemoryAddr{.theAddress = myAddress}).second;
+                myTorn += myValue != 0x0000 && myValue != 0xFFFF ? 1U : 0U;
+            }
+        }
+    }};
+    for (std::size_t i{}; i < 100000; ++i)
+    {
+        for (const auto myAddress : myWords)
+        {
+            EXPECT_EQ(theMemory.write(MemoryAddr{.theAddress = myAddress}, (i % 2) != 0 ? 0xFFFF : 0x0000),
+                      svm::Trap::OK);
+        }
+    }
+    myIsDone = true;
+    myReader.join();
+
+    EXPECT_EQ(myTorn, 0U);
+    EXPECT_EQ(theMemory.readByte(MemoryAddr{.theAddress = 0x2013}).second, 0x5A);
+}
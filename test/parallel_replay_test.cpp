@@ -0,0 +1,165 @@
+#include "arch.hpp"
+#include "expanded_memory.hpp"
+#include "guest_fixture.hpp"
+#include "memory.hpp"
+#include "parallel_replay.hpp"
+#include "port_bus.hpp"
+#include "record_replay.hpp"
+#include "save_state.hpp"
+#include "single_core.hpp"
+#include "trap.hpp"
+
+#include <atomic>
+#include <gtest/gtest.h>
+#include <initializer_list>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+using Regs = svm::arch::Regs;
+using MemoryAddr = svm::arch::MemoryAddress;
+using Trap = svm::Trap;
+using svm::test::load;
+
+class ParallelReplayTest : public ::testing::Test
+{
+  protected:
+    static constexpr std::uint64_t Period = 500U;
+
+    svm::RandomAccessMemory theMemory{};
+    svm::SingleCore theCpu{theMemory};
+    svm::PortBus theBus{};
+    svm::test::CounterDevice theDevice{7, 75, 74};
+    std::vector<svm::ReplayCheckpoint> theCheckpoints;
+    std::string theLog;
+
+    void SetUp() override
+    {
+        theBus.attach(theDevice, 0x40, 1);
+        theCpu.attachPortBus(&theBus);
+        // Timer handler at 0000:0200: IN AX, 0x40; ADC DI, AX; IRET
+        svm::test::loadHandler(theMemory, 0x08, {0xE5, 0x40, 0x11, 0xC7, 0xCF});
+        // STI; MOV CX, 1500; again: IN AX, 0x40; ADC BX, AX; MOV [SI+0x1000], BX; INC SI; LOOP again; HLT
+        svm::test::loadProgram(theMemory, theCpu, {0xFB, 0xB9, 0xDC, 0x05, 0xE5, 0x40, 0x11, 0xC3, 0x89, 0x9C, 0x00,
+                                                   0x10, 0x46, 0xE2, 0xF5, 0xF4});
+        theCpu.writeRegister(Regs::SP, 0x1000);
+    }
+
+    // Records to HLT with a checkpoint every Period instructions, the timer firing after every other one
+    void record(const svm::ExpandedMemory *aExpandedMemory = nullptr)
+    {
+        std::ostringstream myStream;
+        svm::Recorder myRecorder{myStream};
+        theCpu.attachRecorder(&myRecorder);
+        theCheckpoints.push_back(svm::ParallelReplay::checkpoint(theCpu, theMemory, myRecorder, aExpandedMemory));
+        Trap myTrap{Trap::OK};
+        for (std::size_t i = 1; myTrap == Trap::OK; ++i)
+        {
+            myTrap = theCpu.runTo(i * Period);
+            theCheckpoints.push_back(svm::ParallelReplay::checkpoint(theCpu, theMemory, myRecorder, aExpandedMemory));
+            if (i % 2 == 0)
+            {
+                theCpu.raiseInterrupt(0x08);
+            }
+        }
+        EXPECT_EQ(myTrap, Trap::HALT);
+        theCpu.attachRecorder(nullptr);
+        myRecorder.flush();
+        theLog = myStream.str();
+    }
+
+    std::span<const std::uint8_t> log() const
+    {
+        return {reinterpret_cast<const std::uint8_t *>(theLog.data()), theLog.size()};
+    }
+};
+} // namespace
+
+TEST_F(ParallelReplayTest, RunToStopsOnTheExactInstruction)
+{
+    // The loop body is five instructions, 13 lands inside the second iteration's block
+    EXPECT_EQ(theCpu.runTo(13), Trap::OK);
+    EXPECT_EQ(theCpu.instructionCount(), 13U);
+    EXPECT_EQ(theCpu.runTo(13), Trap::OK);
+    EXPECT_EQ(theCpu.instructionCount(), 13U);
+    EXPECT_EQ(theCpu.run(1), Trap::OK);
+    EXPECT_GT(theCpu.instructionCount(), 13U);
+}
+
+TEST_F(ParallelReplayTest, SegmentsReplayInParallelAndMatchTheirCheckpoints)
+{
+    record();
+    ASSERT_GT(theCheckpoints.size(), 10U);
+    // Interrupts were taken, so segments have to resume the log in the middle of the interrupt deltas
+    EXPECT_NE(theCpu.readRegister(Regs::DI), 0);
+
+    std::atomic<std::size_t> myInstrumented{};
+    const auto mySegments = svm::ParallelReplay::replay(
+        log(), theCheckpoints,
+        [&myInstrumented](const svm::ParallelReplay::Segment &, svm::SingleCore &aCore, svm::RandomAccessMemory &) {
+            EXPECT_EQ(aCore.instructionCount(), 0U);
+            ++myInstrumented;
+        },
+        4U);
+
+    ASSERT_EQ(mySegments.size(), theCheckpoints.size() - 1);
+    EXPECT_EQ(myInstrumented.load(), mySegments.size());
+    for (const auto &mySegment : mySegments)
+    {
+        EXPECT_TRUE(mySegment.theIsVerified) << "segment " << mySegment.theIndex;
+        EXPECT_EQ(mySegment.theFirst, mySegment.theIndex * Period);
+    }
+    EXPECT_EQ(mySegments.back().theTrap, Trap::HALT);
+    EXPECT_EQ(mySegments.back().theLast, theCpu.instructionCount());
+}
+
+TEST_F(ParallelReplayTest, SegmentEndingOffItsCheckpointIsNotVerified)
+{
+    record();
+    // Checkpoint 3 claims a different BX, so the segments on both sides of it fail
+    svm::RandomAccessMemory myMemory{};
+    svm::SingleCore myCore{myMemory};
+    ASSERT_EQ(svm::SaveState::decode(theCheckpoints[3].theState, myCore, myMemory), svm::SaveState::Status::OK);
+    myCore.writeRegister(Regs::BX, myCore.readRegister(Regs::BX) + 1);
+    theCheckpoints[3].theState = svm::SaveState::encode(myCore, myMemory);
+
+    const auto mySegments = svm::ParallelReplay::replay(log(), theCheckpoints, {}, 2U);
+    for (const auto &mySegment : mySegments)
+    {
+        EXPECT_EQ(mySegment.theIsVerified, mySegment.theIndex != 2U && mySegment.theIndex != 3U)
+            << "segment " << mySegment.theIndex;
+    }
+}
+
+TEST_F(ParallelReplayTest, SegmentsRestoreTheExpandedMemoryBoard)
+{
+    svm::ExpandedMemory myEms{theMemory, 8};
+    theCpu.attachService(svm::ExpandedMemory::Vector, &myEms);
+    std::uint16_t myHandle{};
+    ASSERT_EQ(myEms.allocate(2, myHandle), svm::ExpandedMemory::OK);
+    // MOV AX, D000h; MOV DS, AX; MOV CX, 600
+    // again: XCHG BX, DI; MOV AX, 4400h; MOV DX, handle; INT 67h; INC word [0]; LOOP again
+    // HLT
+    load(theMemory, 0x100, {0xB8, 0x00, 0xD0, 0x8E, 0xD8, 0xB9, 0x58, 0x02, 0x87, 0xFB, 0xB8, 0x00, 0x44, 0xBA,
+                            static_cast<std::uint8_t>(myHandle), 0x00, 0xCD, 0x67, 0xFF, 0x06, 0x00, 0x00, 0xE2, 0xF0,
+                            0xF4});
+    // BX and DI take turns as the logical page
+    theCpu.writeRegister(Regs::BX, 0);
+    theCpu.writeRegister(Regs::DI, 1);
+    record(&myEms);
+    theCpu.attachService(svm::ExpandedMemory::Vector, nullptr);
+    // Each logical page was counted up through the same window, the one out of view too
+    EXPECT_EQ(theMemory.read(MemoryAddr{.theAddress = 0xD0000}).second, 300);
+    ASSERT_EQ(myEms.map(0, 0, myHandle), svm::ExpandedMemory::OK);
+    EXPECT_EQ(theMemory.read(MemoryAddr{.theAddress = 0xD0000}).second, 300);
+
+    const auto mySegments = svm::ParallelReplay::replay(log(), theCheckpoints, {}, 4U);
+    ASSERT_GT(mySegments.size(), 5U);
+    for (const auto &mySegment : mySegments)
+    {
+        EXPECT_TRUE(mySegment.theIsVerified) << "segment " << mySegment.theIndex;
+    }
+    EXPECT_EQ(mySegments.back().theTrap, Trap::HALT);
+}
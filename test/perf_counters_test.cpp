@@ -0,0 +1,110 @@
+#include "arch.hpp"
+#include "memory.hpp"
+#include "perf_counters.hpp"
+#include "single_core.hpp"
+#include "trap.hpp"
+
+#include <gtest/gtest.h>
+#include <utility>
+
+class PerfCountersTest : public ::testing::Test
+{
+  protected:
+    using Regs = svm::arch::Regs;
+    using Trap = svm::Trap;
+
+    svm::RandomAccessMemory theMemory{};
+    svm::SingleCore theCpu{theMemory};
+
+    void SetUp() override
+    {
+        if constexpr (!svm::counters::ENABLED)
+        {
+            GTEST_SKIP() << "built without SVM_COUNTERS";
+        }
+        // MOV CX, 5; again: MOV [0x400], CX; LOOP again; OUT 0x80, AX; HLT
+        const std::uint8_t myProgram[] = {0xB9, 0x05, 0x00, 0x89, 0x0E, 0x00, 0x04, 0xE2, 0xFA, 0xE7, 0x80, 0xF4};
+        for (std::uint32_t i{}; i < sizeof(myProgram); ++i)
+        {
+            EXPECT_EQ(theMemory.writeByte({.theAddress = 0x100 + i}, myProgram[i]), Trap::OK);
+        }
+        theCpu.writeRegister(Regs::IP, 0x100);
+        theMemory.resetCounters();
+    }
+};
+
+TEST_F(PerfCountersTest, CountsRunEvents)
+{
+    EXPECT_EQ(theCpu.run(1000), Trap::HALT);
+
+    const auto &myCore = theCpu.counters();
+    EXPECT_EQ(myCore.theInstructions, 1U + 5U * 2U + 2U);
+    EXPECT_EQ(myCore.theInstructions, theCpu.instructionCount());
+    // First block up to LOOP, the loop body four more times, then OUT; HLT. The loop edge is linked the first time
+    // it is taken, after that the body is entered through the link
+    EXPECT_EQ(myCore.theBlocks, 6U);
+    EXPECT_EQ(myCore.theBlockCacheMisses, 3U);
+    EXPECT_EQ(myCore.theBlockCacheHits, 1U);
+    EXPECT_EQ(myCore.theBlockLinks, 2U);
+    EXPECT_EQ(myCore.thePortWrites, 1U);
+    EXPECT_EQ(myCore.theTraps[std::to_underlying(Trap::HALT)], 1U);
+    EXPECT_GT(myCore.theHostCycles, 0U);
+
+    EXPECT_EQ(myCore.theMemoryWrites[std::to_underlying(svm::arch::OperandSize::Word)], 5U);
+    EXPECT_EQ(myCore.theMemoryReads[std::to_underlying(svm::arch::OperandSize::Word)], 0U);
+    EXPECT_EQ(theMemory.counters().theBulkBytes, 0U);
+
+    theCpu.resetCounters();
+    EXPECT_EQ(theCpu.counters().theInstructions, 0U);
+}
+
+TEST_F(PerfCountersTest, CoresSharingMemoryCountOnlyTheirOwnAccesses)
+{
+    svm::SingleCore myOther{theMemory};
+    myOther.writeRegister(Regs::IP, 0x100);
+    EXPECT_EQ(theCpu.run(1000), Trap::HALT);
+    EXPECT_EQ(myOther.counters().theMemoryWrites[std::to_underlying(svm::arch::OperandSize::Word)], 0U);
+
+    EXPECT_EQ(myOther.run(1000), Trap::HALT);
+    EXPECT_EQ(myOther.counters().theMemoryWrites[std::to_underlying(svm::arch::OperandSize::Word)], 5U);
+    EXPECT_EQ(theCpu.counters().theMemoryWrites[std::to_underlying(svm::arch::OperandSize::Word)], 5U);
+}
+
+TEST_F(PerfCountersTest, ReportIncludesHostCountersWhenAvailable)
+{
+    svm::HostPerf myPerf;
+    myPerf.start();
+    EXPECT_EQ(theCpu.run(1000), Trap::HALT);
+    const auto mySample = myPerf.stop();
+    EXPECT_EQ(mySample.has_value(), myPerf.isAvailable());
+
+    const auto myReport = svm::PerfReport::format(theCpu.counters(), theMemory.counters(), mySample);
+    EXPECT_NE(myReport.find("instructions"), std::string::npos);
+    EXPECT_NE(myReport.find("trap_halt"), std::string::npos);
+    EXPECT_EQ(myReport.find("host_ipc") != std::string::npos, mySample.has_value());
+    EXPECT_DOUBLE_EQ(svm::PerfReport::perMillion(3, 1'000'000), 3.0);
+}
+
+TEST_F(PerfCountersTest, ReturnsArePredictedFromTheCallSite)
+{
+    if constexpr (!svm::counters::ENABLED)
+    {
+        GTEST_SKIP() << "built without SVM_COUNTERS";
+    }
+    // MOV CX, 5; again: CALL f; LOOP again; HLT; f: INC AX; RET
+    const std::uint8_t myProgram[] = {0xB9, 0x05, 0x00, 0xE8, 0x03, 0x00, 0xE2, 0xFB, 0xF4, 0x40, 0xC3};
+    for (std::uint32_t i{}; i < sizeof(myProgram); ++i)
+    {
+        EXPECT_EQ(theMemory.writeByte({.theAddress = 0x100 + i}, myProgram[i]), Trap::OK);
+    }
+    theCpu.writeRegister(Regs::AX, 0);
+    theCpu.writeRegister(Regs::SP, 0x1000);
+    theCpu.writeRegister(Regs::IP, 0x100);
+
+    EXPECT_EQ(theCpu.run(1000), Trap::HALT);
+    EXPECT_EQ(theCpu.readRegister(Regs::AX), 5);
+    EXPECT_EQ(theCpu.readRegister(Regs::SP), 0x1000);
+    // The first block and the loop's CALL each learn their return block once
+    EXPECT_EQ(theCpu.counters().theReturnMisses, 2U);
+    EXPECT_EQ(theCpu.counters().theReturnHits, 3U);
+}
@@ -0,0 +1,77 @@
+#include "arch.hpp"
+#include "guest_fixture.hpp"
+#include "memory.hpp"
+#include "port_bus.hpp"
+#include "single_core.hpp"
+#include "trap.hpp"
+
+#include <gtest/gtest.h>
+#include <initializer_list>
+#include <vector>
+
+namespace
+{
+struct LatchDevice : svm::PortDevice
+{
+    std::uint16_t theLatch{};
+    std::vector<std::uint16_t> thePorts;
+
+    std::uint16_t in(std::uint16_t aPort, svm::arch::OperandSize) noexcept override
+    {
+        thePorts.push_back(aPort);
+        return theLatch;
+    }
+
+    void out(std::uint16_t aPort, std::uint16_t aValue, svm::arch::OperandSize) noexcept override
+    {
+        thePorts.push_back(aPort);
+        theLatch = aValue;
+    }
+};
+} // namespace
+
+class PortBusTest : public ::testing::Test
+{
+  protected:
+    using Regs = svm::arch::Regs;
+    using MemoryAddr = svm::arch::MemoryAddress;
+    using Trap = svm::Trap;
+    using OperandSize = svm::arch::OperandSize;
+
+    svm::RandomAccessMemory theMemory{};
+    svm::SingleCore theCpu{theMemory};
+    svm::PortBus theBus{};
+    LatchDevice theDevice{};
+
+    void load(std::initializer_list<std::uint8_t> aProgram)
+    {
+        svm::test::loadProgram(theMemory, theCpu, aProgram);
+        theCpu.attachPortBus(&theBus);
+    }
+};
+
+TEST_F(PortBusTest, RoutesClaimedPortsOnly)
+{
+    theBus.attach(theDevice, 0x3F8, 8);
+    theBus.out(0x3F9, 0x1234, OperandSize::Word);
+    EXPECT_EQ(theBus.in(0x3FF, OperandSize::Word), 0x1234);
+    EXPECT_EQ(theBus.in(0x400, OperandSize::Word), svm::PortBus::FloatingBus);
+    EXPECT_EQ(theBus.in(0x400, OperandSize::Byte), 0xFF);
+    EXPECT_EQ(theDevice.thePorts, (std::vector<std::uint16_t>{0x3F9, 0x3FF}));
+
+    theBus.detach(theDevice);
+    EXPECT_EQ(theBus.in(0x3F8, OperandSize::Word), svm::PortBus::FloatingBus);
+}
+
+TEST_F(PortBusTest, InAndOutMoveAccumulator)
+{
+    theBus.attach(theDevice, 0x40, 1);
+    theBus.attach(theDevice, 0x3F8, 1);
+    // MOV AX, 0xABCD; OUT 0x40, AX; MOV AX, 0x1100; IN AL, 0x40; MOV DX, 0x3F8; OUT DX, AL; HLT
+    load({0xB8, 0xCD, 0xAB, 0xE7, 0x40, 0xB8, 0x00, 0x11, 0xE4, 0x40, 0xBA, 0xF8, 0x03, 0xEE, 0xF4});
+
+    EXPECT_EQ(theCpu.run(100), Trap::HALT);
+    EXPECT_EQ(theCpu.readRegister(Regs::AX), 0x11CD);
+    EXPECT_EQ(theDevice.theLatch, 0x00CD);
+    EXPECT_EQ(theDevice.thePorts, (std::vector<std::uint16_t>{0x40, 0x40, 0x3F8}));
+}
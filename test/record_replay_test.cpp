@@ -0,0 +1,120 @@
+#include "arch.hpp"
+#include "guest_fixture.hpp"
+#include "memory.hpp"
+#include "port_bus.hpp"
+#include "record_replay.hpp"
+#include "single_core.hpp"
+#include "trap.hpp"
+
+#include <array>
+#include <gtest/gtest.h>
+#include <initializer_list>
+#include <sstream>
+
+namespace
+{
+using Regs = svm::arch::Regs;
+using MemoryAddr = svm::arch::MemoryAddress;
+using Trap = svm::Trap;
+using svm::test::CounterDevice;
+
+struct Machine
+{
+    svm::RandomAccessMemory theMemory{};
+    svm::SingleCore theCpu{theMemory};
+    svm::PortBus theBus{};
+    CounterDevice theClock;
+    CounterDevice theKeyboard;
+
+    Machine(std::uint16_t aSeed, std::uint8_t aClockPort = 0x40) : theClock{aSeed, 1, 17}, theKeyboard{aSeed, 1, 3}
+    {
+        theBus.attach(theClock, 0x40, 1);
+        theBus.attach(theKeyboard, 0x60, 1);
+        theCpu.attachPortBus(&theBus);
+
+        // Timer handler at 0000:0200: IN AL, 0x60; ADC DI, AX; IRET
+        svm::test::loadHandler(theMemory, 0x08, {0xE4, 0x60, 0x11, 0xC7, 0xCF});
+        // STI; MOV CX, 200; again: IN AX, clock; ADC BX, AX; INC SI; LOOP again; HLT
+        svm::test::loadProgram(theMemory, theCpu,
+                               {0xFB, 0xB9, 0xC8, 0x00, 0xE5, aClockPort, 0x11, 0xC3, 0x46, 0xE2, 0xF9, 0xF4});
+        theCpu.writeRegister(Regs::SP, 0x1000);
+    }
+
+    // Runs to HLT in slices of aSlice instructions, raising the timer interrupt every third slice
+    Trap runToHalt(std::size_t aSlice)
+    {
+        Trap myTrap{};
+        for (std::size_t mySlice = 1; (myTrap = theCpu.run(aSlice)) == Trap::OK; ++mySlice)
+        {
+            if (mySlice % 3 == 0)
+            {
+                theCpu.raiseInterrupt(0x08);
+            }
+        }
+        return myTrap;
+    }
+
+    std::array<std::uint16_t, 14> registers()
+    {
+        std::array<std::uint16_t, 14> myRegisters{};
+        for (std::size_t i{}; i < myRegisters.size(); ++i)
+        {
+            myRegisters[i] = theCpu.readRegister(static_cast<Regs>(i));
+        }
+        return myRegisters;
+    }
+};
+} // namespace
+
+TEST(RecordReplayTest, ReplayIsBitIdentical)
+{
+    std::stringstream myLog;
+    Machine myRecorded{100};
+    {
+        svm::Recorder myRecorder{myLog, 64};
+        myRecorded.theCpu.attachRecorder(&myRecorder);
+        EXPECT_EQ(myRecorded.runToHalt(7), Trap::HALT);
+        myRecorded.theCpu.attachRecorder(nullptr);
+        // 200 clock reads plus the interrupts and their keyboard reads, a few bytes each
+        EXPECT_GT(myRecorder.bytesWritten(), 200U * 4U);
+        EXPECT_LT(myRecorder.bytesWritten(), 300U * 6U);
+    }
+    // The run actually took interrupts
+    EXPECT_NE(myRecorded.theCpu.readRegister(Regs::DI), 0);
+
+    // Different device values and slicing, the log decides what the guest sees
+    Machine myReplayed{9000};
+    svm::Replayer myReplayer{myLog};
+    myReplayed.theCpu.attachReplayer(&myReplayer);
+    EXPECT_EQ(myReplayed.runToHalt(5), Trap::HALT);
+
+    EXPECT_FALSE(myReplayer.diverged());
+    EXPECT_TRUE(myReplayer.finished());
+    EXPECT_EQ(myReplayed.registers(), myRecorded.registers());
+    EXPECT_EQ(myReplayed.theCpu.instructionCount(), myRecorded.theCpu.instructionCount());
+}
+
+TEST(RecordReplayTest, DetectsDivergence)
+{
+    std::stringstream myLog;
+    Machine myRecorded{1};
+    {
+        svm::Recorder myRecorder{myLog};
+        myRecorded.theCpu.attachRecorder(&myRecorder);
+        EXPECT_EQ(myRecorded.runToHalt(11), Trap::HALT);
+    }
+
+    // Same inputs requested from a different port
+    Machine myReplayed{1, 0x41};
+    svm::Replayer myReplayer{myLog};
+    myReplayed.theCpu.attachReplayer(&myReplayer);
+    EXPECT_EQ(myReplayed.runToHalt(11), Trap::HALT);
+    EXPECT_TRUE(myReplayer.diverged());
+}
+
+TEST(RecordReplayTest, RejectsForeignLog)
+{
+    std::stringstream myLog{"not a log"};
+    svm::Replayer myReplayer{myLog};
+    EXPECT_TRUE(myReplayer.diverged());
+}
@@ -0,0 +1,192 @@
+#include "arch.hpp"
+#include "memory.hpp"
+#include "save_state.hpp"
+#include "single_core.hpp"
+#include "trap.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <gtest/gtest.h>
+
+class SaveStateTest : public ::testing::Test
+{
+  protected:
+    using Regs = svm::arch::Regs;
+    using MemoryAddr = svm::arch::MemoryAddress;
+    using Trap = svm::Trap;
+    using PageKind = svm::SaveState::PageKind;
+    using Status = svm::SaveState::Status;
+
+    static constexpr auto PAGE_SIZE = svm::RandomAccessMemory::PageSize;
+
+    svm::RandomAccessMemory theMemory{};
+    svm::SingleCore theCpu{theMemory};
+    svm::RandomAccessMemory theRestoredMemory{};
+    svm::SingleCore theRestoredCpu{theRestoredMemory};
+
+    void fillPage(std::size_t aPage, std::uint8_t aSeed)
+    {
+        for (std::uint32_t i{}; i < PAGE_SIZE; ++i)
+        {
+            const MemoryAddr myAddress{.theAddress = static_cast<std::uint32_t>(aPage * PAGE_SIZE + i)};
+            EXPECT_EQ(theMemory.writeByte(myAddress, static_cast<std::uint8_t>(aSeed + i * 7)), Trap::OK);
+        }
+    }
+
+    void expectSameMemory()
+    {
+        for (std::size_t i{}; i < svm::RandomAccessMemory::PageCount; ++i)
+        {
+            EXPECT_TRUE(std::ranges::equal(theMemory.page(i), theRestoredMemory.page(i))) << "page " << i;
+        }
+    }
+};
+
+TEST_F(SaveStateTest, RoundTripRestoresRegistersAndMemory)
+{
+    theCpu.writeRegister(Regs::AX, 0x1234);
+    theCpu.writeRegister(Regs::SP, 0xFFFE);
+    theCpu.writeRegister(Regs::IP, 0x0100);
+    theCpu.writeRegister(Regs::FLAG, 0x0045);
+    fillPage(1, 3);
+    fillPage(7, 11);
+    EXPECT_EQ(theMemory.fill(MemoryAddr{.theAddress = 3 * PAGE_SIZE + 16}, 64, 0xAA), Trap::OK);
+    // Leave a stale byte in the target so restoring a zero page has to clear it
+    EXPECT_EQ(theRestoredMemory.writeByte(MemoryAddr{.theAddress = 9 * PAGE_SIZE}, 0x55), Trap::OK);
+
+    const auto myImage = svm::SaveState::encode(theCpu, theMemory);
+    EXPECT_EQ(svm::SaveState::decode(myImage, theRestoredCpu, theRestoredMemory), Status::OK);
+
+    EXPECT_EQ(theRestoredCpu.readRegister(Regs::AX), 0x1234);
+    EXPECT_EQ(theRestoredCpu.readRegister(Regs::SP), 0xFFFE);
+    EXPECT_EQ(theRestoredCpu.readRegister(Regs::IP), 0x0100);
+    EXPECT_EQ(theRestoredCpu.readRegister(Regs::FLAG), 0x0045);
+    expectSameMemory();
+}
+
+TEST_F(SaveStateTest, PagesAreEncodedByContent)
+{
+    fillPage(2, 5);
+    fillPage(4, 5);
+    EXPECT_EQ(theMemory.fill(MemoryAddr{.theAddress = 6 * PAGE_SIZE}, PAGE_SIZE / 2, 0x90), Trap::OK);
+
+    const auto myImage = svm::SaveState::encode(theCpu, theMemory);
+    const auto myKinds = svm::SaveState::pageKinds(myImage);
+    ASSERT_EQ(myKinds.size(), svm::RandomAccessMemory::PageCount);
+    EXPECT_EQ(myKinds[0], PageKind::Zero);
+    EXPECT_EQ(myKinds[2], PageKind::Raw);
+    EXPECT_EQ(myKinds[4], PageKind::Duplicate);
+    EXPECT_EQ(myKinds[6], PageKind::RunLength);
+    // Two stored pages plus headers, far below the 1 MiB of guest memory
+    EXPECT_LT(myImage.size(), 4 * PAGE_SIZE);
+
+    EXPECT_EQ(svm::SaveState::decode(myImage, theRestoredCpu, theRestoredMemory), Status::OK);
+    expectSameMemory();
+}
+
+TEST_F(SaveStateTest, SectionsRoundTrip)
+{
+    const std::array mySections{svm::SaveState::Section{.theTag = 0x54524155, .theData = {1, 2, 3}},
+                                svm::SaveState::Section{.theTag = 0x43495450, .theData = {}}};
+    const auto myImage = svm::SaveState::encode(theCpu, theMemory, mySections);
+
+    std::vector<svm::SaveState::Section> myRestored;
+    EXPECT_EQ(svm::SaveState::decode(myImage, theRestoredCpu, theRestoredMemory, &myRestored), Status::OK);
+    ASSERT_EQ(myRestored.size(), 2U);
+    EXPECT_EQ(myRestored[0].theTag, 0x54524155U);
+    EXPECT_EQ(myRestored[0].theData, (std::vector<std::uint8_t>{1, 2, 3}));
+    EXPECT_EQ(myRestored[1].theTag, 0x43495450U);
+    EXPECT_TRUE(myRestored[1].theData.empty());
+}
+
+TEST_F(SaveStateTest, RejectsDamagedImages)
+{
+    theRestoredCpu.writeRegister(Regs::AX, 0x4242);
+    auto myImage = svm::SaveState::encode(theCpu, theMemory);
+
+    auto myBadMagic = myImage;
+    myBadMagic[0] = 'X';
+    EXPECT_EQ(svm::SaveState::decode(myBadMagic, theRestoredCpu, theRestoredMemory), Status::BAD_FORMAT);
+
+    auto myNewerVersion = myImage;
+    myNewerVersion[4] = svm::SaveState::Version + 1;
+    EXPECT_EQ(svm::SaveState::decode(myNewerVersion, theRestoredCpu, theRestoredMemory), Status::VERSION_MISMATCH);
+
+    myImage.resize(16);
+    EXPECT_EQ(svm::SaveState::decode(myImage, theRestoredCpu, theRestoredMemory), Status::BAD_FORMAT);
+
+    // A rejected image leaves the target untouched
+    EXPECT_EQ(theRestoredCpu.readRegister(Regs::AX), 0x4242);
+}
+
+TEST_F(SaveStateTest, CorruptPageRestoresNothing)
+{
+    theRestoredCpu.writeRegister(Regs::AX, 0x4242);
+    theCpu.writeRegister(Regs::AX, 0x1234);
+    fillPage(2, 5);
+    EXPECT_EQ(theMemory.fill(MemoryAddr{.theAddress = 6 * PAGE_SIZE}, PAGE_SIZE / 2, 0x90), Trap::OK);
+    auto myImage = svm::SaveState::encode(theCpu, theMemory);
+    ASSERT_EQ(svm::SaveState::pageKinds(myImage)[6], PageKind::RunLength);
+
+    // Run-length data closes the image, make its last run overflow the page
+    myImage[myImage.size() - 2] = 0xFF;
+    myImage[myImage.size() - 1] = 0xFF;
+    EXPECT_EQ(svm::SaveState::decode(myImage, theRestoredCpu, theRestoredMemory), Status::BAD_FORMAT);
+    EXPECT_EQ(theRestoredCpu.readRegister(Regs::AX), 0x4242);
+    EXPECT_TRUE(std::ranges::all_of(theRestoredMemory.page(2), [](std::uint8_t aByte) { return aByte == 0; }));
+}
+
+TEST_F(SaveStateTest, OnlyChangedPagesAreWritten)
+{
+    fillPage(1, 3);
+    fillPage(4, 3);
+    EXPECT_EQ(theMemory.fill(MemoryAddr{.theAddress = 6 * PAGE_SIZE}, PAGE_SIZE / 2, 0x90), Trap::OK);
+    const auto myImage = svm::SaveState::encode(theCpu, theMemory);
+    const auto myKinds = svm::SaveState::pageKinds(myImage);
+    ASSERT_EQ(myKinds[1], PageKind::Raw);
+    ASSERT_EQ(myKinds[4], PageKind::Duplicate);
+    ASSERT_EQ(myKinds[6], PageKind::RunLength);
+
+    // Into fresh memory the zero pages cost nothing, every page with data is stored once
+    theRestoredMemory.takeSnapshot();
+    EXPECT_EQ(svm::SaveState::decode(myImage, theRestoredCpu, theRestoredMemory), Status::OK);
+    EXPECT_EQ(theRestoredMemory.restoreSnapshot(), 3U);
+
+    // Over the same state nothing changes
+    EXPECT_EQ(svm::SaveState::decode(myImage, theRestoredCpu, theRestoredMemory), Status::OK);
+    theRestoredMemory.takeSnapshot();
+    EXPECT_EQ(svm::SaveState::decode(myImage, theRestoredCpu, theRestoredMemory), Status::OK);
+    EXPECT_EQ(theRestoredMemory.restoreSnapshot(), 0U);
+    expectSameMemory();
+}
+
+TEST_F(SaveStateTest, RejectsSectionOffsetsOutsideTheSectionArea)
+{
+    const std::array mySections{svm::SaveState::Section{.theTag = 0x54524155, .theData = {1, 2, 3}}};
+    const auto myImage = svm::SaveState::encode(theCpu, theMemory, mySections);
+    // Header: magic, version, register count, page size, page count, section count, reserved, section offset
+    constexpr std::size_t mySectionOffsetField = 24;
+    for (const std::uint64_t myOffset : {std::uint64_t{0}, ~std::uint64_t{7}, std::uint64_t{1} << 40})
+    {
+        auto myCrafted = myImage;
+        std::memcpy(myCrafted.data() + mySectionOffsetField, &myOffset, sizeof(myOffset));
+        EXPECT_EQ(svm::SaveState::decode(myCrafted, theRestoredCpu, theRestoredMemory), Status::BAD_FORMAT);
+    }
+}
+
+TEST_F(SaveStateTest, SaveAndLoadFile)
+{
+    theCpu.writeRegister(Regs::CX, 0xBEEF);
+    fillPage(0x10, 1);
+    const auto myPath = std::filesystem::temp_directory_path() / "svm_save_state_test.svms";
+
+    EXPECT_EQ(svm::SaveState::save(myPath, theCpu, theMemory), Status::OK);
+    EXPECT_EQ(svm::SaveState::load(myPath, theRestoredCpu, theRestoredMemory), Status::OK);
+    EXPECT_EQ(theRestoredCpu.readRegister(Regs::CX), 0xBEEF);
+    expectSameMemory();
+    std::filesystem::remove(myPath);
+
+    EXPECT_EQ(svm::SaveState::load(myPath, theRestoredCpu, theRestoredMemory), Status::IO_ERROR);
+}
@@ -3,7 +3,10 @@
 #include "single_core.hpp"
 #include "trap.hpp"
 
+#include <array>
 #include <gtest/gtest.h>
+#include <utility>
+#include <vector>
 
 class SingleCoreTest : public ::testing::Test
 {
@@ -548,3 +551,302 @@ TEST_F(SingleCoreTest, CMPSB_CompareDifferentBytes_SetsFlags)
     EXPECT_EQ(theCpu.readRegister(Regs::SI), 0x3001);
     EXPECT_EQ(theCpu.readRegister(Regs::DI), 0x4001);
 }
+
+TEST_F(SingleCoreTest, Run_LoopUntilHalt)
+{
+    // MOV CX, 5; MOV AX, 0; INC AX; LOOP -3; HLT
+    const std::uint8_t myProgram[] = {0xB9, 0x05, 0x00, 0xB8, 0x00, 0x00, 0x40, 0xE2, 0xFD, 0xF4};
+    for (std::uint32_t i{}; i < sizeof(myProgram); ++i)
+    {
+        EXPECT_EQ(theMemory.writeByte({.theAddress = 0x100 + i}, myProgram[i]), Trap::OK);
+    }
+    theCpu.writeRegister(Regs::IP, 0x100);
+
+    EXPECT_EQ(theCpu.run(1000), Trap::HALT);
+    EXPECT_EQ(theCpu.readRegister(Regs::AX), 5);
+    EXPECT_EQ(theCpu.readRegister(Regs::CX), 0);
+    EXPECT_EQ(theCpu.readRegister(Regs::IP), 0x10A);
+}
+
+TEST_F(SingleCoreTest, Run_IllegalOpcodeLeavesIPOnInstruction)
+{
+    // NOP; undefined opcode
+    EXPECT_EQ(theMemory.writeByte({.theAddress = 0x100}, 0x90), Trap::OK);
+    EXPECT_EQ(theMemory.writeByte({.theAddress = 0x101}, 0x0F), Trap::OK);
+    theCpu.writeRegister(Regs::IP, 0x100);
+
+    EXPECT_EQ(theCpu.run(1000), Trap::ILLEGAL);
+    EXPECT_EQ(theCpu.readRegister(Regs::IP), 0x101);
+}
+
+TEST_F(SingleCoreTest, Run_ModifiedCodeIsDecodedAgain)
+{
+    // MOV AX, 1; HLT
+    const std::uint8_t myProgram[] = {0xB8, 0x01, 0x00, 0xF4};
+    for (std::uint32_t i{}; i < sizeof(myProgram); ++i)
+    {
+        EXPECT_EQ(theMemory.writeByte({.theAddress = 0x100 + i}, myProgram[i]), Trap::OK);
+    }
+    theCpu.writeRegister(Regs::IP, 0x100);
+    EXPECT_EQ(theCpu.run(1000), Trap::HALT);
+    EXPECT_EQ(theCpu.readRegister(Regs::AX), 1);
+
+    EXPECT_EQ(theMemory.writeByte({.theAddress = 0x101}, 0x07), Trap::OK);
+    theCpu.writeRegister(Regs::IP, 0x100);
+    EXPECT_EQ(theCpu.run(1000), Trap::HALT);
+    EXPECT_EQ(theCpu.readRegister(Regs::AX), 7);
+}
+
+TEST_F(SingleCoreTest, Run_ModifiedLinkedBlockIsDecodedAgain)
+{
+    // MOV CX, 3; again: JMP add; add: ADC AX, 1; JMP store; store: MOV [0x111], CX; LOOP again; HLT
+    // Every trip patches the ADC immediate after the JMP into it was linked, stale links would keep adding 1
+    const std::pair<std::uint32_t, std::vector<std::uint8_t>> myProgram[] = {
+        {0x100, {0xB9, 0x03, 0x00, 0xE9, 0x0A, 0x00}},
+        {0x110, {0x15, 0x01, 0x00, 0xEB, 0x0B}},
+        {0x120, {0x89, 0x0E, 0x11, 0x01, 0xE2, 0xDD, 0xF4}},
+    };
+    for (const auto &[myAddress, myBytes] : myProgram)
+    {
+        for (std::uint32_t i{}; i < myBytes.size(); ++i)
+        {
+            EXPECT_EQ(theMemory.writeByte({.theAddress = myAddress + i}, myBytes[i]), Trap::OK);
+        }
+    }
+    theCpu.writeRegister(Regs::AX, 0);
+    theCpu.writeRegister(Regs::IP, 0x100);
+
+    EXPECT_EQ(theCpu.run(1000), Trap::HALT);
+    EXPECT_EQ(theCpu.readRegister(Regs::AX), 1 + 3 + 2);
+    EXPECT_EQ(theCpu.readRegister(Regs::CX), 0);
+    EXPECT_EQ(theCpu.readRegister(Regs::IP), 0x127);
+}
+
+TEST_F(SingleCoreTest, Run_CallAndReturnForms)
+{
+    // MOV BX, 0x120; CALL BX; CALL [0x200]; CALL 0000:0130; CALL 0x140; JMP FAR [0x204]
+    // 0x120: INC AX; RET   0x130: INC AX; RETF   0x140: INC AX; RET 4   0x150: HLT
+    const std::pair<std::uint32_t, std::vector<std::uint8_t>> myProgram[] = {
+        {0x100, {0xBB, 0x20, 0x01, 0xFF, 0xD3, 0xFF, 0x16, 0x00, 0x02, 0x9A, 0x30, 0x01, 0x00, 0x00, 0xE8, 0x2F, 0x00,
+                 0xFF, 0x2E, 0x04, 0x02}},
+        {0x120, {0x40, 0xC3}},
+        {0x130, {0x40, 0xCB}},
+        {0x140, {0x40, 0xC2, 0x04, 0x00}},
+        {0x150, {0xF4}},
+        {0x200, {0x20, 0x01, 0x00, 0x00, 0x50, 0x01, 0x00, 0x00}},
+    };
+    for (const auto &[myAddress, myBytes] : myProgram)
+    {
+        for (std::uint32_t i{}; i < myBytes.size(); ++i)
+        {
+            EXPECT_EQ(theMemory.writeByte({.theAddress = myAddress + i}, myBytes[i]), Trap::OK);
+        }
+    }
+    theCpu.writeRegister(Regs::AX, 0);
+    theCpu.writeRegister(Regs::SP, 0x1000);
+    theCpu.writeRegister(Regs::IP, 0x100);
+
+    EXPECT_EQ(theCpu.run(1000), Trap::HALT);
+    EXPECT_EQ(theCpu.readRegister(Regs::AX), 4);
+    EXPECT_EQ(theCpu.readRegister(Regs::SP), 0x1004);
+    EXPECT_EQ(theCpu.readRegister(Regs::CS), 0);
+    EXPECT_EQ(theCpu.readRegister(Regs::IP), 0x151);
+    // The last call left its return offset below the released arguments
+    EXPECT_EQ(theMemory.read({.theAddress = 0xFFE}).second, 0x111);
+}
+
+TEST_F(SingleCoreTest, Run_IndirectJumpFollowsChangingTarget)
+{
+    // MOV AX, 0x120; MOV BX, 0x130; MOV CX, 4; again: XCHG AX, BX; JMP BX
+    // 0x120: INC DX; JMP next   0x130: INC SI; JMP next   next: LOOP again; HLT
+    const std::pair<std::uint32_t, std::vector<std::uint8_t>> myProgram[] = {
+        {0x100, {0xB8, 0x20, 0x01, 0xBB, 0x30, 0x01, 0xB9, 0x04, 0x00, 0x93, 0xFF, 0xE3}},
+        {0x120, {0x42, 0xEB, 0x03}},
+        {0x126, {0xE2, 0xE1, 0xF4}},
+        {0x130, {0x46, 0xEB, 0xF3}},
+    };
+    for (const auto &[myAddress, myBytes] : myProgram)
+    {
+        for (std::uint32_t i{}; i < myBytes.size(); ++i)
+        {
+            EXPECT_EQ(theMemory.writeByte({.theAddress = myAddress + i}, myBytes[i]), Trap::OK);
+        }
+    }
+    theCpu.writeRegister(Regs::IP, 0x100);
+
+    EXPECT_EQ(theCpu.run(1000), Trap::HALT);
+    EXPECT_EQ(theCpu.readRegister(Regs::DX), 2);
+    EXPECT_EQ(theCpu.readRegister(Regs::SI), 2);
+    EXPECT_EQ(theCpu.readRegister(Regs::IP), 0x129);
+}
+
+TEST_F(SingleCoreTest, Run_EveryModRmAddressMode)
+{
+    // MOV AX, r/m for mod 0 to 2 and every r/m, with BP based forms defaulting to SS
+    theCpu.writeRegister(Regs::DS, 0x100);
+    theCpu.writeRegister(Regs::SS, 0x200);
+    theCpu.writeRegister(Regs::BX, 0x1000);
+    theCpu.writeRegister(Regs::BP, 0x2000);
+    theCpu.writeRegister(Regs::SI, 0x0300);
+    theCpu.writeRegister(Regs::DI, 0x0040);
+    const std::array<std::uint16_t, 8> myBase{0x1000, 0x1000, 0x2000, 0x2000, 0x0300, 0x0040, 0x2000, 0x1000};
+    const std::array<std::uint16_t, 8> myIndex{0x0300, 0x0040, 0x0300, 0x0040, 0, 0, 0, 0};
+    for (std::uint8_t myMod{}; myMod < 3; ++myMod)
+    {
+        for (std::uint8_t myRm{}; myRm < 8; ++myRm)
+        {
+            const bool myIsDirect = myMod == 0 && myRm == 6;
+            std::vector<std::uint8_t> myCode{0x8B, static_cast<std::uint8_t>((myMod << 6) | myRm)};
+            std::uint16_t myOffset = myIsDirect ? 0x0300 : myBase[myRm] + myIndex[myRm];
+            if (myMod == 1)
+            {
+                myCode.push_back(0xFE);
+                myOffset -= 2;
+            }
+            else if (myMod == 2 || myIsDirect)
+            {
+                const std::uint16_t myDisplacement = myIsDirect ? 0x0300 : 0x1234;
+                myCode.push_back(myDisplacement & 0xFF);
+                myCode.push_back(myDisplacement >> 8);
+                myOffset += myMod == 2 ? myDisplacement : 0;
+            }
+            const bool myIsStack = !myIsDirect && (myRm == 2 || myRm == 3 || myRm == 6);
+            const std::uint32_t mySegment = myIsStack ? 0x200 : 0x100;
+            const auto myValue = static_cast<Immediate>((myMod * 8 + myRm + 1) * 0x111);
+            EXPECT_EQ(theMemory.write({.theAddress = (mySegment << 4) + myOffset}, myValue), Trap::OK);
+            for (std::uint32_t i{}; i < myCode.size(); ++i)
+            {
+                EXPECT_EQ(theMemory.writeByte({.theAddress = 0x100 + i}, myCode[i]), Trap::OK);
+            }
+            theCpu.writeRegister(Regs::IP, 0x100);
+
+            EXPECT_EQ(theCpu.step(), Trap::OK);
+            EXPECT_EQ(theCpu.readRegister(Regs::AX), myValue) << "mod " << int{myMod} << " r/m " << int{myRm};
+        }
+    }
+}
+
+TEST_F(SingleCoreTest, Run_StackInstructions)
+{
+    // PUSH AX; PUSH BX; PUSHA; MOV AX, 0; MOV BX, 0; POPA; POP CX; POP DX; PUSHF; PUSH DS; POP ES; POP [0x500];
+    // PUSH [0x500]; POPF; PUSH SP; POP SI; HLT
+    const std::uint8_t myProgram[] = {0x50, 0x53, 0x60, 0xB8, 0x00, 0x00, 0xBB, 0x00, 0x00, 0x61, 0x59, 0x5A, 0x9C,
+                                      0x1E, 0x07, 0x8F, 0x06, 0x00, 0x05, 0xFF, 0x36, 0x00, 0x05, 0x9D, 0x54, 0x5E, 0xF4};
+    for (std::uint32_t i{}; i < sizeof(myProgram); ++i)
+    {
+        EXPECT_EQ(theMemory.writeByte({.theAddress = 0x100 + i}, myProgram[i]), Trap::OK);
+    }
+    theCpu.writeRegister(Regs::AX, 0x1111);
+    theCpu.writeRegister(Regs::BX, 0x2222);
+    theCpu.writeRegister(Regs::DS, 0x30);
+    theCpu.writeRegister(Regs::SP, 0x1000);
+    theCpu.setFlag(Flags::CF, 1);
+    const auto myFlags = theCpu.readRegister(Regs::FLAG);
+    theCpu.writeRegister(Regs::IP, 0x100);
+
+    EXPECT_EQ(theCpu.run(1000), Trap::HALT);
+    EXPECT_EQ(theCpu.readRegister(Regs::AX), 0x1111);
+    EXPECT_EQ(theCpu.readRegister(Regs::BX), 0x2222);
+    EXPECT_EQ(theCpu.readRegister(Regs::CX), 0x2222);
+    EXPECT_EQ(theCpu.readRegister(Regs::DX), 0x1111);
+    EXPECT_EQ(theCpu.readRegister(Regs::ES), 0x30);
+    EXPECT_EQ(theMemory.read({.theAddress = 0x800}).second, myFlags);
+    EXPECT_EQ(theCpu.readRegister(Regs::FLAG), myFlags);
+    // The 8086 pushes SP after the decrement
+    EXPECT_EQ(theCpu.readRegister(Regs::SI), 0x0FFE);
+    EXPECT_EQ(theCpu.readRegister(Regs::SP), 0x1000);
+}
+
+TEST_F(SingleCoreTest, Run_ConditionalBranchFollowsFlags)
+{
+    // CMP AX, 3; JE +3; MOV BX, 1; HLT
+    const std::uint8_t myProgram[] = {0x3D, 0x03, 0x00, 0x74, 0x03, 0xBB, 0x01, 0x00, 0xF4};
+    for (std::uint32_t i{}; i < sizeof(myProgram); ++i)
+    {
+        EXPECT_EQ(theMemory.writeByte({.theAddress = 0x100 + i}, myProgram[i]), Trap::OK);
+    }
+
+    theCpu.writeRegister(Regs::AX, 3);
+    theCpu.writeRegister(Regs::IP, 0x100);
+    EXPECT_EQ(theCpu.run(1000), Trap::HALT);
+    EXPECT_EQ(theCpu.readRegister(Regs::BX), 0);
+
+    theCpu.writeRegister(Regs::AX, 4);
+    theCpu.writeRegister(Regs::IP, 0x100);
+    EXPECT_EQ(theCpu.run(1000), Trap::HALT);
+    EXPECT_EQ(theCpu.readRegister(Regs::BX), 1);
+}
+
+TEST_F(SingleCoreTest, Run_SoftwareInterruptReturnsWithIret)
+{
+    // Vector 0x21 -> 0000:0200
+    EXPECT_EQ(theMemory.write({.theAddress = 0x21 * 4}, 0x0200), Trap::OK);
+    EXPECT_EQ(theMemory.write({.theAddress = 0x21 * 4 + 2}, 0x0000), Trap::OK);
+    // Handler: MOV BX, 7; IRET
+    const std::uint8_t myHandler[] = {0xBB, 0x07, 0x00, 0xCF};
+    // STI; INT 0x21; HLT
+    const std::uint8_t myProgram[] = {0xFB, 0xCD, 0x21, 0xF4};
+    for (std::uint32_t i{}; i < sizeof(myHandler); ++i)
+    {
+        EXPECT_EQ(theMemory.writeByte({.theAddress = 0x200 + i}, myHandler[i]), Trap::OK);
+    }
+    for (std::uint32_t i{}; i < sizeof(myProgram); ++i)
+    {
+        EXPECT_EQ(theMemory.writeByte({.theAddress = 0x100 + i}, myProgram[i]), Trap::OK);
+    }
+    theCpu.writeRegister(Regs::SP, 0x1000);
+    theCpu.writeRegister(Regs::IP, 0x100);
+
+    EXPECT_EQ(theCpu.run(1000), Trap::HALT);
+    EXPECT_EQ(theCpu.readRegister(Regs::BX), 7);
+    EXPECT_EQ(theCpu.readRegister(Regs::SP), 0x1000);
+    EXPECT_EQ(theCpu.readRegister(Regs::IP), 0x104);
+    EXPECT_EQ(theCpu.readFlag(svm::arch::Flags::IF), 1);
+    EXPECT_EQ(theCpu.instructionCount(), 5U);
+}
+
+TEST_F(SingleCoreTest, Run_ExternalInterruptWaitsForIF)
+{
+    EXPECT_EQ(theMemory.write({.theAddress = 0x08 * 4}, 0x0200), Trap::OK);
+    // Handler: INC BX; IRET
+    EXPECT_EQ(theMemory.writeByte({.theAddress = 0x200}, 0x43), Trap::OK);
+    EXPECT_EQ(theMemory.writeByte({.theAddress = 0x201}, 0xCF), Trap::OK);
+    // NOP; HLT; STI; NOP; HLT; HLT
+    const std::uint8_t myProgram[] = {0x90, 0xF4, 0xFB, 0x90, 0xF4, 0xF4};
+    for (std::uint32_t i{}; i < sizeof(myProgram); ++i)
+    {
+        EXPECT_EQ(theMemory.writeByte({.theAddress = 0x100 + i}, myProgram[i]), Trap::OK);
+    }
+    theCpu.writeRegister(Regs::SP, 0x1000);
+    theCpu.writeRegister(Regs::IP, 0x100);
+
+    theCpu.raiseInterrupt(0x08);
+    EXPECT_EQ(theCpu.run(1000), Trap::HALT);
+    EXPECT_EQ(theCpu.run(1000), Trap::HALT);
+    EXPECT_EQ(theCpu.readRegister(Regs::BX), 0);
+
+    // Taken at the start of the next run now that IF is set, returning to the second HLT
+    EXPECT_EQ(theCpu.run(1000), Trap::HALT);
+    EXPECT_EQ(theCpu.readRegister(Regs::BX), 1);
+    EXPECT_EQ(theCpu.readRegister(Regs::IP), 0x106);
+}
+
+TEST_F(SingleCoreTest, Run_XchgAndLockedIncrement)
+{
+    EXPECT_EQ(theMemory.write({.theAddress = 0x2000}, 0x1234), Trap::OK);
+    // XCHG AX, BX; XCHG [0x2000], AX; LOCK INC word [0x2000]; HLT
+    const std::uint8_t myProgram[] = {0x93, 0x87, 0x06, 0x00, 0x20, 0xF0, 0xFF, 0x06, 0x00, 0x20, 0xF4};
+    for (std::uint32_t i{}; i < sizeof(myProgram); ++i)
+    {
+        EXPECT_EQ(theMemory.writeByte({.theAddress = 0x100 + i}, myProgram[i]), Trap::OK);
+    }
+    theCpu.writeRegister(Regs::AX, 1);
+    theCpu.writeRegister(Regs::BX, 0x00FF);
+    theCpu.writeRegister(Regs::IP, 0x100);
+
+    EXPECT_EQ(theCpu.run(1000), Trap::HALT);
+    EXPECT_EQ(theCpu.readRegister(Regs::BX), 1);
+    EXPECT_EQ(theCpu.readRegister(Regs::AX), 0x1234);
+    EXPECT_EQ(theMemory.read({.theAddress = 0x2000}).second, 0x0100);
+    EXPECT_EQ(theCpu.readFlag(svm::arch::Flags::ZF), 0);
+}
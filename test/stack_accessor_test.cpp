@@ -0,0 +1,81 @@
+#include "arch.hpp"
+#include "memory.hpp"
+#include "perf_counters.hpp"
+#include "stack_accessor.hpp"
+#include "trap.hpp"
+
+#include <array>
+#include <gtest/gtest.h>
+
+namespace
+{
+using Trap = svm::Trap;
+using Immediate = svm::arch::Immediate;
+
+constexpr Immediate StackSegment = 0x100;
+constexpr std::uint32_t StackBase = std::uint32_t{StackSegment} << 4;
+} // namespace
+
+TEST(StackAccessorTest, PushAllIsUndoneByPopAll)
+{
+    svm::RandomAccessMemory myMemory;
+    svm::CoreCounters myCounters;
+    Immediate myPointer = 0x20;
+    svm::StackAccessor myStack{myMemory, myCounters, StackSegment, myPointer};
+
+    const std::array<Immediate, 8> myValues{1, 2, 3, 4, 5, 6, 7, 8};
+    EXPECT_EQ(myStack.pushAll(myValues), Trap::OK);
+    EXPECT_EQ(myPointer, 0x10);
+    // First pushed at the highest address
+    EXPECT_EQ(myMemory.read({.theAddress = StackBase + 0x1E}).second, 1);
+    EXPECT_EQ(myMemory.read({.theAddress = StackBase + 0x10}).second, 8);
+    EXPECT_EQ(myStack.pop().second, 8);
+    EXPECT_EQ(myStack.push(8), Trap::OK);
+
+    std::array<Immediate, 8> myPopped{};
+    EXPECT_EQ(myStack.popAll(myPopped), Trap::OK);
+    EXPECT_EQ(myPopped, myValues);
+    EXPECT_EQ(myPointer, 0x20);
+}
+
+TEST(StackAccessorTest, OffsetsWrapAtSegmentEnd)
+{
+    svm::RandomAccessMemory myMemory;
+    svm::CoreCounters myCounters;
+    Immediate myPointer = 0x4;
+    svm::StackAccessor myStack{myMemory, myCounters, StackSegment, myPointer};
+
+    const std::array<Immediate, 4> myValues{0x1111, 0x2222, 0x3333, 0x4444};
+    EXPECT_EQ(myStack.pushAll(myValues), Trap::OK);
+    EXPECT_EQ(myPointer, 0xFFFC);
+    EXPECT_EQ(myMemory.read({.theAddress = StackBase + 0x2}).second, 0x1111);
+    EXPECT_EQ(myMemory.read({.theAddress = StackBase + 0xFFFC}).second, 0x4444);
+
+    std::array<Immediate, 4> myPopped{};
+    EXPECT_EQ(myStack.popAll(myPopped), Trap::OK);
+    EXPECT_EQ(myPopped, myValues);
+    EXPECT_EQ(myPointer, 0x4);
+
+    // A word at offset 0xFFFF has its high byte at offset 0
+    myPointer = 0x1;
+    EXPECT_EQ(myStack.push(0xABCD), Trap::OK);
+    EXPECT_EQ(myPointer, 0xFFFF);
+    EXPECT_EQ(myMemory.readByte({.theAddress = StackBase + 0xFFFF}).second, 0xCD);
+    EXPECT_EQ(myMemory.readByte({.theAddress = StackBase}).second, 0xAB);
+    EXPECT_EQ(myStack.pop().second, 0xABCD);
+    EXPECT_EQ(myPointer, 0x1);
+}
+
+TEST(StackAccessorTest, FaultLeavesPointerAlone)
+{
+    svm::RandomAccessMemory myMemory;
+    svm::CoreCounters myCounters;
+    Immediate myPointer = 0x20;
+    // FFFF:0018 lies past the end of memory
+    svm::StackAccessor myStack{myMemory, myCounters, 0xFFFF, myPointer};
+
+    const std::array<Immediate, 4> myValues{};
+    EXPECT_EQ(myStack.pushAll(myValues), Trap::SEG_FAULT);
+    EXPECT_EQ(myStack.push(1), Trap::SEG_FAULT);
+    EXPECT_EQ(myPointer, 0x20);
+}
@@ -0,0 +1,152 @@
+#include "aot_runtime.hpp"
+#include "arch.hpp"
+#include "memory.hpp"
+#include "single_core.hpp"
+#include "static_recompiler.hpp"
+#include "trap.hpp"
+
+#include <array>
+#include <gtest/gtest.h>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+using Regs = svm::arch::Regs;
+using MemoryAddr = svm::arch::MemoryAddress;
+using Trap = svm::Trap;
+
+// MOV CX, 3; again: INC AX; LOOP again; HLT
+constexpr std::array<std::uint8_t, 7> Program{0xB9, 0x03, 0x00, 0x40, 0xE2, 0xFD, 0xF4};
+constexpr std::array<std::uint8_t, 3> LoopBytes{0x40, 0xE2, 0xFD};
+constexpr std::array<std::uint16_t, 1> LoopInterpreted{0x104};
+
+// What SvmAot emits for the loop body, INC native and LOOP through its handler
+Trap loopBody(svm::SingleCore &aCore, const svm::DecodedInst *aInterpreted, std::uint32_t &aRetired) noexcept
+{
+    if (const auto myTrap = aCore.INC(Regs::AX); myTrap != Trap::OK)
+    {
+        aCore.writeRegister(Regs::IP, 0x103);
+        aRetired = 1;
+        return myTrap;
+    }
+    aCore.writeRegister(Regs::IP, 0x106);
+    const auto myTrap = aInterpreted[0].theHandler(aCore, aInterpreted[0]);
+    if (myTrap != Trap::OK)
+    {
+        aCore.writeRegister(Regs::IP, 0x104);
+    }
+    aRetired = 2;
+    return myTrap;
+}
+
+constexpr std::array<svm::CompiledBlock, 1> Blocks{{{.theSegment = 0,
+                                                     .theOffset = 0x103,
+                                                     .theBytes = LoopBytes,
+                                                     .theInstructions = 2,
+                                                     .theInterpreted = LoopInterpreted,
+                                                     .theBody = &loopBody}}};
+
+class StaticRecompilerTest : public ::testing::Test
+{
+  protected:
+    svm::RandomAccessMemory theMemory{};
+    svm::SingleCore theCpu{theMemory};
+
+    void SetUp() override
+    {
+        ASSERT_EQ(theMemory.writeBlock(MemoryAddr{.theAddress = 0x100}, Program), Trap::OK);
+        theCpu.writeRegister(Regs::IP, 0x100);
+        theCpu.writeRegister(Regs::SP, 0x1000);
+    }
+};
+
+TEST_F(StaticRecompilerTest, DiscoversBlocksReachableFromTheEntry)
+{
+    svm::RandomAccessMemory myMemory{};
+    const auto myProgram = svm::StaticRecompiler::discover(myMemory, Program, 0, 0x100, 0x100);
+
+    ASSERT_EQ(myProgram.theBlocks.size(), 3U);
+    EXPECT_EQ(myProgram.theBlocks[0].theOffset, 0x100);
+    EXPECT_EQ(myProgram.theBlocks[0].theInstructions.size(), 3U);
+    EXPECT_EQ(myProgram.theBlocks[0].theSuccessors, (std::vector<std::uint16_t>{0x103, 0x106}));
+    EXPECT_EQ(myProgram.theBlocks[1].theOffset, 0x103);
+    EXPECT_EQ(myProgram.theBlocks[1].theSuccessors, (std::vector<std::uint16_t>{0x103, 0x106}));
+    EXPECT_EQ(myProgram.theBlocks[2].theOffset, 0x106);
+    EXPECT_EQ(myProgram.theBlocks[2].theInstructions.size(), 1U);
+}
+
+TEST_F(StaticRecompilerTest, TranslatesPlainInstructionsAndInterpretsTransfers)
+{
+    svm::RandomAccessMemory myMemory{};
+    const auto myProgram = svm::StaticRecompiler::discover(myMemory, Program, 0, 0x100, 0x100);
+    const auto &myFirst = myProgram.theBlocks[0].theInstructions;
+    EXPECT_TRUE(svm::StaticRecompiler::isNative(myFirst[0].theDecoded));
+    EXPECT_TRUE(svm::StaticRecompiler::isNative(myFirst[1].theDecoded));
+    EXPECT_FALSE(svm::StaticRecompiler::isNative(myFirst[2].theDecoded));
+    EXPECT_FALSE(svm::StaticRecompiler::isNative(myProgram.theBlocks[2].theInstructions[0].theDecoded));
+
+    std::ostringstream mySource;
+    svm::StaticRecompiler::emit(mySource, myProgram, "loop");
+    EXPECT_NE(mySource.str().find("aCore.MOV(Regs::CX, Immediate{0x0003})"), std::string::npos);
+    EXPECT_NE(mySource.str().find("aInterpreted[0].theHandler"), std::string::npos);
+    EXPECT_NE(mySource.str().find("int main()"), std::string::npos);
+}
+
+TEST_F(StaticRecompilerTest, RunsCompiledBlocksLikeTheInterpreter)
+{
+    svm::AotRuntime myRuntime{theCpu, theMemory, Blocks};
+    EXPECT_EQ(myRuntime.run(100), Trap::HALT);
+
+    EXPECT_EQ(theCpu.readRegister(Regs::AX), 3);
+    EXPECT_EQ(theCpu.readRegister(Regs::IP), 0x107);
+    // MOV, three INC and LOOP pairs and HLT
+    EXPECT_EQ(theCpu.instructionCount(), 8U);
+    EXPECT_EQ(myRuntime.stats().theCompiledBlocks, 2U);
+    EXPECT_EQ(myRuntime.stats().theInvalidations, 0U);
+}
+
+TEST_F(StaticRecompilerTest, InterpretsBlocksTheGuestStoredInto)
+{
+    svm::AotRuntime myRuntime{theCpu, theMemory, Blocks};
+    // INC AX becomes DEC AX
+    constexpr std::array<std::uint8_t, 1> myDec{0x48};
+    ASSERT_EQ(theMemory.writeBlock(MemoryAddr{.theAddress = 0x103}, myDec), Trap::OK);
+    EXPECT_EQ(myRuntime.run(100), Trap::HALT);
+
+    EXPECT_EQ(theCpu.readRegister(Regs::AX), 0xFFFD);
+    EXPECT_EQ(theCpu.instructionCount(), 8U);
+    EXPECT_EQ(myRuntime.stats().theCompiledBlocks, 0U);
+    EXPECT_EQ(myRuntime.stats().theInvalidations, 1U);
+}
+
+TEST_F(StaticRecompilerTest, StoresBesideCompiledBytesKeepTheBlock)
+{
+    svm::AotRuntime myRuntime{theCpu, theMemory, Blocks};
+    // Data on the block's page, just before and just after its bytes
+    ASSERT_EQ(theMemory.write(MemoryAddr{.theAddress = 0x101}, 0x0005), Trap::OK);
+    ASSERT_EQ(theMemory.writeByte(MemoryAddr{.theAddress = 0x106}, 0xF4), Trap::OK);
+    EXPECT_EQ(myRuntime.run(100), Trap::HALT);
+
+    EXPECT_EQ(theCpu.readRegister(Regs::AX), 5);
+    EXPECT_EQ(myRuntime.stats().theCompiledBlocks, 4U);
+    EXPECT_EQ(myRuntime.stats().theInvalidations, 0U);
+
+    // Once dropped the block's bytes are data too
+    constexpr std::array<std::uint8_t, 1> myDec{0x48};
+    ASSERT_EQ(theMemory.writeBlock(MemoryAddr{.theAddress = 0x103}, myDec), Trap::OK);
+    ASSERT_EQ(theMemory.writeBlock(MemoryAddr{.theAddress = 0x104}, std::array<std::uint8_t, 1>{0xE2}), Trap::OK);
+    EXPECT_EQ(myRuntime.stats().theInvalidations, 1U);
+}
+
+TEST_F(StaticRecompilerTest, IgnoresBlocksCompiledFromOtherBytes)
+{
+    constexpr std::array<std::uint8_t, 1> myDec{0x48};
+    ASSERT_EQ(theMemory.writeBlock(MemoryAddr{.theAddress = 0x103}, myDec), Trap::OK);
+    svm::AotRuntime myRuntime{theCpu, theMemory, Blocks};
+    EXPECT_EQ(myRuntime.run(100), Trap::HALT);
+
+    EXPECT_EQ(theCpu.readRegister(Regs::AX), 0xFFFD);
+    EXPECT_EQ(myRuntime.stats().theCompiledBlocks, 0U);
+}
+} // namespace
@@ -0,0 +1,81 @@
+#include "arch.hpp"
+#include "memory.hpp"
+#include "text_video.hpp"
+#include "trap.hpp"
+
+#include <gtest/gtest.h>
+#include <sstream>
+
+class TextModeVideoTest : public ::testing::Test
+{
+  protected:
+    using MemoryAddr = svm::arch::MemoryAddress;
+    using Trap = svm::Trap;
+    using Video = svm::TextModeVideo;
+    using Renderer = svm::HeadlessRenderer;
+
+    static constexpr auto BASE = Video::BaseAddress.theAddress;
+
+    svm::RandomAccessMemory theMemory{};
+    svm::TextModeVideo theVideo{theMemory};
+};
+
+TEST_F(TextModeVideoTest, ByteWriteMarksSingleCell)
+{
+    EXPECT_EQ(theMemory.writeByte(MemoryAddr{.theAddress = BASE + 2}, 'A'), Trap::OK);
+    ASSERT_EQ(theVideo.dirtyCount(), 1U);
+    EXPECT_EQ(theVideo.dirtyCells()[0], 1U);
+    EXPECT_EQ(theVideo.cell(1).theCharacter, 'A');
+}
+
+TEST_F(TextModeVideoTest, WordWriteFillsCharacterAndAttribute)
+{
+    EXPECT_EQ(theMemory.write(MemoryAddr{.theAddress = BASE}, 0x1F41), Trap::OK);
+    ASSERT_EQ(theVideo.dirtyCount(), 1U);
+    EXPECT_EQ(theVideo.cell(0).theCharacter, 'A');
+    EXPECT_EQ(theVideo.cell(0).theAttribute, 0x1F);
+}
+
+TEST_F(TextModeVideoTest, RepeatedWritesAreTrackedOnce)
+{
+    for (int i{}; i < 10; ++i)
+    {
+        EXPECT_EQ(theMemory.writeByte(MemoryAddr{.theAddress = BASE}, 'A' + i), Trap::OK);
+    }
+    EXPECT_EQ(theVideo.dirtyCount(), 1U);
+}
+
+TEST_F(TextModeVideoTest, WritesOutsideFramebufferAreIgnored)
+{
+    EXPECT_EQ(theMemory.writeByte(MemoryAddr{.theAddress = BASE - 1}, 'A'), Trap::OK);
+    EXPECT_EQ(theMemory.writeByte(MemoryAddr{.theAddress = BASE + Video::BufferSize}, 'A'), Trap::OK);
+    EXPECT_EQ(theMemory.writeByte(MemoryAddr{.theAddress = 0x1234}, 'A'), Trap::OK);
+    EXPECT_EQ(theVideo.dirtyCount(), 0U);
+}
+
+TEST_F(TextModeVideoTest, LogRendererEmitsOnlyChangedCells)
+{
+    std::ostringstream myStream;
+    Renderer myRenderer{theVideo, myStream, Renderer::Mode::Log};
+
+    EXPECT_EQ(theMemory.write(MemoryAddr{.theAddress = BASE + Video::Columns * 2}, 0x0748), Trap::OK);
+    EXPECT_EQ(theMemory.write(MemoryAddr{.theAddress = BASE}, 0x0749), Trap::OK);
+
+    EXPECT_EQ(myRenderer.flush(), 2U);
+    EXPECT_EQ(myStream.str(), "0,0 I 07\n1,0 H 07\n");
+    EXPECT_EQ(theVideo.dirtyCount(), 0U);
+
+    EXPECT_EQ(myRenderer.flush(), 0U);
+}
+
+TEST_F(TextModeVideoTest, TerminalRendererSkipsCursorMovesForAdjacentCells)
+{
+    std::ostringstream myStream;
+    Renderer myRenderer{theVideo, myStream, Renderer::Mode::Terminal};
+
+    EXPECT_EQ(theMemory.write(MemoryAddr{.theAddress = BASE}, 0x0748), Trap::OK);
+    EXPECT_EQ(theMemory.write(MemoryAddr{.theAddress = BASE + 2}, 0x0749), Trap::OK);
+
+    EXPECT_EQ(myRenderer.flush(), 2U);
+    EXPECT_EQ(myStream.str(), "\x1b[1;1H\x1b[0;37;40mHI");
+}
@@ -0,0 +1,160 @@
+#include "arch.hpp"
+#include "memory.hpp"
+#include "port_bus.hpp"
+#include "single_core.hpp"
+#include "trace.hpp"
+#include "trap.hpp"
+
+#include <algorithm>
+#include <array>
+#include <gtest/gtest.h>
+#include <span>
+#include <sstream>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace
+{
+using Regs = svm::arch::Regs;
+using MemoryAddr = svm::arch::MemoryAddress;
+using Trap = svm::Trap;
+using Category = svm::trace::Category;
+using Event = svm::trace::Event;
+
+struct NullService : svm::InterruptService
+{
+    Trap onInterrupt(svm::SingleCore &) noexcept override
+    {
+        return Trap::OK;
+    }
+};
+
+std::vector<Event> named(const std::vector<Event> &aEvents, std::string_view aName)
+{
+    std::vector<Event> myEvents;
+    std::ranges::copy_if(aEvents, std::back_inserter(myEvents),
+                         [&](const Event &aEvent) { return aName == aEvent.theName; });
+    return myEvents;
+}
+
+class TraceTest : public ::testing::Test
+{
+  protected:
+    svm::RandomAccessMemory theMemory{};
+    svm::SingleCore theCpu{theMemory};
+    svm::PortBus theBus{};
+    NullService theService{};
+
+    void SetUp() override
+    {
+        if constexpr (!svm::trace::ENABLED)
+        {
+            GTEST_SKIP() << "built without SVM_TRACE";
+        }
+        theCpu.attachPortBus(&theBus);
+        theCpu.attachService(0x21, &theService);
+        theCpu.writeRegister(Regs::SP, 0x1000);
+    }
+
+    // Runs aCode from 0000:0100, it has to end in HLT
+    void run(std::span<const std::uint8_t> aCode)
+    {
+        ASSERT_EQ(theMemory.writeBlock(MemoryAddr{.theAddress = 0x100}, aCode), Trap::OK);
+        theCpu.writeRegister(Regs::IP, 0x100);
+        ASSERT_EQ(theCpu.run(1000), Trap::HALT);
+    }
+};
+
+// OUT 80h, AL four times; INT 21h; HLT
+constexpr std::array<std::uint8_t, 11> Program{0xE6, 0x80, 0xE6, 0x80, 0xE6, 0x80, 0xE6, 0x80, 0xCD, 0x21, 0xF4};
+
+TEST_F(TraceTest, NothingIsRecordedOutsideASession)
+{
+    run(Program);
+    {
+        svm::TraceSession mySession;
+        mySession.stop();
+        run(Program);
+        EXPECT_EQ(mySession.threadCount(), 0U);
+    }
+    EXPECT_FALSE(svm::trace::isActive());
+}
+
+TEST_F(TraceTest, RunSlicesCarryRetiredInstructionsAndPortBursts)
+{
+    svm::TraceSession mySession;
+    run(Program);
+    mySession.stop();
+
+    ASSERT_EQ(mySession.threadCount(), 1U);
+    const auto myEvents = mySession.events(0);
+    const auto myRuns = named(myEvents, "run");
+    ASSERT_EQ(myRuns.size(), 1U);
+    EXPECT_TRUE(myRuns[0].theIsSlice);
+    EXPECT_EQ(myRuns[0].theCategory, Category::Run);
+    EXPECT_EQ(myRuns[0].theValue, 6U);
+
+    // Back to back writes form one burst counting them
+    const auto myOuts = named(myEvents, "out");
+    ASSERT_EQ(myOuts.size(), 1U);
+    EXPECT_EQ(myOuts[0].theValue, 4U);
+    const auto myServices = named(myEvents, "service");
+    ASSERT_EQ(myServices.size(), 1U);
+    EXPECT_EQ(myServices[0].theValue, 0x21U);
+    // Both lie inside the run slice
+    EXPECT_GE(myOuts[0].theBegin, myRuns[0].theBegin);
+    EXPECT_LE(myServices[0].theBegin + myServices[0].theDuration, myRuns[0].theBegin + myRuns[0].theDuration);
+}
+
+TEST_F(TraceTest, DeliveredInterruptsAreInstants)
+{
+    // Handler: IRET
+    ASSERT_EQ(theMemory.write({.theAddress = 0x08 * 4}, 0x0200), Trap::OK);
+    ASSERT_EQ(theMemory.writeByte({.theAddress = 0x200}, 0xCF), Trap::OK);
+    // STI; HLT; HLT
+    constexpr std::array<std::uint8_t, 3> myCode{0xFB, 0xF4, 0xF4};
+    run(myCode);
+    theCpu.raiseInterrupt(0x08);
+
+    svm::TraceSession mySession;
+    ASSERT_EQ(theCpu.run(1000), Trap::HALT);
+    mySession.stop();
+
+    const auto myInterrupts = named(mySession.events(0), "interrupt");
+    ASSERT_EQ(myInterrupts.size(), 1U);
+    EXPECT_FALSE(myInterrupts[0].theIsSlice);
+    EXPECT_EQ(myInterrupts[0].theValue, 0x08U);
+}
+
+TEST_F(TraceTest, ThreadsRecordIntoTracksOfTheirOwn)
+{
+    svm::TraceSession mySession{2};
+    svm::trace::nameThread("main");
+    svm::trace::instant(Category::HostIo, "first");
+    {
+        std::jthread myThread{[] {
+            svm::trace::nameThread("worker");
+            for (int i{}; i < 5; ++i)
+            {
+                svm::trace::instant(Category::Device, "tick", static_cast<std::uint64_t>(i));
+            }
+        }};
+    }
+    mySession.stop();
+
+    ASSERT_EQ(mySession.threadCount(), 2U);
+    EXPECT_EQ(mySession.events(0).size(), 1U);
+    EXPECT_EQ(mySession.events(1).size(), 2U);
+    EXPECT_EQ(mySession.dropped(), 3U);
+
+    std::ostringstream myJson;
+    mySession.write(myJson);
+    const auto myText = myJson.str();
+    EXPECT_TRUE(myText.starts_with("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["));
+    EXPECT_NE(myText.find("\"args\":{\"name\":\"worker\"}"), std::string::npos);
+    EXPECT_NE(myText.find("{\"ph\":\"i\",\"s\":\"t\",\"cat\":\"device\",\"name\":\"tick\",\"pid\":1,\"tid\":1,"),
+              std::string::npos);
+    EXPECT_NE(myText.find("\"otherData\":{\"dropped\":\"3\"}"), std::string::npos);
+}
+} // namespace
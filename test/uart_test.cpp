@@ -0,0 +1,173 @@
+#include "arch.hpp"
+#include "device_scheduler.hpp"
+#include "guest_fixture.hpp"
+#include "memory.hpp"
+#include "port_bus.hpp"
+#include "single_core.hpp"
+#include "trap.hpp"
+#include "uart.hpp"
+
+#include <gtest/gtest.h>
+#include <initializer_list>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+using Trap = svm::Trap;
+using Regs = svm::arch::Regs;
+using Uart = svm::Uart;
+constexpr auto Byte = svm::arch::OperandSize::Byte;
+
+class UartTest : public ::testing::Test
+{
+  protected:
+    svm::RandomAccessMemory theMemory{};
+    svm::SingleCore theCpu{theMemory};
+    svm::PortBus theBus{};
+    int thePipe[2]{-1, -1};
+
+    void SetUp() override
+    {
+        ASSERT_EQ(::pipe2(thePipe, O_NONBLOCK), 0);
+        theCpu.attachPortBus(&theBus);
+    }
+
+    void TearDown() override
+    {
+        ::close(thePipe[0]);
+        ::close(thePipe[1]);
+    }
+
+    std::string drain()
+    {
+        std::string myText(4096, '\0');
+        const auto myRead = ::read(thePipe[0], myText.data(), myText.size());
+        myText.resize(myRead > 0 ? static_cast<std::size_t>(myRead) : 0U);
+        return myText;
+    }
+};
+
+TEST_F(UartTest, GuestOutputIsBatched)
+{
+    Uart myUart{theCpu, thePipe[1]};
+    theBus.attach(myUart, Uart::BasePort, Uart::PortCount);
+    // MOV DX, 3F8h; MOV AX, 'H'; OUT DX, AL; MOV AX, 'i'; OUT DX, AL; MOV DX, 3FDh; IN AL, DX; HLT
+    svm::test::loadProgram(theMemory, theCpu, {0xBA, 0xF8, 0x03, 0xB8, 0x48, 0x00, 0xEE, 0xB8, 0x69, 0x00, 0xEE, 0xBA,
+                                               0xFD, 0x03, 0xEC, 0xF4});
+
+    EXPECT_EQ(theCpu.run(100), Trap::HALT);
+    EXPECT_EQ(theCpu.readRegister(Regs::AX) & 0xFF, Uart::TransmitHoldingEmpty | Uart::TransmitterEmpty);
+    EXPECT_EQ(myUart.transmitted(), 2U);
+    EXPECT_EQ(myUart.flushes(), 0U);
+    EXPECT_EQ(drain(), "");
+
+    EXPECT_TRUE(myUart.flush());
+    EXPECT_EQ(drain(), "Hi");
+}
+
+TEST_F(UartTest, FullBatchIsWrittenInOneGo)
+{
+    {
+        Uart myUart{theCpu, thePipe[1], Uart::BasePort, Uart::DefaultVector, 4};
+        for (const char myChar : std::string{"0123456789"})
+        {
+            myUart.out(Uart::BasePort, static_cast<std::uint8_t>(myChar), Byte);
+        }
+        EXPECT_EQ(myUart.flushes(), 2U);
+        EXPECT_EQ(drain(), "01234567");
+    }
+    // The tail goes out on destruction
+    EXPECT_EQ(drain(), "89");
+}
+
+TEST_F(UartTest, NewlineWritesUnlessTheLastWriteIsRecent)
+{
+    Uart myUart{theCpu, thePipe[1]};
+    for (const char myChar : std::string{"a\nb\n"})
+    {
+        myUart.out(Uart::BasePort, static_cast<std::uint8_t>(myChar), Byte);
+    }
+    // The second line came within the flush delay of the first and waits
+    EXPECT_EQ(myUart.flushes(), 1U);
+    EXPECT_EQ(drain(), "a\n");
+    EXPECT_TRUE(myUart.flush());
+    EXPECT_EQ(drain(), "b\n");
+}
+
+TEST_F(UartTest, SchedulerWritesWhatAnIdleGuestLeftQueued)
+{
+    svm::DeviceScheduler myScheduler;
+    Uart myUart{theCpu, thePipe[1], Uart::BasePort, Uart::DefaultVector, Uart::DefaultBatchSize, 1000};
+    ASSERT_TRUE(myUart.attachScheduler(myScheduler));
+    theBus.attach(myUart, Uart::BasePort, Uart::PortCount);
+    // MOV DX, 3F8h; MOV AX, 'x'; OUT DX, AL; STI; HLT; HLT
+    svm::test::loadProgram(theMemory, theCpu, {0xBA, 0xF8, 0x03, 0xB8, 0x78, 0x00, 0xEE, 0xFB, 0xF4, 0xF4});
+
+    EXPECT_EQ(myScheduler.run(theCpu, 1000000), Trap::HALT);
+    EXPECT_EQ(myUart.flushes(), 1U);
+    EXPECT_EQ(drain(), "x");
+    // The wait was skipped, not spent executing
+    EXPECT_LT(theCpu.instructionCount(), 10U);
+    EXPECT_GE(myScheduler.now(), 1000U);
+}
+
+TEST_F(UartTest, ReceivedBytesSetDataReadyAndInterrupt)
+{
+    Uart myUart{theCpu, -1};
+    EXPECT_EQ(myUart.in(Uart::BasePort + Uart::InterruptId, Byte), 0x01);
+    myUart.out(Uart::BasePort + Uart::InterruptEnable, Uart::ReceiveInterrupt, Byte);
+    myUart.receive('a');
+    myUart.receive('b');
+
+    EXPECT_EQ(myUart.in(Uart::BasePort + Uart::LineStatus, Byte) & Uart::DataReady, Uart::DataReady);
+    EXPECT_EQ(myUart.in(Uart::BasePort + Uart::InterruptId, Byte), 0x04);
+    EXPECT_EQ(myUart.in(Uart::BasePort, Byte), 'a');
+    EXPECT_EQ(myUart.in(Uart::BasePort, Byte), 'b');
+    EXPECT_EQ(myUart.in(Uart::BasePort + Uart::LineStatus, Byte) & Uart::DataReady, 0);
+    EXPECT_EQ(myUart.in(Uart::BasePort + Uart::InterruptId, Byte), 0x01);
+
+    // Vector 0Ch -> 0000:0200: IN AL, DX; HLT with DX = 3F8h
+    svm::test::loadHandler(theMemory, Uart::DefaultVector, {0xEC, 0xF4});
+    // STI; JMP $
+    svm::test::loadProgram(theMemory, theCpu, {0xFB, 0xEB, 0xFE});
+    theBus.attach(myUart, Uart::BasePort, Uart::PortCount);
+    theCpu.writeRegister(Regs::SP, 0x800);
+    theCpu.writeRegister(Regs::DX, Uart::BasePort);
+    myUart.receive('c');
+    EXPECT_EQ(theCpu.run(100), Trap::HALT);
+    EXPECT_EQ(theCpu.readRegister(Regs::AX) & 0xFF, 'c');
+}
+
+TEST_F(UartTest, HostSourceOverrunIsReported)
+{
+    Uart myUart{theCpu, -1};
+    const std::string myInput(Uart::ReceiveCapacity + 1, 'x');
+    ASSERT_EQ(::write(thePipe[1], myInput.data(), myInput.size()), static_cast<long>(myInput.size()));
+    long myTotal{};
+    for (auto myRead = myUart.receiveFrom(thePipe[0]); myRead > 0; myRead = myUart.receiveFrom(thePipe[0]))
+    {
+        myTotal += myRead;
+    }
+    EXPECT_EQ(myTotal, static_cast<long>(myInput.size()));
+
+    const auto myStatus = myUart.in(Uart::BasePort + Uart::LineStatus, Byte);
+    EXPECT_EQ(myStatus & (Uart::DataReady | Uart::OverrunError), Uart::DataReady | Uart::OverrunError);
+    EXPECT_EQ(myUart.in(Uart::BasePort + Uart::LineStatus, Byte) & Uart::OverrunError, 0);
+}
+
+TEST_F(UartTest, DivisorLatchSharesDataPorts)
+{
+    Uart myUart{theCpu, thePipe[1]};
+    myUart.out(Uart::BasePort + Uart::LineControl, 0x80, Byte);
+    myUart.out(Uart::BasePort, 0x01, Byte);
+    myUart.out(Uart::BasePort + Uart::InterruptEnable, 0x00, Byte);
+    EXPECT_EQ(myUart.in(Uart::BasePort, Byte), 0x01);
+    myUart.out(Uart::BasePort + Uart::LineControl, 0x03, Byte);
+    myUart.out(Uart::BasePort + Uart::Scratch, 0x5A, Byte);
+    EXPECT_EQ(myUart.in(Uart::BasePort + Uart::Scratch, Byte), 0x5A);
+    EXPECT_EQ(myUart.transmitted(), 0U);
+}
+} // namespace
@@ -0,0 +1,43 @@
+// Compiles a guest program to C++ ahead of time.
+//
+//   SvmAot IMAGE OUTPUT.cpp
+//
+// The image loads like Svm loads it, at 0000:0100, and the output builds into a program that runs it on compiled
+// blocks where discovery reached and on the interpreter everywhere else. Link it against Svm_Lib.
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+
+#include "guest_program.hpp"
+#include "memory.hpp"
+#include "static_recompiler.hpp"
+
+int main(int aArgc, char **aArgv)
+{
+    if (aArgc != 3)
+    {
+        std::cerr << "usage: SvmAot IMAGE OUTPUT.cpp\n";
+        return 2;
+    }
+    const std::filesystem::path myImagePath{aArgv[1]};
+    const auto myImage = svm::GuestProgram::load(myImagePath);
+    if (!myImage)
+    {
+        std::cerr << "SvmAot: cannot load " << myImagePath.string() << '\n';
+        return 2;
+    }
+
+    constexpr auto myOffset = static_cast<std::uint16_t>(svm::GuestProgram::LoadAddress);
+    const auto myMemory = std::make_unique<svm::RandomAccessMemory>();
+    const auto myProgram = svm::StaticRecompiler::discover(*myMemory, *myImage, 0, myOffset, myOffset);
+    std::ofstream myOutput{aArgv[2]};
+    svm::StaticRecompiler::emit(myOutput, myProgram, myImagePath.stem().string());
+    if (!myOutput)
+    {
+        std::cerr << "SvmAot: cannot write " << aArgv[2] << '\n';
+        return 2;
+    }
+    return EXIT_SUCCESS;
+}